@@ -1,8 +1,15 @@
 #include <LoRa.h>
 #include <Streaming.h>
+#include <NanodroneTelemetry.h>
 
 #define SYS_LED 6
 
+//! Prefix of the telemetry packets forwarded to the ground station
+#define TLM_LINE_PREFIX "TLM "
+
+//! The received packet buffer
+uint8_t packet[TLM_MAX_PACKET];
+
 void setup() {
   // Initialize the monitoring serial
   Serial.begin(38400);
@@ -21,6 +28,17 @@ void setup() {
   }
 }
 
+//! Forward the packet as a single hex line. The ground station decodes it.
+void forwardPacket(uint8_t* data, int length) {
+  Serial1.print(TLM_LINE_PREFIX);
+  for(int j = 0; j < length; j++) {
+    if(data[j] < 0x10) {
+      Serial1.print('0');
+    }
+    Serial1.print(data[j], HEX);
+  }
+  Serial1.println();
+}
 
 void loop() {
   int packetSize = LoRa.parsePacket();
@@ -33,10 +51,19 @@ void loop() {
     digitalWrite(SYS_LED, HIGH);
     Serial << "Receiving LoRa packet of " << packetSize << " bytes" << endl;
     // read packet
+    int length = 0;
     while (LoRa.available()) {
-      String inPacket = LoRa.readString();
-      Serial << "Sending >>" << inPacket << endl;
-      Serial1.println(inPacket); 
+      uint8_t c = LoRa.read();
+      if(length < TLM_MAX_PACKET) {
+        packet[length++] = c;
+      }
+    }
+    if(packetSize <= TLM_MAX_PACKET) {
+      Serial << "Sending >> drone " << telemetryDroneId(packet, length) << 
+          " RSSI " << LoRa.packetRssi() << endl;
+      forwardPacket(packet, length);
+    } else {
+      Serial << "Packet too long, dropped" << endl;
     }
     digitalWrite(SYS_LED, LOW);
   }
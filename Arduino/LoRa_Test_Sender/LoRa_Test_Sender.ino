@@ -1,22 +1,45 @@
 #include <SPI.h>
 #include <LoRa.h>
 #include <Streaming.h>
+#include <NanodroneTelemetry.h>
+#include <DownlinkScheduler.h>
+
+//! The drone id sent with the telemetry
+#define DRONE_ID 1
+//! Milliseconds between two test updates
+#define UPDATE_INTERVAL 5000
 
 int counter = 0;
-String val="";
+//! Time of the last test update
+unsigned long lastUpdate = 0;
+//! Packets are sent by the scheduler within the duty-cycle budget
+DownlinkScheduler scheduler(DRONE_ID);
+//! Encoded packet buffer
+uint8_t packet[TLM_MAX_PACKET];
 
 void setup() {
  if (!LoRa.begin(915E6)) {
     Serial.println("Starting LoRa failed!");
     while (1);
   }
+  // The test updates are health stats, send them as soon as possible
+  scheduler.setHoldoff(DL_HEALTH, 0);
 }
 
 void loop() {
-  LoRa.beginPacket();
-  LoRa << "Nanodrone test " << counter << endl;
-  LoRa.endPacket();
-  counter++; // this help keep track if the packet is recived on the sender side
+  unsigned long now = millis();
+
+  // Test update with the frame counter only
+  if(now - lastUpdate >= UPDATE_INTERVAL) {
+    lastUpdate = now;
+    scheduler.postHealth(counter, 0, 0, 0, now);
+    counter++; // this help keep track if the packet is recived on the sender side
+  }
 
-  delay(5000);
+  int length = scheduler.poll(now, packet, sizeof(packet));
+  if(length > 0) {
+    LoRa.beginPacket();
+    LoRa.write(packet, length);
+    LoRa.endPacket();
+  }
 }
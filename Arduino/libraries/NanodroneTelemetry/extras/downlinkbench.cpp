@@ -0,0 +1,92 @@
+/**
+ * @file downlinkbench.cpp
+ * @brief Simulated clock run of the downlink scheduler against the naive
+ * "send every update" loop of the test sketches.
+ *
+ * The simulated drone posts a GPS fix every second, the health stats every
+ * capture (6 s) and bursts of person detections. The clock advances by
+ * BENCH_STEP_MS and the scheduler is polled at every step, as in the main
+ * loop of a sketch.
+ *
+ * Usage: downlinkbench [seconds] [sf]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include "DownlinkScheduler.h"
+
+using namespace std;
+
+//! Default simulated time, s
+#define BENCH_SECONDS 3600
+//! Clock step, ms
+#define BENCH_STEP_MS 10
+
+int main(int argc, char* argv[]) {
+    uint32_t seconds = (argc > 1) ? atoi(argv[1]) : BENCH_SECONDS;
+    uint8_t sf = (argc > 2) ? atoi(argv[2]) : 7;
+    DownlinkScheduler scheduler(1, DL_DEFAULT_DUTY_PPM, DL_DEFAULT_BURST_MS, sf);
+    TelemetryEncoder naive;
+    TelemetryUpdate u = {};
+    uint8_t packet[TLM_MAX_PACKET];
+    uint64_t naiveAir = 0;
+    uint32_t naivePackets = 0;
+    uint16_t frame = 0;
+    uint32_t seed = 1;
+
+    u.droneId = 1;
+    for(uint32_t t = 0; t < seconds * 1000; t += BENCH_STEP_MS) {
+        uint8_t fields = 0;
+        if(t % 1000 == 0) {
+            u.latitude = 395696000 + (int32_t)(t / 100);
+            u.longitude = 26502000 - (int32_t)(t / 200);
+            u.altitude = 450;
+            scheduler.postGPS(u.latitude, u.longitude, u.altitude, t);
+            fields |= TLM_HAS_GPS;
+        }
+        if(t % 6000 == 0) {
+            u.frame = ++frame;
+            u.lightIndex = 180;
+            u.lightPerc = 30;
+            scheduler.postHealth(u.frame, u.lightIndex, u.lightPerc, 0, t);
+            fields |= TLM_HAS_EXPOSURE;
+        }
+        // A person is in view for ~10% of the time, one inference per second
+        seed = seed * 1103515245 + 12345;
+        if(t % 1000 == 500 && ((t / 60000) % 10 == 3)) {
+            u.personScore = (uint8_t)(160 + (seed >> 16) % 60);
+            u.noPersonScore = 255 - u.personScore;
+            scheduler.postDetection(u.personScore, u.noPersonScore, t);
+            fields |= TLM_HAS_DETECTION;
+        }
+
+        // Naive loop: one packet every update
+        if(fields) {
+            u.fields = fields;
+            naiveAir += loraAirtimeUs(naive.encode(&u, packet, sizeof(packet)), sf);
+            naivePackets++;
+        }
+
+        scheduler.poll(t, packet, sizeof(packet));
+    }
+
+    DownlinkStats* s = scheduler.getStats();
+    const char* names[DL_CLASSES] = { "alert ", "gps   ", "health" };
+    double total = seconds * 1e6;
+
+    cout << fixed << setprecision(2) <<
+            "Simulated " << seconds << " s at SF" << (int)sf << ", duty 1%" << endl <<
+            "naive      packets " << naivePackets << " airtime " <<
+            naiveAir * 100.0 / total << "%" << endl <<
+            "scheduler  packets " << s->packets << " airtime " <<
+            s->airtimeUs * 100.0 / total << "% deferred polls " << s->deferred << endl <<
+            "class   posted  coalesced  sent  avg latency ms  max latency ms" << endl;
+    for(int c = 0; c < DL_CLASSES; c++) {
+        cout << names[c] << setw(9) << s->posted[c] << setw(11) << s->coalesced[c] <<
+                setw(6) << s->sent[c] << setw(16) <<
+                (s->sent[c] ? (double)s->sumLatencyMs[c] / s->sent[c] : 0) <<
+                setw(16) << s->maxLatencyMs[c] << endl;
+    }
+    return 0;
+}
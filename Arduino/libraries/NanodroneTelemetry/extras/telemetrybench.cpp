@@ -0,0 +1,116 @@
+/**
+ * @file telemetrybench.cpp
+ * @brief Bytes per update and encode cost of the binary telemetry codec
+ * compared with the text format of the LoRa test sketches.
+ *
+ * A simulated survey flight (slow drift, hover and turns) is encoded with both
+ * formats. Every binary packet is decoded back and compared with the source
+ * update to check the codec round trip.
+ *
+ * Usage: telemetrybench [updates]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "NanodroneTelemetry.h"
+
+using namespace std;
+
+//! Default number of simulated updates
+#define BENCH_UPDATES 100000
+
+//! Monotonic clock in nanoseconds
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//! Simulated flight: one update every 6 s (firstfly default interval)
+static void simulate(TelemetryUpdate* u, int j) {
+    double t = j * 6.0;
+    u->droneId = 1;
+    u->fields = TLM_HAS_GPS | TLM_HAS_EXPOSURE | TLM_HAS_DETECTION;
+    u->frame = (uint16_t)j;
+    // About 2 m/s on a slow circle around Palma
+    u->latitude = (int32_t)((39.5696 + 0.0005 * sin(t / 300)) * TLM_DEG_SCALE);
+    u->longitude = (int32_t)((2.6502 + 0.0005 * cos(t / 300)) * TLM_DEG_SCALE);
+    u->altitude = (int16_t)((45.0 + 3 * sin(t / 60)) * TLM_ALT_SCALE);
+    u->lightIndex = (uint8_t)(180 + j % 7);
+    u->lightPerc = (uint8_t)(30 + j % 5);
+    u->eqLoops = (uint8_t)(j % 3);
+    u->personScore = (uint8_t)(j % 97 < 5 ? 200 : 20 + j % 11);
+    u->noPersonScore = (uint8_t)(255 - u->personScore);
+}
+
+//! Same fields in the text format of the test sketches
+static int encodeText(const TelemetryUpdate* u, char* out, size_t size) {
+    return snprintf(out, size, "Nanodrone %d frame %u lat %.7f lon %.7f alt %.1f "
+                    "light %.3f %u%% eq %u person %u no %u\n",
+                    u->droneId, u->frame,
+                    (double)u->latitude / TLM_DEG_SCALE,
+                    (double)u->longitude / TLM_DEG_SCALE,
+                    (double)u->altitude / TLM_ALT_SCALE,
+                    u->lightIndex / 255.0, u->lightPerc, u->eqLoops,
+                    u->personScore, u->noPersonScore);
+}
+
+int main(int argc, char* argv[]) {
+    int updates = (argc > 1) ? atoi(argv[1]) : BENCH_UPDATES;
+    TelemetryEncoder encoder;
+    TelemetryDecoder decoder;
+    TelemetryUpdate u, d;
+    uint8_t packet[TLM_MAX_PACKET];
+    char text[128];
+    uint64_t binBytes = 0, textBytes = 0, binAir = 0, textAir = 0;
+    double binNs = 0, textNs = 0, t;
+    int errors = 0, keys = 0;
+
+    if(updates <= 0) {
+        updates = BENCH_UPDATES;
+    }
+
+    for(int j = 0; j < updates; j++) {
+        simulate(&u, j);
+
+        t = nowNs();
+        int n = encoder.encode(&u, packet, sizeof(packet));
+        binNs += nowNs() - t;
+
+        t = nowNs();
+        int m = encodeText(&u, text, sizeof(text));
+        textNs += nowNs() - t;
+
+        binBytes += n;
+        textBytes += m;
+        binAir += loraAirtimeUs(n);
+        textAir += loraAirtimeUs(m);
+        keys += (packet[1] & TLM_KEY) ? 1 : 0;
+
+        memset(&d, 0, sizeof(d));
+        if((decoder.decode(packet, n, &d) != TLM_OK) ||
+           (d.frame != u.frame) || (d.latitude != u.latitude) ||
+           (d.longitude != u.longitude) || (d.altitude != u.altitude) ||
+           (d.personScore != u.personScore) || (d.eqLoops != u.eqLoops)) {
+            errors++;
+        }
+    }
+
+    cout << fixed << setprecision(1) <<
+            "Updates " << updates << " (" << keys << " key packets)" << endl <<
+            "Format   bytes/update  encode ns/update  airtime ms (SF7 125k)" << endl <<
+            "text     " << setw(12) << (double)textBytes / updates <<
+            setw(18) << textNs / updates <<
+            setw(23) << (double)textAir / updates / 1000 << endl <<
+            "binary   " << setw(12) << (double)binBytes / updates <<
+            setw(18) << binNs / updates <<
+            setw(23) << (double)binAir / updates / 1000 << endl <<
+            "Round trip errors " << errors << endl;
+
+    return errors ? 1 : 0;
+}
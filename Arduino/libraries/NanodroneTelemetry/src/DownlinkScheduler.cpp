@@ -0,0 +1,171 @@
+/**
+ * @file DownlinkScheduler.cpp
+ * @brief Priority-queued LoRa downlink scheduler with duty-cycle budgeting.
+ *
+ */
+
+#include <string.h>
+#include "DownlinkScheduler.h"
+
+namespace {
+
+//! Telemetry fields carried by every priority class
+const uint8_t kClassFields[DL_CLASSES] = {
+    TLM_HAS_DETECTION, TLM_HAS_GPS, TLM_HAS_EXPOSURE
+};
+
+}  // namespace
+
+DownlinkScheduler::DownlinkScheduler(uint16_t droneId, uint32_t dutyPpm,
+                                     uint32_t burstMs, uint8_t sf) {
+    memset(&update, 0, sizeof(update));
+    memset(&stats, 0, sizeof(stats));
+    update.droneId = droneId;
+    duty = dutyPpm;
+    spreading = sf;
+    // Airtime earned in the burst period: burstMs * 1000 us * duty / 1e6
+    bucketUs = (uint32_t)((uint64_t)burstMs * dutyPpm / 1000);
+    budget = bucketUs;
+    refillMs = 0;
+    holdoffMs[DL_ALERT] = DL_HOLDOFF_ALERT;
+    holdoffMs[DL_GPS] = DL_HOLDOFF_GPS;
+    holdoffMs[DL_HEALTH] = DL_HOLDOFF_HEALTH;
+    for(int c = 0; c < DL_CLASSES; c++) {
+        isPending[c] = false;
+        postedMs[c] = 0;
+    }
+}
+
+void DownlinkScheduler::setHoldoff(uint8_t priority, uint32_t ms) {
+    if(priority < DL_CLASSES) {
+        holdoffMs[priority] = ms;
+    }
+}
+
+DownlinkStats* DownlinkScheduler::getStats() {
+    return &stats;
+}
+
+uint8_t DownlinkScheduler::pending() {
+    uint8_t n = 0;
+    for(int c = 0; c < DL_CLASSES; c++) {
+        n += isPending[c] ? 1 : 0;
+    }
+    return n;
+}
+
+uint32_t DownlinkScheduler::budgetUs(uint32_t nowMs) {
+    refill(nowMs);
+    return budget;
+}
+
+void DownlinkScheduler::markPending(uint8_t priority, uint32_t nowMs) {
+    stats.posted[priority]++;
+    if(isPending[priority]) {
+        // Only the latest value is sent, the holdoff runs from the oldest
+        stats.coalesced[priority]++;
+    } else {
+        isPending[priority] = true;
+        postedMs[priority] = nowMs;
+    }
+}
+
+void DownlinkScheduler::postDetection(uint8_t personScore, uint8_t noPersonScore,
+                                      uint32_t nowMs) {
+    update.personScore = personScore;
+    update.noPersonScore = noPersonScore;
+    markPending(DL_ALERT, nowMs);
+}
+
+void DownlinkScheduler::postGPS(int32_t latitude, int32_t longitude,
+                                int16_t altitude, uint32_t nowMs) {
+    update.latitude = latitude;
+    update.longitude = longitude;
+    update.altitude = altitude;
+    markPending(DL_GPS, nowMs);
+}
+
+void DownlinkScheduler::postHealth(uint16_t frame, uint8_t lightIndex,
+                                   uint8_t lightPerc, uint8_t eqLoops,
+                                   uint32_t nowMs) {
+    update.frame = frame;
+    update.lightIndex = lightIndex;
+    update.lightPerc = lightPerc;
+    update.eqLoops = eqLoops;
+    markPending(DL_HEALTH, nowMs);
+}
+
+void DownlinkScheduler::refill(uint32_t nowMs) {
+    // Unsigned difference, safe across the millis() wrap
+    uint32_t elapsed = nowMs - refillMs;
+    uint64_t b = budget + (uint64_t)elapsed * duty / 1000;
+    budget = (b > bucketUs) ? bucketUs : (uint32_t)b;
+    refillMs = nowMs;
+}
+
+int DownlinkScheduler::encodeClasses(uint8_t classes, uint8_t* packet,
+                                     size_t size) {
+    update.fields = 0;
+    for(int c = 0; c < DL_CLASSES; c++) {
+        if(classes & (1 << c)) {
+            update.fields |= kClassFields[c];
+        }
+    }
+    return encoder.encode(&update, packet, size);
+}
+
+int DownlinkScheduler::poll(uint32_t nowMs, uint8_t* packet, size_t size) {
+    uint8_t classes = 0;
+    int top = -1;
+    bool due = false;
+
+    refill(nowMs);
+    for(int c = 0; c < DL_CLASSES; c++) {
+        if(isPending[c]) {
+            classes |= (1 << c);
+            if(top < 0) {
+                top = c;
+            }
+            if(nowMs - postedMs[c] >= holdoffMs[c]) {
+                due = true;
+            }
+        }
+    }
+    if(!classes || !due) {
+        return 0;
+    }
+
+    // Encode on a copy: the encoder state changes only if the packet is sent
+    TelemetryEncoder saved = encoder;
+    int length = encodeClasses(classes, packet, size);
+    uint32_t air = (length > 0) ? loraAirtimeUs(length, spreading) : 0;
+
+    if(length > 0 && air > budget && classes != (1 << top)) {
+        // Over budget: try with the highest priority class only
+        encoder = saved;
+        classes = (uint8_t)(1 << top);
+        length = encodeClasses(classes, packet, size);
+        air = (length > 0) ? loraAirtimeUs(length, spreading) : 0;
+    }
+    if(length <= 0 || air > budget) {
+        encoder = saved;
+        stats.deferred++;
+        return 0;
+    }
+
+    budget -= air;
+    stats.packets++;
+    stats.airtimeUs += air;
+    for(int c = 0; c < DL_CLASSES; c++) {
+        if(classes & (1 << c)) {
+            uint32_t latency = nowMs - postedMs[c];
+            isPending[c] = false;
+            stats.sent[c]++;
+            stats.sumLatencyMs[c] += latency;
+            if(latency > stats.maxLatencyMs[c]) {
+                stats.maxLatencyMs[c] = latency;
+            }
+        }
+    }
+    return length;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file DownlinkScheduler.h
+ * @brief Priority-queued LoRa downlink scheduler with duty-cycle budgeting.
+ *
+ * The application posts the updates when they are available; the scheduler
+ * keeps only the latest value of every priority class, coalesces all the
+ * pending classes in a single telemetry packet and decides when the packet
+ * can be sent:
+ *
+ * - Every class has a max holdoff: a packet is sent when the oldest pending
+ *   update reaches its holdoff (alerts are sent immediately), so the low
+ *   priority updates travel together with the next high priority one.
+ * - The airtime is tracked with a token bucket filled at the duty-cycle rate.
+ *   The bucket holds the airtime earned in the burst period, so in any
+ *   regulatory window the airtime is at most duty * (window + burst). If the
+ *   coalesced packet does not fit the budget, a smaller packet with the
+ *   highest priority class only is tried, else everything waits.
+ *
+ * The clock is passed by the caller (millis() on Arduino, a monotonic clock
+ * on the Pi, a simulated clock on Linux), so the scheduler has no platform
+ * dependencies.
+ */
+
+#ifndef _DOWNLINK_SCHEDULER
+#define _DOWNLINK_SCHEDULER
+
+#include <stdint.h>
+#include <stddef.h>
+#include "NanodroneTelemetry.h"
+
+// Priority classes, highest first -----------------------------------
+//! Person detection alert
+#define DL_ALERT 0
+//! GPS fix
+#define DL_GPS 1
+//! Health stats (frame counter and exposure)
+#define DL_HEALTH 2
+//! Number of priority classes
+#define DL_CLASSES 3
+
+// Defaults ----------------------------------------------------------
+//! Duty cycle in parts per million (1%, ETSI g1 868 MHz sub-band)
+#define DL_DEFAULT_DUTY_PPM 10000UL
+//! Burst period, ms. 1/10 of the one hour ETSI window: at most 1.1% per hour
+#define DL_DEFAULT_BURST_MS 360000UL
+//! Max holdoff of the alerts, ms
+#define DL_HOLDOFF_ALERT 0UL
+//! Max holdoff of the GPS fixes, ms
+#define DL_HOLDOFF_GPS 10000UL
+//! Max holdoff of the health stats, ms
+#define DL_HOLDOFF_HEALTH 60000UL
+
+/**
+ * @brief Scheduler counters
+ */
+struct DownlinkStats {
+    uint32_t posted[DL_CLASSES];        ///< Updates posted per class
+    uint32_t coalesced[DL_CLASSES];     ///< Updates replaced by a newer one
+    uint32_t sent[DL_CLASSES];          ///< Updates sent per class
+    uint32_t maxLatencyMs[DL_CLASSES];  ///< Max post to send delay
+    uint64_t sumLatencyMs[DL_CLASSES];  ///< Total post to send delay
+    uint32_t packets;                   ///< Packets sent
+    uint32_t deferred;                  ///< Polls delayed by the budget
+    uint64_t airtimeUs;                 ///< Total airtime
+};
+
+class DownlinkScheduler {
+
+public:
+    /**
+     * Class constructor
+     *
+     * @param droneId The id sent in the packets
+     * @param dutyPpm Duty cycle in parts per million
+     * @param burstMs The bucket holds the airtime earned in this period
+     * @param sf LoRa spreading factor used for the airtime
+     */
+    DownlinkScheduler(uint16_t droneId, uint32_t dutyPpm = DL_DEFAULT_DUTY_PPM,
+                      uint32_t burstMs = DL_DEFAULT_BURST_MS, uint8_t sf = 7);
+
+    /**
+     * Set the max holdoff of a priority class
+     */
+    void setHoldoff(uint8_t priority, uint32_t ms);
+
+    /**
+     * Post a detection alert
+     */
+    void postDetection(uint8_t personScore, uint8_t noPersonScore, uint32_t nowMs);
+
+    /**
+     * Post a GPS fix (fixed point, see TelemetryUpdate)
+     */
+    void postGPS(int32_t latitude, int32_t longitude, int16_t altitude,
+                 uint32_t nowMs);
+
+    /**
+     * Post the health stats
+     */
+    void postHealth(uint16_t frame, uint8_t lightIndex, uint8_t lightPerc,
+                    uint8_t eqLoops, uint32_t nowMs);
+
+    /**
+     * Check if a packet should be sent now. Call it from the main loop.
+     *
+     * @param nowMs The current time
+     * @param packet The output buffer, at least TLM_MAX_PACKET bytes
+     * @param size The output buffer size
+     * @return The length of the packet to send, 0 if nothing should be sent
+     */
+    int poll(uint32_t nowMs, uint8_t* packet, size_t size);
+
+    /**
+     * Number of the pending classes
+     */
+    uint8_t pending();
+
+    /**
+     * Airtime available now, microseconds
+     */
+    uint32_t budgetUs(uint32_t nowMs);
+
+    /**
+     * Return the counters
+     */
+    DownlinkStats* getStats();
+
+private:
+    //! Packet encoder
+    TelemetryEncoder encoder;
+    //! Latest values of all the classes
+    TelemetryUpdate update;
+    //! Pending flag per class
+    bool isPending[DL_CLASSES];
+    //! Time of the oldest pending update per class
+    uint32_t postedMs[DL_CLASSES];
+    //! Max holdoff per class
+    uint32_t holdoffMs[DL_CLASSES];
+    //! Duty cycle, ppm
+    uint32_t duty;
+    //! Bucket size, microseconds of airtime
+    uint32_t bucketUs;
+    //! Airtime available, microseconds
+    uint32_t budget;
+    //! Time of the last budget refill
+    uint32_t refillMs;
+    //! LoRa spreading factor
+    uint8_t spreading;
+    //! Counters
+    DownlinkStats stats;
+
+    //! Mark a class as pending and count the coalesced updates
+    void markPending(uint8_t priority, uint32_t nowMs);
+
+    //! Refill the airtime bucket
+    void refill(uint32_t nowMs);
+
+    //! Encode the classes in the mask, return the packet length
+    int encodeClasses(uint8_t classes, uint8_t* packet, size_t size);
+};
+
+#endif
@@ -0,0 +1,340 @@
+/**
+ * @file NanodroneTelemetry.cpp
+ * @brief Compact binary telemetry codec for the Nanodrone LoRa link.
+ *
+ */
+
+#include "NanodroneTelemetry.h"
+
+namespace {
+
+//! Min bytes of the header of a key packet (magic, fields, id, seq)
+const size_t kKeyHeader = 4;
+//! Bytes of the CRC
+const size_t kCRCSize = 2;
+
+// Zigzag varint helpers. Small signed deltas are packed in one byte.
+
+uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+//! Write an unsigned varint, return the number of bytes
+size_t putUVarint(uint8_t* p, uint32_t v) {
+    size_t n = 0;
+    while(v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+//! Write a signed varint, return the number of bytes
+size_t putVarint(uint8_t* p, int32_t value) {
+    return putUVarint(p, zigzag(value));
+}
+
+//! Read an unsigned varint, return the number of bytes or 0 if truncated
+size_t getUVarint(const uint8_t* p, size_t avail, uint32_t* value) {
+    uint32_t v = 0;
+    for(size_t n = 0; (n < avail) && (n < 5); n++) {
+        v |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if(!(p[n] & 0x80)) {
+            *value = v;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+//! Read a signed varint, return the number of bytes or 0 if truncated
+size_t getVarint(const uint8_t* p, size_t avail, int32_t* value) {
+    uint32_t v;
+    size_t n = getUVarint(p, avail, &v);
+    if(n) {
+        *value = unzigzag(v);
+    }
+    return n;
+}
+
+void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+//! Wrapping difference, the position deltas can't overflow across the meridian
+int32_t diff32(int32_t a, int32_t b) {
+    return (int32_t)((uint32_t)a - (uint32_t)b);
+}
+
+int32_t add32(int32_t a, int32_t b) {
+    return (int32_t)((uint32_t)a + (uint32_t)b);
+}
+
+uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+//                      Encoder
+// --------------------------------------------------------------------------
+
+TelemetryEncoder::TelemetryEncoder(uint8_t keyInterval) {
+    interval = keyInterval;
+    seq = 0;
+    keySeq = 0;
+    sinceKey = 0;
+    hasKey = false;
+}
+
+void TelemetryEncoder::forceKey() {
+    hasKey = false;
+}
+
+int TelemetryEncoder::encode(const TelemetryUpdate* update, uint8_t* packet,
+                             size_t size) {
+    if(size < TLM_MAX_PACKET) {
+        return TLM_ERR_BUFFER;
+    }
+
+    // A key packet is needed also when the delta can't represent the fields
+    bool isKey = !hasKey || (sinceKey >= interval) ||
+                 ((update->fields & TLM_HAS_GPS) && !(key.fields & TLM_HAS_GPS));
+    uint8_t fields = update->fields & TLM_FIELDS_MASK;
+    size_t n = 0;
+
+    packet[n++] = TLM_MAGIC;
+    packet[n++] = fields | (isKey ? TLM_KEY : 0);
+    n += putUVarint(&packet[n], update->droneId);
+    packet[n++] = seq;
+
+    if(isKey) {
+        put16(&packet[n], update->frame);
+        n += 2;
+        if(fields & TLM_HAS_GPS) {
+            put32(&packet[n], (uint32_t)update->latitude);
+            put32(&packet[n + 4], (uint32_t)update->longitude);
+            put16(&packet[n + 8], (uint16_t)update->altitude);
+            n += 10;
+        }
+    } else {
+        packet[n++] = keySeq;
+        n += putVarint(&packet[n], (int32_t)(uint16_t)(update->frame - key.frame));
+        if(fields & TLM_HAS_GPS) {
+            n += putVarint(&packet[n], diff32(update->latitude, key.latitude));
+            n += putVarint(&packet[n], diff32(update->longitude, key.longitude));
+            n += putVarint(&packet[n], update->altitude - key.altitude);
+        }
+    }
+
+    if(fields & TLM_HAS_EXPOSURE) {
+        packet[n++] = update->lightIndex;
+        packet[n++] = update->lightPerc;
+        packet[n++] = update->eqLoops;
+    }
+    if(fields & TLM_HAS_DETECTION) {
+        packet[n++] = update->personScore;
+        packet[n++] = update->noPersonScore;
+    }
+
+    put16(&packet[n], telemetryCRC(packet, n));
+    n += kCRCSize;
+
+    if(isKey) {
+        key = *update;
+        key.fields = fields;
+        keySeq = seq;
+        sinceKey = 0;
+        hasKey = true;
+    }
+    sinceKey++;
+    seq++;
+
+    return (int)n;
+}
+
+// --------------------------------------------------------------------------
+//                      Decoder
+// --------------------------------------------------------------------------
+
+TelemetryDecoder::TelemetryDecoder() {
+    keySeq = 0;
+    seq = 0;
+    hasKey = false;
+}
+
+uint8_t TelemetryDecoder::lastSeq() {
+    return seq;
+}
+
+int TelemetryDecoder::decode(const uint8_t* packet, size_t length,
+                             TelemetryUpdate* update) {
+    if(length < kKeyHeader + kCRCSize) {
+        return TLM_ERR_LENGTH;
+    }
+    if(packet[0] != TLM_MAGIC) {
+        return TLM_ERR_MAGIC;
+    }
+    if(telemetryCRC(packet, length - kCRCSize) != get16(&packet[length - kCRCSize])) {
+        return TLM_ERR_CRC;
+    }
+
+    //! Payload end (the CRC is excluded)
+    size_t end = length - kCRCSize;
+    uint8_t flags = packet[1];
+    bool isKey = (flags & TLM_KEY) != 0;
+    size_t n = 2;
+    int32_t d;
+    uint32_t id;
+    size_t used;
+
+    if(!(used = getUVarint(&packet[n], end - n, &id)) || (id > 0xFFFF) ||
+       (n + used >= end)) {
+        return TLM_ERR_LENGTH;
+    }
+    n += used;
+    //! Sequence number of this packet
+    uint8_t packetSeq = packet[n++];
+    update->fields = flags & TLM_FIELDS_MASK;
+    update->droneId = (uint16_t)id;
+
+    if(isKey) {
+        if(n + 2 + ((flags & TLM_HAS_GPS) ? 10 : 0) > end) {
+            return TLM_ERR_LENGTH;
+        }
+        update->frame = get16(&packet[n]);
+        n += 2;
+        if(flags & TLM_HAS_GPS) {
+            update->latitude = (int32_t)get32(&packet[n]);
+            update->longitude = (int32_t)get32(&packet[n + 4]);
+            update->altitude = (int16_t)get16(&packet[n + 8]);
+            n += 10;
+        }
+    } else {
+        if(n >= end) {
+            return TLM_ERR_LENGTH;
+        }
+        if(!hasKey || (packet[n++] != keySeq)) {
+            return TLM_ERR_NO_KEY;
+        }
+        if(!(used = getVarint(&packet[n], end - n, &d))) {
+            return TLM_ERR_LENGTH;
+        }
+        n += used;
+        update->frame = (uint16_t)(key.frame + d);
+        if(flags & TLM_HAS_GPS) {
+            if(!(key.fields & TLM_HAS_GPS)) {
+                return TLM_ERR_NO_KEY;
+            }
+            if(!(used = getVarint(&packet[n], end - n, &d))) {
+                return TLM_ERR_LENGTH;
+            }
+            n += used;
+            update->latitude = add32(key.latitude, d);
+            if(!(used = getVarint(&packet[n], end - n, &d))) {
+                return TLM_ERR_LENGTH;
+            }
+            n += used;
+            update->longitude = add32(key.longitude, d);
+            if(!(used = getVarint(&packet[n], end - n, &d))) {
+                return TLM_ERR_LENGTH;
+            }
+            n += used;
+            update->altitude = (int16_t)(key.altitude + d);
+        }
+    }
+
+    if(flags & TLM_HAS_EXPOSURE) {
+        if(n + 3 > end) {
+            return TLM_ERR_LENGTH;
+        }
+        update->lightIndex = packet[n++];
+        update->lightPerc = packet[n++];
+        update->eqLoops = packet[n++];
+    }
+    if(flags & TLM_HAS_DETECTION) {
+        if(n + 2 > end) {
+            return TLM_ERR_LENGTH;
+        }
+        update->personScore = packet[n++];
+        update->noPersonScore = packet[n++];
+    }
+    if(n != end) {
+        return TLM_ERR_LENGTH;
+    }
+
+    if(isKey) {
+        key = *update;
+        keySeq = packetSeq;
+        hasKey = true;
+    }
+    seq = packetSeq;
+
+    return TLM_OK;
+}
+
+// --------------------------------------------------------------------------
+//                      Helpers
+// --------------------------------------------------------------------------
+
+int telemetryDroneId(const uint8_t* packet, size_t length) {
+    uint32_t id;
+
+    if(length < kKeyHeader + kCRCSize) {
+        return TLM_ERR_LENGTH;
+    }
+    if(packet[0] != TLM_MAGIC) {
+        return TLM_ERR_MAGIC;
+    }
+    if(!getUVarint(&packet[2], length - kCRCSize - 2, &id) || (id > 0xFFFF)) {
+        return TLM_ERR_LENGTH;
+    }
+    return (int)id;
+}
+
+uint16_t telemetryCRC(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while(length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for(int j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint32_t loraAirtimeUs(size_t length, uint8_t sf, uint32_t bandwidth, uint8_t cr) {
+    //! Symbol time in microseconds
+    uint32_t tSym = (uint32_t)(((uint64_t)1000000 << sf) / bandwidth);
+    //! Low data rate optimization is mandatory over 16 ms symbols
+    int de = (tSym > 16000) ? 1 : 0;
+    //! Implicit header off, CRC on
+    int32_t num = 8 * (int32_t)length - 4 * sf + 28 + 16;
+    int32_t den = 4 * (sf - 2 * de);
+    int32_t payloadSymbols = 8;
+
+    if(num > 0) {
+        payloadSymbols += ((num + den - 1) / den) * (cr + 4);
+    }
+    // Preamble: 8 programmed symbols + 4.25
+    return (uint32_t)((8 * 4 + 17) * tSym / 4 + payloadSymbols * tSym);
+}
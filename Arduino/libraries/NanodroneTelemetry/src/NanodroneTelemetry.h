@@ -0,0 +1,200 @@
+/**
+ * @file NanodroneTelemetry.h
+ * @brief Compact binary telemetry codec for the Nanodrone LoRa link.
+ *
+ * The same source is used by the LoRa sketches, by the Raspberry Pi and by
+ * the ground station on Linux. It has no dependencies outside the C standard
+ * library.
+ *
+ * Packet layout (little endian):
+ *
+ * | Bytes | Field                                                        |
+ * |-------|--------------------------------------------------------------|
+ * | 1     | Magic and version (TLM_MAGIC)                                |
+ * | 1     | Field flags (TLM_KEY, TLM_HAS_GPS, TLM_HAS_EXPOSURE, ...)    |
+ * | 1-3   | Drone id, unsigned varint (1 byte up to 127)                 |
+ * | 1     | Packet sequence number                                       |
+ * | 1     | Sequence of the reference key packet (delta packets only)    |
+ * | 2/var | Frame counter: uint16 on key packets, zigzag varint delta    |
+ * | 10/var| GPS: lat, lon (int32 1e-7 deg), alt (int16 dm) or deltas     |
+ * | 3     | Exposure: light index (x255), light %, equalization loops    |
+ * | 2     | Detection: person score, no person score                     |
+ * | 2     | CRC-16/CCITT of all the previous bytes                       |
+ *
+ * Delta packets are encoded against the last key packet (not the previous
+ * packet), so a lost delta packet never invalidates the following ones. Only
+ * the loss of a key packet discards the deltas up to the next key packet,
+ * which is sent every TLM_KEY_INTERVAL packets.
+ */
+
+#ifndef _NANODRONE_TELEMETRY
+#define _NANODRONE_TELEMETRY
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Packet header -----------------------------------------------------
+//! Magic (high nibble) and codec version (low nibble)
+#define TLM_MAGIC 0xD2
+//! Key packet (absolute values)
+#define TLM_KEY 0x80
+//! The packet contains the GPS position
+#define TLM_HAS_GPS 0x01
+//! The packet contains the exposure stats
+#define TLM_HAS_EXPOSURE 0x02
+//! The packet contains the detection scores
+#define TLM_HAS_DETECTION 0x04
+//! Mask of the optional fields
+#define TLM_FIELDS_MASK 0x07
+
+//! Default number of packets between two key packets
+#define TLM_KEY_INTERVAL 10
+//! Max size of an encoded packet
+#define TLM_MAX_PACKET 32
+
+// Decoder return codes ----------------------------------------------
+//! Packet decoded
+#define TLM_OK 0
+//! The packet is too short or truncated
+#define TLM_ERR_LENGTH -1
+//! Unknown magic or version
+#define TLM_ERR_MAGIC -2
+//! CRC mismatch
+#define TLM_ERR_CRC -3
+//! Delta packet whose key packet has not been received
+#define TLM_ERR_NO_KEY -4
+//! The output buffer is too small
+#define TLM_ERR_BUFFER -5
+
+// Fixed point scales ------------------------------------------------
+//! Latitude and longitude units per degree
+#define TLM_DEG_SCALE 10000000L
+//! Altitude units per meter
+#define TLM_ALT_SCALE 10
+
+/**
+ * @brief One telemetry update. The GPS position is in fixed point to be
+ * converted with the TLM_DEG_SCALE and TLM_ALT_SCALE units.
+ */
+struct TelemetryUpdate {
+    uint16_t droneId;       ///< Sender id
+    uint8_t fields;         ///< Fields present (TLM_HAS_...)
+    uint16_t frame;         ///< Captured frames counter
+    int32_t latitude;       ///< Latitude, 1e-7 degrees (negative S)
+    int32_t longitude;      ///< Longitude, 1e-7 degrees (negative W)
+    int16_t altitude;       ///< Altitude on the sea level, decimeters
+    uint8_t lightIndex;     ///< Image lighting index (0-1 scaled to 0-255)
+    uint8_t lightPerc;      ///< Image lighting percentage
+    uint8_t eqLoops;        ///< Exposure equalization loops
+    uint8_t personScore;    ///< Person detection score
+    uint8_t noPersonScore;  ///< No person detection score
+};
+
+/**
+ * @brief Encodes the updates of one drone. Keeps the last key packet to
+ * calculate the deltas.
+ */
+class TelemetryEncoder {
+
+public:
+    /**
+     * Class constructor
+     *
+     * @param keyInterval Number of packets between two key packets
+     */
+    TelemetryEncoder(uint8_t keyInterval = TLM_KEY_INTERVAL);
+
+    /**
+     * Encode an update
+     *
+     * @param update The update to encode
+     * @param packet The output buffer, at least TLM_MAX_PACKET bytes
+     * @param size The output buffer size
+     * @return The packet length or TLM_ERR_BUFFER
+     */
+    int encode(const TelemetryUpdate* update, uint8_t* packet, size_t size);
+
+    /**
+     * Force the next packet to be a key packet
+     */
+    void forceKey();
+
+private:
+    //! The last key packet values
+    TelemetryUpdate key;
+    //! Sequence number of the last key packet
+    uint8_t keySeq;
+    //! Sequence number of the next packet
+    uint8_t seq;
+    //! Packets sent since the last key packet
+    uint8_t sinceKey;
+    //! Packets between two key packets
+    uint8_t interval;
+    //! Flag is true when a key packet has been sent
+    bool hasKey;
+};
+
+/**
+ * @brief Decodes the packets of one drone. The ground station keeps one
+ * decoder per drone id.
+ */
+class TelemetryDecoder {
+
+public:
+    /**
+     * Class constructor
+     */
+    TelemetryDecoder();
+
+    /**
+     * Decode a packet
+     *
+     * @param packet The received packet
+     * @param length The packet length
+     * @param update The decoded update
+     * @return TLM_OK or a TLM_ERR_... code
+     */
+    int decode(const uint8_t* packet, size_t length, TelemetryUpdate* update);
+
+    /**
+     * Sequence number of the last decoded packet
+     */
+    uint8_t lastSeq();
+
+private:
+    //! The last key packet values
+    TelemetryUpdate key;
+    //! Sequence number of the last key packet
+    uint8_t keySeq;
+    //! Sequence number of the last decoded packet
+    uint8_t seq;
+    //! Flag is true when a key packet has been received
+    bool hasKey;
+};
+
+/**
+ * Read the drone id of a packet without decoding it, to dispatch the packet
+ * to the decoder of the drone.
+ *
+ * @return The drone id or TLM_ERR_... code
+ */
+int telemetryDroneId(const uint8_t* packet, size_t length);
+
+/**
+ * CRC-16/CCITT (poly 0x1021, init 0xFFFF)
+ */
+uint16_t telemetryCRC(const uint8_t* data, size_t length);
+
+/**
+ * LoRa time on air of a packet, in microseconds (Semtech AN1200.13).
+ * Explicit header, CRC on, 8 symbols preamble.
+ *
+ * @param length Payload length in bytes
+ * @param sf Spreading factor 6-12
+ * @param bandwidth Bandwidth in Hz
+ * @param cr Coding rate denominator - 4 (1 = 4/5 ... 4 = 4/8)
+ */
+uint32_t loraAirtimeUs(size_t length, uint8_t sf = 7,
+                       uint32_t bandwidth = 125000, uint8_t cr = 1);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file dronetable.cpp
+ * @brief Per-drone state table of the ground station.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "dronetable.h"
+
+namespace {
+
+//! Value of an hex digit or -1
+int hexValue(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+}  // namespace
+
+DroneTable::DroneTable() {
+    drones.reserve(TABLE_RESERVE);
+}
+
+size_t DroneTable::size() {
+    return drones.size();
+}
+
+int DroneTable::processLine(const char* line, size_t length, double now) {
+    const size_t prefix = sizeof(TLM_LINE_PREFIX) - 1;
+    uint8_t packet[TLM_MAX_PACKET];
+    size_t n = 0;
+
+    // Strip the CR of the println() line ending
+    while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')) {
+        length--;
+    }
+    if(length < prefix || memcmp(line, TLM_LINE_PREFIX, prefix) != 0) {
+        return 1;
+    }
+    stats.lines++;
+
+    if((length - prefix) % 2 || (length - prefix) / 2 > TLM_MAX_PACKET) {
+        stats.badLines++;
+        return TLM_ERR_LENGTH;
+    }
+    for(size_t j = prefix; j < length; j += 2) {
+        int hi = hexValue(line[j]);
+        int lo = hexValue(line[j + 1]);
+        if(hi < 0 || lo < 0) {
+            stats.badLines++;
+            return TLM_ERR_LENGTH;
+        }
+        packet[n++] = (uint8_t)((hi << 4) | lo);
+    }
+    return processPacket(packet, n, now);
+}
+
+int DroneTable::processPacket(const uint8_t* packet, size_t length, double now) {
+    int id = telemetryDroneId(packet, length);
+    if(id < 0) {
+        stats.badLines++;
+        return id;
+    }
+    // Check the integrity before creating a drone for a corrupted id
+    if(length < 2 || telemetryCRC(packet, length - 2) !=
+       (uint16_t)(packet[length - 2] | (packet[length - 1] << 8))) {
+        stats.crcErrors++;
+        return TLM_ERR_CRC;
+    }
+
+    DroneState& drone = drones[(uint16_t)id];
+    uint8_t prevSeq = drone.decoder.lastSeq();
+    TelemetryUpdate update = drone.last;
+
+    int status = drone.decoder.decode(packet, length, &update);
+    if(status == TLM_ERR_NO_KEY) {
+        drone.noKey++;
+        stats.noKey++;
+        return status;
+    } else if(status != TLM_OK) {
+        stats.badLines++;
+        return status;
+    }
+
+    // Sequence gaps include the packets lost on air and the undecodable deltas
+    if(drone.hasUpdate) {
+        uint8_t gap = (uint8_t)(drone.decoder.lastSeq() - prevSeq - 1);
+        drone.lost += gap;
+        stats.lost += gap;
+    }
+    // Keep the last known values of the fields not present in the packet
+    drone.last = update;
+    drone.hasUpdate = true;
+    drone.packets++;
+    drone.lastSeen = now;
+    stats.packets++;
+    return TLM_OK;
+}
+
+const DroneState* DroneTable::getDrone(uint16_t id) {
+    auto it = drones.find(id);
+    return (it == drones.end()) ? nullptr : &it->second;
+}
+
+void DroneTable::formatDrone(uint16_t id, double now, string* out) {
+    char line[256];
+    const DroneState* d = getDrone(id);
+
+    if(d == nullptr || !d->hasUpdate) {
+        snprintf(line, sizeof(line), "%u unknown\n", id);
+    } else {
+        const TelemetryUpdate& u = d->last;
+        snprintf(line, sizeof(line),
+                 "%u frame %u lat %.7f lon %.7f alt %.1f light %u %u eq %u "
+                 "person %u no %u packets %u lost %u nokey %u age %.1f\n",
+                 id, u.frame,
+                 (double)u.latitude / TLM_DEG_SCALE,
+                 (double)u.longitude / TLM_DEG_SCALE,
+                 (double)u.altitude / TLM_ALT_SCALE,
+                 u.lightIndex, u.lightPerc, u.eqLoops,
+                 u.personScore, u.noPersonScore,
+                 d->packets, d->lost, d->noKey, now - d->lastSeen);
+    }
+    out->append(line);
+}
+
+void DroneTable::formatAll(double now, string* out) {
+    for(auto& it : drones) {
+        formatDrone(it.first, now, out);
+    }
+}
+
+void DroneTable::formatStats(string* out) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "drones %zu lines %llu packets %llu lost %llu nokey %llu "
+             "crc %llu bad %llu\n", drones.size(),
+             (unsigned long long)stats.lines, (unsigned long long)stats.packets,
+             (unsigned long long)stats.lost, (unsigned long long)stats.noKey,
+             (unsigned long long)stats.crcErrors,
+             (unsigned long long)stats.badLines);
+    out->append(line);
+}
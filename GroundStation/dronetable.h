@@ -0,0 +1,108 @@
+/**
+ * @file dronetable.h
+ * @brief Per-drone state table of the ground station, updated by the
+ * telemetry packets forwarded by the LoRa receiver.
+ *
+ * The receiver forwards every LoRa packet on its serial as a single text line
+ * in the format "TLM <hex bytes>". Other lines (debug messages) are ignored.
+ */
+
+#ifndef _DRONETABLE
+#define _DRONETABLE
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+#include "NanodroneTelemetry.h"
+
+using namespace std;
+
+//! Prefix of the telemetry lines forwarded by the receiver
+#define TLM_LINE_PREFIX "TLM "
+//! Initial number of buckets of the table, sized for a large fleet
+#define TABLE_RESERVE 4096
+
+/**
+ * @brief The state of a single drone
+ */
+struct DroneState {
+    TelemetryDecoder decoder;   ///< Delta decoder of the drone packets
+    TelemetryUpdate last;       ///< Last decoded update
+    bool hasUpdate = false;     ///< Flag is true after the first update
+    uint32_t packets = 0;       ///< Decoded packets
+    uint32_t lost = 0;          ///< Sequence gaps between decoded packets
+    uint32_t noKey = 0;         ///< Deltas dropped for a missing key packet
+    double lastSeen = 0;        ///< Time of the last decoded packet (s)
+};
+
+/**
+ * @brief Totals of the table, including the packets that can't be
+ * assigned to a drone (e.g. CRC errors)
+ */
+struct TableStats {
+    uint64_t lines = 0;         ///< Telemetry lines parsed
+    uint64_t packets = 0;       ///< Decoded packets
+    uint64_t badLines = 0;      ///< Malformed hex lines
+    uint64_t crcErrors = 0;     ///< CRC errors and unknown versions
+    uint64_t noKey = 0;         ///< Deltas without key packet
+    uint64_t lost = 0;          ///< Sequence gaps
+};
+
+class DroneTable {
+
+public:
+    /**
+     * Class constructor
+     */
+    DroneTable();
+
+    /**
+     * Parse a line from the receiver serial stream. Lines that are not
+     * telemetry are ignored.
+     *
+     * @param line The line, without the end of line
+     * @param now The time of reception in seconds
+     * @return TLM_OK, a TLM_ERR_... code, or 1 if the line is not telemetry
+     */
+    int processLine(const char* line, size_t length, double now);
+
+    /**
+     * Decode a packet and update the state of its drone
+     *
+     * @return TLM_OK or a TLM_ERR_... code
+     */
+    int processPacket(const uint8_t* packet, size_t length, double now);
+
+    /**
+     * Return the state of a drone or nullptr if it is unknown
+     */
+    const DroneState* getDrone(uint16_t id);
+
+    /**
+     * Append the state of a drone as a single text line
+     */
+    void formatDrone(uint16_t id, double now, string* out);
+
+    /**
+     * Append all the drones, one per line
+     */
+    void formatAll(double now, string* out);
+
+    /**
+     * Append the table totals as a single text line
+     */
+    void formatStats(string* out);
+
+    /**
+     * Number of drones in the table
+     */
+    size_t size();
+
+private:
+    //! Drones by id
+    unordered_map<uint16_t, DroneState> drones;
+    //! Table totals
+    TableStats stats;
+};
+
+#endif
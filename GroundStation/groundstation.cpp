@@ -0,0 +1,326 @@
+/**
+@file groundstation.cpp
+
+@brief Ground station daemon. Reads the telemetry lines forwarded by the LoRa
+receiver on its serial (or by the linksim pty simulator), decodes the packets
+and keeps the state of every drone, queryable over a local unix socket.
+
+Usage: groundstation [-d device] [-s socket] [-r report seconds]
+
+The socket accepts one command per line:
+ - GET <id>  State of a drone
+ - LIST      State of all the drones, terminated by END
+ - STATS     Table totals
+
+Example: echo LIST | socat - UNIX-CONNECT:/tmp/nanodrone-gs.sock
+
+@author Enrico Miglino <balearicdynamics@gmail.com>
+@version 1.0
+@date October 2026
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "dronetable.h"
+
+using namespace std;
+
+// ----------------------------- Defaults
+//! Serial of the LoRa receiver (Serial1 through an USB adapter)
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+//! Local query socket
+#define DEFAULT_SOCKET "/tmp/nanodrone-gs.sock"
+//! Seconds between two status reports on the console
+#define DEFAULT_REPORT 10
+//! Serial read buffer size
+#define READ_BUF_SIZE 65536
+//! Max length of a serial or query line
+#define MAX_LINE 256
+//! Max pending clients on the query socket
+#define MAX_CLIENTS 64
+
+// ----------------------------- Messages
+#define DEVICE_ERROR "Error opening the receiver device "
+#define SOCKET_ERROR "Error creating the query socket "
+#define UNKNOWN_COMMAND "ERR unknown command\n"
+
+/**
+ * @brief A client connected to the query socket
+ */
+struct Client {
+    int fd;         ///< Socket
+    string in;      ///< Partial command line
+    string out;     ///< Pending reply bytes
+    bool eof;       ///< No more commands, closed once the reply is sent
+};
+
+//! Cleared by SIGINT/SIGTERM
+volatile sig_atomic_t running = 1;
+
+void stopDaemon(int sig) {
+    running = 0;
+}
+
+//! Monotonic time in seconds
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//! Log timestamp in the same format of the drone applications
+string getLogTimestamp() {
+    time_t t = time(NULL);
+    struct tm tstruct;
+    char buf[40];
+    tstruct = *localtime(&t);
+    strftime(buf, sizeof(buf), "%Y/%m/%d %H:%M:%S", &tstruct);
+    return buf;
+}
+
+/**
+ * Open the receiver serial (or the simulator pty) in raw mode, 115200 baud
+ *
+ * @return The file descriptor or -1
+ */
+int openDevice(const char* device) {
+    int fd = open(device, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if(fd < 0) {
+        return -1;
+    }
+    struct termios options;
+    if(tcgetattr(fd, &options) == 0) {
+        cfmakeraw(&options);
+        cfsetispeed(&options, B115200);
+        options.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &options);
+    }
+    return fd;
+}
+
+/**
+ * Create the listening unix socket
+ *
+ * @return The file descriptor or -1
+ */
+int openSocket(const char* path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       listen(fd, MAX_CLIENTS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//! Execute a query command, appending the reply to the client output
+void executeCommand(DroneTable* table, const string& cmd, string* out) {
+    double t = now();
+    if(cmd.compare(0, 4, "GET ") == 0) {
+        table->formatDrone((uint16_t)atoi(cmd.c_str() + 4), t, out);
+    } else if(cmd == "LIST") {
+        table->formatAll(t, out);
+        out->append("END\n");
+    } else if(cmd == "STATS") {
+        table->formatStats(out);
+    } else {
+        out->append(UNKNOWN_COMMAND);
+    }
+}
+
+//! Read and execute the pending commands of a client. A client closing its
+//! side still gets the replies of the commands sent before. Return false on
+//! errors
+bool readClient(DroneTable* table, Client* c) {
+    char buf[MAX_LINE];
+    ssize_t n;
+
+    while((n = read(c->fd, buf, sizeof(buf))) > 0) {
+        c->in.append(buf, n);
+    }
+    if(n == 0) {
+        c->eof = true;
+    } else if(errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+    }
+    size_t eol;
+    while((eol = c->in.find('\n')) != string::npos) {
+        string cmd = c->in.substr(0, eol);
+        if(!cmd.empty() && cmd.back() == '\r') {
+            cmd.pop_back();
+        }
+        executeCommand(table, cmd, &c->out);
+        c->in.erase(0, eol + 1);
+    }
+    // Drop the clients that never send an end of line
+    return c->in.size() < MAX_LINE;
+}
+
+//! Send the pending reply. Return false on errors
+bool writeClient(Client* c) {
+    while(!c->out.empty()) {
+        ssize_t n = write(c->fd, c->out.data(), c->out.size());
+        if(n < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        c->out.erase(0, n);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char* device = DEFAULT_DEVICE;
+    const char* socketPath = DEFAULT_SOCKET;
+    int reportSec = DEFAULT_REPORT;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:s:r:")) != -1) {
+        switch(opt) {
+            case 'd': device = optarg; break;
+            case 's': socketPath = optarg; break;
+            case 'r': reportSec = atoi(optarg); break;
+            default:
+                cerr << "Usage: groundstation [-d device] [-s socket] "
+                        "[-r report seconds]" << endl;
+                return 1;
+        }
+    }
+
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+    signal(SIGPIPE, SIG_IGN);
+
+    int serialFd = openDevice(device);
+    if(serialFd < 0) {
+        cerr << DEVICE_ERROR << device << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    int listenFd = openSocket(socketPath);
+    if(listenFd < 0) {
+        cerr << SOCKET_ERROR << socketPath << ": " << strerror(errno) << endl;
+        close(serialFd);
+        return 1;
+    }
+    cout << getLogTimestamp() << " - Ground station on " << device <<
+            ", queries on " << socketPath << endl;
+
+    DroneTable table;
+    vector<Client> clients;
+    vector<struct pollfd> fds;
+    static char readBuf[READ_BUF_SIZE];
+    //! Partial serial line
+    string line;
+    double nextReport = now() + reportSec;
+
+    while(running) {
+        fds.clear();
+        fds.push_back({serialFd, POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        for(auto& c : clients) {
+            fds.push_back({c.fd, (short)((c.eof ? 0 : POLLIN) |
+                                         (c.out.empty() ? 0 : POLLOUT)), 0});
+        }
+
+        if(poll(fds.data(), fds.size(), 1000) < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+
+        // Telemetry stream
+        if(fds[0].revents & POLLIN) {
+            ssize_t n;
+            double t = now();
+            while((n = read(serialFd, readBuf, sizeof(readBuf))) > 0) {
+                char* p = readBuf;
+                char* end = readBuf + n;
+                while(p < end) {
+                    char* eol = (char*)memchr(p, '\n', end - p);
+                    if(eol == nullptr) {
+                        line.append(p, end - p);
+                        break;
+                    }
+                    if(line.empty()) {
+                        table.processLine(p, eol - p, t);
+                    } else {
+                        line.append(p, eol - p);
+                        table.processLine(line.data(), line.size(), t);
+                        line.clear();
+                    }
+                    p = eol + 1;
+                }
+                // Resynchronize on garbage without end of line
+                if(line.size() > MAX_LINE) {
+                    line.clear();
+                }
+            }
+        } else if(fds[0].revents & (POLLHUP | POLLERR)) {
+            // The simulator closed the pty: wait for the next writer
+            usleep(100000);
+        }
+
+        // New query clients
+        if(fds[1].revents & POLLIN) {
+            int fd;
+            while((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                clients.push_back({fd, string(), string(), false});
+            }
+        }
+
+        // Client commands and replies
+        for(size_t j = 0; j < clients.size() && j + 2 < fds.size(); j++) {
+            short ev = fds[j + 2].revents;
+            bool ok = true;
+            if(ev & POLLIN) {
+                ok = readClient(&table, &clients[j]);
+            }
+            if(ok && !clients[j].out.empty()) {
+                ok = writeClient(&clients[j]);
+            }
+            if(!ok || (clients[j].eof && clients[j].out.empty()) ||
+               (ev & (POLLERR | POLLHUP) && !(ev & POLLIN))) {
+                close(clients[j].fd);
+                clients[j].fd = -1;
+            }
+        }
+        clients.erase(remove_if(clients.begin(), clients.end(),
+                                [](const Client& c) { return c.fd < 0; }),
+                      clients.end());
+
+        if(reportSec > 0 && now() >= nextReport) {
+            string stats;
+            table.formatStats(&stats);
+            cout << getLogTimestamp() << " - " << stats << flush;
+            nextReport += reportSec;
+        }
+    }
+
+    for(auto& c : clients) {
+        close(c.fd);
+    }
+    close(listenFd);
+    unlink(socketPath);
+    close(serialFd);
+    return 0;
+}
@@ -0,0 +1,284 @@
+/**
+@file linksim.cpp
+
+@brief LoRa link simulator. Simulates a fleet of drones sending telemetry to
+the LoRa receiver and writes the lines forwarded by the receiver to a pty,
+so the ground station can be exercised without radios.
+
+The simulated link injects packet loss, latency with jitter and the
+regulatory duty-cycle limit of every drone (token bucket over one hour, the
+airtime is calculated from the packet size and the spreading factor).
+
+Usage: linksim [-n drones] [-i interval s] [-l loss %] [-L latency ms]
+               [-j jitter ms] [-d duty %] [-s sf] [-t seconds] [-f]
+
+With -f the simulated clock runs as fast as the ground station reads the
+pty, to measure the max packets/s the ground side can sustain.
+
+Example:
+  ./linksim -n 5000 -f          (prints the pty name, e.g. /dev/pts/3)
+  ./groundstation -d /dev/pts/3
+
+@author Enrico Miglino <balearicdynamics@gmail.com>
+@version 1.0
+@date October 2026
+*/
+
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "NanodroneTelemetry.h"
+
+using namespace std;
+
+// ----------------------------- Defaults
+#define DEFAULT_DRONES 100
+#define DEFAULT_INTERVAL 6.0    ///< Seconds between two updates (firstfly)
+#define DEFAULT_LOSS 5.0        ///< Packet loss %
+#define DEFAULT_LATENCY 200.0   ///< Receiver to ground station latency, ms
+#define DEFAULT_JITTER 100.0    ///< Max additional random latency, ms
+#define DEFAULT_DUTY 1.0        ///< Duty cycle %
+#define DEFAULT_SF 7            ///< LoRa spreading factor
+#define DEFAULT_DURATION 60.0   ///< Simulated seconds
+//! Duty-cycle observation window (ETSI EN 300 220, one hour)
+#define DUTY_WINDOW 3600.0
+//! Prefix of the lines forwarded by the receiver
+#define TLM_LINE_PREFIX "TLM "
+
+/**
+ * @brief A simulated drone
+ */
+struct SimDrone {
+    TelemetryEncoder encoder;   ///< Packet encoder
+    TelemetryUpdate update;     ///< Current telemetry
+    double phase;               ///< Flight path phase
+    double budget;              ///< Airtime available (s), duty-cycle bucket
+    double lastSend;            ///< Time of the last budget update
+};
+
+/**
+ * @brief A packet in flight between the receiver and the ground station
+ */
+struct Delivery {
+    double time;                ///< Delivery time
+    string line;                ///< Forwarded line
+    bool operator>(const Delivery& d) const { return time > d.time; }
+};
+
+//! Time ordered event (drone index)
+typedef pair<double, int> SendEvent;
+
+//! Monotonic time in seconds
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//! Update the simulated telemetry of a drone at time t
+void simulate(SimDrone* d, uint16_t id, double t) {
+    TelemetryUpdate* u = &d->update;
+    u->droneId = id;
+    u->fields = TLM_HAS_GPS | TLM_HAS_EXPOSURE | TLM_HAS_DETECTION;
+    u->frame++;
+    // Every drone flies a slow circle around its own survey area
+    double cx = 39.5 + (id % 100) * 0.001;
+    double cy = 2.6 + (id / 100) * 0.001;
+    u->latitude = (int32_t)((cx + 0.0005 * sin(t / 300 + d->phase)) * TLM_DEG_SCALE);
+    u->longitude = (int32_t)((cy + 0.0005 * cos(t / 300 + d->phase)) * TLM_DEG_SCALE);
+    u->altitude = (int16_t)((45.0 + 3 * sin(t / 60 + d->phase)) * TLM_ALT_SCALE);
+    u->lightIndex = (uint8_t)(180 + u->frame % 7);
+    u->lightPerc = (uint8_t)(30 + u->frame % 5);
+    u->eqLoops = (uint8_t)(u->frame % 3);
+    u->personScore = (uint8_t)(u->frame % 97 < 5 ? 200 : 20 + u->frame % 11);
+    u->noPersonScore = (uint8_t)(255 - u->personScore);
+}
+
+//! Receiver line format: "TLM <hex>"
+string formatLine(const uint8_t* packet, int length) {
+    static const char hex[] = "0123456789ABCDEF";
+    string line(TLM_LINE_PREFIX);
+    for(int j = 0; j < length; j++) {
+        line += hex[packet[j] >> 4];
+        line += hex[packet[j] & 0x0F];
+    }
+    line += "\r\n";
+    return line;
+}
+
+//! Write the whole line, blocking while the ground station is busy
+bool writeLine(int fd, const string& line) {
+    size_t done = 0;
+    while(done < line.size()) {
+        ssize_t n = write(fd, line.data() + done, line.size() - done);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int numDrones = DEFAULT_DRONES;
+    double interval = DEFAULT_INTERVAL;
+    double loss = DEFAULT_LOSS;
+    double latency = DEFAULT_LATENCY;
+    double jitter = DEFAULT_JITTER;
+    double duty = DEFAULT_DUTY;
+    int sf = DEFAULT_SF;
+    double duration = DEFAULT_DURATION;
+    bool fast = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:i:l:L:j:d:s:t:f")) != -1) {
+        switch(opt) {
+            case 'n': numDrones = atoi(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 'l': loss = atof(optarg); break;
+            case 'L': latency = atof(optarg); break;
+            case 'j': jitter = atof(optarg); break;
+            case 'd': duty = atof(optarg); break;
+            case 's': sf = atoi(optarg); break;
+            case 't': duration = atof(optarg); break;
+            case 'f': fast = true; break;
+            default:
+                cerr << "Usage: linksim [-n drones] [-i interval s] [-l loss %] "
+                        "[-L latency ms] [-j jitter ms] [-d duty %] [-s sf] "
+                        "[-t seconds] [-f]" << endl;
+                return 1;
+        }
+    }
+    if(numDrones < 1 || numDrones > 0xFFFF || interval <= 0 || sf < 6 || sf > 12) {
+        cerr << "Invalid parameters" << endl;
+        return 1;
+    }
+
+    // The pty master is the receiver serial, the slave is read by the daemon
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        cerr << "Can't create the pty: " << strerror(errno) << endl;
+        return 1;
+    }
+    // Keep the slave open in raw mode, so nothing is lost before the
+    // ground station opens it
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    struct termios options;
+    if(slave >= 0 && tcgetattr(slave, &options) == 0) {
+        cfmakeraw(&options);
+        tcsetattr(slave, TCSANOW, &options);
+    }
+    cout << ptsname(master) << endl;
+    cout << "Press enter when the ground station is connected" << endl;
+    cin.get();
+
+    mt19937 rng(1);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<SimDrone> drones(numDrones);
+    priority_queue<SendEvent, vector<SendEvent>, greater<SendEvent> > sends;
+    priority_queue<Delivery, vector<Delivery>, greater<Delivery> > deliveries;
+    //! Airtime bucket size (s)
+    double bucket = DUTY_WINDOW * duty / 100;
+    uint64_t generated = 0, dutyDrops = 0, lost = 0, delivered = 0, bytes = 0;
+    double airtime = 0;
+
+    for(int j = 0; j < numDrones; j++) {
+        memset(&drones[j].update, 0, sizeof(TelemetryUpdate));
+        drones[j].phase = uniform(rng) * 2 * M_PI;
+        drones[j].budget = bucket;
+        drones[j].lastSend = 0;
+        // Stagger the first transmissions over one interval
+        sends.push(SendEvent(uniform(rng) * interval, j));
+    }
+
+    double start = now();
+    double simTime = 0;
+
+    while(!sends.empty() || !deliveries.empty()) {
+        bool isSend = !sends.empty() &&
+                      (deliveries.empty() || sends.top().first <= deliveries.top().time);
+        double t = isSend ? sends.top().first : deliveries.top().time;
+
+        // Real time pacing
+        if(!fast) {
+            double wait = t - (now() - start);
+            if(wait > 0) {
+                usleep((useconds_t)(wait * 1e6));
+            }
+        }
+        simTime = t;
+
+        if(isSend) {
+            int j = sends.top().second;
+            sends.pop();
+            SimDrone* d = &drones[j];
+            uint8_t packet[TLM_MAX_PACKET];
+
+            simulate(d, (uint16_t)(j + 1), t);
+            int length = d->encoder.encode(&d->update, packet, sizeof(packet));
+            double air = loraAirtimeUs(length, sf) / 1e6;
+            generated++;
+
+            // Duty-cycle token bucket: the radio can't transmit over budget
+            d->budget += (t - d->lastSend) * duty / 100;
+            if(d->budget > bucket) {
+                d->budget = bucket;
+            }
+            d->lastSend = t;
+            if(d->budget < air) {
+                dutyDrops++;
+            } else {
+                d->budget -= air;
+                airtime += air;
+                if(uniform(rng) * 100 < loss) {
+                    lost++;
+                } else {
+                    deliveries.push({t + air + (latency + uniform(rng) * jitter) / 1000,
+                                     formatLine(packet, length)});
+                }
+            }
+            if(t + interval < duration) {
+                sends.push(SendEvent(t + interval, j));
+            }
+        } else {
+            if(!writeLine(master, deliveries.top().line)) {
+                cerr << "pty write error: " << strerror(errno) << endl;
+                break;
+            }
+            bytes += deliveries.top().line.size();
+            delivered++;
+            deliveries.pop();
+        }
+    }
+
+    double elapsed = now() - start;
+    cout << "Drones " << numDrones << " simulated " << simTime << " s in " <<
+            elapsed << " s" << endl <<
+            "Packets generated " << generated << " duty-cycle drops " << dutyDrops <<
+            " lost " << lost << " delivered " << delivered << endl <<
+            "Channel airtime " << airtime << " s (" <<
+            ((simTime > 0) ? airtime * 100 / simTime : 0) << "% of one channel)" << endl <<
+            "Serial bytes " << bytes << " (" <<
+            ((elapsed > 0) ? bytes / elapsed : 0) << " B/s, " <<
+            ((elapsed > 0) ? delivered / elapsed : 0) << " packets/s)" << endl;
+
+    // Closing the master discards the lines not yet read by the ground station
+    sleep(1);
+    if(slave >= 0) {
+        close(slave);
+    }
+    close(master);
+    return 0;
+}
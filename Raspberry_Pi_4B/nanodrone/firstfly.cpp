@@ -221,16 +221,17 @@ void captureImage() {
 }
 
 /**
- * Save the image to file
+ * Drain the JPEG image from the camera FIFO to the local buffer.
+ * 
+ * The whole image is kept in memory (the buffer has the same size of the
+ * camera FIFO) so it can be hashed before deciding if it should be saved.
+ * 
+ * @return The image drain status
  */
-int saveImage(string fn) {
+int drainImage() {
     uint8_t temp = 0, temp_last = 0;
-    const char* fnp = fn.c_str();
 
-    FILE *fp1 = fopen(fnp, "w+");   
-    if (!fp1) {
-        return CAM_FILE_ERROR;
-        }
+    imageLength = 0;
     size_t length = Cam5642.read_fifo_length();
     if (length >= MAX_FIFO_SIZE) {
         return CAM_BUF_OVERSIZE;
@@ -247,36 +248,39 @@ int saveImage(string fn) {
         temp_last = temp;
         temp =  Cam5642.transfer(0x00);
         // Read JPEG data from FIFO and if find the end break while
-        if ( (temp == 0xD9) && (temp_last == 0xFF) ) {
+        if ( (temp == 0xD9) && (temp_last == 0xFF) && is_header) {
             buf[i++] = temp;  //save the last  0XD9     
-            //Write the remain bytes in the buffer
-            Cam5642.CS_HIGH();
-            fwrite(buf, i, 1, fp1);    
-            //Close the file
-            fclose(fp1); 
             is_header = false;
-            i = 0;
+            break;
         }
         if (is_header == true) { 
-            if (i < BUF_SIZE) { 
-                buf[i++] = temp;
-            } 
-            else {
-                // Write BUF_SIZE bytes image data to file
-                Cam5642.CS_HIGH();
-                fwrite(buf, BUF_SIZE, 1, fp1);
-                i = 0;
-                buf[i++] = temp;
-                Cam5642.CS_LOW();
-                Cam5642.set_fifo_burst();
-            }        
+            buf[i++] = temp;
         }
         else if ((temp == 0xD8) & (temp_last == 0xFF)) {
             is_header = true;
             buf[i++] = temp_last;
             buf[i++] = temp;
         }
-    } // While until the end of buffer
+    } // While until the end of the image
+    Cam5642.CS_HIGH();
+    is_header = false;
+    imageLength = i;
+
+    return (imageLength > 0) ? CAM_FILE_OK : CAM_BUF_ZERO;
+}
+
+/**
+ * Save the image drained in the local buffer to file
+ */
+int saveImage(string fn) {
+    const char* fnp = fn.c_str();
+
+    FILE *fp1 = fopen(fnp, "w+");   
+    if (!fp1) {
+        return CAM_FILE_ERROR;
+        }
+    fwrite(buf, imageLength, 1, fp1);
+    fclose(fp1); 
     
     return CAM_FILE_OK;
 }
@@ -338,14 +342,46 @@ int argToInt(string arg) {
     return x;
 }
 
+/**
+ * Capture an image, save and process it. Near-duplicates of the last kept
+ * frame are dropped before saving: the log only records the reference to
+ * the kept image. Every frame is sent to the preview stream. The people
+ * detected in the kept frames are logged with their boxes.
+ */
 void imageCaptureAndProcess() {
     digitalWrite(LED_PIN, true);
     captureImage();
+    // The capture is done, the time of the preview
+    uint64_t captureUs = PreviewRing::nowUs();
+    if(drainImage() != CAM_FILE_OK) {
+        digitalWrite(LED_PIN, false);
+        return;
+    }
+    // Also the duplicates are previewed, the viewer shows the live scene
+    previewGen.submit(buf, imageLength, captureUs);
+    if(frameHash.isDuplicate(buf, imageLength)) {
+        writeLog(LOG_IMAGE_DUPLICATE + to_string(frameHash.lastDistance()) +
+                 LOG_IMAGE_REFERENCE, lastSavedImage);
+        digitalWrite(LED_PIN, false);
+        return;
+    }
+    double start = FrameHash::now();
     lastSavedImage = createImageFileName();
     saveImage(lastSavedImage);
     writeLog(LOG_IMAGE_SAVED, lastSavedImage);
     imgProcessor.loadDefaultImage(lastSavedImage);
     eq = imgProcessor.correctExposure(&lightCorrector);
+    if(personDetector.detect(buf, imageLength) > 0) {
+        string boxes;
+        for(const Detection& d : personDetector.getDetections()) {
+            boxes += " [" + to_string(d.x) + "," + to_string(d.y) + " " +
+                     to_string(d.size) + " score " + to_string(d.score) + "]";
+        }
+        writeLog(LOG_PERSON_DETECTED +
+                 to_string(personDetector.getDetections().size()) + boxes,
+                 lastSavedImage);
+    }
+    frameHash.addProcessTime(FrameHash::now() - start);
     writeLog(LOG_IMAGE_PROCESS);
     digitalWrite(LED_PIN, false);
 }
@@ -353,7 +389,10 @@ void imageCaptureAndProcess() {
 /**
  * Main application.
  * 
- * Usage: firstfly <interval>
+ * Usage: firstfly <interval> <hash threshold>
+ * 
+ * The hash threshold is the max Hamming distance (0-64) of the near-duplicate
+ * frames that are dropped. A negative value keeps all the frames.
  * 
  * @note The capture delay (sec) of the series of images
  * do not consider the time needed to capture and process an image.
@@ -363,10 +402,13 @@ int main(int argc, char *argv[]) {
     // Number of seconds between the capture of two images
     int capInterval = DEFAULT_CAPTURE_INTERVAL;
 
-    // Check for the parameter
-    if(argc == 2) {
+    // Check for the parameters
+    if(argc >= 2) {
         capInterval = argToInt(argv[1]);
     }
+    if(argc >= 3) {
+        frameHash.setThreshold(argToInt(argv[2]));
+    }
 
     // Initialization and setup
     setup(); 
@@ -383,6 +425,20 @@ int main(int argc, char *argv[]) {
     writeLog(LOG_LIGHT_INDEX + to_string(lightCorrector.lightingIndex));
     writeLog(LOG_LIGHT_PERC + to_string(lightCorrector.lightingPerc));
     writeLog(LOG_LIGHT_LOOP + to_string(lightCorrector.maxExposureAdjust));
+    writeLog(LOG_HASH_THRESHOLD + (argc >= 3 ? string(argv[2]) :
+             to_string(DEFAULT_HASH_THRESHOLD)));
+    // The capture runs anyway if the preview stream can't be created
+    if(previewGen.start()) {
+        writeLog(LOG_PREVIEW_STARTED + string(PREVIEW_SHM_NAME));
+    } else {
+        writeLog(LOG_PREVIEW_ERROR);
+    }
+    // The frames are still captured and saved without the detector
+    if(personDetector.init()) {
+        writeLog(LOG_PERSON_STARTED);
+    } else {
+        writeLog(LOG_PERSON_ERROR);
+    }
 
     // Set the camera resolution
     Cam5642.OV5642_set_JPEG_size(OV5642_1600x1200);
@@ -410,5 +466,10 @@ int main(int argc, char *argv[]) {
     }
 
     digitalWrite(LED_PIN, false);
+    // Session report of the suppressed frames
+    frameHash.report(cout);
+    previewGen.stop();
+    previewGen.report(cout);
+    personDetector.report(cout);
     return 0;
 }
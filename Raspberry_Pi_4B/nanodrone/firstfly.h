@@ -29,6 +29,9 @@ at increasing speeds.
 #include "cam5642_errors.h"
 #include "imageprocessor.h"
 #include "serialgps.h"
+#include "framehash.h"
+#include "previewgen.h"
+#include "persondetector.h"
 
 // ----------------------------- Application version, subversion and build number
 #define testlens_VERSION_MAJOR 1
@@ -67,6 +70,8 @@ at increasing speeds.
 #define VSYNC_LEVEL_MASK 0x02  // 0 = High active - 1 = Low active
 //! Image data acquisitino buffer
 uint8_t buf[BUF_SIZE];
+//! Length of the JPEG image drained from the camera FIFO in the buffer
+size_t imageLength = 0;
 //! Image header flag
 bool is_header = false;
 //! Flag indicating is the camera has been initialized
@@ -86,6 +91,12 @@ string lastSavedImage = "";
 SerialGPS GPS;
 //! Number of times the image equalization has been applied
 int eq;
+//! Near-duplicate frames suppression (hovering drone)
+FrameHash frameHash;
+//! Preview stream for the local viewer and the downlink
+PreviewGenerator previewGen;
+//! Person detection on the kept frames
+PersonDetector personDetector;
 
 // ----------------------------- Messages
 #define CAMERA_STARTING "Initializing camera"
@@ -106,6 +117,14 @@ int eq;
 #define LOG_CAMERA_STARTED "OV5642 camera started"
 #define LOG_CAMERA_SETRES "Set camera resolution to 1600x1200"
 #define LOG_IMAGE_SAVED "Image saved"
+#define LOG_IMAGE_DUPLICATE "Near-duplicate frame dropped (distance "
+#define LOG_IMAGE_REFERENCE ") reference"
+#define LOG_HASH_THRESHOLD "Near-duplicate hash threshold: "
+#define LOG_PREVIEW_STARTED "Preview stream started: "
+#define LOG_PREVIEW_ERROR "Preview stream not available"
+#define LOG_PERSON_STARTED "Person detection model loaded"
+#define LOG_PERSON_ERROR "Person detection not available"
+#define LOG_PERSON_DETECTED "Persons detected: "
 // ----------------------------- Function prototypes
 void pVersion();
 int initCamera();
@@ -116,6 +135,7 @@ void showEqParams(LightIndexes* lc);
 void help();
 int startForCapture();
 void captureImage();
+int drainImage();
 int saveImage(string fn);
 void setup();
 int main(int argc, char *argv[]);
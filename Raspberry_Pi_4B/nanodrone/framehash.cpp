@@ -0,0 +1,119 @@
+/**
+ * @file framehash.cpp
+ * @brief Perceptual hash of the captured frames.
+ *
+*/
+
+#include "framehash.h"
+
+FrameHash::FrameHash(int threshold) {
+    maxDistance = threshold;
+    refHash = 0;
+    hasRef = false;
+}
+
+void FrameHash::setThreshold(int threshold) {
+    maxDistance = threshold;
+}
+
+int FrameHash::lastDistance() {
+    return distance;
+}
+
+DedupStats* FrameHash::getStats() {
+    return &stats;
+}
+
+bool FrameHash::dHash(const uint8_t* jpeg, size_t length, uint64_t* hash) {
+    //! Wraps the buffer without copying it
+    cv::Mat raw(1, (int)length, CV_8UC1, (void*)jpeg);
+    //! Luma plane decoded at 1/8 of the resolution (200x150 from 1600x1200)
+    cv::Mat luma = cv::imdecode(raw, cv::IMREAD_REDUCED_GRAYSCALE_8);
+    //! The hash source image
+    cv::Mat small;
+
+    if(luma.empty()) {
+        return false;
+    }
+
+    cv::resize(luma, small, cv::Size(HASH_WIDTH + 1, HASH_HEIGHT), 0, 0,
+               cv::INTER_AREA);
+
+    // One bit every pair of horizontal neighbours, set when the luma increases
+    uint64_t h = 0;
+    for(int y = 0; y < HASH_HEIGHT; y++) {
+        const uint8_t* row = small.ptr<uint8_t>(y);
+        for(int x = 0; x < HASH_WIDTH; x++) {
+            h = (h << 1) | (row[x] < row[x + 1] ? 1 : 0);
+        }
+    }
+    *hash = h;
+    return true;
+}
+
+bool FrameHash::isDuplicate(const uint8_t* jpeg, size_t length) {
+    double start = now();
+    uint64_t hash;
+    bool duplicate = false;
+
+    stats.frames++;
+    if(dHash(jpeg, length, &hash)) {
+        if(hasRef) {
+            distance = hamming(hash, refHash);
+            duplicate = (distance <= maxDistance);
+        } else {
+            distance = -1;
+        }
+        // Only the kept frames become the reference
+        if(!duplicate) {
+            refHash = hash;
+            hasRef = true;
+        }
+    } else {
+        distance = -1;
+    }
+    stats.hashSec += now() - start;
+
+    if(duplicate) {
+        stats.duplicates++;
+        stats.bytesSaved += length;
+    } else {
+        stats.bytesKept += length;
+    }
+    return duplicate;
+}
+
+void FrameHash::addProcessTime(double sec) {
+    stats.processSec += sec;
+}
+
+void FrameHash::report(ostream& out) {
+    int kept = stats.frames - stats.duplicates;
+    //! Average cost of a kept frame (save + exposure correction)
+    double avgProcess = (kept > 0) ? stats.processSec / kept : 0;
+    //! Estimated CPU time that the duplicates would have needed
+    double cpuSaved = avgProcess * stats.duplicates - stats.hashSec;
+    uint64_t total = stats.bytesKept + stats.bytesSaved;
+
+    out << "Frames " << stats.frames << " kept " << kept <<
+           " duplicates " << stats.duplicates << endl <<
+           "Hash time " << stats.hashSec << " s (" <<
+           ((stats.frames > 0) ? stats.hashSec * 1000 / stats.frames : 0) <<
+           " ms/frame)" << endl <<
+           "Process time " << stats.processSec << " s (" <<
+           avgProcess * 1000 << " ms/kept frame)" << endl <<
+           "CPU saved " << cpuSaved << " s" << endl <<
+           "Storage saved " << stats.bytesSaved / 1024 << " KB of " <<
+           total / 1024 << " KB (" <<
+           ((total > 0) ? stats.bytesSaved * 100.0 / total : 0) << "%)" << endl;
+}
+
+int FrameHash::hamming(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+double FrameHash::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
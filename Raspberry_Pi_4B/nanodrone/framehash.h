@@ -0,0 +1,133 @@
+/**
+ * @file framehash.h
+ * @brief Perceptual hash of the captured frames to suppress the near-duplicate
+ * images acquired while the drone is hovering.
+ *
+ * The hash is a 64 bit difference hash (dHash) calculated on a downscaled luma
+ * plane of the JPEG image still in memory, before it is saved on file. The JPEG
+ * is decoded at 1/8 of the resolution (the scaling is done in the DCT domain by
+ * libjpeg) so the cost is a small fraction of a full decode.
+ *
+ * @note A frame is considered a duplicate when the Hamming distance between its
+ * hash and the hash of the last kept frame is less or equal to the threshold.
+ * The reference is not updated by the duplicates, so a slow drift is detected
+ * anyway when the accumulated difference exceeds the threshold.
+ */
+
+#ifndef _FRAMEHASH
+#define _FRAMEHASH
+
+#include <iostream>
+#include <stdint.h>
+#include <time.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+
+//! Default max Hamming distance between two hashes of near-duplicate frames
+#define DEFAULT_HASH_THRESHOLD 6
+//! Hash width (columns compared per row). The image is resized to (W + 1) x H
+#define HASH_WIDTH 8
+//! Hash height (rows)
+#define HASH_HEIGHT 8
+
+/**
+ * @brief Counters of the frame suppression used to report the CPU time
+ * and the storage saved during a session.
+ */
+struct DedupStats {
+    int frames = 0;             ///< Number of hashed frames
+    int duplicates = 0;         ///< Frames suppressed as near-duplicates
+    uint64_t bytesKept = 0;     ///< JPEG bytes written of the kept frames
+    uint64_t bytesSaved = 0;    ///< JPEG bytes not written (duplicates)
+    double hashSec = 0;         ///< Total time spent hashing all the frames
+    double processSec = 0;      ///< Total time spent saving and processing kept frames
+};
+
+class FrameHash {
+
+public:
+    /**
+     * Class constructor
+     *
+     * @param threshold Max Hamming distance of near-duplicate frames. A
+     * negative value disables the suppression (all the frames are kept)
+     */
+    FrameHash(int threshold = DEFAULT_HASH_THRESHOLD);
+
+    /**
+     * Calculate the difference hash of a JPEG image in memory
+     *
+     * @param jpeg The JPEG data buffer
+     * @param length The JPEG data length in bytes
+     * @param hash The calculated hash
+     * @return false if the JPEG can't be decoded
+     */
+    bool dHash(const uint8_t* jpeg, size_t length, uint64_t* hash);
+
+    /**
+     * Check if the frame is a near-duplicate of the last kept frame. If it is
+     * not a duplicate, the frame becomes the new reference.
+     *
+     * @note Frames that can't be decoded are never considered duplicates
+     *
+     * @param jpeg The JPEG data buffer
+     * @param length The JPEG data length in bytes
+     * @return true if the frame can be dropped
+     */
+    bool isDuplicate(const uint8_t* jpeg, size_t length);
+
+    /**
+     * Add the time spent saving and processing a kept frame. The average
+     * is used to estimate the CPU time saved by the suppressed frames.
+     *
+     * @param sec Seconds
+     */
+    void addProcessTime(double sec);
+
+    /**
+     * Set the Hamming distance threshold
+     */
+    void setThreshold(int threshold);
+
+    /**
+     * Return the Hamming distance between the last hashed frame and the reference
+     */
+    int lastDistance();
+
+    /**
+     * Return the session counters
+     */
+    DedupStats* getStats();
+
+    /**
+     * Print the CPU time and storage saved in the session
+     */
+    void report(ostream& out);
+
+    /**
+     * Number of different bits of two hashes
+     */
+    static int hamming(uint64_t a, uint64_t b);
+
+    /**
+     * Monotonic clock in seconds, used to profile the frame processing
+     */
+    static double now();
+
+private:
+    //! Max Hamming distance of the near-duplicates
+    int maxDistance;
+    //! Hash of the last kept frame
+    uint64_t refHash;
+    //! Flag is true when a reference frame has been hashed
+    bool hasRef = false;
+    //! Distance of the last hashed frame from the reference
+    int distance = -1;
+    //! Session counters
+    DedupStats stats;
+};
+
+#endif
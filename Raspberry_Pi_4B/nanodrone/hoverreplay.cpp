@@ -0,0 +1,66 @@
+/**
+@file hoverreplay.cpp
+
+@brief Replay a sequence of images captured by firstfly (e.g. while the drone
+is hovering) through the near-duplicate frames suppression and the image
+processor, reporting the CPU time and the storage saved.
+
+Usage: hoverreplay <hash threshold> <image> [<image> ...]
+
+The images are processed in the command line order, so use a shell glob
+on the timestamped names of a session (e.g. data/firstfly_*.jpg).
+
+@author Enrico Miglino <balearicdynamics@gmail.com>
+@version 1.0
+@date October 2026
+*/
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <stdint.h>
+#include "imageprocessor.h"
+#include "framehash.h"
+
+using namespace std;
+
+//! Image processor class instance
+ImageProcessor imgProcessor;
+//! Same light correction parameters used by firstfly
+LightIndexes lightCorrector = { 0.7, 3, 3 };
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        cout << "Usage: hoverreplay <hash threshold> <image> [<image> ...]" << endl;
+        return 1;
+    }
+
+    FrameHash frameHash(atoi(argv[1]));
+
+    for(int j = 2; j < argc; j++) {
+        ifstream file(argv[j], ios::binary);
+        if(!file) {
+            cout << "Can't read " << argv[j] << endl;
+            continue;
+        }
+        vector<uint8_t> jpeg((istreambuf_iterator<char>(file)),
+                             istreambuf_iterator<char>());
+
+        if(frameHash.isDuplicate(jpeg.data(), jpeg.size())) {
+            cout << argv[j] << " duplicate (distance " <<
+                    frameHash.lastDistance() << ")" << endl;
+            continue;
+        }
+        // Same processing of the kept frames in firstfly
+        double start = FrameHash::now();
+        imgProcessor.loadDefaultImage(argv[j]);
+        imgProcessor.correctExposure(&lightCorrector);
+        frameHash.addProcessTime(FrameHash::now() - start);
+        cout << argv[j] << " kept (distance " <<
+                frameHash.lastDistance() << ")" << endl;
+    }
+
+    frameHash.report(cout);
+    return 0;
+}
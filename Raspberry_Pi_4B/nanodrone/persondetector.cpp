@@ -0,0 +1,90 @@
+/**
+ * @file persondetector.cpp
+ * @brief Person detection on the captured frames with the NanoramaCam model.
+ *
+*/
+
+#include "persondetector.h"
+#include "framehash.h"
+
+//! Detector settings of the decoded plane, already reduced by the decoder
+static TiledDetectorConfig detectorConfig(int windowStride) {
+    TiledDetectorConfig config;
+    config.window_stride = windowStride;
+    config.max_width = 0;
+    return config;
+}
+
+PersonDetector::PersonDetector(int windowStride)
+    : detector(detectorConfig(windowStride)) {
+}
+
+bool PersonDetector::init() {
+    isReady = detector.Init();
+    return isReady;
+}
+
+const vector<Detection>& PersonDetector::getDetections() {
+    return detections;
+}
+
+PersonStats* PersonDetector::getStats() {
+    return &stats;
+}
+
+int PersonDetector::detect(const uint8_t* jpeg, size_t length) {
+    double start = FrameHash::now();
+
+    detections.clear();
+    if(!isReady) {
+        stats.errors++;
+        return -1;
+    }
+    //! Wraps the buffer without copying it
+    cv::Mat raw(1, (int)length, CV_8UC1, (void*)jpeg);
+    cv::Mat luma = cv::imdecode(raw, PERSON_DECODE_FLAGS);
+    if(luma.empty() || !luma.isContinuous()) {
+        stats.errors++;
+        return -1;
+    }
+    double decoded = FrameHash::now();
+    stats.decodeSec += decoded - start;
+
+    bool ok = detector.Detect(luma.ptr<uint8_t>(0), luma.cols, luma.rows,
+                              &detections);
+    stats.detectSec += FrameHash::now() - decoded;
+    if(!ok) {
+        stats.errors++;
+        return -1;
+    }
+    // Boxes of the decoded plane to frame pixels
+    for(Detection& d : detections) {
+        d.x *= PERSON_DECODE_SCALE;
+        d.y *= PERSON_DECODE_SCALE;
+        d.size *= PERSON_DECODE_SCALE;
+    }
+    const TiledDetectorStats& s = detector.stats();
+    stats.frames++;
+    stats.windows += s.windows;
+    stats.rejected += s.rejected;
+    stats.detections += detections.size();
+    if(!detections.empty()) {
+        stats.withPersons++;
+    }
+    return detections.size();
+}
+
+void PersonDetector::report(ostream& out) {
+    out << "Person detection " << stats.frames << " frames, " <<
+           stats.withPersons << " with persons, " << stats.detections <<
+           " detections (" << stats.errors << " errors)" << endl;
+    if(stats.frames > 0) {
+        out << "Windows " << stats.windows / stats.frames << " per frame, " <<
+               ((stats.windows > 0) ? stats.rejected * 100.0 / stats.windows : 0) <<
+               "% skipped (flat)" << endl <<
+               "Detection time " << (stats.decodeSec + stats.detectSec) * 1000 /
+               stats.frames << " ms/frame (decode " << stats.decodeSec * 1000 /
+               stats.frames << " ms), " << stats.frames /
+               (stats.decodeSec + stats.detectSec) << " frames/s" << endl;
+    }
+}
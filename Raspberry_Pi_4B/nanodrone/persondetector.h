@@ -0,0 +1,102 @@
+/**
+ * @file persondetector.h
+ * @brief Person detection on the captured frames with the NanoramaCam model.
+ *
+ * The JPEG still in memory is decoded as a luma plane at 1/4 of the
+ * resolution (DCT domain scaling of libjpeg, a 1600x1200 frame is decoded
+ * as 400x300) and scanned by the tiled pyramid detector of the NanoramaCam
+ * host build (Sense33/NanoramaCam/host/tiled_detector.h): overlapping 96x96
+ * windows at several scales, flat windows skipped, detections merged by
+ * non-maximum suppression.
+ *
+ * @note The detector is linked from libpersondetect.a, build it first with
+ * make libpersondetect.a in Sense33/NanoramaCam/host.
+ */
+
+#ifndef _PERSONDETECTOR
+#define _PERSONDETECTOR
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "tiled_detector.h"
+
+using namespace std;
+
+//! Decode flags of the detection luma plane
+#define PERSON_DECODE_FLAGS cv::IMREAD_REDUCED_GRAYSCALE_4
+//! Frame pixels per pixel of the decoded plane
+#define PERSON_DECODE_SCALE 4
+//! Step between the 96x96 windows of a pyramid level (decoded pixels)
+#define PERSON_WINDOW_STRIDE 48
+
+/**
+ * @brief Counters of the person detection of a session
+ */
+struct PersonStats {
+    int frames = 0;             ///< Frames scanned
+    int withPersons = 0;        ///< Frames with at least one detection
+    int detections = 0;         ///< Total detections after the suppression
+    int errors = 0;             ///< Decode or detector errors
+    long windows = 0;           ///< Windows of the pyramids
+    long rejected = 0;          ///< Flat windows skipped
+    double decodeSec = 0;       ///< Total time spent decoding the luma planes
+    double detectSec = 0;       ///< Total time spent in the detector
+};
+
+class PersonDetector {
+
+public:
+    /**
+     * Class constructor
+     *
+     * @param windowStride Step between the windows of a level
+     */
+    PersonDetector(int windowStride = PERSON_WINDOW_STRIDE);
+
+    /**
+     * Load the model
+     *
+     * @return false if the interpreter can't be created
+     */
+    bool init();
+
+    /**
+     * Detect the people of a JPEG frame in memory
+     *
+     * @param jpeg The full frame JPEG
+     * @param length JPEG length
+     * @return The number of detections, -1 on error
+     */
+    int detect(const uint8_t* jpeg, size_t length);
+
+    /**
+     * Return the detections of the last frame, in frame pixels
+     */
+    const vector<Detection>& getDetections();
+
+    /**
+     * Return the session counters
+     */
+    PersonStats* getStats();
+
+    /**
+     * Print the person detection report
+     */
+    void report(ostream& out);
+
+private:
+    //! Pyramid detector
+    TiledDetector detector;
+    //! Detections of the last frame
+    vector<Detection> detections;
+    //! Flag is true when the model is loaded
+    bool isReady = false;
+    //! Session counters
+    PersonStats stats;
+};
+
+#endif
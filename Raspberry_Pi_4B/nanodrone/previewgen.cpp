@@ -0,0 +1,144 @@
+/**
+ * @file previewgen.cpp
+ * @brief Generation of the small JPEG previews of the captured frames.
+ *
+*/
+
+#include <string.h>
+#include "previewgen.h"
+#include "framehash.h"
+
+using namespace cv;
+
+PreviewGenerator::PreviewGenerator(int width, int height, int quality) {
+    previewWidth = width;
+    previewHeight = height;
+    jpegQuality = quality;
+    pendingUs = 0;
+    currentUs = 0;
+    hasPending = false;
+    isRunning = false;
+}
+
+PreviewGenerator::~PreviewGenerator() {
+    stop();
+}
+
+bool PreviewGenerator::start(string name) {
+    if(isRunning) {
+        return true;
+    }
+    if(!ring.create(name)) {
+        return false;
+    }
+    isRunning = true;
+    worker = thread(&PreviewGenerator::run, this);
+    return true;
+}
+
+void PreviewGenerator::stop() {
+    {
+        unique_lock<mutex> guard(lock);
+        if(!isRunning) {
+            return;
+        }
+        isRunning = false;
+    }
+    ready.notify_one();
+    worker.join();
+}
+
+void PreviewGenerator::submit(const uint8_t* jpeg, size_t length,
+                              uint64_t captureUs) {
+    double start = FrameHash::now();
+    {
+        unique_lock<mutex> guard(lock);
+        if(!isRunning) {
+            return;
+        }
+        stats.submitted++;
+        if(hasPending) {
+            stats.replaced++;
+        }
+        // The vector capacity is kept, no allocations after the first frames
+        pending.assign(jpeg, jpeg + length);
+        pendingUs = captureUs;
+        hasPending = true;
+        stats.copySec += FrameHash::now() - start;
+    }
+    ready.notify_one();
+}
+
+bool PreviewGenerator::makePreview(const uint8_t* jpeg, size_t length,
+                                   vector<uchar>* out) {
+    Mat data(1, (int)length, CV_8UC1, (void*)jpeg);
+    Mat small = imdecode(data, IMREAD_REDUCED_COLOR_8);
+    if(small.empty()) {
+        return false;
+    }
+    Mat preview;
+    if(small.cols != previewWidth || small.rows != previewHeight) {
+        resize(small, preview, Size(previewWidth, previewHeight), 0, 0, INTER_AREA);
+    } else {
+        preview = small;
+    }
+    vector<int> params = { IMWRITE_JPEG_QUALITY, jpegQuality };
+    return imencode(".jpg", preview, *out, params);
+}
+
+void PreviewGenerator::run() {
+    vector<uchar> preview;
+
+    while(true) {
+        {
+            unique_lock<mutex> guard(lock);
+            while(isRunning && !hasPending) {
+                ready.wait(guard);
+            }
+            if(!isRunning) {
+                return;
+            }
+            // Swap the buffers: the capture loop fills the other one
+            current.swap(pending);
+            currentUs = pendingUs;
+            hasPending = false;
+        }
+
+        double start = FrameHash::now();
+        bool isOk = makePreview(current.data(), current.size(), &preview) &&
+                    ring.publish(preview.data(), preview.size(),
+                                 (uint16_t)previewWidth, (uint16_t)previewHeight,
+                                 currentUs);
+        double elapsed = FrameHash::now() - start;
+
+        unique_lock<mutex> guard(lock);
+        stats.previewSec += elapsed;
+        if(isOk) {
+            stats.published++;
+            stats.bytes += preview.size();
+        } else {
+            stats.errors++;
+        }
+    }
+}
+
+PreviewStats PreviewGenerator::getStats() {
+    unique_lock<mutex> guard(lock);
+    return stats;
+}
+
+void PreviewGenerator::report(ostream& out) {
+    PreviewStats s = getStats();
+
+    out << "Previews " << s.published << " of " << s.submitted << " frames (" <<
+           s.replaced << " replaced, " << s.errors << " errors)" << endl;
+    if(s.published > 0) {
+        out << "Preview size " << previewWidth << "x" << previewHeight <<
+               ", average " << s.bytes / s.published << " bytes, " <<
+               s.previewSec * 1000 / s.published << " ms per preview (worker)" << endl;
+    }
+    if(s.submitted > 0) {
+        out << "Capture loop cost " << s.copySec * 1000 / s.submitted <<
+               " ms per frame (copy)" << endl;
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * @file previewgen.h
+ * @brief Generation of the small JPEG previews of the captured frames.
+ *
+ * The preview is made from the JPEG still in memory: the image is decoded at
+ * 1/8 of the resolution (the scaling is done in the DCT domain by libjpeg, a
+ * 1600x1200 frame is decoded as 200x150), resized to the preview size and
+ * encoded again. The previews are published in the shared memory ring.
+ *
+ * The work is done by a worker thread, so the capture loop only pays the copy
+ * of the JPEG. If a new frame is submitted while the previous one is still
+ * waiting, the oldest is replaced: the previews never slow down the capture.
+ */
+
+#ifndef _PREVIEWGEN
+#define _PREVIEWGEN
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "previewring.h"
+
+using namespace std;
+
+//! Preview width
+#define PREVIEW_WIDTH 160
+//! Preview height
+#define PREVIEW_HEIGHT 120
+//! Preview JPEG quality
+#define PREVIEW_QUALITY 70
+
+/**
+ * @brief Counters of the preview generation
+ */
+struct PreviewStats {
+    int submitted = 0;          ///< Frames submitted by the capture loop
+    int published = 0;          ///< Previews published in the ring
+    int replaced = 0;           ///< Frames replaced before the preview was made
+    int errors = 0;             ///< Decode, encode or ring errors
+    uint64_t bytes = 0;         ///< Total bytes of the previews
+    double copySec = 0;         ///< Capture loop time (frame copy)
+    double previewSec = 0;      ///< Worker time (decode, resize, encode)
+};
+
+class PreviewGenerator {
+
+public:
+    /**
+     * Class constructor
+     *
+     * @param width Preview width
+     * @param height Preview height
+     * @param quality Preview JPEG quality (0-100)
+     */
+    PreviewGenerator(int width = PREVIEW_WIDTH, int height = PREVIEW_HEIGHT,
+                     int quality = PREVIEW_QUALITY);
+
+    /**
+     * Class destructor. Stops the worker thread
+     */
+    ~PreviewGenerator();
+
+    /**
+     * Create the shared memory ring and start the worker thread
+     *
+     * @return false if the ring can't be created
+     */
+    bool start(string name = PREVIEW_SHM_NAME);
+
+    /**
+     * Stop the worker thread. The pending frame is discarded
+     */
+    void stop();
+
+    /**
+     * Submit a captured frame. The JPEG is copied, the buffer can be reused
+     * immediately.
+     *
+     * @param captureUs Capture time of the frame (PreviewRing::nowUs()),
+     * the timestamp of its preview
+     */
+    void submit(const uint8_t* jpeg, size_t length, uint64_t captureUs);
+
+    /**
+     * Make a preview from a JPEG in memory
+     *
+     * @param jpeg The full frame JPEG
+     * @param length JPEG length
+     * @param out The preview JPEG
+     * @return false if the frame can't be decoded
+     */
+    bool makePreview(const uint8_t* jpeg, size_t length, vector<uchar>* out);
+
+    /**
+     * Return the counters
+     */
+    PreviewStats getStats();
+
+    /**
+     * Print the preview generation report
+     */
+    void report(ostream& out);
+
+private:
+    //! Preview size and quality
+    int previewWidth;
+    int previewHeight;
+    int jpegQuality;
+    //! Shared memory ring
+    PreviewRing ring;
+    //! Worker thread
+    thread worker;
+    //! Protects the pending frame, the flags and the counters
+    mutex lock;
+    condition_variable ready;
+    //! Frame waiting for the worker and its capture time
+    vector<uint8_t> pending;
+    uint64_t pendingUs;
+    //! Frame in process by the worker and its capture time
+    vector<uint8_t> current;
+    uint64_t currentUs;
+    bool hasPending;
+    bool isRunning;
+    //! Counters
+    PreviewStats stats;
+
+    //! Worker thread loop
+    void run();
+};
+
+#endif
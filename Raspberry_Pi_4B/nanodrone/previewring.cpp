@@ -0,0 +1,124 @@
+/**
+ * @file previewring.cpp
+ * @brief Shared memory ring of the JPEG previews of the captured frames.
+ *
+*/
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "previewring.h"
+
+PreviewRing::PreviewRing() {
+    ring = nullptr;
+    isWriter = false;
+}
+
+PreviewRing::~PreviewRing() {
+    if(ring != nullptr) {
+        munmap(ring, sizeof(PreviewRingHeader));
+        if(isWriter) {
+            shm_unlink(shmName.c_str());
+        }
+    }
+}
+
+bool PreviewRing::create(string name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    if(ftruncate(fd, sizeof(PreviewRingHeader)) < 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, sizeof(PreviewRingHeader), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        return false;
+    }
+    ring = (PreviewRingHeader*)p;
+    memset(ring, 0, sizeof(PreviewRingHeader));
+    ring->slots = PREVIEW_SLOTS;
+    __atomic_store_n(&ring->magic, PREVIEW_MAGIC, __ATOMIC_RELEASE);
+    shmName = name;
+    isWriter = true;
+    return true;
+}
+
+bool PreviewRing::open(string name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0) {
+        return false;
+    }
+    void* p = mmap(nullptr, sizeof(PreviewRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        return false;
+    }
+    ring = (PreviewRingHeader*)p;
+    if(__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != PREVIEW_MAGIC) {
+        munmap(p, sizeof(PreviewRingHeader));
+        ring = nullptr;
+        return false;
+    }
+    shmName = name;
+    isWriter = false;
+    return true;
+}
+
+uint32_t PreviewRing::frames() {
+    return (ring == nullptr) ? 0 : __atomic_load_n(&ring->frames, __ATOMIC_ACQUIRE);
+}
+
+uint64_t PreviewRing::nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool PreviewRing::publish(const uint8_t* jpeg, size_t length, uint16_t width,
+                          uint16_t height, uint64_t timestampUs) {
+    if(ring == nullptr || !isWriter || length > PREVIEW_SLOT_SIZE) {
+        return false;
+    }
+    uint32_t frame = ring->frames;
+    PreviewSlot* s = &ring->slot[frame % PREVIEW_SLOTS];
+
+    // Odd: the readers discard the slot while it is written
+    uint32_t seq = s->seq + 1;
+    __atomic_store_n(&s->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(s->data, jpeg, length);
+    s->length = (uint32_t)length;
+    s->frame = frame;
+    s->width = width;
+    s->height = height;
+    s->timestampUs = timestampUs;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->frames, frame + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool PreviewRing::latest(const PreviewSlot** slot, uint32_t* seq) {
+    uint32_t n = frames();
+    if(n == 0) {
+        return false;
+    }
+    const PreviewSlot* s = &ring->slot[(n - 1) % PREVIEW_SLOTS];
+    uint32_t q = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    if(q & 1) {
+        return false;
+    }
+    *slot = s;
+    *seq = q;
+    return true;
+}
+
+bool PreviewRing::isValid(const PreviewSlot* slot, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
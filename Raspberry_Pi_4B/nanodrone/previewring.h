@@ -0,0 +1,126 @@
+/**
+ * @file previewring.h
+ * @brief Shared memory ring of the JPEG previews of the captured frames.
+ *
+ * The capture application is the only writer; any number of local processes
+ * (viewer, downlink) can map the ring read-only and use the latest preview
+ * directly from the shared memory, without copying it.
+ *
+ * Every slot is protected by a sequence counter (seqlock): the writer makes
+ * it odd while the slot is written and even when the slot is complete. A
+ * reader checks the counter before and after using the data; if it changed,
+ * the slot has been overwritten and the data should be discarded.
+ */
+
+#ifndef _PREVIEWRING
+#define _PREVIEWRING
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+using namespace std;
+
+//! POSIX shared memory object name
+#define PREVIEW_SHM_NAME "/nanodrone-preview"
+//! Ring identification
+#define PREVIEW_MAGIC 0x4E505256
+//! Number of previews in the ring
+#define PREVIEW_SLOTS 8
+//! Max JPEG preview size. A 160x120 JPEG is usually 4-8 KB
+#define PREVIEW_SLOT_SIZE 32768
+
+/**
+ * @brief One preview in the shared memory
+ */
+struct PreviewSlot {
+    uint32_t seq;                       ///< Seqlock counter, odd while writing
+    uint32_t length;                    ///< JPEG length
+    uint32_t frame;                     ///< Frame number
+    uint16_t width;                     ///< Preview width
+    uint16_t height;                    ///< Preview height
+    uint64_t timestampUs;               ///< Capture time of the frame (CLOCK_REALTIME)
+    uint8_t data[PREVIEW_SLOT_SIZE];    ///< JPEG data
+};
+
+/**
+ * @brief Shared memory layout
+ */
+struct PreviewRingHeader {
+    uint32_t magic;                     ///< PREVIEW_MAGIC when initialized
+    uint32_t slots;                     ///< Number of slots
+    uint32_t frames;                    ///< Previews published, the last is (frames - 1) % slots
+    uint32_t reserved;
+    PreviewSlot slot[PREVIEW_SLOTS];
+};
+
+class PreviewRing {
+
+public:
+    /**
+     * Class constructor
+     */
+    PreviewRing();
+
+    /**
+     * Class destructor. Unmaps the shared memory (the writer also removes it)
+     */
+    ~PreviewRing();
+
+    /**
+     * Create the shared memory ring (writer)
+     *
+     * @return false on errors
+     */
+    bool create(string name = PREVIEW_SHM_NAME);
+
+    /**
+     * Map an existing ring read-only (reader)
+     *
+     * @return false if the ring does not exist
+     */
+    bool open(string name = PREVIEW_SHM_NAME);
+
+    /**
+     * Publish a preview in the next slot (writer)
+     *
+     * @param timestampUs Capture time of the frame, from nowUs()
+     * @return false if the preview is too large
+     */
+    bool publish(const uint8_t* jpeg, size_t length, uint16_t width, uint16_t height,
+                 uint64_t timestampUs);
+
+    /**
+     * Current time in us, the CLOCK_REALTIME of the slot timestamps
+     */
+    static uint64_t nowUs();
+
+    /**
+     * Return the latest complete preview, pointing in the shared memory
+     *
+     * @param slot The slot of the latest preview
+     * @param seq The slot sequence, to be checked with isValid() after use
+     * @return false if no previews are available
+     */
+    bool latest(const PreviewSlot** slot, uint32_t* seq);
+
+    /**
+     * Check if the slot has not been overwritten since latest() returned it
+     */
+    bool isValid(const PreviewSlot* slot, uint32_t seq);
+
+    /**
+     * Number of previews published
+     */
+    uint32_t frames();
+
+private:
+    //! The mapped ring
+    PreviewRingHeader* ring;
+    //! Shared memory name
+    string shmName;
+    //! Flag is true for the writer
+    bool isWriter;
+};
+
+#endif
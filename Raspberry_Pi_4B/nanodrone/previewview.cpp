@@ -0,0 +1,96 @@
+/**
+@file previewview.cpp
+
+@brief Local viewer of the preview stream published by firstfly in the shared
+memory ring. The previews are decoded directly from the shared memory.
+
+Usage: previewview [-o file]
+
+Without options the latest preview is shown in a window, updated when a new
+preview is published (press ESC to exit). With -o the latest preview is
+written to the file and the program exits, so it can be used headless (e.g.
+by a downlink script).
+
+@author Enrico Miglino <balearicdynamics@gmail.com>
+@version 1.0
+@date October 2026
+*/
+
+#include <iostream>
+#include <fstream>
+#include <unistd.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "previewring.h"
+
+using namespace cv;
+using namespace std;
+
+//! Preview window name
+#define PREVIEW_WINDOW "Nanodrone preview"
+//! Window refresh period, ms
+#define REFRESH_MS 50
+//! ESC key code
+#define KEY_ESC 27
+
+int main(int argc, char *argv[]) {
+    string outFile = "";
+    int opt;
+
+    while((opt = getopt(argc, argv, "o:")) != -1) {
+        switch(opt) {
+            case 'o': outFile = optarg; break;
+            default:
+                cout << "Usage: previewview [-o file]" << endl;
+                return 1;
+        }
+    }
+
+    PreviewRing ring;
+    if(!ring.open()) {
+        cout << "No preview stream (is firstfly running?)" << endl;
+        return 1;
+    }
+
+    // Headless: save the latest preview. Retry if it is overwritten meanwhile
+    if(!outFile.empty()) {
+        const PreviewSlot* slot;
+        uint32_t seq;
+        for(int retry = 0; retry < PREVIEW_SLOTS; retry++) {
+            if(!ring.latest(&slot, &seq)) {
+                usleep(REFRESH_MS * 1000);
+                continue;
+            }
+            ofstream file(outFile, ios::binary);
+            file.write((const char*)slot->data, slot->length);
+            file.close();
+            if(ring.isValid(slot, seq)) {
+                cout << "Preview " << slot->frame << " " << slot->width << "x" <<
+                        slot->height << " saved to " << outFile << endl;
+                return 0;
+            }
+        }
+        cout << "Can't read the preview" << endl;
+        return 1;
+    }
+
+    uint32_t shown = 0;
+    namedWindow(PREVIEW_WINDOW, WINDOW_NORMAL | WINDOW_KEEPRATIO);
+    while(waitKey(REFRESH_MS) != KEY_ESC) {
+        const PreviewSlot* slot;
+        uint32_t seq;
+        if(ring.frames() == shown || !ring.latest(&slot, &seq)) {
+            continue;
+        }
+        // Decode from the shared memory, discard if overwritten meanwhile
+        Mat data(1, (int)slot->length, CV_8UC1, (void*)slot->data);
+        Mat preview = imdecode(data, IMREAD_COLOR);
+        if(!ring.isValid(slot, seq) || preview.empty()) {
+            continue;
+        }
+        shown = slot->frame + 1;
+        imshow(PREVIEW_WINDOW, preview);
+    }
+    destroyWindow(PREVIEW_WINDOW);
+    return 0;
+}
@@ -23,9 +23,14 @@ connected applicaiton based on Ble for short range communication.
 
 #include "main_functions.h"
 
+#include "capture_pipeline.h"
+#include "detection_filter.h"
+#include "detection_report.h"
 #include "detection_responder.h"
 #include "image_provider.h"
 #include "model_settings.h"
+#include "motion_gate.h"
+#include "person_detect_memory_plan.h"
 #include "person_detect_model_data.h"
 #include "tensorflow/lite/micro/kernels/micro_ops.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
@@ -35,6 +40,13 @@ connected applicaiton based on Ble for short range communication.
 #include "tensorflow/lite/version.h"
 
 #undef _REPORT_TF_LITE_ERROR
+// Define to capture every frame after the inference of the previous one,
+// otherwise the next capture runs during the inference (capture_pipeline.h).
+// The overlap gives about 6% more detections per second, but the frame
+// inferred was captured before the previous inference: about 2.1 s old at
+// the end of its inference instead of 1.15 s (host/capture_pipeline_sim).
+// The serial capture keeps the detection latency low.
+#define _SERIAL_CAPTURE
 
 // Globals, used for compatibility with Arduino-style sketches.
 namespace {
@@ -44,22 +56,48 @@ tflite::MicroInterpreter* interpreter = nullptr;
 TfLiteTensor* input = nullptr;
 
 // An area of memory to use for input, output, and intermediate arrays.
-constexpr int kTensorArenaSize = 93 * 1024;
+// 72624 bytes are used on the 64 bit host build with the offline memory plan
+// (host/person_detect_plan) and the requantization tables in the model
+// metadata, the 32 bit target needs less.
+constexpr int kTensorArenaSize = 71 * 1024;
 static uint8_t tensor_arena[kTensorArenaSize];
+
+// The split capture of the image provider
+struct ArducamCamera {
+  TfLiteStatus Start() { return StartImageCapture(error_reporter); }
+  TfLiteStatus Read(uint8_t* image_data) {
+    return ReadCapturedImage(error_reporter, kNumCols, kNumRows, kNumChannels,
+                             image_data);
+  }
+};
+ArducamCamera camera;
+#ifdef _SERIAL_CAPTURE
+CapturePipeline<ArducamCamera> capture_pipeline(&camera, false);
+#else
+CapturePipeline<ArducamCamera> capture_pipeline(&camera, true);
+#endif
+
+// Skips the inference of the still frames
+MotionGate motion_gate;
+// Detection over the last inferences
+DetectionFilter detection_filter;
 }  // namespace
 
 //! Create the custom BLE service with a random generated UUID
 BLEService personDetect("4f375fe5-24b2-46ba-b760-5b121ec695df");
 //! Define the custom characteristic with the associated UUID
-//! Clients are notified when the characteristic changes and can read the value
-BLEUnsignedCharCharacteristic humanDetected("4f375fe5-24b2-46ba-b760-5b121ec695df",
-    BLERead | BLENotify);
-//! Clients receives the number of tries
-BLEUnsignedCharCharacteristic triesCount("4f375fe5-24b2-46ba-b760-5b121ec695df",
-    BLERead | BLENotify);
-
-//! Number of tries to detect a human
-int detections = 0;
+//! The detection report of detection_report.h: detection, score, confidence,
+//! frame counter and timing. Clients are notified when the detection changes,
+//! the score changes are batched, and can read the value
+BLECharacteristic detectionReport("4f375fe8-24b2-46ba-b760-5b121ec695df",
+    BLERead | BLENotify, kDetectionReportSize, true);
+
+//! Connection interval requested to the central, 1.25 ms units (50-100 ms)
+constexpr uint16_t kConnectionIntervalMin = 40;
+constexpr uint16_t kConnectionIntervalMax = 80;
+//! Notifies the report, at most once per connection interval
+DetectionReporter<BLECharacteristic> detectionReporter(&detectionReport,
+    kConnectionIntervalMax * 5 / 4);
 
 // The name of this function is important for Arduino compatibility.
 void setup() {
@@ -90,13 +128,10 @@ void setup() {
   // Initialize the bLE features before starting advertising
   BLE.setLocalName("Nanodrone");
   BLE.setAdvertisedService(personDetect);
-  personDetect.addCharacteristic(humanDetected);
-  personDetect.addCharacteristic(triesCount);
-  BLE.addService(personDetect);
+  personDetect.addCharacteristic(detectionReport);
   BLE.addService(personDetect);
-  // The initial value is false, as no person has been detected
-  humanDetected.writeValue(false);
-  triesCount.writeValue((int)0);
+  BLE.setConnectionInterval(kConnectionIntervalMin, kConnectionIntervalMax);
+  // The initial report is sent by the first loop(), no person detected
 
   /* Start advertising BLE.  It will start continuously transmitting BLE
      advertising packets and will be visible to remote BLE central devices
@@ -117,16 +152,27 @@ void setup() {
   micro_op_resolver.AddBuiltin(
       tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
       tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  // Im2col + GEMM convolution, same results of Register_CONV_2D(). The per
+  // channel offsets are read from the model metadata, not from the arena
   micro_op_resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
-                               tflite::ops::micro::Register_CONV_2D());
-  micro_op_resolver.AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
-                               tflite::ops::micro::Register_AVERAGE_POOL_2D());
+                               tflite::ops::micro::Register_CONV_2D_GEMM());
+  // Average pool dividing by the reciprocal of the window size, same
+  // results of Register_AVERAGE_POOL_2D()
+  micro_op_resolver.AddBuiltin(
+      tflite::BuiltinOperator_AVERAGE_POOL_2D,
+      tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL());
 
   // Build an interpreter to run the model with.
   static tflite::MicroInterpreter static_interpreter(
       model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
   interpreter = &static_interpreter;
 
+  // The arena layout is computed offline for these kernels, no greedy
+  // planning at startup. A plan not matching the model is ignored.
+  static tflite::PrecomputedMemoryPlanner memory_planner(
+      g_person_detect_memory_plan, g_person_detect_memory_plan_len);
+  interpreter->SetMemoryPlanner(&memory_planner);
+
   // Allocate memory from the tensor_arena for the model's tensors.
   TfLiteStatus allocate_status = interpreter->AllocateTensors();
   if (allocate_status != kTfLiteOk) {
@@ -145,38 +191,51 @@ void setup() {
 void loop() {
   BLEDevice central = BLE.central();
 
-    // Get image from provider.
-    if (kTfLiteOk != GetImage(error_reporter, kNumCols, kNumRows, kNumChannels,
-                              input->data.uint8)) {
+    // Get image from provider, the next capture starts unless
+    // _SERIAL_CAPTURE is defined
+    if (kTfLiteOk != capture_pipeline.NextImage(input->data.uint8)) {
 #ifdef _REPORT_TF_LITE_ERROR
       TF_LITE_REPORT_ERROR(error_reporter, "Image capture failed.");
 #endif
     }
   
-    // Run the model on this input and make sure it succeeds.
-    if (kTfLiteOk != interpreter->Invoke()) {
+    // Run the model on this input and make sure it succeeds, unless the
+    // scene is still: the last detection holds.
+    static uint16_t inference_ms = 0;
+    if (motion_gate.Check(input->data.uint8)) {
+      const unsigned long invoke_start = millis();
+      if (kTfLiteOk != interpreter->Invoke()) {
 #ifdef _REPORT_TF_LITE_ERROR
-      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed.");
+        TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed.");
 #endif
-    }
+      }
+      inference_ms = (uint16_t)(millis() - invoke_start);
   
-    TfLiteTensor* output = interpreter->output(0);
+      TfLiteTensor* output = interpreter->output(0);
   
-    // Process the inference results.
-    uint8_t person_score = output->data.uint8[kPersonIndex];
-    uint8_t no_person_score = output->data.uint8[kNotAPersonIndex];
-    RespondToDetection(error_reporter, person_score, no_person_score);
-    // Advertise the detection, if any
-    // Here we consider only the highest score but it is worth to optimize the
-    // detection adding the trustability of the result
-    // Note that only the detected events are notified.
-    if(person_score > 150) {
-      humanDetected.writeValue('T');
-    } // Human has been detected!
-    else {
-      humanDetected.writeValue('F');
-    } // No human detected
-
-    triesCount.writeValue((unsigned char)++detections);
+      // Process the inference results.
+      uint8_t person_score = output->data.uint8[kPersonIndex];
+      uint8_t no_person_score = output->data.uint8[kNotAPersonIndex];
+      RespondToDetection(error_reporter, person_score, no_person_score);
+
+      // The scores are smoothed over the last inferences with two
+      // thresholds (detection_filter.h), a single frame doesn't switch the
+      // detection.
+      if (detection_filter.Update(person_score)) {
+        RespondToDetectionChange(error_reporter, detection_filter.person(),
+                                 detection_filter.confidence());
+      }
+    }
+
+    // Advertise the detection. The report is written, and notified, only
+    // when the detection changes or, batched, when the score changes.
+    DetectionReport report;
+    report.flags = detection_filter.person() ? kReportPerson : 0;
+    report.score = detection_filter.score();
+    report.confidence = detection_filter.confidence();
+    report.skipped_percent = motion_gate.skipped_percent();
+    report.frames = motion_gate.frames();
+    report.inference_ms = inference_ms;
+    detectionReporter.Update(report, millis());
 
 }
@@ -13,6 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 
 Addressing the BLE service instead of seral score output
+
+No delay() after the inference: the blue LED toggles, the person/no person
+LEDs change only with the filtered detection. E.M.
 ==============================================================================*/
 
 #if defined(ARDUINO) && !defined(ARDUINO_ARDUINO_NANO33BLE)
@@ -25,33 +28,46 @@ Addressing the BLE service instead of seral score output
 
 #include "Arduino.h"
 
-// Flash the blue LED after each inference
-void RespondToDetection(tflite::ErrorReporter* error_reporter,
-                        uint8_t person_score, uint8_t no_person_score) {
+namespace {
+
+void InitLeds() {
   static bool is_initialized = false;
   if (!is_initialized) {
     // Pins for the built-in RGB LEDs on the Arduino Nano 33 BLE Sense
     pinMode(LEDR, OUTPUT);
     pinMode(LEDG, OUTPUT);
     pinMode(LEDB, OUTPUT);
+    // Note: The RGB LEDs on the Arduino Nano 33 BLE
+    // Sense are on when the pin is LOW, off when HIGH.
+    digitalWrite(LEDR, HIGH);
+    digitalWrite(LEDG, HIGH);
+    digitalWrite(LEDB, HIGH);
     is_initialized = true;
   }
+}
+
+}  // namespace
 
-  // Note: The RGB LEDs on the Arduino Nano 33 BLE
-  // Sense are on when the pin is LOW, off when HIGH.
+// Toggle the blue LED after each inference
+void RespondToDetection(tflite::ErrorReporter* error_reporter,
+                        uint8_t person_score, uint8_t no_person_score) {
+  static bool blue_on = false;
+  InitLeds();
 
-  // Switch the person/not person LEDs off
-  digitalWrite(LEDG, HIGH);
-  digitalWrite(LEDR, HIGH);
+  blue_on = !blue_on;
+  digitalWrite(LEDB, blue_on ? LOW : HIGH);
+
+  TF_LITE_REPORT_ERROR(error_reporter, "Person score: %d No person score: %d",
+                       person_score, no_person_score);
+}
 
-  // Flash the blue LED after every inference.
-  digitalWrite(LEDB, LOW);
-  delay(100);
-  digitalWrite(LEDB, HIGH);
+// Switch on the green LED when a person is detected,
+// the red when no person is detected
+void RespondToDetectionChange(tflite::ErrorReporter* error_reporter,
+                              bool person, uint8_t confidence) {
+  InitLeds();
 
-  // Switch on the green LED when a person is detected,
-  // the red when no person is detected
-  if (person_score > no_person_score) {
+  if (person) {
     digitalWrite(LEDG, LOW);
     digitalWrite(LEDR, HIGH);
   } else {
@@ -59,8 +75,8 @@ void RespondToDetection(tflite::ErrorReporter* error_reporter,
     digitalWrite(LEDR, LOW);
   }
 
-  TF_LITE_REPORT_ERROR(error_reporter, "Person score: %d No person score: %d",
-                       person_score, no_person_score);
+  TF_LITE_REPORT_ERROR(error_reporter, "Person detected: %d Confidence: %d%%",
+                       person, confidence);
 }
 
 #endif  // ARDUINO_EXCLUDE_CODE
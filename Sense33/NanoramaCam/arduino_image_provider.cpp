@@ -12,12 +12,16 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 
-Removed the unwanted serial messages. E.M.
+Removed the unwanted serial messages. The greyscale conversion is in fixed
+point and the JPEG decoding stops after the last MCU of the crop
+(rgb565_grey.h). Excluded by the _RAW_CAPTURE path of image_provider.h. E.M.
 
 ==============================================================================*/
 
 #include "image_provider.h"
 
+#include "rgb565_grey.h"
+
 /*
  * Arducam
  * -------
@@ -35,9 +39,10 @@ Removed the unwanted serial messages. E.M.
  *    "#define LOAD_SD_LIBRARY" and "#define LOAD_SDFAT_LIBRARY".
  */
 
-#if defined(ARDUINO) && !defined(ARDUINO_ARDUINO_NANO33BLE)
+#if defined(ARDUINO) && \
+    (!defined(ARDUINO_ARDUINO_NANO33BLE) || defined(_RAW_CAPTURE))
 #define ARDUINO_EXCLUDE_CODE
-#endif  // defined(ARDUINO) && !defined(ARDUINO_ARDUINO_NANO33BLE)
+#endif  // defined(ARDUINO) && (!defined(ARDUINO_ARDUINO_NANO33BLE) || ...
 
 #ifndef ARDUINO_EXCLUDE_CODE
 
@@ -109,8 +114,8 @@ TfLiteStatus InitCamera(tflite::ErrorReporter* error_reporter) {
   return kTfLiteOk;
 }
 
-// Begin the capture and wait for it to finish
-TfLiteStatus PerformCapture(tflite::ErrorReporter* error_reporter) {
+// Begin the capture, the camera writes the frame into its FIFO
+TfLiteStatus StartCapture(tflite::ErrorReporter* error_reporter) {
 #ifdef _NO_ERRORS_REPORT
   TF_LITE_REPORT_ERROR(error_reporter, "Starting capture");
 #endif
@@ -119,6 +124,11 @@ TfLiteStatus PerformCapture(tflite::ErrorReporter* error_reporter) {
   myCAM.clear_fifo_flag();
   // Start capture
   myCAM.start_capture();
+  return kTfLiteOk;
+}
+
+// Wait for the capture to finish
+TfLiteStatus WaitCapture(tflite::ErrorReporter* error_reporter) {
   // Wait for indication that it is done
   while (!myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
   }
@@ -174,88 +184,16 @@ TfLiteStatus DecodeAndProcessImage(tflite::ErrorReporter* error_reporter,
   // Parse the JPEG headers. The image will be decoded as a sequence of Minimum
   // Coded Units (MCUs), which are 16x8 blocks of pixels.
   JpegDec.decodeArray(jpeg_buffer, jpeg_length);
-
-  // Crop the image by keeping a certain number of MCUs in each dimension
-  const int keep_x_mcus = image_width / JpegDec.MCUWidth;
-  const int keep_y_mcus = image_height / JpegDec.MCUHeight;
-
-  // Calculate how many MCUs we will throw away on the x axis
-  const int skip_x_mcus = JpegDec.MCUSPerRow - keep_x_mcus;
-  // Roughly center the crop by skipping half the throwaway MCUs at the
-  // beginning of each row
-  const int skip_start_x_mcus = skip_x_mcus / 2;
-  // Index where we will start throwing away MCUs after the data
-  const int skip_end_x_mcu_index = skip_start_x_mcus + keep_x_mcus;
-  // Same approach for the columns
-  const int skip_y_mcus = JpegDec.MCUSPerCol - keep_y_mcus;
-  const int skip_start_y_mcus = skip_y_mcus / 2;
-  const int skip_end_y_mcu_index = skip_start_y_mcus + keep_y_mcus;
-
-  // Pointer to the current pixel
-  uint16_t* pImg;
-  // Color of the current pixel
-  uint16_t color;
-
-  // Loop over the MCUs
-  while (JpegDec.read()) {
-    // Skip over the initial set of rows
-    if (JpegDec.MCUy < skip_start_y_mcus) {
-      continue;
-    }
-    // Skip if we're on a column that we don't want
-    if (JpegDec.MCUx < skip_start_x_mcus ||
-        JpegDec.MCUx >= skip_end_x_mcu_index) {
-      continue;
-    }
-    // Skip if we've got all the rows we want
-    if (JpegDec.MCUy >= skip_end_y_mcu_index) {
-      continue;
-    }
-    // Pointer to the current pixel
-    pImg = JpegDec.pImage;
-
-    // The x and y indexes of the current MCU, ignoring the MCUs we skip
-    int relative_mcu_x = JpegDec.MCUx - skip_start_x_mcus;
-    int relative_mcu_y = JpegDec.MCUy - skip_start_y_mcus;
-
-    // The coordinates of the top left of this MCU when applied to the output
-    // image
-    int x_origin = relative_mcu_x * JpegDec.MCUWidth;
-    int y_origin = relative_mcu_y * JpegDec.MCUHeight;
-
-    // Loop through the MCU's rows and columns
-    for (int mcu_row = 0; mcu_row < JpegDec.MCUHeight; mcu_row++) {
-      // The y coordinate of this pixel in the output index
-      int current_y = y_origin + mcu_row;
-      for (int mcu_col = 0; mcu_col < JpegDec.MCUWidth; mcu_col++) {
-        // Read the color of the pixel as 16-bit integer
-        color = *pImg++;
-        // Extract the color values (5 red bits, 6 green, 5 blue)
-        uint8_t r, g, b;
-        r = ((color & 0xF800) >> 11) * 8;
-        g = ((color & 0x07E0) >> 5) * 4;
-        b = ((color & 0x001F) >> 0) * 8;
-        // Convert to grayscale by calculating luminance
-        // See https://en.wikipedia.org/wiki/Grayscale for magic numbers
-        float gray_value = (0.2126 * r) + (0.7152 * g) + (0.0722 * b);
-
-        // The x coordinate of this pixel in the output image
-        int current_x = x_origin + mcu_col;
-        // The index of this pixel in our flat output buffer
-        int index = (current_y * image_width) + current_x;
-        image_data[index] = static_cast<uint8_t>(gray_value);
-      }
-    }
-  }
+  // Crop and convert the MCUs to greyscale in the input tensor
+  DecodeMcusToGrey(&JpegDec, image_width, image_height, image_data);
 #ifdef _NO_ERRORS_REPORT
   TF_LITE_REPORT_ERROR(error_reporter, "Image decoded and processed");
 #endif
   return kTfLiteOk;
 }
 
-// Get an image from the camera module
-TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
-                      int image_height, int channels, uint8_t* image_data) {
+// Start the capture of a frame, initializing the camera module the first time
+TfLiteStatus StartImageCapture(tflite::ErrorReporter* error_reporter) {
   static bool g_is_camera_initialized = false;
   if (!g_is_camera_initialized) {
     TfLiteStatus init_status = InitCamera(error_reporter);
@@ -267,11 +205,17 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
     }
     g_is_camera_initialized = true;
   }
+  return StartCapture(error_reporter);
+}
 
-  TfLiteStatus capture_status = PerformCapture(error_reporter);
+// Get the image of the started capture from the camera module
+TfLiteStatus ReadCapturedImage(tflite::ErrorReporter* error_reporter,
+                               int image_width, int image_height,
+                               int channels, uint8_t* image_data) {
+  TfLiteStatus capture_status = WaitCapture(error_reporter);
   if (capture_status != kTfLiteOk) {
 #ifdef _NO_ERRORS_REPORT
-    TF_LITE_REPORT_ERROR(error_reporter, "PerformCapture failed");
+    TF_LITE_REPORT_ERROR(error_reporter, "WaitCapture failed");
 #endif
     return capture_status;
   }
@@ -296,4 +240,15 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
   return kTfLiteOk;
 }
 
+// Get an image from the camera module
+TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
+                      int image_height, int channels, uint8_t* image_data) {
+  TfLiteStatus start_status = StartImageCapture(error_reporter);
+  if (start_status != kTfLiteOk) {
+    return start_status;
+  }
+  return ReadCapturedImage(error_reporter, image_width, image_height, channels,
+                           image_data);
+}
+
 #endif  // ARDUINO_EXCLUDE_CODE
@@ -0,0 +1,238 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Raw capture version of arduino_image_provider.cpp, built when _RAW_CAPTURE is
+defined in image_provider.h: the OV2640 outputs the 160x120 frames as 8-bit
+luminance and the FIFO is cropped and downsampled into the input tensor while
+it is read (raw_grey_stream.h), there is no JPEG buffer and no decoding. E.M.
+
+==============================================================================*/
+
+#include "image_provider.h"
+
+#include "raw_grey_stream.h"
+
+/*
+ * Arducam
+ * -------
+ * 1. Download https://github.com/ArduCAM/Arduino and copy its `ArduCAM`
+ *    subdirectory into `Arduino/libraries`. Commit #e216049 has been tested
+ *    with this code.
+ * 2. Edit `Arduino/libraries/ArduCAM/memorysaver.h` and ensure that
+ *    "#define OV2640_MINI_2MP_PLUS" is not commented out. Ensure all other
+ *    defines in the same section are commented out.
+ */
+
+#if defined(ARDUINO) && \
+    (!defined(ARDUINO_ARDUINO_NANO33BLE) || !defined(_RAW_CAPTURE))
+#define ARDUINO_EXCLUDE_CODE
+#endif  // defined(ARDUINO) && (!defined(ARDUINO_ARDUINO_NANO33BLE) || ...
+
+#ifndef ARDUINO_EXCLUDE_CODE
+
+// Required by Arducam library
+#include <SPI.h>
+#include <Wire.h>
+#include <memorysaver.h>
+// Arducam library
+#include <ArduCAM.h>
+
+// Checks that the Arducam library has been correctly configured
+#if !(defined OV2640_MINI_2MP_PLUS)
+#error Please select the hardware platform and camera module in the Arduino/libraries/ArduCAM/memorysaver.h
+#endif
+
+// The pin connected to the Arducam Chip Select
+#define CS 3
+// Sensor frame size, the smallest output window of the DSP
+#define RAW_WIDTH 160
+#define RAW_HEIGHT 120
+
+// Undef to remove serial output reporting
+#undef _NO_ERRORS_REPORT
+
+// Sensor output format, kYuyv if the DVP doesn't support Y8
+constexpr RawFormat kRawFormat = RawFormat::kY8;
+
+// DSP registers of the OV2640 (bank 0) overriding the QVGA setup of the
+// ArduCAM library: 160x120 output window (ZMOW, ZMOH in units of 4 pixels)
+// and Y8 or YUV422 output on the DVP (IMAGE_MODE)
+const struct sensor_reg kRawOutputRegs[] = {
+    {0xff, 0x00},
+    {0xe0, 0x04},
+    {0x5a, RAW_WIDTH / 4},
+    {0x5b, RAW_HEIGHT / 4},
+    {0x5c, 0x00},
+    {0xda, kRawFormat == RawFormat::kY8 ? 0x40 : 0x00},
+    {0xe0, 0x00},
+    {0xff, 0xff},
+};
+
+// Camera library instance
+ArduCAM myCAM(OV2640, CS);
+
+// FIFO burst read of raw_grey_stream.h
+struct ArducamFifo {
+  uint8_t Read() { return SPI.transfer(0x00); }
+  void Skip(int bytes) {
+    while (bytes-- > 0) {
+      SPI.transfer(0x00);
+    }
+  }
+};
+
+// Get the camera module ready
+TfLiteStatus InitCamera(tflite::ErrorReporter* error_reporter) {
+#ifdef _NO_ERRORS_REPORT
+  TF_LITE_REPORT_ERROR(error_reporter, "Attempting to start Arducam");
+#endif
+  // Enable the Wire library
+  Wire.begin();
+  // Configure the CS pin
+  pinMode(CS, OUTPUT);
+  digitalWrite(CS, HIGH);
+  // initialize SPI
+  SPI.begin();
+  // Reset the CPLD
+  myCAM.write_reg(0x07, 0x80);
+  delay(100);
+  myCAM.write_reg(0x07, 0x00);
+  delay(100);
+  // Test whether we can communicate with Arducam via SPI
+  myCAM.write_reg(ARDUCHIP_TEST1, 0x55);
+  uint8_t test;
+  test = myCAM.read_reg(ARDUCHIP_TEST1);
+  if (test != 0x55) {
+#ifdef _NO_ERRORS_REPORT
+    TF_LITE_REPORT_ERROR(error_reporter, "Can't communicate with Arducam");
+#endif
+    delay(1000);
+    return kTfLiteError;
+  }
+  // Uncompressed capture mode, then the raw luminance output
+  myCAM.set_format(BMP);
+  myCAM.InitCAM();
+  myCAM.wrSensorRegs8_8(kRawOutputRegs);
+  delay(100);
+  return kTfLiteOk;
+}
+
+// Begin the capture, the camera writes the frame into its FIFO
+TfLiteStatus StartCapture(tflite::ErrorReporter* error_reporter) {
+#ifdef _NO_ERRORS_REPORT
+  TF_LITE_REPORT_ERROR(error_reporter, "Starting capture");
+#endif
+  // Make sure the buffer is emptied before each capture
+  myCAM.flush_fifo();
+  myCAM.clear_fifo_flag();
+  // Start capture
+  myCAM.start_capture();
+  return kTfLiteOk;
+}
+
+// Wait for the capture to finish
+TfLiteStatus WaitCapture(tflite::ErrorReporter* error_reporter) {
+  // Wait for indication that it is done
+  while (!myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
+  }
+#ifdef _NO_ERRORS_REPORT
+  TF_LITE_REPORT_ERROR(error_reporter, "Image captured");
+#endif
+  // Clear the capture done flag
+  myCAM.clear_fifo_flag();
+  return kTfLiteOk;
+}
+
+// Stream the frame from the camera module into the image
+TfLiteStatus ReadAndProcessImage(tflite::ErrorReporter* error_reporter,
+                                 int image_width, int image_height,
+                                 uint8_t* image_data) {
+  const uint32_t frame_bytes = RAW_WIDTH * RAW_HEIGHT *
+                               (kRawFormat == RawFormat::kYuyv ? 2 : 1);
+  const uint32_t fifo_length = myCAM.read_fifo_length();
+  if (fifo_length < frame_bytes) {
+#ifdef _NO_ERRORS_REPORT
+    TF_LITE_REPORT_ERROR(error_reporter, "Short frame in FIFO buffer (%d)",
+                         fifo_length);
+#endif
+    return kTfLiteError;
+  }
+  myCAM.CS_LOW();
+  myCAM.set_fifo_burst();
+  ArducamFifo fifo;
+  const bool fits = StreamRawToGrey(&fifo, RAW_WIDTH, RAW_HEIGHT, kRawFormat,
+                                    image_width, image_height, image_data);
+  myCAM.CS_HIGH();
+  if (!fits) {
+#ifdef _NO_ERRORS_REPORT
+    TF_LITE_REPORT_ERROR(error_reporter, "Can't scale %dx%d to %dx%d",
+                         RAW_WIDTH, RAW_HEIGHT, image_width, image_height);
+#endif
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+// Start the capture of a frame, initializing the camera module the first time
+TfLiteStatus StartImageCapture(tflite::ErrorReporter* error_reporter) {
+  static bool g_is_camera_initialized = false;
+  if (!g_is_camera_initialized) {
+    TfLiteStatus init_status = InitCamera(error_reporter);
+    if (init_status != kTfLiteOk) {
+#ifdef _NO_ERRORS_REPORT
+      TF_LITE_REPORT_ERROR(error_reporter, "InitCamera failed");
+#endif
+      return init_status;
+    }
+    g_is_camera_initialized = true;
+  }
+  return StartCapture(error_reporter);
+}
+
+// Get the image of the started capture from the camera module
+TfLiteStatus ReadCapturedImage(tflite::ErrorReporter* error_reporter,
+                               int image_width, int image_height,
+                               int channels, uint8_t* image_data) {
+  TfLiteStatus capture_status = WaitCapture(error_reporter);
+  if (capture_status != kTfLiteOk) {
+#ifdef _NO_ERRORS_REPORT
+    TF_LITE_REPORT_ERROR(error_reporter, "WaitCapture failed");
+#endif
+    return capture_status;
+  }
+
+  TfLiteStatus read_status = ReadAndProcessImage(error_reporter, image_width,
+                                                 image_height, image_data);
+  if (read_status != kTfLiteOk) {
+#ifdef _NO_ERRORS_REPORT
+    TF_LITE_REPORT_ERROR(error_reporter, "ReadAndProcessImage failed");
+#endif
+    return read_status;
+  }
+
+  return kTfLiteOk;
+}
+
+// Get an image from the camera module
+TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
+                      int image_height, int channels, uint8_t* image_data) {
+  TfLiteStatus start_status = StartImageCapture(error_reporter);
+  if (start_status != kTfLiteOk) {
+    return start_status;
+  }
+  return ReadCapturedImage(error_reporter, image_width, image_height, channels,
+                           image_data);
+}
+
+#endif  // ARDUINO_EXCLUDE_CODE
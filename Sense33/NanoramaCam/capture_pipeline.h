@@ -0,0 +1,54 @@
+/* Overlapped capture and inference of NanoramaCam.ino. The FIFO of the
+Arducam module is the second frame buffer: the capture of the next frame is
+started as soon as the current one is in the input tensor, the sensor
+exposes it and writes the FIFO while the model runs. The SPI read and the
+decoding are done by the CPU and stay in series with the inference, no
+memory is added to the arena. The frames inferred are one inference older,
+the sketch defaults to the serial capture for the detection latency.
+host/capture_pipeline_sim runs it on a simulated camera. E.M.
+*/
+
+#ifndef NANORAMACAM_CAPTURE_PIPELINE_H_
+#define NANORAMACAM_CAPTURE_PIPELINE_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+// Camera provides TfLiteStatus Start(), starting a capture into its FIFO,
+// and TfLiteStatus Read(uint8_t* image_data), waiting for the started
+// capture and reading it (StartImageCapture() and ReadCapturedImage() of
+// image_provider.h on the board).
+template <typename Camera>
+class CapturePipeline {
+ public:
+  // Without overlap every frame is captured when it is needed
+  CapturePipeline(Camera* camera, bool overlapped)
+      : camera_(camera), overlapped_(overlapped) {}
+
+  // Reads the next frame into image_data. When overlapped the capture of
+  // the following frame is started before returning, the image is the one
+  // captured during the previous inference.
+  TfLiteStatus NextImage(uint8_t* image_data) {
+    if (!capture_started_) {
+      const TfLiteStatus start_status = camera_->Start();
+      if (start_status != kTfLiteOk) {
+        return start_status;
+      }
+    }
+    capture_started_ = false;
+    const TfLiteStatus read_status = camera_->Read(image_data);
+    // A failed start is retried by the next call
+    if (overlapped_ && camera_->Start() == kTfLiteOk) {
+      capture_started_ = true;
+    }
+    return read_status;
+  }
+
+ private:
+  Camera* camera_;
+  const bool overlapped_;
+  bool capture_started_ = false;
+};
+
+#endif  // NANORAMACAM_CAPTURE_PIPELINE_H_
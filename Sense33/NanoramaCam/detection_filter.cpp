@@ -0,0 +1,32 @@
+/* Detection filter of NanoramaCam.ino, see detection_filter.h. E.M.
+*/
+
+#include "detection_filter.h"
+
+bool DetectionFilter::Update(uint8_t person_score) {
+  average_q8_ += ((static_cast<int32_t>(person_score) << 8) - average_q8_) >>
+                 kDetectionAverageShift;
+  const bool person = person_ ? score() >= kDetectionOffThreshold
+                              : score() > kDetectionOnThreshold;
+  if (person == person_) {
+    return false;
+  }
+  person_ = person;
+  return true;
+}
+
+uint8_t DetectionFilter::confidence() const {
+  const int s = score();
+  int margin, range;
+  if (person_) {
+    margin = s - kDetectionOffThreshold;
+    range = 255 - kDetectionOffThreshold;
+  } else {
+    margin = kDetectionOnThreshold - s;
+    range = kDetectionOnThreshold;
+  }
+  if (margin < 0) {
+    margin = 0;
+  }
+  return static_cast<uint8_t>(margin * 100 / range);
+}
@@ -0,0 +1,47 @@
+/* Detection filter of NanoramaCam.ino: the person scores of the inferences
+are smoothed by an exponential moving average, the person is detected when
+the average rises over an upper threshold and lost when it falls under a
+lower one. A single frame doesn't switch the detection, a score oscillating
+around one threshold doesn't make it blink. The confidence is the distance
+of the average from the threshold switching the detection back.
+host/detection_filter_sim compares it with the single frame threshold.
+E.M.
+*/
+
+#ifndef NANORAMACAM_DETECTION_FILTER_H_
+#define NANORAMACAM_DETECTION_FILTER_H_
+
+#include <cstdint>
+
+// Weight of the new score in the average, 1 / 2^kDetectionAverageShift.
+// About the last 2^(shift + 1) - 1 inferences count.
+constexpr int kDetectionAverageShift = 1;
+// Average person score detecting a person and losing it
+constexpr int kDetectionOnThreshold = 160;
+constexpr int kDetectionOffThreshold = 130;
+static_assert(kDetectionOffThreshold < kDetectionOnThreshold,
+              "The hysteresis needs the lower threshold under the upper one");
+
+class DetectionFilter {
+ public:
+  DetectionFilter() {}
+
+  // Adds the person score of a new inference, returns true if the
+  // detection changed. The scores reused for the still frames must not be
+  // added again, they are not new evidence.
+  bool Update(uint8_t person_score);
+
+  // Person detected
+  bool person() const { return person_; }
+  // Average person score
+  uint8_t score() const { return static_cast<uint8_t>(average_q8_ >> 8); }
+  // Confidence of the detection, or of its absence, 0 to 100
+  uint8_t confidence() const;
+
+ private:
+  // Average person score, Q8
+  int32_t average_q8_ = 0;
+  bool person_ = false;
+};
+
+#endif  // NANORAMACAM_DETECTION_FILTER_H_
@@ -0,0 +1,136 @@
+/* BLE report of NanoramaCam.ino: the detection, its score and confidence,
+the frame counter and the timing are packed in a single characteristic of
+kDetectionReportSize bytes, fitting a notification of the default ATT MTU.
+A change of detection is notified at once, no more than one per connection
+interval. The other changes of score, confidence and skipped frames are
+batched, one notification every kReportBatchMs at most rounded up to the
+connection intervals; the frame counter and the timing don't notify, they
+follow the other changes. A still scene makes no radio traffic.
+host/detection_report_sim counts the notifications on a mock of the
+characteristic. E.M.
+*/
+
+#ifndef NANORAMACAM_DETECTION_REPORT_H_
+#define NANORAMACAM_DETECTION_REPORT_H_
+
+#include <cstdint>
+
+// Little endian layout of the characteristic:
+//   0     flags, kReportPerson
+//   1     average person score (detection_filter.h)
+//   2     confidence of the detection, 0 to 100
+//   3     frames skipped by the motion gate, percent
+//   4-7   frames since the start
+//   8-9   last inference, ms
+//   10-11 mean loop() period since the previous notification, ms
+constexpr int kDetectionReportSize = 12;
+
+// Person detected
+constexpr uint8_t kReportPerson = 0x01;
+
+// Shortest time between two notifications without a change of detection
+constexpr uint32_t kReportBatchMs = 5000;
+
+struct DetectionReport {
+  uint8_t flags = 0;
+  uint8_t score = 0;
+  uint8_t confidence = 0;
+  uint8_t skipped_percent = 0;
+  uint32_t frames = 0;
+  uint16_t inference_ms = 0;
+  uint16_t loop_ms = 0;
+};
+
+inline void PackDetectionReport(const DetectionReport& report, uint8_t* data) {
+  data[0] = report.flags;
+  data[1] = report.score;
+  data[2] = report.confidence;
+  data[3] = report.skipped_percent;
+  for (int i = 0; i < 4; i++) {
+    data[4 + i] = static_cast<uint8_t>(report.frames >> (8 * i));
+  }
+  data[8] = static_cast<uint8_t>(report.inference_ms);
+  data[9] = static_cast<uint8_t>(report.inference_ms >> 8);
+  data[10] = static_cast<uint8_t>(report.loop_ms);
+  data[11] = static_cast<uint8_t>(report.loop_ms >> 8);
+}
+
+inline DetectionReport UnpackDetectionReport(const uint8_t* data) {
+  DetectionReport report;
+  report.flags = data[0];
+  report.score = data[1];
+  report.confidence = data[2];
+  report.skipped_percent = data[3];
+  report.frames = 0;
+  for (int i = 0; i < 4; i++) {
+    report.frames |= static_cast<uint32_t>(data[4 + i]) << (8 * i);
+  }
+  report.inference_ms = static_cast<uint16_t>(data[8] | (data[9] << 8));
+  report.loop_ms = static_cast<uint16_t>(data[10] | (data[11] << 8));
+  return report;
+}
+
+// Characteristic provides writeValue(const uint8_t* value, int length), as
+// BLECharacteristic of ArduinoBLE.
+template <typename Characteristic>
+class DetectionReporter {
+ public:
+  // connection_interval_ms is the longest connection interval accepted,
+  // BLE.setConnectionInterval() on the board
+  DetectionReporter(Characteristic* characteristic,
+                    uint32_t connection_interval_ms)
+      : characteristic_(characteristic),
+        interval_ms_(connection_interval_ms > 0 ? connection_interval_ms : 1),
+        batch_ms_((kReportBatchMs + interval_ms_ - 1) / interval_ms_ *
+                  interval_ms_) {}
+
+  // Called by every loop() with the current report, without loop_ms, and
+  // the time in ms (millis()). Returns true if the characteristic was
+  // written. The first call always writes it.
+  bool Update(const DetectionReport& report, uint32_t now_ms) {
+    loops_++;
+    const uint32_t elapsed = now_ms - last_ms_;
+    bool write;
+    if (!has_published_) {
+      write = true;
+    } else if ((report.flags ^ published_.flags) & kReportPerson) {
+      // A notification in the same connection interval would wait for the
+      // previous one, it is sent by the next loop() instead
+      write = elapsed >= interval_ms_;
+    } else {
+      write = elapsed >= batch_ms_ && (report.score != published_.score ||
+                                       report.confidence !=
+                                           published_.confidence ||
+                                       report.skipped_percent !=
+                                           published_.skipped_percent);
+    }
+    if (!write) {
+      return false;
+    }
+    published_ = report;
+    const uint32_t loop_ms = has_published_ ? elapsed / loops_ : 0;
+    published_.loop_ms =
+        static_cast<uint16_t>(loop_ms < 0xffff ? loop_ms : 0xffff);
+    uint8_t data[kDetectionReportSize];
+    PackDetectionReport(published_, data);
+    characteristic_->writeValue(data, kDetectionReportSize);
+    has_published_ = true;
+    last_ms_ = now_ms;
+    loops_ = 0;
+    return true;
+  }
+
+  // Last report written
+  const DetectionReport& published() const { return published_; }
+
+ private:
+  Characteristic* characteristic_;
+  const uint32_t interval_ms_;
+  const uint32_t batch_ms_;
+  DetectionReport published_;
+  bool has_published_ = false;
+  uint32_t last_ms_ = 0;
+  uint32_t loops_ = 0;
+};
+
+#endif  // NANORAMACAM_DETECTION_REPORT_H_
@@ -11,6 +11,9 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+RespondToDetection() doesn't block, the detection is signalled by
+RespondToDetectionChange() when the detection filter switches. E.M.
 ==============================================================================*/
 
 // Provides an interface to take an action based on the output from the person
@@ -31,4 +34,10 @@ limitations under the License.
 void RespondToDetection(tflite::ErrorReporter* error_reporter,
                         uint8_t person_score, uint8_t no_person_score);
 
+// Called when the detection smoothed over the last inferences
+// (detection_filter.h) changes. `person` is the new detection and
+// `confidence` its confidence, 0 to 100.
+void RespondToDetectionChange(tflite::ErrorReporter* error_reporter,
+                              bool person, uint8_t confidence);
+
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_DETECTION_RESPONDER_H_
@@ -0,0 +1,118 @@
+/**
+ * @file ble_mock.h
+ * @brief Host mock of the BLECharacteristic of ArduinoBLE used by the
+ * sketch, counting the notifications.
+ *
+ * writeValue() stores the value as the library does and, when a central is
+ * subscribed to a BLENotify characteristic, counts a notification. The
+ * notifications are grouped by connection event: with a simulated clock
+ * (SetTime()) and connection interval, all the ones written in the same
+ * interval leave the board in the same event.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#ifndef BLE_MOCK_H
+#define BLE_MOCK_H
+
+#include <cstdint>
+#include <cstring>
+
+enum BLEProperty {
+  BLEBroadcast = 0x01,
+  BLERead = 0x02,
+  BLEWriteWithoutResponse = 0x04,
+  BLEWrite = 0x08,
+  BLENotify = 0x10,
+  BLEIndicate = 0x20
+};
+
+class BLECharacteristic {
+ public:
+  //! Longest value of the mock
+  static constexpr int kMaxValueSize = 64;
+
+  BLECharacteristic(const char* uuid, unsigned char properties, int valueSize,
+                    bool fixedLength = false)
+      : uuid_(uuid),
+        properties_(properties),
+        value_size_(valueSize < kMaxValueSize ? valueSize : kMaxValueSize),
+        fixed_length_(fixedLength) {}
+
+  int writeValue(const uint8_t value[], int length) {
+    if (length > value_size_ || (fixed_length_ && length != value_size_)) {
+      return 0;
+    }
+    memcpy(value_, value, length);
+    value_length_ = length;
+    writes_++;
+    if (subscribed_ && (properties_ & BLENotify)) {
+      notifications_++;
+      const uint32_t event = now_ms_ / interval_ms_;
+      if (event_notifications_ == 0 || event != last_event_) {
+        events_++;
+        event_notifications_ = 0;
+        last_event_ = event;
+      }
+      event_notifications_++;
+      if (event_notifications_ > max_per_event_) {
+        max_per_event_ = event_notifications_;
+      }
+    }
+    return 1;
+  }
+
+  const uint8_t* value() const { return value_; }
+  int valueLength() const { return value_length_; }
+  bool subscribed() const { return subscribed_; }
+  const char* uuid() const { return uuid_; }
+
+  //! Mock: simulated clock and connection
+  void SetTime(uint32_t now_ms) { now_ms_ = now_ms; }
+  void SetConnectionInterval(uint32_t interval_ms) {
+    interval_ms_ = interval_ms > 0 ? interval_ms : 1;
+  }
+  void SetSubscribed(bool subscribed) { subscribed_ = subscribed; }
+
+  //! Mock: values written, notifications sent, connection events carrying
+  //! them and most notifications queued in one event
+  int writes() const { return writes_; }
+  int notifications() const { return notifications_; }
+  int events() const { return events_; }
+  int max_per_event() const { return max_per_event_; }
+
+ private:
+  const char* uuid_;
+  const unsigned char properties_;
+  const int value_size_;
+  const bool fixed_length_;
+  uint8_t value_[kMaxValueSize] = {};
+  int value_length_ = 0;
+  bool subscribed_ = true;
+  uint32_t now_ms_ = 0;
+  uint32_t interval_ms_ = 1;
+  int writes_ = 0;
+  int notifications_ = 0;
+  int events_ = 0;
+  int event_notifications_ = 0;
+  uint32_t last_event_ = 0;
+  int max_per_event_ = 0;
+};
+
+// BLETypedCharacteristic<unsigned char> of the library
+class BLEUnsignedCharCharacteristic : public BLECharacteristic {
+ public:
+  BLEUnsignedCharCharacteristic(const char* uuid, unsigned char properties)
+      : BLECharacteristic(uuid, properties, 1, true) {}
+
+  int writeValue(unsigned char value) {
+    return BLECharacteristic::writeValue(&value, 1);
+  }
+  unsigned char value() const {
+    return valueLength() > 0 ? BLECharacteristic::value()[0] : 0;
+  }
+};
+
+#endif  // BLE_MOCK_H
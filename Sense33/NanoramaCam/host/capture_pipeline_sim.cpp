@@ -0,0 +1,235 @@
+/**
+ * @file capture_pipeline_sim.cpp
+ * @brief Timing model of the serial and overlapped capture of NanoramaCam.ino.
+ *
+ * Runs the loop() of the sketch with the CapturePipeline of
+ * capture_pipeline.h on a simulated Arducam: a capture ends capture ms
+ * after it is started, without the CPU, then ReadCapturedImage() waits for
+ * it, the settle delay of the provider, the SPI read and the decoding, all
+ * on the CPU, followed by the inference and the detection response. The
+ * times are parameters, the defaults are estimates of the JPEG provider on
+ * the Nano 33 BLE Sense, measure them with micros() on the board.
+ *
+ * Usage: capture_pipeline_sim [-n frames] [-p jpeg|raw] [-c capture_ms]
+ *                             [-s settle_ms] [-r read_ms] [-d decode_ms]
+ *                             [-i invoke_ms] [-b response_ms]
+ *
+ * -p raw starts from the estimates of the raw capture provider (no settle
+ * delay, 19 KB SPI read with the scaling, no decoding). The detections per
+ * second, the CPU time waiting for the camera and the age of the frames at
+ * the end of their inference are printed for both modes. The simulated
+ * camera also checks the sequence: every frame read must have been started
+ * and read once.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "capture_pipeline.h"
+#include "model_settings.h"
+
+namespace {
+
+constexpr int kDefaultFrames = 100;
+
+// Stage times in us
+struct Timing {
+  int64_t capture;
+  int64_t settle;
+  int64_t read;
+  int64_t decode;
+  int64_t invoke;
+  int64_t response;
+};
+
+// Estimates for the Nano 33 BLE Sense. JPEG: 160x120 frame at 15 fps,
+// delay(50) after CAP_DONE, 4 KB at 4 MHz SPI, JPEGDecoder of 128 MCUs;
+// raw: 19 KB Y8 read and scaled byte by byte. The inference is the one of
+// the sketch kernels, the response a few ms: the LED writes without delay,
+// the detection filter and the batched BLE report update.
+constexpr Timing kJpegTiming = {67000, 50000, 10000, 90000, 1000000, 2000};
+constexpr Timing kRawTiming = {67000, 0, 45000, 0, 1000000, 2000};
+
+// Arducam with a simulated clock
+class SimulatedCamera {
+ public:
+  SimulatedCamera(const Timing& timing, int64_t* now)
+      : timing_(timing), now_(now) {}
+
+  TfLiteStatus Start() {
+    // flush_fifo() drops an unread frame
+    capturing_ = true;
+    capture_end_ = *now_ + timing_.capture;
+    started_++;
+    return kTfLiteOk;
+  }
+
+  TfLiteStatus Read(uint8_t* image_data) {
+    if (!capturing_) {
+      errors_++;
+      return kTfLiteError;
+    }
+    capturing_ = false;
+    if (capture_end_ > *now_) {
+      wait_ += capture_end_ - *now_;
+      *now_ = capture_end_;
+    }
+    *now_ += timing_.settle + timing_.read + timing_.decode;
+    last_capture_end_ = capture_end_;
+    // The frame number as image, checked by the loop
+    memset(image_data, static_cast<uint8_t>(started_), kMaxImageSize);
+    read_++;
+    return kTfLiteOk;
+  }
+
+  int started() const { return started_; }
+  int read() const { return read_; }
+  int errors() const { return errors_; }
+  int64_t wait() const { return wait_; }
+  int64_t last_capture_end() const { return last_capture_end_; }
+
+ private:
+  const Timing timing_;
+  int64_t* now_;
+  bool capturing_ = false;
+  int64_t capture_end_ = 0;
+  int64_t last_capture_end_ = 0;
+  int started_ = 0;
+  int read_ = 0;
+  int errors_ = 0;
+  int64_t wait_ = 0;
+};
+
+struct Result {
+  double detections_per_second;
+  double wait_ms;
+  double age_ms;
+  int errors;
+};
+
+// loop() of NanoramaCam.ino for frames iterations
+Result RunLoop(const Timing& timing, bool overlapped, int frames) {
+  int64_t now = 0;
+  SimulatedCamera camera(timing, &now);
+  CapturePipeline<SimulatedCamera> pipeline(&camera, overlapped);
+  static uint8_t input[kMaxImageSize];
+  int errors = 0;
+  int previous_frame = -1;
+  int64_t age = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    if (pipeline.NextImage(input) != kTfLiteOk) {
+      errors++;
+      continue;
+    }
+    // A new frame every time, started before this read
+    if (input[0] == previous_frame) {
+      errors++;
+    }
+    previous_frame = input[0];
+    const int64_t captured = camera.last_capture_end();
+    now += timing.invoke;
+    age += now - captured;
+    now += timing.response;
+  }
+  Result result;
+  result.detections_per_second = frames * 1e6 / now;
+  result.wait_ms = camera.wait() / 1000.0 / frames;
+  result.age_ms = age / 1000.0 / frames;
+  result.errors = errors + camera.errors() + (camera.read() != frames);
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int frames = kDefaultFrames;
+  Timing timing = kJpegTiming;
+  const char* preset = "jpeg";
+  Timing overrides = {-1, -1, -1, -1, -1, -1};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:p:c:s:r:d:i:b:")) != -1) {
+    switch (opt) {
+      case 'n':
+        frames = std::max(atoi(optarg), 1);
+        break;
+      case 'p':
+        if (strcmp(optarg, "raw") == 0) {
+          timing = kRawTiming;
+          preset = "raw";
+        } else if (strcmp(optarg, "jpeg") != 0) {
+          fprintf(stderr, "Unknown provider %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'c':
+        overrides.capture = atoi(optarg) * 1000;
+        break;
+      case 's':
+        overrides.settle = atoi(optarg) * 1000;
+        break;
+      case 'r':
+        overrides.read = atoi(optarg) * 1000;
+        break;
+      case 'd':
+        overrides.decode = atoi(optarg) * 1000;
+        break;
+      case 'i':
+        overrides.invoke = atoi(optarg) * 1000;
+        break;
+      case 'b':
+        overrides.response = atoi(optarg) * 1000;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: capture_pipeline_sim [-n frames] [-p jpeg|raw] "
+                "[-c capture_ms] [-s settle_ms] [-r read_ms] [-d decode_ms] "
+                "[-i invoke_ms] [-b response_ms]\n");
+        return 1;
+    }
+  }
+  int64_t* stages[] = {&timing.capture, &timing.settle, &timing.read,
+                       &timing.decode,  &timing.invoke, &timing.response};
+  const int64_t* values[] = {&overrides.capture, &overrides.settle,
+                             &overrides.read,    &overrides.decode,
+                             &overrides.invoke,  &overrides.response};
+  for (int i = 0; i < 6; i++) {
+    if (*values[i] >= 0) {
+      *stages[i] = *values[i];
+    }
+  }
+
+  printf("Provider %s, ms: capture %d settle %d read %d decode %d invoke %d "
+         "response %d\n",
+         preset, static_cast<int>(timing.capture / 1000),
+         static_cast<int>(timing.settle / 1000),
+         static_cast<int>(timing.read / 1000),
+         static_cast<int>(timing.decode / 1000),
+         static_cast<int>(timing.invoke / 1000),
+         static_cast<int>(timing.response / 1000));
+  printf("%-11s %13s %12s %12s\n", "capture", "detections/s", "wait ms",
+         "age ms");
+  const Result serial = RunLoop(timing, false, frames);
+  const Result overlapped = RunLoop(timing, true, frames);
+  printf("%-11s %13.3f %12.1f %12.1f\n", "serial",
+         serial.detections_per_second, serial.wait_ms, serial.age_ms);
+  printf("%-11s %13.3f %12.1f %12.1f\n", "overlapped",
+         overlapped.detections_per_second, overlapped.wait_ms,
+         overlapped.age_ms);
+  printf("Speedup: %.2fx over %d frames\n",
+         overlapped.detections_per_second / serial.detections_per_second,
+         frames);
+  if (serial.errors + overlapped.errors > 0) {
+    printf("Frame sequence errors: %d\n", serial.errors + overlapped.errors);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,15 @@
+/**
+ * @file debug_log.cpp
+ * @brief Debug log of the host build, replaces
+ * tensorflow/lite/micro/arduino/debug_log.cpp (the Arduino serial).
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include "tensorflow/lite/micro/debug_log.h"
+
+#include <cstdio>
+
+extern "C" void DebugLog(const char* s) { fputs(s, stderr); }
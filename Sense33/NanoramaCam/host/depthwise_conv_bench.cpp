@@ -0,0 +1,410 @@
+/**
+ * @file depthwise_conv_bench.cpp
+ * @brief Bit-exactness check and speedup report of the 3x3 depthwise kernels.
+ *
+ * Runs every DEPTHWISE_CONV_2D layer of the person detection model with the
+ * reference kernel and with the specialized kernel of
+ * portable_optimized/depthwise_conv_3x3.h on random inputs, compares the
+ * outputs and reports the time of both. The model layers are uint8, each one
+ * is also run as an int8 per-channel layer with random filters and
+ * quantization. A few small shapes exercise the padding borders.
+ *
+ * Usage: depthwise_conv_bench [-r runs] [-s seed]
+ *
+ * The exit status is 1 if any output differs from the reference.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "person_detect_model_data.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/depthwise_conv_3x3.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+constexpr int kTensorArenaSize = 93 * 1024;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+
+constexpr int kDefaultRuns = 20;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int32_t Random(int32_t min, int32_t max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int32_t>((random_state >> 8) %
+                                    static_cast<uint32_t>(max - min + 1));
+}
+
+// One depthwise layer, the data of the tensors and the parameters of both
+// the uint8 and the int8 kernels
+struct Layer {
+  char name[32];
+  tflite::RuntimeShape input_shape;
+  tflite::RuntimeShape filter_shape;
+  tflite::RuntimeShape output_shape;
+  tflite::DepthwiseParams params;
+  std::vector<int32_t> bias;
+  // uint8 layer
+  std::vector<uint8_t> filter;
+  std::vector<uint8_t> input;
+  // int8 per-channel layer
+  std::vector<int8_t> filter_int8;
+  std::vector<int8_t> input_int8;
+  std::vector<int32_t> multipliers;
+  std::vector<int32_t> shifts;
+};
+
+struct Result {
+  double reference_us;
+  double optimized_us;
+  bool exact;
+};
+
+double Microseconds(int32_t start, int runs) {
+  const uint32_t ticks = static_cast<uint32_t>(tflite::GetCurrentTimeTicks()) -
+                         static_cast<uint32_t>(start);
+  return 1e6 * ticks / tflite::ticks_per_second() / runs;
+}
+
+void CopyShape(const tflite::RuntimeShape& from, tflite::RuntimeShape* to) {
+  to->ReplaceWith(from.DimensionsCount(), from.DimsData());
+}
+
+// Random data and int8 quantization of the layer
+void FillRandom(Layer* layer, bool random_uint8_filter) {
+  const int depth = layer->filter_shape.Dims(3);
+  layer->input.resize(layer->input_shape.FlatSize());
+  layer->input_int8.resize(layer->input_shape.FlatSize());
+  for (size_t i = 0; i < layer->input.size(); ++i) {
+    layer->input[i] = static_cast<uint8_t>(Random(0, 255));
+    layer->input_int8[i] = static_cast<int8_t>(Random(-128, 127));
+  }
+  if (random_uint8_filter) {
+    layer->filter.resize(layer->filter_shape.FlatSize());
+    for (uint8_t& v : layer->filter) {
+      v = static_cast<uint8_t>(Random(0, 255));
+    }
+  }
+  layer->filter_int8.resize(layer->filter_shape.FlatSize());
+  for (int8_t& v : layer->filter_int8) {
+    v = static_cast<int8_t>(Random(-127, 127));
+  }
+  layer->multipliers.resize(depth);
+  layer->shifts.resize(depth);
+  for (int c = 0; c < depth; ++c) {
+    int shift;
+    tflite::QuantizeMultiplier(Random(100, 5000) * 1e-6,
+                               &layer->multipliers[c], &shift);
+    layer->shifts[c] = shift;
+  }
+}
+
+// Small layers with odd sizes, for the padding borders
+void AddEdgeLayer(int height, int width, int depth, int depth_multiplier,
+                  int stride, TfLitePadding padding,
+                  std::vector<Layer>* layers) {
+  const int output_depth = depth * depth_multiplier;
+  Layer layer;
+  snprintf(layer.name, sizeof(layer.name), "edge %s",
+           padding == kTfLitePaddingSame ? "same" : "valid");
+  int out_height, out_width;
+  TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+      stride, stride, 1, 1, height, width, 3, 3, padding, &out_height,
+      &out_width);
+  layer.input_shape.BuildFrom({1, height, width, depth});
+  layer.filter_shape.BuildFrom({1, 3, 3, output_depth});
+  layer.output_shape.BuildFrom({1, out_height, out_width, output_depth});
+  tflite::DepthwiseParams& params = layer.params;
+  params.padding_type = tflite::PaddingType::kSame;
+  params.padding_values.width = pad.width;
+  params.padding_values.height = pad.height;
+  params.stride_width = stride;
+  params.stride_height = stride;
+  params.dilation_width_factor = 1;
+  params.dilation_height_factor = 1;
+  params.depth_multiplier = depth_multiplier;
+  params.input_offset = -Random(0, 255);
+  params.weights_offset = -Random(0, 255);
+  params.output_offset = Random(0, 255);
+  int shift;
+  tflite::QuantizeMultiplier(Random(100, 5000) * 1e-6,
+                             &params.output_multiplier, &shift);
+  params.output_shift = shift;
+  params.quantized_activation_min = Random(0, 20);
+  params.quantized_activation_max = Random(235, 255);
+  layer.bias.resize(output_depth);
+  for (int32_t& b : layer.bias) {
+    b = Random(-20000, 20000);
+  }
+  FillRandom(&layer, true);
+  layers->push_back(layer);
+}
+
+void ReportError(TfLiteContext* context, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+// The depthwise layers of the person detection model
+bool AddModelLayers(std::vector<Layer>* layers) {
+  static tflite::MicroErrorReporter micro_error_reporter;
+  const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+  static tflite::MicroOpResolver<3> resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                      tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                      tflite::ops::micro::Register_CONV_2D());
+  resolver.AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                      tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  static tflite::MicroInterpreter interpreter(
+      model, resolver, tensor_arena, kTensorArenaSize, &micro_error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    return false;
+  }
+  TfLiteContext context = {};
+  context.ReportError = ReportError;
+
+  for (size_t i = 0; i < interpreter.operators_size(); ++i) {
+    const tflite::NodeAndRegistration nr = interpreter.node_and_registration(i);
+    if (nr.registration->builtin_code !=
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D) {
+      continue;
+    }
+    const TfLiteNode& node = nr.node;
+    const TfLiteTensor* input = interpreter.tensor(node.inputs->data[0]);
+    const TfLiteTensor* filter = interpreter.tensor(node.inputs->data[1]);
+    const TfLiteTensor* bias = interpreter.tensor(node.inputs->data[2]);
+    TfLiteTensor* output = interpreter.tensor(node.outputs->data[0]);
+    const auto* conv_params =
+        static_cast<const TfLiteDepthwiseConvParams*>(node.builtin_data);
+    if (input->type != kTfLiteUInt8) {
+      fprintf(stderr, "Node %d is not uint8, skipped\n", static_cast<int>(i));
+      continue;
+    }
+
+    Layer layer;
+    snprintf(layer.name, sizeof(layer.name), "node %d", static_cast<int>(i));
+    CopyShape(tflite::GetTensorShape(input), &layer.input_shape);
+    CopyShape(tflite::GetTensorShape(filter), &layer.filter_shape);
+    CopyShape(tflite::GetTensorShape(output), &layer.output_shape);
+    const int depth = layer.filter_shape.Dims(3);
+
+    int out_height, out_width;
+    TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+        conv_params->stride_height, conv_params->stride_width,
+        conv_params->dilation_height_factor,
+        conv_params->dilation_width_factor, layer.input_shape.Dims(1),
+        layer.input_shape.Dims(2), layer.filter_shape.Dims(1),
+        layer.filter_shape.Dims(2), conv_params->padding, &out_height,
+        &out_width);
+
+    // Same parameters of EvalQuantized() in depthwise_conv.cpp
+    int32_t output_multiplier;
+    int output_shift;
+    int32_t activation_min, activation_max;
+    std::vector<int32_t> channel_multipliers(depth);
+    std::vector<int> channel_shifts(depth);
+    if (tflite::PopulateConvolutionQuantizationParams(
+            &context, input, filter, bias, output, conv_params->activation,
+            &output_multiplier, &output_shift, &activation_min,
+            &activation_max, channel_multipliers.data(),
+            channel_shifts.data(), depth) != kTfLiteOk) {
+      return false;
+    }
+    tflite::DepthwiseParams& params = layer.params;
+    params.padding_type = tflite::PaddingType::kSame;
+    params.padding_values.width = pad.width;
+    params.padding_values.height = pad.height;
+    params.stride_width = conv_params->stride_width;
+    params.stride_height = conv_params->stride_height;
+    params.dilation_width_factor = 1;
+    params.dilation_height_factor = 1;
+    params.depth_multiplier = conv_params->depth_multiplier;
+    params.input_offset = -input->params.zero_point;
+    params.weights_offset = -filter->params.zero_point;
+    params.output_offset = output->params.zero_point;
+    params.output_multiplier = output_multiplier;
+    params.output_shift = -output_shift;
+    params.quantized_activation_min = activation_min;
+    params.quantized_activation_max = activation_max;
+
+    const uint8_t* filter_data = tflite::GetTensorData<uint8_t>(filter);
+    layer.filter.assign(filter_data, filter_data + filter->bytes);
+    const int32_t* bias_data = tflite::GetTensorData<int32_t>(bias);
+    layer.bias.assign(bias_data, bias_data + depth);
+    FillRandom(&layer, false);
+    layers->push_back(layer);
+  }
+  return true;
+}
+
+Result RunUint8(const Layer& layer, int runs) {
+  const tflite::DepthwiseParams& p = layer.params;
+  std::vector<uint8_t> reference(layer.output_shape.FlatSize());
+  std::vector<uint8_t> optimized(reference.size());
+  const int32_t output_shift = p.output_shift;
+  Result result;
+
+  int32_t start = tflite::GetCurrentTimeTicks();
+  for (int r = 0; r < runs; ++r) {
+    tflite::reference_ops::DepthwiseConv(
+        p, layer.input_shape, layer.input.data(), layer.filter_shape,
+        layer.filter.data(), tflite::RuntimeShape(1, static_cast<int>(layer.bias.size())),
+        layer.bias.data(), layer.output_shape, reference.data());
+  }
+  result.reference_us = Microseconds(start, runs);
+
+  start = tflite::GetCurrentTimeTicks();
+  for (int r = 0; r < runs; ++r) {
+    tflite::ops::micro::depthwise_conv_3x3::DepthwiseConv3x3<uint8_t>(
+        p, &p.output_multiplier, &output_shift, /*quant_step=*/0,
+        layer.input_shape, layer.input.data(), layer.filter_shape,
+        layer.filter.data(), layer.bias.data(), layer.output_shape,
+        optimized.data());
+  }
+  result.optimized_us = Microseconds(start, runs);
+  result.exact = reference == optimized;
+  return result;
+}
+
+Result RunInt8(const Layer& layer, int runs) {
+  // Same parameters of EvalQuantizedPerChannel() in depthwise_conv.cpp
+  tflite::DepthwiseParams p = layer.params;
+  p.input_offset += 128;
+  p.weights_offset = 0;
+  p.output_offset = p.output_offset - 128;
+  p.quantized_activation_min = std::numeric_limits<int8_t>::min();
+  p.quantized_activation_max = std::numeric_limits<int8_t>::max();
+  std::vector<int8_t> reference(layer.output_shape.FlatSize());
+  std::vector<int8_t> optimized(reference.size());
+  Result result;
+
+  int32_t start = tflite::GetCurrentTimeTicks();
+  for (int r = 0; r < runs; ++r) {
+    tflite::reference_integer_ops::DepthwiseConvPerChannel(
+        p, layer.multipliers.data(), layer.shifts.data(), layer.input_shape,
+        layer.input_int8.data(), layer.filter_shape, layer.filter_int8.data(),
+        tflite::RuntimeShape(1, static_cast<int>(layer.bias.size())), layer.bias.data(),
+        layer.output_shape, reference.data());
+  }
+  result.reference_us = Microseconds(start, runs);
+
+  start = tflite::GetCurrentTimeTicks();
+  for (int r = 0; r < runs; ++r) {
+    tflite::ops::micro::depthwise_conv_3x3::DepthwiseConv3x3<int8_t>(
+        p, layer.multipliers.data(), layer.shifts.data(), /*quant_step=*/1,
+        layer.input_shape, layer.input_int8.data(), layer.filter_shape,
+        layer.filter_int8.data(), layer.bias.data(), layer.output_shape,
+        optimized.data());
+  }
+  result.optimized_us = Microseconds(start, runs);
+  result.exact = reference == optimized;
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int runs = kDefaultRuns;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+    switch (opt) {
+      case 'r':
+        runs = atoi(optarg);
+        break;
+      case 's':
+        random_state = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+        break;
+      default:
+        fprintf(stderr, "Usage: depthwise_conv_bench [-r runs] [-s seed]\n");
+        return 1;
+    }
+  }
+  if (runs < 1) {
+    runs = 1;
+  }
+
+  std::vector<Layer> layers;
+  if (!AddModelLayers(&layers)) {
+    fprintf(stderr, "Can't read the depthwise layers of the model\n");
+    return 1;
+  }
+  AddEdgeLayer(5, 7, 3, 1, 1, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(5, 7, 3, 1, 2, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(6, 6, 5, 1, 2, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(4, 9, 2, 1, 1, kTfLitePaddingValid, &layers);
+  AddEdgeLayer(7, 4, 4, 1, 2, kTfLitePaddingValid, &layers);
+  AddEdgeLayer(3, 3, 1, 1, 1, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(1, 1, 8, 1, 2, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(5, 6, 1, 8, 2, kTfLitePaddingSame, &layers);
+  AddEdgeLayer(4, 5, 2, 8, 1, kTfLitePaddingValid, &layers);
+
+  int mismatches = 0;
+  double total_reference = 0;
+  double total_optimized = 0;
+  printf("%-12s %-13s %-6s %-5s %10s %10s %8s %s\n", "layer", "input",
+         "stride", "type", "ref us", "3x3 us", "speedup", "exact");
+  for (const Layer& layer : layers) {
+    char shape[32];
+    snprintf(shape, sizeof(shape), "%dx%dx%d", layer.input_shape.Dims(1),
+             layer.input_shape.Dims(2), layer.input_shape.Dims(3));
+    if (!tflite::ops::micro::depthwise_conv_3x3::CanRun(layer.params,
+                                                        layer.filter_shape)) {
+      printf("%-12s %-13s %-6d not a specialized shape\n", layer.name, shape,
+             layer.params.stride_width);
+      continue;
+    }
+    const Result results[] = {RunUint8(layer, runs), RunInt8(layer, runs)};
+    const char* types[] = {"uint8", "int8"};
+    for (int t = 0; t < 2; ++t) {
+      const Result& r = results[t];
+      printf("%-12s %-13s %-6d %-5s %10.1f %10.1f %7.2fx %s\n", layer.name,
+             shape, layer.params.stride_width, types[t], r.reference_us,
+             r.optimized_us,
+             r.optimized_us > 0 ? r.reference_us / r.optimized_us : 0.0,
+             r.exact ? "yes" : "NO");
+      mismatches += r.exact ? 0 : 1;
+      if (strncmp(layer.name, "node", 4) == 0 && t == 0) {
+        total_reference += r.reference_us;
+        total_optimized += r.optimized_us;
+      }
+    }
+  }
+  printf("Model uint8 layers: reference %.1f us, 3x3 %.1f us, %.2fx\n",
+         total_reference, total_optimized,
+         total_optimized > 0 ? total_reference / total_optimized : 0.0);
+  if (mismatches > 0) {
+    printf("%d outputs differ from the reference\n", mismatches);
+    return 1;
+  }
+  printf("All the outputs are bit-exact\n");
+  return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file detection_filter_sim.cpp
+ * @brief Alerts of the single frame threshold and of the detection filter.
+ *
+ * Runs the model (gemm kernels of the sketch) on a sequence of noisy frames
+ * of the corpus: the images are shuffled, every one is held for a number of
+ * frames with uniform sensor noise. The label of an image is its folder,
+ * person or no_person. The detections of the single frame threshold
+ * (person score > 150) and of the DetectionFilter of detection_filter.h
+ * are compared with the labels: the changes of detection, the ones not
+ * following a change of label (false alerts), the frames detected wrong
+ * and the frames from a change of label to the matching detection.
+ *
+ * Usage: detection_filter_sim [-f frames] [-n noise] [-s seed] <dir> ...
+ *
+ * -f frames per image (default 10), -n noise amplitude in grey levels
+ * (default 8), -s seed of the shuffle and the noise. The images are 96x96
+ * P5 PGM files, the directories are scanned recursively.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "detection_filter.h"
+#include "model_settings.h"
+#include "pgm_corpus.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+namespace {
+
+constexpr int kDefaultFrames = 10;
+constexpr int kDefaultNoise = 8;
+// Single frame threshold of the sketch before the filter
+constexpr int kPersonThreshold = 150;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int Random(int min, int max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int>((random_state >> 8) %
+                                static_cast<uint32_t>(max - min + 1));
+}
+
+struct Image {
+  std::vector<uint8_t> pixels;
+  bool person;
+};
+
+// Detections of a sequence against its labels
+struct Result {
+  int changes = 0;
+  int false_alerts = 0;
+  int wrong_frames = 0;
+  int delays = 0;
+  int64_t delay_frames = 0;
+  // Detection and frames since the last change of label, -1 once matched
+  bool person = false;
+  int since_label = -1;
+  bool label_changed = false;
+};
+
+void Score(bool person, bool label, bool label_changed, Result* r) {
+  if (label_changed) {
+    r->since_label = 0;
+    r->label_changed = true;
+  }
+  if (person != r->person) {
+    r->changes++;
+    // A change not moving to a new label
+    if (!r->label_changed || person != label) {
+      r->false_alerts++;
+    }
+    r->label_changed = false;
+    r->person = person;
+  }
+  if (person != label) {
+    r->wrong_frames++;
+  }
+  if (r->since_label >= 0) {
+    if (person == label) {
+      r->delays++;
+      r->delay_frames += r->since_label;
+      r->since_label = -1;
+    } else {
+      r->since_label++;
+    }
+  }
+}
+
+void Print(const char* name, const Result& r, int frames) {
+  printf("%-10s %8d %13d %13.1f%% %13.2f\n", name, r.changes, r.false_alerts,
+         100.0 * r.wrong_frames / frames,
+         r.delays > 0 ? static_cast<double>(r.delay_frames) / r.delays : 0.0);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int frames_per_image = kDefaultFrames;
+  int noise = kDefaultNoise;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:n:s:")) != -1) {
+    switch (opt) {
+      case 'f':
+        frames_per_image = std::max(atoi(optarg), 1);
+        break;
+      case 'n':
+        noise = std::max(atoi(optarg), 0);
+        break;
+      case 's':
+        random_state = static_cast<uint32_t>(atoi(optarg));
+        break;
+      default:
+        fprintf(stderr, "Usage: detection_filter_sim [-f frames] [-n noise] "
+                        "[-s seed] <dir> ...\n");
+        return 1;
+    }
+  }
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) {
+    CollectImages(argv[i], &files);
+  }
+  std::vector<Image> images;
+  for (const std::string& file : files) {
+    Image image;
+    if (!ReadModelPgm(file, &image.pixels)) {
+      fprintf(stderr, "Skipped %s, not a 96x96 P5 PGM\n", file.c_str());
+      continue;
+    }
+    image.person = LabelFromPath(file) == kPerson;
+    images.push_back(image);
+  }
+  if (images.empty()) {
+    fprintf(stderr, "No images\n");
+    return 1;
+  }
+  // Fisher-Yates shuffle
+  for (int i = static_cast<int>(images.size()) - 1; i > 0; i--) {
+    std::swap(images[i], images[Random(0, i)]);
+  }
+
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  tflite::MicroInterpreter* interpreter =
+      NewSketchInterpreter(error_reporter);
+  if (interpreter == nullptr) {
+    return 1;
+  }
+  TfLiteTensor* input = interpreter->input(0);
+  TfLiteTensor* output = interpreter->output(0);
+
+  DetectionFilter filter;
+  Result single, filtered;
+  int label_changes = 0;
+  bool label = false;
+  for (const Image& image : images) {
+    const bool label_changed = image.person != label;
+    label_changes += label_changed;
+    label = image.person;
+    for (int f = 0; f < frames_per_image; f++) {
+      for (int i = 0; i < kMaxImageSize; i++) {
+        input->data.uint8[i] = static_cast<uint8_t>(std::min(
+            255, std::max(0, image.pixels[i] + Random(-noise, noise))));
+      }
+      if (interpreter->Invoke() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+        return 1;
+      }
+      const uint8_t score = output->data.uint8[kPersonIndex];
+      filter.Update(score);
+      Score(score > kPersonThreshold, label, label_changed && f == 0, &single);
+      Score(filter.person(), label, label_changed && f == 0, &filtered);
+    }
+  }
+
+  const int frames = static_cast<int>(images.size()) * frames_per_image;
+  printf("Frames: %d (%d images x %d, noise +-%d), label changes %d\n",
+         frames, static_cast<int>(images.size()), frames_per_image, noise,
+         label_changes);
+  printf("Filter: average 1/%d, thresholds %d/%d\n",
+         1 << kDetectionAverageShift, kDetectionOnThreshold,
+         kDetectionOffThreshold);
+  printf("%-10s %8s %13s %14s %13s\n", "detection", "changes", "false alerts",
+         "wrong frames", "delay frames");
+  Print("single", single, frames);
+  Print("filtered", filtered, frames);
+  return 0;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file detection_report_sim.cpp
+ * @brief BLE notifications of the detection of NanoramaCam.ino, checked on
+ * the mock of the ArduinoBLE characteristics (ble_mock.h).
+ *
+ * Runs the loop() of the sketch on a simulated clock for a sequence of
+ * scenes with and without a person. Each scene lasts a random time, the
+ * inference gives a noisy person score and the motion gate skips most
+ * frames of a still scene. The DetectionFilter of detection_filter.h
+ * smooths the scores. Two reporting methods are compared:
+ *
+ * - characteristics: the separate characteristics written after every
+ *   loop() before the report, with the tries counter notified every time;
+ * - report: the DetectionReporter of detection_report.h.
+ *
+ * The notifications, the connection events carrying them and the
+ * notifications per minute are printed for both.
+ *
+ * The report is checked:
+ * - every change of detection is notified within one connection interval
+ *   and one loop();
+ * - no connection event carries two notifications;
+ * - the notifications are at most the changes of detection plus one per
+ *   batch period;
+ * - the last value decodes to the last detection.
+ *
+ * Usage: detection_report_sim [-t seconds] [-c interval_ms] [-s seed]
+ *
+ * The exit status is 1 if a check fails.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ble_mock.h"
+#include "detection_filter.h"
+#include "detection_report.h"
+
+namespace {
+
+constexpr int kDefaultSeconds = 3600;
+constexpr int kDefaultIntervalMs = 100;
+
+// loop() periods: capture and inference, capture of a skipped frame
+constexpr uint32_t kInferredLoopMs = 1100;
+constexpr uint32_t kSkippedLoopMs = 100;
+constexpr uint16_t kInferenceMs = 1000;
+// Scenes from 10 s to 2 min, the first frames of a scene are inferred
+constexpr int kMinSceneMs = 10000;
+constexpr int kMaxSceneMs = 120000;
+constexpr int kSceneInferences = 3;
+// Frames skipped by the motion gate in a still scene, percent
+constexpr int kStillSkipPercent = 80;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int Random(int min, int max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int>((random_state >> 8) %
+                                static_cast<uint32_t>(max - min + 1));
+}
+
+uint8_t PersonScore(bool person) {
+  const int score = person ? Random(120, 255) : Random(0, 170);
+  return static_cast<uint8_t>(std::min(255, std::max(0, score)));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int seconds = kDefaultSeconds;
+  uint32_t interval_ms = kDefaultIntervalMs;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:c:s:")) != -1) {
+    switch (opt) {
+      case 't':
+        seconds = std::max(atoi(optarg), 1);
+        break;
+      case 'c':
+        interval_ms = static_cast<uint32_t>(std::max(atoi(optarg), 8));
+        break;
+      case 's':
+        random_state = static_cast<uint32_t>(atoi(optarg));
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: detection_report_sim [-t seconds] [-c interval_ms] "
+                "[-s seed]\n");
+        return 1;
+    }
+  }
+
+  // The characteristics of the sketch before the report
+  BLEUnsignedCharCharacteristic humanDetected(
+      "4f375fe5-24b2-46ba-b760-5b121ec695df", BLERead | BLENotify);
+  BLEUnsignedCharCharacteristic triesCount(
+      "4f375fe5-24b2-46ba-b760-5b121ec695df", BLERead | BLENotify);
+  BLEUnsignedCharCharacteristic skippedPercent(
+      "4f375fe6-24b2-46ba-b760-5b121ec695df", BLERead | BLENotify);
+  BLEUnsignedCharCharacteristic detectionConfidence(
+      "4f375fe7-24b2-46ba-b760-5b121ec695df", BLERead);
+  BLEUnsignedCharCharacteristic* characteristics[] = {
+      &humanDetected, &triesCount, &skippedPercent, &detectionConfidence};
+  // The report
+  BLECharacteristic detectionReport("4f375fe8-24b2-46ba-b760-5b121ec695df",
+                                    BLERead | BLENotify, kDetectionReportSize,
+                                    true);
+  for (BLEUnsignedCharCharacteristic* c : characteristics) {
+    c->SetConnectionInterval(interval_ms);
+  }
+  detectionReport.SetConnectionInterval(interval_ms);
+  DetectionReporter<BLECharacteristic> reporter(&detectionReport, interval_ms);
+
+  DetectionFilter filter;
+  const uint32_t end_ms = static_cast<uint32_t>(seconds) * 1000;
+  uint32_t now = 0;
+  uint32_t scene_end = 0;
+  bool person = false;
+  int scene_frames = 0;
+  uint32_t frames = 0, skipped = 0;
+  unsigned char detections = 0;
+  int changes = 0;
+  // Time of the last change of detection not yet notified, 0 if none
+  uint32_t pending_change = 0;
+  bool has_pending_change = false;
+  uint32_t max_latency = 0;
+  int late = 0;
+  // Connection events with notifications of the characteristics
+  int legacy_notifications = 0, legacy_events = 0;
+  uint32_t legacy_event = 0;
+  while (now < end_ms) {
+    if (now >= scene_end) {
+      scene_end = now + Random(kMinSceneMs, kMaxSceneMs);
+      person = Random(0, 1) == 1;
+      scene_frames = 0;
+    }
+    frames++;
+    const bool inferred = scene_frames++ < kSceneInferences ||
+                          Random(1, 100) > kStillSkipPercent;
+    now += inferred ? kInferredLoopMs : kSkippedLoopMs;
+    skipped += !inferred;
+    const uint8_t skipped_percent = static_cast<uint8_t>(skipped * 100 / frames);
+    for (BLEUnsignedCharCharacteristic* c : characteristics) {
+      c->SetTime(now);
+    }
+    detectionReport.SetTime(now);
+
+    bool changed = false;
+    if (inferred) {
+      changed = filter.Update(PersonScore(person));
+    }
+    if (changed) {
+      changes++;
+      if (!has_pending_change) {
+        pending_change = now;
+        has_pending_change = true;
+      }
+    }
+
+    // Characteristics: the loop() of the sketch before the report
+    if (changed) {
+      humanDetected.writeValue(filter.person() ? 'T' : 'F');
+    }
+    if (inferred && detectionConfidence.value() != filter.confidence()) {
+      detectionConfidence.writeValue(filter.confidence());
+    }
+    triesCount.writeValue(++detections);
+    if (skippedPercent.value() != skipped_percent) {
+      skippedPercent.writeValue(skipped_percent);
+    }
+    int notifications = 0;
+    for (BLEUnsignedCharCharacteristic* c : characteristics) {
+      notifications += c->notifications();
+    }
+    if (notifications > legacy_notifications &&
+        (legacy_events == 0 || now / interval_ms != legacy_event)) {
+      legacy_events++;
+      legacy_event = now / interval_ms;
+    }
+    legacy_notifications = notifications;
+
+    // Report
+    DetectionReport report;
+    report.flags = filter.person() ? kReportPerson : 0;
+    report.score = filter.score();
+    report.confidence = filter.confidence();
+    report.skipped_percent = skipped_percent;
+    report.frames = frames;
+    report.inference_ms = kInferenceMs;
+    if (reporter.Update(report, now) && has_pending_change &&
+        (reporter.published().flags & kReportPerson) ==
+            (filter.person() ? kReportPerson : 0)) {
+      const uint32_t latency = now - pending_change;
+      max_latency = std::max(max_latency, latency);
+      late += latency > interval_ms + kInferredLoopMs;
+      has_pending_change = false;
+    }
+  }
+  // The next loop() sends a change still waiting for its interval
+  now += interval_ms;
+  detectionReport.SetTime(now);
+  DetectionReport report = reporter.published();
+  report.flags = filter.person() ? kReportPerson : 0;
+  reporter.Update(report, now);
+
+  const double minutes = now / 60000.0;
+  printf("Simulated %d s, %u frames (%u%% skipped), %d changes of detection, "
+         "connection interval %u ms\n",
+         seconds, frames, skipped * 100 / frames, changes, interval_ms);
+  printf("%-16s %14s %18s %12s\n", "reporting", "notifications",
+         "connection events", "per minute");
+  printf("%-16s %14d %18d %12.2f\n", "characteristics", legacy_notifications,
+         legacy_events, legacy_notifications / minutes);
+  printf("%-16s %14d %18d %12.2f\n", "report", detectionReport.notifications(),
+         detectionReport.events(), detectionReport.notifications() / minutes);
+  printf("Change notified in %u ms at most, batch period %u ms\n", max_latency,
+         (kReportBatchMs + interval_ms - 1) / interval_ms * interval_ms);
+
+  int errors = 0;
+  if (late > 0) {
+    printf("Changes notified late: %d\n", late);
+    errors++;
+  }
+  if (detectionReport.max_per_event() > 1) {
+    printf("Notifications in one connection event: %d\n",
+           detectionReport.max_per_event());
+    errors++;
+  }
+  const int bound = changes + static_cast<int>(now / kReportBatchMs) + 1;
+  if (detectionReport.notifications() > bound) {
+    printf("Notifications over the bound of %d\n", bound);
+    errors++;
+  }
+  const DetectionReport last =
+      UnpackDetectionReport(detectionReport.value());
+  if (detectionReport.valueLength() != kDetectionReportSize ||
+      ((last.flags & kReportPerson) != 0) != filter.person()) {
+    printf("Last report doesn't match the detection\n");
+    errors++;
+  }
+  return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * @file image_provider_bench.cpp
+ * @brief Check and timing of the greyscale images of the Arducam frames.
+ *
+ * Compares the fixed point conversion of rgb565_grey.h with the double
+ * precision one it replaced in arduino_image_provider.cpp: all the 65536
+ * RGB565 colors, then the 96x96 crop of random 160x120 frames served as
+ * 16x8 MCUs by a stand-in of the JPEGDecoder library (the same members used
+ * by DecodeMcusToGrey(), no entropy decoding). The time per frame and the
+ * MCUs decoded of both are reported: on the board every MCU decoded costs
+ * the Huffman decoding, the IDCT and the color conversion of the library.
+ *
+ * The raw capture path (raw_grey_stream.h) is checked on random 160x120 Y8
+ * and YUYV frames read from a simulated FIFO: the 96x96 images must be the
+ * 5:4 area average of the centered 120x120 crop, computed here from the
+ * whole frame. The time per frame and the FIFO bytes read are reported, on
+ * the board each one is an SPI transfer.
+ *
+ * Usage: image_provider_bench [-r runs] [-s seed]
+ *
+ * The exit status is 1 if any greyscale value differs.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "model_settings.h"
+#include "raw_grey_stream.h"
+#include "rgb565_grey.h"
+#include "tensorflow/lite/micro/micro_time.h"
+
+namespace {
+
+// OV2640_160x120 JPEG frames of the sketch
+constexpr int kFrameWidth = 160;
+constexpr int kFrameHeight = 120;
+constexpr int kMcuWidth = 16;
+constexpr int kMcuHeight = 8;
+
+constexpr int kDefaultRuns = 2000;
+constexpr int kFrames = 16;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+uint16_t RandomColor() {
+  random_state = random_state * 1664525u + 1013904223u;
+  return static_cast<uint16_t>(random_state >> 16);
+}
+
+// Stand-in of JpegDec: decodeArray() takes a raw RGB565 frame and read()
+// copies its MCUs, left to right and top to bottom
+class JpegDecoderStandIn {
+ public:
+  int MCUWidth = kMcuWidth;
+  int MCUHeight = kMcuHeight;
+  int MCUSPerRow = kFrameWidth / kMcuWidth;
+  int MCUSPerCol = kFrameHeight / kMcuHeight;
+  int MCUx = 0;
+  int MCUy = 0;
+  uint16_t* pImage = mcu_;
+
+  int decodeArray(const uint8_t array[], uint32_t array_size) {
+    if (array_size < kFrameWidth * kFrameHeight * sizeof(uint16_t)) {
+      return 0;
+    }
+    frame_ = reinterpret_cast<const uint16_t*>(array);
+    next_ = 0;
+    return 1;
+  }
+
+  int read() {
+    if (frame_ == nullptr || next_ == MCUSPerRow * MCUSPerCol) {
+      return 0;
+    }
+    MCUx = next_ % MCUSPerRow;
+    MCUy = next_ / MCUSPerRow;
+    for (int row = 0; row < MCUHeight; row++) {
+      memcpy(mcu_ + row * MCUWidth,
+             frame_ + (MCUy * MCUHeight + row) * kFrameWidth + MCUx * MCUWidth,
+             MCUWidth * sizeof(uint16_t));
+    }
+    next_++;
+    return 1;
+  }
+
+  void abort() { frame_ = nullptr; }
+
+ private:
+  const uint16_t* frame_ = nullptr;
+  int next_ = 0;
+  uint16_t mcu_[kMcuWidth * kMcuHeight];
+};
+
+// Camera FIFO holding a raw frame, counts the bytes read
+class SimulatedFifo {
+ public:
+  explicit SimulatedFifo(const std::vector<uint8_t>& frame) : frame_(frame) {}
+
+  uint8_t Read() {
+    const uint8_t byte = position_ < frame_.size() ? frame_[position_] : 0;
+    position_++;
+    return byte;
+  }
+
+  void Skip(int bytes) { position_ += bytes; }
+
+  size_t position() const { return position_; }
+
+ private:
+  const std::vector<uint8_t>& frame_;
+  size_t position_ = 0;
+};
+
+// 5:4 area average of the centered crop of the luminance of a frame, the
+// overlaps in quarters of sensor pixel (fifths of image pixel)
+void RawReference(const std::vector<uint8_t>& frame, RawFormat format,
+                  int image_side, uint8_t* image_data) {
+  const int crop = image_side * 5 / 4;
+  const int x0 = (kFrameWidth - crop) / 2;
+  const int y0 = (kFrameHeight - crop) / 2;
+  const int bytes_per_pixel = format == RawFormat::kYuyv ? 2 : 1;
+  auto overlap = [](int dst, int src) {
+    return std::max(0, std::min(4 * src + 4, 5 * dst + 5) -
+                           std::max(4 * src, 5 * dst));
+  };
+  for (int y = 0; y < image_side; y++) {
+    for (int x = 0; x < image_side; x++) {
+      int sum = 0;
+      for (int sy = 0; sy < crop; sy++) {
+        for (int sx = 0; sx < crop; sx++) {
+          sum += overlap(y, sy) * overlap(x, sx) *
+                 frame[((y0 + sy) * kFrameWidth + x0 + sx) * bytes_per_pixel];
+        }
+      }
+      image_data[y * image_side + x] = static_cast<uint8_t>((sum + 12) / 25);
+    }
+  }
+}
+
+// The conversion of arduino_image_provider.cpp before rgb565_grey.h
+uint8_t LegacyGrey(uint16_t color) {
+  uint8_t r, g, b;
+  r = ((color & 0xF800) >> 11) * 8;
+  g = ((color & 0x07E0) >> 5) * 4;
+  b = ((color & 0x001F) >> 0) * 8;
+  float gray_value = (0.2126 * r) + (0.7152 * g) + (0.0722 * b);
+  return static_cast<uint8_t>(gray_value);
+}
+
+// The MCU loop of arduino_image_provider.cpp before rgb565_grey.h: every
+// MCU is decoded
+int LegacyDecode(JpegDecoderStandIn* decoder, int image_width,
+                 int image_height, uint8_t* image_data) {
+  const int keep_x_mcus = image_width / decoder->MCUWidth;
+  const int keep_y_mcus = image_height / decoder->MCUHeight;
+  const int skip_start_x_mcus = (decoder->MCUSPerRow - keep_x_mcus) / 2;
+  const int skip_end_x_mcu_index = skip_start_x_mcus + keep_x_mcus;
+  const int skip_start_y_mcus = (decoder->MCUSPerCol - keep_y_mcus) / 2;
+  const int skip_end_y_mcu_index = skip_start_y_mcus + keep_y_mcus;
+  int decoded = 0;
+  while (decoder->read()) {
+    decoded++;
+    if (decoder->MCUy < skip_start_y_mcus ||
+        decoder->MCUx < skip_start_x_mcus ||
+        decoder->MCUx >= skip_end_x_mcu_index ||
+        decoder->MCUy >= skip_end_y_mcu_index) {
+      continue;
+    }
+    const uint16_t* pImg = decoder->pImage;
+    const int x_origin = (decoder->MCUx - skip_start_x_mcus) * decoder->MCUWidth;
+    const int y_origin = (decoder->MCUy - skip_start_y_mcus) * decoder->MCUHeight;
+    for (int mcu_row = 0; mcu_row < decoder->MCUHeight; mcu_row++) {
+      for (int mcu_col = 0; mcu_col < decoder->MCUWidth; mcu_col++) {
+        image_data[(y_origin + mcu_row) * image_width + x_origin + mcu_col] =
+            LegacyGrey(*pImg++);
+      }
+    }
+  }
+  return decoded;
+}
+
+// Mean us per frame of decode over runs frames
+template <typename Decode>
+double TimeFrames(const std::vector<std::vector<uint16_t>>& frames, int runs,
+                  Decode decode) {
+  const int32_t start = tflite::GetCurrentTimeTicks();
+  for (int r = 0; r < runs; r++) {
+    decode(frames[r % frames.size()]);
+  }
+  return static_cast<double>(tflite::GetCurrentTimeTicks() - start) / runs;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int runs = kDefaultRuns;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+    switch (opt) {
+      case 'r':
+        runs = atoi(optarg) > 0 ? atoi(optarg) : 1;
+        break;
+      case 's':
+        random_state = static_cast<uint32_t>(atoi(optarg));
+        break;
+      default:
+        fprintf(stderr, "Usage: image_provider_bench [-r runs] [-s seed]\n");
+        return 1;
+    }
+  }
+
+  int color_mismatches = 0;
+  for (uint32_t color = 0; color < 65536; color++) {
+    const uint16_t pixel = static_cast<uint16_t>(color);
+    uint8_t row;
+    Rgb565RowToGrey(&pixel, 1, &row);
+    if (Rgb565ToGrey(color) != LegacyGrey(pixel) || row != LegacyGrey(pixel)) {
+      color_mismatches++;
+    }
+  }
+  printf("Colors: %d of 65536 differ from the double conversion\n",
+         color_mismatches);
+
+  std::vector<std::vector<uint16_t>> frames(
+      kFrames, std::vector<uint16_t>(kFrameWidth * kFrameHeight));
+  for (std::vector<uint16_t>& frame : frames) {
+    for (uint16_t& pixel : frame) {
+      pixel = RandomColor();
+    }
+  }
+  const int image_bytes = kNumCols * kNumRows;
+  std::vector<uint8_t> legacy_image(image_bytes);
+  std::vector<uint8_t> grey_image(image_bytes);
+  JpegDecoderStandIn decoder;
+  int legacy_mcus = 0;
+  int grey_mcus = 0;
+  int pixel_mismatches = 0;
+  for (const std::vector<uint16_t>& frame : frames) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(frame.data());
+    const uint32_t size = frame.size() * sizeof(uint16_t);
+    decoder.decodeArray(data, size);
+    legacy_mcus =
+        LegacyDecode(&decoder, kNumCols, kNumRows, legacy_image.data());
+    decoder.decodeArray(data, size);
+    grey_mcus = DecodeMcusToGrey(&decoder, kNumCols, kNumRows,
+                                 grey_image.data());
+    for (int i = 0; i < image_bytes; i++) {
+      pixel_mismatches += legacy_image[i] != grey_image[i];
+    }
+  }
+  printf("Frames: %d pixels of %d frames %dx%d differ\n", pixel_mismatches,
+         kFrames, kNumCols, kNumRows);
+
+  const double legacy_us =
+      TimeFrames(frames, runs, [&](const std::vector<uint16_t>& frame) {
+        decoder.decodeArray(reinterpret_cast<const uint8_t*>(frame.data()),
+                            frame.size() * sizeof(uint16_t));
+        LegacyDecode(&decoder, kNumCols, kNumRows, legacy_image.data());
+      });
+  const double grey_us =
+      TimeFrames(frames, runs, [&](const std::vector<uint16_t>& frame) {
+        decoder.decodeArray(reinterpret_cast<const uint8_t*>(frame.data()),
+                            frame.size() * sizeof(uint16_t));
+        DecodeMcusToGrey(&decoder, kNumCols, kNumRows, grey_image.data());
+      });
+  const int total_mcus = decoder.MCUSPerRow * decoder.MCUSPerCol;
+  printf("%-10s %8s %12s\n", "decode", "us/frame", "MCUs decoded");
+  printf("%-10s %8.2f %6d of %d\n", "double", legacy_us, legacy_mcus,
+         total_mcus);
+  printf("%-10s %8.2f %6d of %d\n", "fixed", grey_us, grey_mcus, total_mcus);
+  printf("Speedup: %.2fx, %d MCUs not decoded (mean of %d frames)\n",
+         legacy_us / grey_us, legacy_mcus - grey_mcus, runs);
+
+  const char* format_names[] = {"Y8", "YUYV"};
+  const RawFormat formats[] = {RawFormat::kY8, RawFormat::kYuyv};
+  int raw_mismatches = 0;
+  for (int f = 0; f < 2; f++) {
+    const int bytes_per_pixel = formats[f] == RawFormat::kYuyv ? 2 : 1;
+    std::vector<std::vector<uint8_t>> raw_frames(
+        kFrames,
+        std::vector<uint8_t>(kFrameWidth * kFrameHeight * bytes_per_pixel));
+    for (std::vector<uint8_t>& frame : raw_frames) {
+      for (uint8_t& byte : frame) {
+        byte = static_cast<uint8_t>(RandomColor());
+      }
+    }
+    int mismatches = 0;
+    size_t bytes_read = 0;
+    for (const std::vector<uint8_t>& frame : raw_frames) {
+      SimulatedFifo fifo(frame);
+      if (!StreamRawToGrey(&fifo, kFrameWidth, kFrameHeight, formats[f],
+                           kNumCols, kNumRows, grey_image.data())) {
+        fprintf(stderr, "Can't stream %dx%d frames to %dx%d\n", kFrameWidth,
+                kFrameHeight, kNumCols, kNumRows);
+        return 1;
+      }
+      bytes_read = fifo.position();
+      RawReference(frame, formats[f], kNumCols, legacy_image.data());
+      for (int i = 0; i < image_bytes; i++) {
+        mismatches += legacy_image[i] != grey_image[i];
+      }
+    }
+    const int32_t start = tflite::GetCurrentTimeTicks();
+    for (int r = 0; r < runs; r++) {
+      SimulatedFifo fifo(raw_frames[r % kFrames]);
+      StreamRawToGrey(&fifo, kFrameWidth, kFrameHeight, formats[f], kNumCols,
+                      kNumRows, grey_image.data());
+    }
+    const double raw_us =
+        static_cast<double>(tflite::GetCurrentTimeTicks() - start) / runs;
+    printf("Raw %-4s: %d pixels of %d frames differ, %.2f us/frame, FIFO "
+           "bytes read %d of %d\n",
+           format_names[f], mismatches, kFrames, raw_us,
+           static_cast<int>(bytes_read),
+           static_cast<int>(raw_frames[0].size()));
+    raw_mismatches += mismatches;
+  }
+  return color_mismatches + pixel_mismatches + raw_mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file micro_time.cpp
+ * @brief POSIX timer of the host build, replaces the reference
+ * tensorflow/lite/micro/micro_time.cpp that always returns 0 ticks.
+ *
+ * One tick is one microsecond of the monotonic clock. The 32 bit counter
+ * wraps after about 71 minutes, so only the difference of two readings
+ * should be used (as the TFLM profiling code does).
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include "tensorflow/lite/micro/micro_time.h"
+
+#include <time.h>
+
+namespace tflite {
+
+int32_t ticks_per_second() { return 1000000; }
+
+int32_t GetCurrentTimeTicks() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  // Unsigned arithmetic, the wrap is well defined
+  uint32_t us = static_cast<uint32_t>(ts.tv_sec) * 1000000u +
+                static_cast<uint32_t>(ts.tv_nsec / 1000);
+  return static_cast<int32_t>(us);
+}
+
+}  // namespace tflite
@@ -0,0 +1,155 @@
+/**
+ * @file motion_gate_sim.cpp
+ * @brief Skip rate and score error of the motion gate of NanoramaCam.ino.
+ *
+ * Feeds the MotionGate of motion_gate.h with a sequence of noisy frames:
+ * every image is held for a number of frames with uniform sensor noise, then
+ * the next one replaces it. The model (gemm kernels of the sketch) runs on
+ * every frame, the scores reused on the skipped frames are compared with
+ * the ones the inference would have given: the mean and largest person
+ * score error and the detections (person score > 150) flipped. A change of
+ * image the gate skips is a missed change. The time of MotionGate::Check()
+ * is printed.
+ *
+ * Usage: motion_gate_sim [-f frames] [-n noise] <image.pgm | dir> ...
+ *
+ * -f frames per image (default 10), -n noise amplitude in grey levels
+ * (default 3). The images are 96x96 P5 PGM files, the directories are
+ * scanned recursively. The exit status is 1 if a change is missed.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "model_settings.h"
+#include "motion_gate.h"
+#include "pgm_corpus.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_time.h"
+
+namespace {
+
+constexpr int kDefaultFrames = 10;
+constexpr int kDefaultNoise = 3;
+// Detection threshold of NanoramaCam.ino
+constexpr int kPersonThreshold = 150;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int Random(int min, int max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int>((random_state >> 8) %
+                                static_cast<uint32_t>(max - min + 1));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int frames_per_image = kDefaultFrames;
+  int noise = kDefaultNoise;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:n:")) != -1) {
+    switch (opt) {
+      case 'f':
+        frames_per_image = std::max(atoi(optarg), 1);
+        break;
+      case 'n':
+        noise = std::max(atoi(optarg), 0);
+        break;
+      default:
+        fprintf(stderr, "Usage: motion_gate_sim [-f frames] [-n noise] "
+                        "<image.pgm | dir> ...\n");
+        return 1;
+    }
+  }
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) {
+    CollectImages(argv[i], &files);
+  }
+  std::vector<std::vector<uint8_t>> images;
+  for (const std::string& file : files) {
+    std::vector<uint8_t> pixels;
+    if (ReadModelPgm(file, &pixels)) {
+      images.push_back(pixels);
+    } else {
+      fprintf(stderr, "Skipped %s, not a 96x96 P5 PGM\n", file.c_str());
+    }
+  }
+  if (images.empty()) {
+    fprintf(stderr, "No images\n");
+    return 1;
+  }
+
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  tflite::MicroInterpreter* interpreter =
+      NewSketchInterpreter(error_reporter);
+  if (interpreter == nullptr) {
+    return 1;
+  }
+  TfLiteTensor* input = interpreter->input(0);
+  TfLiteTensor* output = interpreter->output(0);
+
+  MotionGate gate;
+  std::vector<uint8_t> frame(kMaxImageSize);
+  uint8_t reused_score = 0;
+  int missed_changes = 0;
+  int flipped = 0;
+  int max_error = 0;
+  int64_t total_error = 0;
+  uint32_t gate_us = 0;
+  for (const std::vector<uint8_t>& image : images) {
+    for (int f = 0; f < frames_per_image; f++) {
+      for (int i = 0; i < kMaxImageSize; i++) {
+        frame[i] = static_cast<uint8_t>(
+            std::min(255, std::max(0, image[i] + Random(-noise, noise))));
+      }
+      const uint32_t start = tflite::GetCurrentTimeTicks();
+      const bool infer = gate.Check(frame.data());
+      gate_us += tflite::GetCurrentTimeTicks() - start;
+      memcpy(input->data.uint8, frame.data(), kMaxImageSize);
+      if (interpreter->Invoke() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+        return 1;
+      }
+      const uint8_t score = output->data.uint8[kPersonIndex];
+      if (infer) {
+        reused_score = score;
+        continue;
+      }
+      if (f == 0) {
+        missed_changes++;
+      }
+      const int error = std::abs(score - reused_score);
+      max_error = std::max(max_error, error);
+      total_error += error;
+      flipped += (score > kPersonThreshold) != (reused_score > kPersonThreshold);
+    }
+  }
+
+  const uint32_t frames = gate.frames();
+  const uint32_t skipped = gate.skipped();
+  printf("Frames: %u (%d images x %d, noise +-%d)\n", frames,
+         static_cast<int>(images.size()), frames_per_image, noise);
+  printf("Skipped: %u (%u%%), inferred %u, threshold %d grey levels\n",
+         skipped, gate.skipped_percent(), frames - skipped, gate.threshold());
+  printf("Changes missed: %d of %d\n", missed_changes,
+         static_cast<int>(images.size()) - 1);
+  printf("Reused person score error: mean %.2f max %d, detections flipped %d\n",
+         skipped > 0 ? static_cast<double>(total_error) / skipped : 0.0,
+         max_error, flipped);
+  printf("Check() us: %.2f per frame\n", static_cast<double>(gate_us) / frames);
+  return missed_changes > 0 ? 1 : 0;
+}
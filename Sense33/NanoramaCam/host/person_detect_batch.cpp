@@ -0,0 +1,515 @@
+/**
+ * @file person_detect_batch.cpp
+ * @brief Multi-threaded batch runner of the person detection model.
+ *
+ * Screens whole camera frames for people: every frame is tiled into 96x96
+ * windows and the windows are run through the model by a pool of worker
+ * threads. Every worker owns a MicroInterpreter and its tensor arena, the
+ * read-only model flatbuffer and the op resolver are shared. The tiles are
+ * dealt in contiguous blocks to per-worker queues; a worker pops from the
+ * back of its own queue and, when it runs dry, steals from the front of the
+ * others, so the uneven latency of the cores is balanced without a central
+ * lock. The scores are written per tile and aggregated per frame after the
+ * batch: max person score, its window and the windows over the
+ * NanoramaCam.ino threshold.
+ *
+ * Usage: person_detect_batch [-t threads] [-s stride] [-d downscale]
+ *                            [-r runs] [-k kernels] [-v]
+ *                            <frame.pgm | dir> ...
+ *
+ * The frames are binary PGM (P5), 8 bit, of any size of at least 96x96
+ * after the downscale. The directories are scanned recursively.
+ * Without frames a flat grey 640x480 frame is screened.
+ * -t sets the max number of workers (default 4): the batch is run with 1 to
+ * threads workers and the tiles/s of each are reported with the speedup
+ * over one worker. -s is the step between the windows (default 96, no
+ * overlap), the last row and column of windows are aligned to the frame
+ * border. -d averages d x d pixel blocks before the tiling (default 1).
+ * -r repeats the batch of every worker count (default 1). -k selects the
+ * kernel set as in person_detect_bench: "reference", "gemm" or "simd"
+ * (default). -v prints the result of every frame.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model_settings.h"
+#include "person_detect_model_data.h"
+#include "pgm_corpus.h"
+#include "tensorflow/lite/kernels/internal/optimized/simd_ops.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+// Fits every kernel set as person_detect_bench, one per worker
+constexpr int kTensorArenaSize = 89 * 1024;
+
+// Detection threshold used by NanoramaCam.ino
+constexpr int kSketchThreshold = 150;
+constexpr int kDefaultThreads = 4;
+constexpr int kDefaultStride = kNumCols;
+// Frame screened when no frame is given
+constexpr int kGreyFrameWidth = 640;
+constexpr int kGreyFrameHeight = 480;
+
+struct Frame {
+  std::string path;
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;
+  // First tile of the frame in the batch, the tiles are contiguous
+  int first_tile;
+  int num_tiles;
+};
+
+// Top left corner of a window in its frame
+struct Tile {
+  int frame;
+  int x;
+  int y;
+};
+
+// Average of the factor x factor blocks, the partial blocks of the right
+// and bottom borders are dropped
+void Downscale(Frame* frame, int factor) {
+  const int width = frame->width / factor;
+  const int height = frame->height / factor;
+  const int area = factor * factor;
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int sum = 0;
+      for (int dy = 0; dy < factor; dy++) {
+        const uint8_t* row =
+            frame->pixels.data() + (y * factor + dy) * frame->width +
+            x * factor;
+        for (int dx = 0; dx < factor; dx++) {
+          sum += row[dx];
+        }
+      }
+      pixels[y * width + x] = static_cast<uint8_t>((sum + area / 2) / area);
+    }
+  }
+  frame->pixels.swap(pixels);
+  frame->width = width;
+  frame->height = height;
+}
+
+// Window origins along one side, the last window is aligned to the border
+std::vector<int> WindowOrigins(int size, int window, int stride) {
+  std::vector<int> origins;
+  for (int p = 0; p + window <= size; p += stride) {
+    origins.push_back(p);
+  }
+  if (origins.back() + window < size) {
+    origins.push_back(size - window);
+  }
+  return origins;
+}
+
+// Kernel sets selectable with -k
+enum KernelSet { kReferenceKernels, kGemmKernels, kSimdKernels };
+
+bool ParseKernelSet(const char* name, KernelSet* set) {
+  if (strcmp(name, "reference") == 0) {
+    *set = kReferenceKernels;
+  } else if (strcmp(name, "gemm") == 0) {
+    *set = kGemmKernels;
+  } else if (strcmp(name, "simd") == 0) {
+    *set = kSimdKernels;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Output score in the 0-255 range of the uint8 model
+int Score(const TfLiteTensor* output, int index) {
+  if (output->type == kTfLiteInt8) {
+    return output->data.int8[index] + 128;
+  }
+  return output->data.uint8[index];
+}
+
+// Tile indices of one worker. The owner pops from the back, the thieves
+// take from the front: the two ends rarely collide on the same tile.
+class TileQueue {
+ public:
+  void Reset(int first, int last) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiles_.clear();
+    for (int i = first; i < last; i++) {
+      tiles_.push_back(i);
+    }
+  }
+
+  bool Pop(int* tile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tiles_.empty()) {
+      return false;
+    }
+    *tile = tiles_.back();
+    tiles_.pop_back();
+    return true;
+  }
+
+  bool Steal(int* tile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tiles_.empty()) {
+      return false;
+    }
+    *tile = tiles_.front();
+    tiles_.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<int> tiles_;
+};
+
+// Interpreter, arena and queue of one thread. The allocator aligns the
+// tensors in the arena.
+struct Worker {
+  uint8_t tensor_arena[kTensorArenaSize];
+  tflite::MicroErrorReporter error_reporter;
+  std::unique_ptr<tflite::MicroInterpreter> interpreter;
+  TileQueue queue;
+  int tiles_run;
+  int tiles_stolen;
+};
+
+class BatchRunner {
+ public:
+  BatchRunner(const std::vector<Frame>& frames, const std::vector<Tile>& tiles,
+              std::vector<int>* scores)
+      : frames_(frames), tiles_(tiles), scores_(scores), failed_(false) {}
+
+  // Creates the workers on the shared model and resolver
+  bool Init(const tflite::Model* model, const tflite::MicroOpResolver<3>& ops,
+            int max_workers) {
+    for (int i = 0; i < max_workers; i++) {
+      std::unique_ptr<Worker> w(new Worker);
+      w->interpreter.reset(new tflite::MicroInterpreter(
+          model, ops, w->tensor_arena, kTensorArenaSize, &w->error_reporter));
+      if (w->interpreter->AllocateTensors() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(&w->error_reporter, "AllocateTensors() failed");
+        return false;
+      }
+      // Untimed first inference of the worker
+      if (!RunTile(w.get(), 0)) {
+        return false;
+      }
+      workers_.push_back(std::move(w));
+    }
+    return true;
+  }
+
+  // Screens all the tiles with the first num_workers workers, returns the
+  // elapsed microseconds or -1 on error
+  int64_t Run(int num_workers) {
+    const int num_tiles = static_cast<int>(tiles_.size());
+    for (int i = 0; i < num_workers; i++) {
+      Worker* w = workers_[i].get();
+      w->queue.Reset(num_tiles * i / num_workers,
+                     num_tiles * (i + 1) / num_workers);
+      w->tiles_run = 0;
+      w->tiles_stolen = 0;
+    }
+    failed_ = false;
+
+    const uint32_t start = tflite::GetCurrentTimeTicks();
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_workers; i++) {
+      threads.emplace_back(&BatchRunner::WorkerLoop, this, i, num_workers);
+    }
+    // The main thread is the first worker
+    WorkerLoop(0, num_workers);
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    const uint32_t ticks = tflite::GetCurrentTimeTicks() - start;
+    if (failed_) {
+      return -1;
+    }
+    return static_cast<int64_t>(ticks) * 1000000 / tflite::ticks_per_second();
+  }
+
+  const Worker& worker(int i) const { return *workers_[i]; }
+
+ private:
+  bool RunTile(Worker* w, int index) {
+    const Tile& tile = tiles_[index];
+    const Frame& frame = frames_[tile.frame];
+    TfLiteTensor* input = w->interpreter->input(0);
+    for (int y = 0; y < kNumRows; y++) {
+      const uint8_t* row =
+          frame.pixels.data() + (tile.y + y) * frame.width + tile.x;
+      if (input->type == kTfLiteInt8) {
+        int8_t* dst = input->data.int8 + y * kNumCols;
+        for (int x = 0; x < kNumCols; x++) {
+          dst[x] = static_cast<int8_t>(row[x] - 128);
+        }
+      } else {
+        memcpy(input->data.uint8 + y * kNumCols, row, kNumCols);
+      }
+    }
+    if (w->interpreter->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(&w->error_reporter, "Invoke failed on %s (%d, %d)",
+                           frame.path.c_str(), tile.x, tile.y);
+      return false;
+    }
+    (*scores_)[index] = Score(w->interpreter->output(0), kPersonIndex);
+    return true;
+  }
+
+  void WorkerLoop(int id, int num_workers) {
+    Worker* w = workers_[id].get();
+    int index;
+    while (!failed_) {
+      bool stolen = false;
+      bool found = w->queue.Pop(&index);
+      // Own queue empty, steal from the next workers in turn
+      for (int i = 1; !found && i < num_workers; i++) {
+        found = workers_[(id + i) % num_workers]->queue.Steal(&index);
+        stolen = found;
+      }
+      if (!found) {
+        // The tiles are all queued before the start, nothing else comes
+        return;
+      }
+      if (!RunTile(w, index)) {
+        failed_ = true;
+        return;
+      }
+      w->tiles_run++;
+      w->tiles_stolen += stolen ? 1 : 0;
+    }
+  }
+
+  const std::vector<Frame>& frames_;
+  const std::vector<Tile>& tiles_;
+  std::vector<int>* scores_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<bool> failed_;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int max_threads = kDefaultThreads;
+  int stride = kDefaultStride;
+  int downscale = 1;
+  int runs = 1;
+  bool verbose = false;
+  KernelSet kernels = kSimdKernels;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:s:d:r:k:v")) != -1) {
+    switch (opt) {
+      case 't':
+        max_threads = atoi(optarg);
+        break;
+      case 's':
+        stride = atoi(optarg);
+        break;
+      case 'd':
+        downscale = atoi(optarg);
+        break;
+      case 'r':
+        runs = atoi(optarg);
+        break;
+      case 'k':
+        if (!ParseKernelSet(optarg, &kernels)) {
+          fprintf(stderr, "Unknown kernel set %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: person_detect_batch [-t threads] [-s stride] "
+                "[-d downscale] [-r runs] [-k kernels] [-v] "
+                "<frame.pgm | dir> ...\n");
+        return 1;
+    }
+  }
+  max_threads = std::max(max_threads, 1);
+  stride = std::max(stride, 1);
+  downscale = std::max(downscale, 1);
+  runs = std::max(runs, 1);
+
+  // Frames and their tiles
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) {
+    CollectImages(argv[i], &files);
+  }
+  std::vector<Frame> frames;
+  for (const std::string& file : files) {
+    Frame f;
+    if (!ReadPgm(file, &f.width, &f.height, &f.pixels)) {
+      fprintf(stderr, "Skipped %s (not an 8 bit PGM)\n", file.c_str());
+      continue;
+    }
+    Downscale(&f, downscale);
+    if (f.width < kNumCols || f.height < kNumRows) {
+      fprintf(stderr, "Skipped %s (smaller than %dx%d)\n", file.c_str(),
+              kNumCols, kNumRows);
+      continue;
+    }
+    f.path = file;
+    frames.push_back(std::move(f));
+  }
+  if (frames.empty()) {
+    printf("No frames, screening a flat grey %dx%d frame\n", kGreyFrameWidth,
+           kGreyFrameHeight);
+    Frame f;
+    f.path = "grey";
+    f.width = kGreyFrameWidth;
+    f.height = kGreyFrameHeight;
+    f.pixels.assign(kGreyFrameWidth * kGreyFrameHeight, 128);
+    frames.push_back(std::move(f));
+  }
+  std::vector<Tile> tiles;
+  for (size_t i = 0; i < frames.size(); i++) {
+    Frame& f = frames[i];
+    f.first_tile = static_cast<int>(tiles.size());
+    for (int y : WindowOrigins(f.height, kNumRows, stride)) {
+      for (int x : WindowOrigins(f.width, kNumCols, stride)) {
+        tiles.push_back({static_cast<int>(i), x, y});
+      }
+    }
+    f.num_tiles = static_cast<int>(tiles.size()) - f.first_tile;
+  }
+
+  // Same setup of NanoramaCam.ino, the model and the resolver are shared
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         model->version(), TFLITE_SCHEMA_VERSION);
+    return 1;
+  }
+  static tflite::MicroOpResolver<3> micro_op_resolver;
+  if (kernels == kSimdKernels) {
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+        tflite::ops::micro::Register_DEPTHWISE_CONV_2D_SIMD());
+    micro_op_resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                                 tflite::ops::micro::Register_CONV_2D_SIMD());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_AVERAGE_POOL_2D,
+        tflite::ops::micro::Register_AVERAGE_POOL_2D_SIMD());
+  } else {
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+        tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_CONV_2D,
+        kernels == kGemmKernels ? tflite::ops::micro::Register_CONV_2D_GEMM()
+                                : tflite::ops::micro::Register_CONV_2D());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_AVERAGE_POOL_2D,
+        kernels == kGemmKernels
+            ? tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL()
+            : tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  }
+
+  std::vector<int> scores(tiles.size());
+  BatchRunner runner(frames, tiles, &scores);
+  if (!runner.Init(model, micro_op_resolver, max_threads)) {
+    return 1;
+  }
+
+  if (kernels == kSimdKernels) {
+    printf("Kernels: simd (%s)\n", tflite::simd_ops::BackendName());
+  } else {
+    printf("Kernels: %s\n", kernels == kGemmKernels ? "gemm" : "reference");
+  }
+  printf("Frames: %d, %d tiles (%dx%d windows, stride %d, downscale %d)\n",
+         static_cast<int>(frames.size()), static_cast<int>(tiles.size()),
+         kNumCols, kNumRows, stride, downscale);
+  printf("Cores online: %u\n", std::thread::hardware_concurrency());
+  printf("Threads  Tiles/s  Speedup  Stolen\n");
+
+  // The scores of one worker are the reference of the other counts
+  std::vector<int> first_scores;
+  double single_rate = 0;
+  bool consistent = true;
+  for (int n = 1; n <= max_threads; n++) {
+    int64_t elapsed_us = 0;
+    int stolen = 0;
+    for (int r = 0; r < runs; r++) {
+      const int64_t us = runner.Run(n);
+      if (us < 0) {
+        return 1;
+      }
+      elapsed_us += us;
+      for (int i = 0; i < n; i++) {
+        stolen += runner.worker(i).tiles_stolen;
+      }
+    }
+    const double rate =
+        elapsed_us > 0 ? 1e6 * tiles.size() * runs / elapsed_us : 0;
+    if (n == 1) {
+      single_rate = rate;
+      first_scores = scores;
+    } else if (scores != first_scores) {
+      consistent = false;
+    }
+    printf("%7d %8.1f %7.2fx %7d\n", n, rate,
+           single_rate > 0 ? rate / single_rate : 0, stolen / runs);
+  }
+  if (!consistent) {
+    printf("The scores differ between the thread counts\n");
+    return 1;
+  }
+
+  // Per frame aggregation
+  int detected = 0;
+  for (const Frame& f : frames) {
+    int best = f.first_tile;
+    int over = 0;
+    for (int t = f.first_tile; t < f.first_tile + f.num_tiles; t++) {
+      if (scores[t] > scores[best]) {
+        best = t;
+      }
+      over += scores[t] > kSketchThreshold ? 1 : 0;
+    }
+    detected += over > 0 ? 1 : 0;
+    if (verbose) {
+      printf("%s: %d tiles, max person %d at (%d, %d), %d over %d\n",
+             f.path.c_str(), f.num_tiles, scores[best], tiles[best].x,
+             tiles[best].y, over, kSketchThreshold);
+    }
+  }
+  printf("Frames with a person (score > %d): %d of %d\n", kSketchThreshold,
+         detected, static_cast<int>(frames.size()));
+  return 0;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file person_detect_bench.cpp
+ * @brief Host benchmark of the NanoramaCam person detection stack.
+ *
+ * Runs the same model, op resolver and tensor arena of NanoramaCam.ino on a
+ * corpus of 96x96 grey images and reports the latency of
+ * MicroInterpreter::Invoke() and the detection accuracy. This is the
+ * baseline the kernel optimizations are measured against.
+ *
+ * Usage: person_detect_bench [-r runs] [-w warmup] [-k kernels] [-m model]
+ *                            [-f | -F] [-d layers:rows] [-v] [-p]
+ *                            <image.pgm | dir> ...
+ *
+ * The images are binary PGM (P5) files, 96x96, 8 bit. The directories are
+ * scanned recursively for .pgm files. The expected result is taken from the
+ * path: a component containing "no_person" (or "noperson", "notperson")
+ * labels the image as no person, else a component containing "person"
+ * labels it as person. The other images are only timed.
+ * Without images a flat grey frame is timed.
+ * -k selects the kernel set registered in the op resolver: "reference" (the
+ * reference kernels, default), "gemm" (im2col + GEMM CONV_2D, the reciprocal
+ * AVERAGE_POOL_2D and the offline memory plan of person_detect_memory_plan.h,
+ * as in NanoramaCam.ino) or
+ * "simd" (the NEON/SSE4.1/AVX2 kernels of simd_ops.h, the backend built in
+ * is printed with the results).
+ * -m selects the model: "original" (person_detect_model_data, default) or
+ * "palette" (person_detect_palette_model_data, the CONV_2D filters
+ * palettized by person_detect_compress), only the gemm kernels decode the
+ * palettized filters. Compare the accuracy and the latency of the two.
+ * -f also registers the fused DEPTHWISE_CONV_2D/AVERAGE_POOL_2D + 1x1
+ * CONV_2D kernel (micro_fusion.h): the operator pairs that don't grow the
+ * arena are fused at AllocateTensors() and the activation size of the
+ * greedy planner (GetMaximumMemorySize()) is printed to compare with the
+ * unfused run. The offline plan doesn't apply to the fused graph. -F fuses
+ * every supported pair, to check the fused kernel with -v.
+ * -d runs the first layers of the model patch by patch, each patch
+ * computing the given output rows of the last one
+ * (MicroInterpreter::SetPatchExecution()). The arena is printed with the
+ * recompute of the halos, in MACs of the patched layers: compare the arena
+ * and the latency of a few settings, e.g. -d 4:4, -d 8:1, -d 8:2.
+ * Compare the -v output of two sets to check that they are bit-exact.
+ * With -p the MicroOpProfiler table of the timed inferences is dumped on
+ * stderr (time, MACs and arena high-water mark of every node).
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "model_settings.h"
+#include "person_detect_memory_plan.h"
+#include "person_detect_model_data.h"
+#include "person_detect_palette_model_data.h"
+#include "pgm_corpus.h"
+#include "tensorflow/lite/kernels/internal/optimized/simd_ops.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_profiler.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+// Fits every kernel set, the reference kernels need more than the 71 KB of
+// NanoramaCam.ino (kSketchArenaSize)
+constexpr int kTensorArenaSize = 89 * 1024;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+
+// Detection threshold used by NanoramaCam.ino
+constexpr int kSketchThreshold = 150;
+// Default number of untimed inferences before the measure
+constexpr int kDefaultWarmup = 3;
+
+struct Sample {
+  std::string path;
+  int label;
+  std::vector<uint8_t> pixels;
+};
+
+// Detection counters of one decision rule
+struct Confusion {
+  int tp = 0;
+  int fp = 0;
+  int tn = 0;
+  int fn = 0;
+
+  void Add(int label, bool detected) {
+    if (label == kPerson) {
+      detected ? tp++ : fn++;
+    } else {
+      detected ? fp++ : tn++;
+    }
+  }
+
+  void Print(const char* rule) const {
+    int total = tp + fp + tn + fn;
+    printf("Accuracy (%s): %.2f%% of %d images (TP %d FP %d TN %d FN %d)\n",
+           rule, total ? 100.0 * (tp + tn) / total : 0.0, total, tp, fp, tn,
+           fn);
+  }
+};
+
+// Copy the grey image in the input tensor (uint8 or int8 models)
+void SetInput(TfLiteTensor* input, const std::vector<uint8_t>& pixels) {
+  if (input->type == kTfLiteInt8) {
+    for (int i = 0; i < kMaxImageSize; i++) {
+      input->data.int8[i] = static_cast<int8_t>(pixels[i] - 128);
+    }
+  } else {
+    memcpy(input->data.uint8, pixels.data(), kMaxImageSize);
+  }
+}
+
+// Output score in the 0-255 range of the uint8 model
+int Score(const TfLiteTensor* output, int index) {
+  if (output->type == kTfLiteInt8) {
+    return output->data.int8[index] + 128;
+  }
+  return output->data.uint8[index];
+}
+
+// Kernel sets selectable with -k
+enum KernelSet { kReferenceKernels, kGemmKernels, kSimdKernels };
+
+bool ParseKernelSet(const char* name, KernelSet* set) {
+  if (strcmp(name, "reference") == 0) {
+    *set = kReferenceKernels;
+  } else if (strcmp(name, "gemm") == 0) {
+    *set = kGemmKernels;
+  } else if (strcmp(name, "simd") == 0) {
+    *set = kSimdKernels;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+double Percentile(const std::vector<int32_t>& sorted, double p) {
+  size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int runs = 1;
+  int warmup = kDefaultWarmup;
+  bool verbose = false;
+  bool profile = false;
+  bool fusion = false;
+  bool fusion_arena_guard = true;
+  int patch_layers = 0;
+  int patch_rows = 0;
+  KernelSet kernels = kReferenceKernels;
+  bool palette = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:w:k:m:fFd:vp")) != -1) {
+    switch (opt) {
+      case 'r':
+        runs = atoi(optarg);
+        break;
+      case 'w':
+        warmup = atoi(optarg);
+        break;
+      case 'k':
+        if (!ParseKernelSet(optarg, &kernels)) {
+          fprintf(stderr, "Unknown kernel set %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'm':
+        if (strcmp(optarg, "palette") == 0) {
+          palette = true;
+        } else if (strcmp(optarg, "original") != 0) {
+          fprintf(stderr, "Unknown model %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'f':
+        fusion = true;
+        break;
+      case 'F':
+        fusion = true;
+        fusion_arena_guard = false;
+        break;
+      case 'd':
+        if (sscanf(optarg, "%d:%d", &patch_layers, &patch_rows) != 2 ||
+            patch_layers < 1 || patch_rows < 1) {
+          fprintf(stderr, "Bad patch setting %s, layers:rows\n", optarg);
+          return 1;
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'p':
+        profile = true;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: person_detect_bench [-r runs] [-w warmup] [-k kernels] "
+                "[-m model] [-f | -F] [-d layers:rows] [-v] [-p] "
+                "<image.pgm | dir> ...\n");
+        return 1;
+    }
+  }
+  if (palette && kernels != kGemmKernels) {
+    fprintf(stderr, "The palettized model needs the gemm kernels (-k gemm)\n");
+    return 1;
+  }
+  if (runs < 1) {
+    runs = 1;
+  }
+
+  // Corpus
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) {
+    CollectImages(argv[i], &files);
+  }
+  std::vector<Sample> samples;
+  for (const std::string& file : files) {
+    Sample s;
+    if (!ReadModelPgm(file, &s.pixels)) {
+      fprintf(stderr, "Skipped %s (not a %dx%d 8 bit PGM)\n", file.c_str(),
+              kNumCols, kNumRows);
+      continue;
+    }
+    s.path = file;
+    s.label = LabelFromPath(file);
+    samples.push_back(s);
+  }
+  if (samples.empty()) {
+    printf("No images, timing a flat grey frame\n");
+    samples.push_back({"grey", kUnlabeled,
+                       std::vector<uint8_t>(kMaxImageSize, 128)});
+  }
+
+  // Same setup of NanoramaCam.ino
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  const tflite::Model* model =
+      tflite::GetModel(palette ? g_person_detect_palette_model_data
+                               : g_person_detect_model_data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         model->version(), TFLITE_SCHEMA_VERSION);
+    return 1;
+  }
+  static tflite::MicroOpResolver<5> micro_op_resolver;
+  if (kernels == kSimdKernels) {
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+        tflite::ops::micro::Register_DEPTHWISE_CONV_2D_SIMD());
+    micro_op_resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                                 tflite::ops::micro::Register_CONV_2D_SIMD());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_AVERAGE_POOL_2D,
+        tflite::ops::micro::Register_AVERAGE_POOL_2D_SIMD());
+  } else {
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+        tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_CONV_2D,
+        kernels == kGemmKernels ? tflite::ops::micro::Register_CONV_2D_GEMM()
+                                : tflite::ops::micro::Register_CONV_2D());
+    micro_op_resolver.AddBuiltin(
+        tflite::BuiltinOperator_AVERAGE_POOL_2D,
+        kernels == kGemmKernels
+            ? tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL()
+            : tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  }
+  if (fusion) {
+    micro_op_resolver.AddCustom(tflite::kFusedConv2dOpName,
+                                tflite::ops::micro::Register_FUSED_CONV_2D());
+  }
+  if (patch_layers > 0) {
+    micro_op_resolver.AddCustom(
+        tflite::kPatchedLayersOpName,
+        tflite::ops::micro::Register_PATCHED_LAYERS());
+  }
+  static tflite::MicroOpProfiler profiler;
+  static tflite::MicroInterpreter interpreter(
+      model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter,
+      profile ? &profiler : nullptr);
+  // The plan is computed for the sketch kernels
+  static tflite::PrecomputedMemoryPlanner memory_planner(
+      g_person_detect_memory_plan, g_person_detect_memory_plan_len);
+  const bool unchanged_graph = !fusion && patch_layers == 0;
+  if (kernels == kGemmKernels && unchanged_graph) {
+    interpreter.SetMemoryPlanner(&memory_planner);
+  }
+  interpreter.SetPatchExecution(patch_layers, patch_rows);
+  interpreter.SetFusionArenaGuard(fusion_arena_guard);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return 1;
+  }
+  TfLiteTensor* input = interpreter.input(0);
+  TfLiteTensor* output = interpreter.output(0);
+
+  for (int i = 0; i < warmup; i++) {
+    SetInput(input, samples[0].pixels);
+    interpreter.Invoke();
+  }
+  profiler.Reset();
+
+  std::vector<int32_t> latencies;
+  Confusion argmax;
+  Confusion sketch;
+  const double ticks_us = 1e6 / tflite::ticks_per_second();
+
+  for (const Sample& s : samples) {
+    int person = 0;
+    int no_person = 0;
+    for (int r = 0; r < runs; r++) {
+      SetInput(input, s.pixels);
+      int32_t start = tflite::GetCurrentTimeTicks();
+      if (interpreter.Invoke() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed on %s",
+                             s.path.c_str());
+        return 1;
+      }
+      // Tick difference, safe across the counter wrap
+      latencies.push_back(static_cast<int32_t>(
+          (static_cast<uint32_t>(tflite::GetCurrentTimeTicks()) -
+           static_cast<uint32_t>(start)) * ticks_us));
+      person = Score(output, kPersonIndex);
+      no_person = Score(output, kNotAPersonIndex);
+    }
+    if (s.label != kUnlabeled) {
+      argmax.Add(s.label, person > no_person);
+      sketch.Add(s.label, person > kSketchThreshold);
+    }
+    if (verbose) {
+      printf("%s person %d no person %d%s\n", s.path.c_str(), person,
+             no_person,
+             s.label == kUnlabeled
+                 ? ""
+                 : ((person > no_person) == (s.label == kPerson) ? " ok"
+                                                                  : " WRONG"));
+    }
+  }
+
+  std::vector<int32_t> sorted = latencies;
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0;
+  for (int32_t l : sorted) {
+    sum += l;
+  }
+  double mean = sum / sorted.size();
+
+  if (kernels == kSimdKernels) {
+    printf("Kernels: simd (%s)\n", tflite::simd_ops::BackendName());
+  } else if (kernels == kGemmKernels) {
+    printf("Kernels: gemm%s\n",
+           unchanged_graph ? " (offline memory plan)" : "");
+  } else {
+    printf("Kernels: reference\n");
+  }
+  if (fusion) {
+    printf("Fusion: %d operator pairs fused\n", interpreter.fused_operators());
+  }
+  if (patch_layers > 0) {
+    const tflite::PatchExecutionInfo& patches = interpreter.patch_execution();
+    printf("Patches: %d layers, %d patches of %d rows, buffers %d bytes, "
+           "recompute +%.1f%% MACs (%d of %d)\n",
+           patches.layers, patches.patches, patches.patch_rows,
+           static_cast<int>(patches.buffer_bytes),
+           100.0 * (patches.patch_macs - patches.layer_macs) /
+               patches.layer_macs,
+           static_cast<int>(patches.patch_macs),
+           static_cast<int>(patches.layer_macs));
+  }
+  printf("Model: %s %d bytes, %d operators, arena used %d of %d bytes\n",
+         palette ? "palette" : "original",
+         palette ? g_person_detect_palette_model_data_len
+                 : g_person_detect_model_data_len,
+         static_cast<int>(interpreter.operators_size()),
+         static_cast<int>(interpreter.arena_used_bytes()), kTensorArenaSize);
+  printf("Requantization tables: %d operators\n",
+         interpreter.requantization_tables());
+  printf("Activations: %d bytes planned\n",
+         static_cast<int>(interpreter.arena_planned_bytes()));
+  printf("Inferences: %d (%d images x %d runs, %d warmup)\n",
+         static_cast<int>(latencies.size()), static_cast<int>(samples.size()),
+         runs, warmup);
+  printf("Latency us: mean %.0f min %d p50 %.0f p90 %.0f p99 %.0f max %d\n",
+         mean, sorted.front(), Percentile(sorted, 0.5),
+         Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted.back());
+  printf("Throughput: %.2f inferences/s\n", mean > 0 ? 1e6 / mean : 0.0);
+  if (argmax.tp + argmax.fp + argmax.tn + argmax.fn > 0) {
+    argmax.Print("person > no person");
+    sketch.Print("person > 150, NanoramaCam.ino");
+  }
+  if (profile) {
+    fflush(stdout);
+    profiler.Log(error_reporter);
+  }
+  return 0;
+}
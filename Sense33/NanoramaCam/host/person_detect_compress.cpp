@@ -0,0 +1,492 @@
+/**
+ * @file person_detect_compress.cpp
+ * @brief Palettizes the CONV_2D filters of the person detection model.
+ *
+ * Replaces every CONV_2D filter of the model with the 4-bit palette format
+ * of palette_weights.h: each output channel keeps a codebook of 16 filter
+ * values and every filter value becomes a 4-bit index in it, the pointwise
+ * filters take about half of their size. The im2col + GEMM CONV_2D (and the
+ * fused and patched kernels sharing its GEMM) decode the filters a few
+ * channels at a time during the inference, the other kernel sets can't run
+ * the palettized model.
+ *
+ * The codebook of a channel is the optimal 1D clustering of its values in
+ * 16 groups (least squared error, dynamic programming on the value
+ * histogram) with the centers rounded to the quantized type. A channel of
+ * at most 16 distinct values is lossless. The filters the palette doesn't
+ * shrink (depth up to 32) and the DEPTHWISE_CONV_2D ones are left raw: a
+ * 3x3 channel has 9 values, less than its codebook. The requantization
+ * tables of the model metadata (requantization_tables.h) are computed again
+ * on the palettized filters.
+ *
+ * Usage: person_detect_compress [-x] [-o dir]
+ *
+ * The size and the RMS error (in quantized steps) of every filter are
+ * printed. -x checks the kernels: the palettized model on the gemm kernels
+ * (also fused and patched) must give the same outputs of the reference
+ * kernels on the decoded model, random frames. -o writes
+ * person_detect_palette_model_data.h and .cpp in dir, the sketch folder is
+ * "..". The accuracy is measured by person_detect_bench -m palette.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "person_detect_model_data.h"
+#include "requantization_tables.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/conv_gemm.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/palette_weights.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_fusion.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+namespace palette = tflite::ops::micro::palette_weights;
+
+// Arena of the -x check, larger than the one of NanoramaCam.ino: the
+// persistent data of the fused graph grows with the 64-bit pointers
+constexpr int kTensorArenaSize = 128 * 1024;
+alignas(16) uint8_t reference_arena[kTensorArenaSize];
+alignas(16) uint8_t palette_arena[kTensorArenaSize];
+
+// Random frames of the -x check
+constexpr int kCheckFrames = 8;
+// Patch setting of the -x check
+constexpr int kCheckPatchLayers = 4;
+constexpr int kCheckPatchRows = 4;
+
+// Values of a filter channel as unsigned bins, int8 filters are offset
+// by 128
+constexpr int kBins = 256;
+
+struct Palettized {
+  int tensor;
+  int output_depth;
+  int depth;
+  size_t raw_bytes;
+  size_t palette_bytes;
+  double rms_error;
+  int lossless_channels;
+};
+
+// Squared error of the bins [a, b] around their rounded mean, from the
+// prefix sums of count, count * v and count * v * v
+double SegmentCost(const std::vector<double>& s0, const std::vector<double>& s1,
+                   const std::vector<double>& s2, int a, int b, int* center) {
+  const double n = s0[b + 1] - s0[a];
+  const double sum = s1[b + 1] - s1[a];
+  const double sum2 = s2[b + 1] - s2[a];
+  if (n == 0) {
+    *center = a;
+    return 0;
+  }
+  const int c = static_cast<int>(std::floor(sum / n + 0.5));
+  *center = c;
+  return sum2 - 2.0 * c * sum + static_cast<double>(c) * c * n;
+}
+
+// Codebook (bins) of the values of a channel and the index of every bin
+void Cluster(const int* values, int depth, uint8_t* codebook,
+             uint8_t* bin_index) {
+  std::vector<double> count(kBins, 0);
+  for (int k = 0; k < depth; k++) {
+    count[values[k]] += 1;
+  }
+  // Distinct values, the bins of the dynamic programming
+  std::vector<int> bins;
+  for (int v = 0; v < kBins; v++) {
+    if (count[v] > 0) {
+      bins.push_back(v);
+    }
+  }
+  const int n = static_cast<int>(bins.size());
+  std::vector<double> s0(n + 1, 0), s1(n + 1, 0), s2(n + 1, 0);
+  for (int i = 0; i < n; i++) {
+    const double c = count[bins[i]];
+    s0[i + 1] = s0[i] + c;
+    s1[i + 1] = s1[i] + c * bins[i];
+    s2[i + 1] = s2[i] + c * bins[i] * bins[i];
+  }
+  const int groups = std::min(n, palette::kCodebookSize);
+  // cost[g][i]: best error of the first i bins in g groups
+  const double kInf = 1e300;
+  std::vector<std::vector<double>> cost(
+      groups + 1, std::vector<double>(n + 1, kInf));
+  std::vector<std::vector<int>> split(groups + 1, std::vector<int>(n + 1, 0));
+  cost[0][0] = 0;
+  for (int g = 1; g <= groups; g++) {
+    for (int i = g; i <= n; i++) {
+      for (int j = g - 1; j < i; j++) {
+        if (cost[g - 1][j] >= kInf) {
+          continue;
+        }
+        int center;
+        const double c = cost[g - 1][j] +
+                         SegmentCost(s0, s1, s2, j, i - 1, &center);
+        if (c < cost[g][i]) {
+          cost[g][i] = c;
+          split[g][i] = j;
+        }
+      }
+    }
+  }
+  memset(codebook, 0, palette::kCodebookSize);
+  int end = n;
+  for (int g = groups; g > 0; g--) {
+    const int begin = split[g][end];
+    int center;
+    SegmentCost(s0, s1, s2, begin, end - 1, &center);
+    codebook[g - 1] = static_cast<uint8_t>(center);
+    for (int i = begin; i < end; i++) {
+      bin_index[bins[i]] = static_cast<uint8_t>(g - 1);
+    }
+    end = begin;
+  }
+}
+
+// Palettizes the filter of a CONV_2D in its buffer, unless the codebooks
+// take more than the indices save or the depth is over the GEMM limit
+bool PalettizeFilter(tflite::ModelT* model, int tensor_index,
+                     Palettized* result) {
+  tflite::SubGraphT& subgraph = *model->subgraphs[0];
+  const tflite::TensorT& tensor = *subgraph.tensors[tensor_index];
+  const bool is_int8 = tensor.type == tflite::TensorType_INT8;
+  if ((tensor.type != tflite::TensorType_UINT8 && !is_int8) ||
+      tensor.shape.size() != 4) {
+    return false;
+  }
+  std::vector<uint8_t>& data = model->buffers[tensor.buffer]->data;
+  const int output_depth = tensor.shape[0];
+  const int depth = tensor.shape[1] * tensor.shape[2] * tensor.shape[3];
+  if (static_cast<int>(data.size()) != output_depth * depth ||
+      palette::FilterBytes(output_depth, depth) >= data.size() ||
+      output_depth > 0xffff ||
+      depth > tflite::ops::micro::conv_gemm::kPaletteMaxDepth) {
+    return false;
+  }
+  const int offset = is_int8 ? 128 : 0;
+  const int row_bytes = palette::RowBytes(depth);
+  std::vector<uint8_t> packed(palette::FilterBytes(output_depth, depth), 0);
+  memcpy(packed.data(), palette::kMagic, 4);
+  packed[4] = output_depth & 0xff;
+  packed[5] = output_depth >> 8;
+  packed[6] = depth & 0xff;
+  packed[7] = depth >> 8;
+  uint8_t* codebooks = packed.data() + palette::kHeaderBytes;
+  uint8_t* indices = codebooks + output_depth * palette::kCodebookSize;
+
+  double squared_error = 0;
+  int lossless = 0;
+  std::vector<int> values(depth);
+  uint8_t bin_index[kBins];
+  for (int oc = 0; oc < output_depth; oc++) {
+    for (int k = 0; k < depth; k++) {
+      const uint8_t raw = data[oc * depth + k];
+      values[k] = is_int8 ? static_cast<int8_t>(raw) + offset : raw;
+    }
+    uint8_t* codebook = codebooks + oc * palette::kCodebookSize;
+    Cluster(values.data(), depth, codebook, bin_index);
+    double channel_error = 0;
+    for (int k = 0; k < depth; k++) {
+      const uint8_t index = bin_index[values[k]];
+      const double d = codebook[index] - values[k];
+      channel_error += d * d;
+      indices[oc * row_bytes + k / 2] |= index << (k % 2 ? 4 : 0);
+    }
+    if (channel_error == 0) {
+      lossless++;
+    }
+    squared_error += channel_error;
+    // The codebook holds the values of the tensor type
+    for (int i = 0; i < palette::kCodebookSize; i++) {
+      codebook[i] = static_cast<uint8_t>(codebook[i] - offset);
+    }
+  }
+  result->tensor = tensor_index;
+  result->output_depth = output_depth;
+  result->depth = depth;
+  result->raw_bytes = data.size();
+  result->palette_bytes = packed.size();
+  result->rms_error = std::sqrt(squared_error / (output_depth * depth));
+  result->lossless_channels = lossless;
+  data = packed;
+  return true;
+}
+
+// Raw filter of a palettized buffer, undoes PalettizeFilter() with the
+// rounding of the codebooks
+void DecodeFilter(const Palettized& p, std::vector<uint8_t>* data) {
+  const uint8_t* codebooks =
+      palette::Parse(data->data(), p.output_depth, p.depth);
+  std::vector<uint8_t> raw(p.output_depth * p.depth);
+  for (int oc = 0; oc < p.output_depth; oc++) {
+    palette::DecodeRow<uint8_t>(codebooks, p.output_depth, p.depth, oc,
+                                &raw[oc * p.depth]);
+  }
+  *data = raw;
+}
+
+std::vector<uint8_t> PackModel(const tflite::ModelT& model) {
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(builder, tflite::Model::Pack(builder, &model));
+  return std::vector<uint8_t>(builder.GetBufferPointer(),
+                              builder.GetBufferPointer() + builder.GetSize());
+}
+
+std::unique_ptr<tflite::MicroInterpreter> Allocate(
+    const uint8_t* model_data, const tflite::OpResolver& resolver,
+    uint8_t* arena, tflite::ErrorReporter* error_reporter, int patch_layers,
+    bool fusion_arena_guard) {
+  std::unique_ptr<tflite::MicroInterpreter> interpreter(
+      new tflite::MicroInterpreter(tflite::GetModel(model_data), resolver,
+                                   arena, kTensorArenaSize, error_reporter));
+  interpreter->SetPatchExecution(patch_layers, kCheckPatchRows);
+  interpreter->SetFusionArenaGuard(fusion_arena_guard);
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    interpreter.reset();
+  }
+  return interpreter;
+}
+
+// Frames whose outputs differ between the palettized model on the gemm
+// kernels and the decoded model on the reference kernels, -1 on errors
+int CheckKernels(const std::vector<uint8_t>& palette_model,
+                 const std::vector<uint8_t>& decoded_model, bool fusion,
+                 int patch_layers, tflite::ErrorReporter* error_reporter) {
+  tflite::MicroOpResolver<3> reference_resolver;
+  reference_resolver.AddBuiltin(
+      tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+      tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  reference_resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                                tflite::ops::micro::Register_CONV_2D());
+  reference_resolver.AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                                tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  tflite::MicroOpResolver<5> gemm_resolver;
+  gemm_resolver.AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                           tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  gemm_resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                           tflite::ops::micro::Register_CONV_2D_GEMM());
+  gemm_resolver.AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                           tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  if (fusion) {
+    gemm_resolver.AddCustom(tflite::kFusedConv2dOpName,
+                            tflite::ops::micro::Register_FUSED_CONV_2D());
+  }
+  if (patch_layers > 0) {
+    gemm_resolver.AddCustom(tflite::kPatchedLayersOpName,
+                            tflite::ops::micro::Register_PATCHED_LAYERS());
+  }
+  std::unique_ptr<tflite::MicroInterpreter> reference =
+      Allocate(decoded_model.data(), reference_resolver, reference_arena,
+               error_reporter, 0, true);
+  // Every supported pair is fused to check the fused kernel
+  std::unique_ptr<tflite::MicroInterpreter> palettized =
+      Allocate(palette_model.data(), gemm_resolver, palette_arena,
+               error_reporter, patch_layers, !fusion);
+  if (!reference || !palettized) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return -1;
+  }
+  TfLiteTensor* reference_input = reference->input(0);
+  TfLiteTensor* palette_input = palettized->input(0);
+  srand(1);
+  int mismatches = 0;
+  for (int frame = 0; frame < kCheckFrames; frame++) {
+    for (size_t i = 0; i < reference_input->bytes; i++) {
+      // A flat frame first, then noise
+      const uint8_t pixel = frame == 0 ? 128 : static_cast<uint8_t>(rand());
+      reference_input->data.uint8[i] = pixel;
+      palette_input->data.uint8[i] = pixel;
+    }
+    if (reference->Invoke() != kTfLiteOk ||
+        palettized->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+      return -1;
+    }
+    if (memcmp(reference->output(0)->data.uint8,
+               palettized->output(0)->data.uint8,
+               reference->output(0)->bytes) != 0) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+bool WriteModel(const std::string& dir, const std::vector<uint8_t>& model) {
+  const std::string header = dir + "/person_detect_palette_model_data.h";
+  const std::string source = dir + "/person_detect_palette_model_data.cpp";
+  FILE* f = fopen(header.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "/* Person detection model with the CONV_2D filters palettized to 4 "
+          "bits\n(palette_weights.h), only the gemm kernels of the "
+          "NanoramaCam.ino op\nresolver can run it. It was created using the "
+          "command:\nhost/person_detect_compress -o ..\nRun it again after "
+          "changing person_detect_model_data. E.M.\n*/\n\n"
+          "#ifndef NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_\n"
+          "#define NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_\n\n"
+          "extern const unsigned char g_person_detect_palette_model_data[];\n"
+          "extern const int g_person_detect_palette_model_data_len;\n\n"
+          "#endif  // NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_\n");
+  fclose(f);
+
+  f = fopen(source.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "/* Generated by host/person_detect_compress, don't edit. E.M. */"
+          "\n\n#include \"person_detect_palette_model_data.h\"\n\n"
+          "// The flatbuffer is read in place, keep it aligned\n"
+          "alignas(16) const unsigned char "
+          "g_person_detect_palette_model_data[] = {\n");
+  for (size_t i = 0; i < model.size(); i++) {
+    fprintf(f, "%s0x%02x,%s", i % 12 == 0 ? "  " : " ", model[i],
+            i % 12 == 11 || i + 1 == model.size() ? "\n" : "");
+  }
+  fprintf(f,
+          "};\nconst int g_person_detect_palette_model_data_len = %d;\n",
+          static_cast<int>(model.size()));
+  fclose(f);
+  printf("Wrote %s and %s\n", header.c_str(), source.c_str());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool check = false;
+  const char* out_dir = nullptr;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "xo:")) != -1) {
+    switch (opt) {
+      case 'x':
+        check = true;
+        break;
+      case 'o':
+        out_dir = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: person_detect_compress [-x] [-o dir]\n");
+        return 1;
+    }
+  }
+
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  const tflite::Model* source = tflite::GetModel(g_person_detect_model_data);
+  if (source->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         source->version(), TFLITE_SCHEMA_VERSION);
+    return 1;
+  }
+  std::unique_ptr<tflite::ModelT> model(source->UnPack());
+  if (model->subgraphs.size() != 1) {
+    fprintf(stderr, "Only single subgraph models are supported\n");
+    return 1;
+  }
+
+  // Every CONV_2D filter, once even if shared
+  std::vector<Palettized> filters;
+  std::vector<bool> done(model->buffers.size(), false);
+  for (const std::unique_ptr<tflite::OperatorT>& op :
+       model->subgraphs[0]->operators) {
+    const tflite::BuiltinOperator code =
+        model->operator_codes[op->opcode_index]->builtin_code;
+    if (code != tflite::BuiltinOperator_CONV_2D || op->inputs.size() < 2) {
+      continue;
+    }
+    const int tensor = op->inputs[1];
+    const uint32_t buffer = model->subgraphs[0]->tensors[tensor]->buffer;
+    if (done[buffer]) {
+      continue;
+    }
+    Palettized p;
+    if (PalettizeFilter(model.get(), tensor, &p)) {
+      filters.push_back(p);
+      done[buffer] = true;
+    }
+  }
+
+  size_t raw_bytes = 0;
+  size_t palette_bytes = 0;
+  printf("Filter                                  shape      raw    palette"
+         "  RMS  lossless\n");
+  for (const Palettized& p : filters) {
+    const std::string& name = model->subgraphs[0]->tensors[p.tensor]->name;
+    printf("%-38.38s %4dx%-4d %6d %6d %6.3f %4d/%d\n", name.c_str(),
+           p.output_depth, p.depth, static_cast<int>(p.raw_bytes),
+           static_cast<int>(p.palette_bytes), p.rms_error,
+           p.lossless_channels, p.output_depth);
+    raw_bytes += p.raw_bytes;
+    palette_bytes += p.palette_bytes;
+  }
+  // The accumulator offsets of the GEMM fold the decoded filters
+  RequantizationTablesInfo tables;
+  std::string error;
+  if (!BakeRequantizationTables(model.get(), &tables, &error)) {
+    fprintf(stderr, "Can't compute the requantization tables: %s\n",
+            error.c_str());
+    return 1;
+  }
+  const std::vector<uint8_t> palette_model = PackModel(*model);
+  printf("Filters: %d CONV_2D, %d -> %d bytes\n",
+         static_cast<int>(filters.size()), static_cast<int>(raw_bytes),
+         static_cast<int>(palette_bytes));
+  printf("Model: %d -> %d bytes\n", g_person_detect_model_data_len,
+         static_cast<int>(palette_model.size()));
+  printf("Requantization tables: %d operators, %d bytes\n", tables.tables,
+         tables.bytes);
+
+  if (check) {
+    for (Palettized& p : filters) {
+      const uint32_t buffer = model->subgraphs[0]->tensors[p.tensor]->buffer;
+      DecodeFilter(p, &model->buffers[buffer]->data);
+    }
+    const std::vector<uint8_t> decoded_model = PackModel(*model);
+    const char* names[] = {"gemm", "gemm fused", "gemm patched"};
+    int failed = 0;
+    for (int run = 0; run < 3; run++) {
+      const int mismatches = CheckKernels(
+          palette_model, decoded_model, run == 1,
+          run == 2 ? kCheckPatchLayers : 0, error_reporter);
+      if (mismatches < 0) {
+        return 1;
+      }
+      printf("Check (%s): %d of %d frames differ from the reference kernels "
+             "on the decoded model\n",
+             names[run], mismatches, kCheckFrames);
+      failed += mismatches;
+    }
+    if (failed > 0) {
+      return 1;
+    }
+  }
+  if (out_dir != nullptr && !WriteModel(out_dir, palette_model)) {
+    fprintf(stderr, "Can't write the model in %s\n", out_dir);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,564 @@
+/**
+ * @file person_detect_plan.cpp
+ * @brief Offline memory plan compiler of the person detection model.
+ *
+ * Records the activation and scratch buffers the MicroAllocator plans for
+ * the model and a kernel set, searches their arena layout and writes it as
+ * the person_detect_memory_plan table of the sketch, replayed on the target
+ * by the PrecomputedMemoryPlanner instead of running the greedy planner at
+ * every startup.
+ *
+ * The search is a branch and bound over the placement of the buffers,
+ * largest first, at the offsets touching the buffers already placed that
+ * live at the same time. It starts from the greedy layout and stops at the
+ * lower bound (the largest sum of the buffers live at the same node) or
+ * after max_nodes placements.
+ *
+ * The plan is checked on the interpreter: the arena used, the smallest arena
+ * AllocateTensors() accepts, the startup time and the outputs on random
+ * frames are compared against the greedy planner.
+ *
+ * Usage: person_detect_plan [-k kernels] [-n max_nodes] [-r runs] [-o dir]
+ *
+ * -k selects the kernel set as person_detect_bench: "reference", "gemm"
+ * (default, the op resolver of NanoramaCam.ino) or "simd". The scratch
+ * buffers depend on the kernels, a plan only fits its own set.
+ * -n limits the search (default 1000000 placements). -r is the number of
+ * AllocateTensors() timed (default 100). -o writes
+ * person_detect_memory_plan.h and .cpp in dir, the sketch folder is "..".
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model_settings.h"
+#include "person_detect_model_data.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "tensorflow/lite/micro/memory_planner/precomputed_memory_planner.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+// Fits every kernel set, the smallest arena of the plan is printed
+constexpr int kTensorArenaSize = 89 * 1024;
+// Upper end of the search of the smallest arena
+constexpr int kMaxArenaSize = 256 * 1024;
+alignas(16) uint8_t greedy_arena[kMaxArenaSize];
+alignas(16) uint8_t plan_arena[kMaxArenaSize];
+
+constexpr int kDefaultMaxNodes = 1000000;
+constexpr int kDefaultRuns = 100;
+// Random frames run through both layouts
+constexpr int kCheckFrames = 8;
+// Each buffer takes about 36 bytes of greedy planner scratch
+constexpr int kGreedyScratchSize = 64 * 1024;
+
+// Kernel sets selectable with -k
+enum KernelSet { kReferenceKernels, kGemmKernels, kSimdKernels };
+
+bool ParseKernelSet(const char* name, KernelSet* set) {
+  if (strcmp(name, "reference") == 0) {
+    *set = kReferenceKernels;
+  } else if (strcmp(name, "gemm") == 0) {
+    *set = kGemmKernels;
+  } else if (strcmp(name, "simd") == 0) {
+    *set = kSimdKernels;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* KernelSetName(KernelSet set) {
+  return set == kSimdKernels ? "simd"
+                             : (set == kGemmKernels ? "gemm" : "reference");
+}
+
+void AddKernels(KernelSet kernels, tflite::MicroOpResolver<3>* resolver) {
+  if (kernels == kSimdKernels) {
+    resolver->AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                         tflite::ops::micro::Register_DEPTHWISE_CONV_2D_SIMD());
+    resolver->AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                         tflite::ops::micro::Register_CONV_2D_SIMD());
+    resolver->AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                         tflite::ops::micro::Register_AVERAGE_POOL_2D_SIMD());
+  } else {
+    resolver->AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                         tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+    resolver->AddBuiltin(
+        tflite::BuiltinOperator_CONV_2D,
+        kernels == kGemmKernels ? tflite::ops::micro::Register_CONV_2D_GEMM()
+                                : tflite::ops::micro::Register_CONV_2D());
+    resolver->AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                         tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  }
+}
+
+// Drops the errors of the arena size search
+class SilentErrorReporter : public tflite::ErrorReporter {
+ public:
+  int Report(const char* format, va_list args) override { return 0; }
+};
+
+struct Buffer {
+  int size;
+  int first;
+  int last;
+};
+
+bool LiveTogether(const Buffer& a, const Buffer& b) {
+  return a.first <= b.last && b.first <= a.last;
+}
+
+// Records the buffers of the allocator and lays them out with the greedy
+// planner, so the interpreter still runs
+class RecordingMemoryPlanner : public tflite::MemoryPlanner {
+ public:
+  RecordingMemoryPlanner()
+      : scratch_(kGreedyScratchSize),
+        greedy_(scratch_.data(), kGreedyScratchSize) {}
+
+  TfLiteStatus AddBuffer(tflite::ErrorReporter* error_reporter, int size,
+                         int first_time_used, int last_time_used) override {
+    buffers_.push_back({size, first_time_used, last_time_used});
+    return greedy_.AddBuffer(error_reporter, size, first_time_used,
+                             last_time_used);
+  }
+  size_t GetMaximumMemorySize() override {
+    return greedy_.GetMaximumMemorySize();
+  }
+  int GetBufferCount() override { return greedy_.GetBufferCount(); }
+  TfLiteStatus GetOffsetForBuffer(tflite::ErrorReporter* error_reporter,
+                                  int buffer_index, int* offset) override {
+    return greedy_.GetOffsetForBuffer(error_reporter, buffer_index, offset);
+  }
+
+  const std::vector<Buffer>& buffers() const { return buffers_; }
+
+ private:
+  std::vector<unsigned char> scratch_;
+  tflite::GreedyMemoryPlanner greedy_;
+  std::vector<Buffer> buffers_;
+};
+
+// Largest sum of the buffers live at the same node, no layout is smaller
+int LowerBound(const std::vector<Buffer>& buffers, int* node) {
+  int last_node = 0;
+  for (const Buffer& b : buffers) {
+    last_node = std::max(last_node, b.last);
+  }
+  int bound = 0;
+  *node = 0;
+  for (int t = 0; t <= last_node; t++) {
+    int live = 0;
+    for (const Buffer& b : buffers) {
+      if (b.first <= t && t <= b.last) {
+        live += b.size;
+      }
+    }
+    if (live > bound) {
+      bound = live;
+      *node = t;
+    }
+  }
+  return bound;
+}
+
+int LayoutSize(const std::vector<Buffer>& buffers,
+               const std::vector<int>& offsets) {
+  int size = 0;
+  for (size_t i = 0; i < buffers.size(); i++) {
+    size = std::max(size, offsets[i] + buffers[i].size);
+  }
+  return size;
+}
+
+bool LayoutOverlaps(const std::vector<Buffer>& buffers,
+                    const std::vector<int>& offsets) {
+  for (size_t i = 0; i < buffers.size(); i++) {
+    for (size_t j = i + 1; j < buffers.size(); j++) {
+      if (LiveTogether(buffers[i], buffers[j]) &&
+          offsets[i] < offsets[j] + buffers[j].size &&
+          offsets[j] < offsets[i] + buffers[i].size) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Branch and bound over the placement of the buffers
+class LayoutSearch {
+ public:
+  LayoutSearch(const std::vector<Buffer>& buffers, int lower_bound,
+               long max_nodes)
+      : buffers_(buffers),
+        lower_bound_(lower_bound),
+        max_nodes_(max_nodes),
+        offsets_(buffers.size(), -1) {
+    for (size_t i = 0; i < buffers.size(); i++) {
+      order_.push_back(static_cast<int>(i));
+    }
+    std::stable_sort(order_.begin(), order_.end(), [&](int a, int b) {
+      const Buffer& x = buffers_[a];
+      const Buffer& y = buffers_[b];
+      if (x.size != y.size) {
+        return x.size > y.size;
+      }
+      return x.last - x.first > y.last - y.first;
+    });
+  }
+
+  // Improves the layout given, returns its size
+  int Run(std::vector<int>* best) {
+    best_ = *best;
+    best_size_ = LayoutSize(buffers_, best_);
+    nodes_ = 0;
+    if (best_size_ > lower_bound_) {
+      Place(0, 0);
+    }
+    *best = best_;
+    return best_size_;
+  }
+
+  long nodes() const { return nodes_; }
+  bool exhausted() const { return nodes_ >= max_nodes_; }
+
+ private:
+  void Place(size_t k, int size) {
+    if (k == order_.size()) {
+      best_ = offsets_;
+      best_size_ = size;
+      return;
+    }
+    const int index = order_[k];
+    const Buffer& buffer = buffers_[index];
+    // Candidate offsets: the arena start and the end of the buffers placed
+    // that live at the same time
+    std::vector<int> candidates(1, 0);
+    for (size_t i = 0; i < k; i++) {
+      const int other = order_[i];
+      if (LiveTogether(buffer, buffers_[other])) {
+        candidates.push_back(offsets_[other] + buffers_[other].size);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    for (int offset : candidates) {
+      // The candidates are sorted, the next ones are only larger
+      if (offset + buffer.size >= best_size_ || nodes_ >= max_nodes_ ||
+          best_size_ == lower_bound_) {
+        return;
+      }
+      bool fits = true;
+      for (size_t i = 0; i < k && fits; i++) {
+        const int other = order_[i];
+        fits = !LiveTogether(buffer, buffers_[other]) ||
+               offset >= offsets_[other] + buffers_[other].size ||
+               offsets_[other] >= offset + buffer.size;
+      }
+      if (!fits) {
+        continue;
+      }
+      nodes_++;
+      offsets_[index] = offset;
+      Place(k + 1, std::max(size, offset + buffer.size));
+    }
+    offsets_[index] = -1;
+  }
+
+  const std::vector<Buffer>& buffers_;
+  const int lower_bound_;
+  const long max_nodes_;
+  std::vector<int> order_;
+  std::vector<int> offsets_;
+  std::vector<int> best_;
+  int best_size_ = 0;
+  long nodes_ = 0;
+};
+
+// Builds an interpreter in the arena and times AllocateTensors()
+std::unique_ptr<tflite::MicroInterpreter> Allocate(
+    const tflite::Model* model, const tflite::OpResolver& resolver,
+    uint8_t* arena, int arena_size, tflite::ErrorReporter* error_reporter,
+    tflite::MemoryPlanner* planner, uint32_t* us) {
+  std::unique_ptr<tflite::MicroInterpreter> interpreter(
+      new tflite::MicroInterpreter(model, resolver, arena, arena_size,
+                                   error_reporter));
+  interpreter->SetMemoryPlanner(planner);
+  const uint32_t start = tflite::GetCurrentTimeTicks();
+  const TfLiteStatus status = interpreter->AllocateTensors();
+  if (us != nullptr) {
+    *us = tflite::GetCurrentTimeTicks() - start;
+  }
+  if (status != kTfLiteOk) {
+    interpreter.reset();
+  }
+  return interpreter;
+}
+
+// Allocates the model with the plan, or the greedy planner if null
+bool AllocateWithPlan(const tflite::Model* model,
+                      const tflite::OpResolver& resolver, int arena_size,
+                      tflite::ErrorReporter* error_reporter,
+                      const std::vector<tflite::PlannedBuffer>* plan,
+                      uint32_t* us) {
+  tflite::PrecomputedMemoryPlanner precomputed(
+      plan != nullptr ? plan->data() : nullptr,
+      plan != nullptr ? static_cast<int>(plan->size()) : 0);
+  return Allocate(model, resolver, plan_arena, arena_size, error_reporter,
+                  plan != nullptr ? &precomputed : nullptr,
+                  us) != nullptr;
+}
+
+// Smallest arena where AllocateTensors() succeeds, 0 if none
+int MinArenaSize(const tflite::Model* model,
+                 const tflite::OpResolver& resolver,
+                 const std::vector<tflite::PlannedBuffer>* plan) {
+  SilentErrorReporter silent;
+  int low = 0;
+  int high = kMaxArenaSize;
+  while (low < high) {
+    const int size = (low + high) / 2;
+    if (AllocateWithPlan(model, resolver, size, &silent, plan, nullptr)) {
+      high = size;
+    } else {
+      low = size + 1;
+    }
+  }
+  return low < kMaxArenaSize ? low : 0;
+}
+
+uint32_t MeanAllocateUs(const tflite::Model* model,
+                        const tflite::OpResolver& resolver,
+                        tflite::ErrorReporter* error_reporter,
+                        const std::vector<tflite::PlannedBuffer>* plan,
+                        int runs) {
+  uint64_t total = 0;
+  for (int r = 0; r < runs; r++) {
+    uint32_t us = 0;
+    if (!AllocateWithPlan(model, resolver, kTensorArenaSize, error_reporter,
+                          plan, &us)) {
+      return 0;
+    }
+    total += us;
+  }
+  return static_cast<uint32_t>(total / runs);
+}
+
+bool WritePlan(const std::string& dir, KernelSet kernels,
+               const std::vector<tflite::PlannedBuffer>& plan,
+               int activation_size) {
+  const std::string header = dir + "/person_detect_memory_plan.h";
+  const std::string source = dir + "/person_detect_memory_plan.cpp";
+  FILE* f = fopen(header.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "/* Arena layout of the person detection model, computed offline\n"
+          "for the %s kernels of the NanoramaCam.ino op resolver and replayed "
+          "by the\nPrecomputedMemoryPlanner. It was created using the "
+          "command:\nhost/person_detect_plan -k %s -o ..\nRun it again after "
+          "changing the model or the kernels. E.M.\n*/\n\n"
+          "#ifndef NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_\n"
+          "#define NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_\n\n"
+          "#include \"tensorflow/lite/micro/memory_planner/"
+          "precomputed_memory_planner.h\"\n\n"
+          "// Activation and scratch buffers in the AddBuffer() order, "
+          "%d bytes of arena\n"
+          "extern const tflite::PlannedBuffer g_person_detect_memory_plan[];\n"
+          "extern const int g_person_detect_memory_plan_len;\n\n"
+          "#endif  // NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_\n",
+          KernelSetName(kernels), KernelSetName(kernels), activation_size);
+  fclose(f);
+
+  f = fopen(source.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "/* Generated by host/person_detect_plan -k %s, don't edit. E.M. "
+          "*/\n\n#include \"person_detect_memory_plan.h\"\n\n"
+          "// size, first node, last node, offset\n"
+          "const tflite::PlannedBuffer g_person_detect_memory_plan[] = {\n",
+          KernelSetName(kernels));
+  for (const tflite::PlannedBuffer& b : plan) {
+    fprintf(f, "    {%d, %d, %d, %d},\n", b.size, b.first_time_used,
+            b.last_time_used, b.offset);
+  }
+  fprintf(f,
+          "};\n\nconst int g_person_detect_memory_plan_len =\n"
+          "    sizeof(g_person_detect_memory_plan) /\n"
+          "    sizeof(g_person_detect_memory_plan[0]);\n");
+  fclose(f);
+  printf("Wrote %s and %s\n", header.c_str(), source.c_str());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  KernelSet kernels = kGemmKernels;
+  long max_nodes = kDefaultMaxNodes;
+  int runs = kDefaultRuns;
+  const char* out_dir = nullptr;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "k:n:r:o:")) != -1) {
+    switch (opt) {
+      case 'k':
+        if (!ParseKernelSet(optarg, &kernels)) {
+          fprintf(stderr, "Unknown kernel set %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'n':
+        max_nodes = std::max(atol(optarg), 1L);
+        break;
+      case 'r':
+        runs = std::max(atoi(optarg), 1);
+        break;
+      case 'o':
+        out_dir = optarg;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: person_detect_plan [-k kernels] [-n max_nodes] "
+                "[-r runs] [-o dir]\n");
+        return 1;
+    }
+  }
+
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         model->version(), TFLITE_SCHEMA_VERSION);
+    return 1;
+  }
+  static tflite::MicroOpResolver<3> resolver;
+  AddKernels(kernels, &resolver);
+
+  // Buffers and greedy layout of the allocator
+  RecordingMemoryPlanner recorder;
+  std::unique_ptr<tflite::MicroInterpreter> greedy =
+      Allocate(model, resolver, greedy_arena, kTensorArenaSize,
+               error_reporter, &recorder, nullptr);
+  if (!greedy) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return 1;
+  }
+  const std::vector<Buffer>& buffers = recorder.buffers();
+  std::vector<int> offsets(buffers.size());
+  for (size_t i = 0; i < buffers.size(); i++) {
+    recorder.GetOffsetForBuffer(error_reporter, static_cast<int>(i),
+                                &offsets[i]);
+  }
+  const int greedy_size = LayoutSize(buffers, offsets);
+  int bound_node = 0;
+  const int lower_bound = LowerBound(buffers, &bound_node);
+
+  LayoutSearch search(buffers, lower_bound, max_nodes);
+  const uint32_t start = tflite::GetCurrentTimeTicks();
+  const int plan_size = search.Run(&offsets);
+  const uint32_t search_us = tflite::GetCurrentTimeTicks() - start;
+  if (LayoutOverlaps(buffers, offsets)) {
+    fprintf(stderr, "The searched layout has overlapping buffers\n");
+    return 1;
+  }
+  std::vector<tflite::PlannedBuffer> plan;
+  for (size_t i = 0; i < buffers.size(); i++) {
+    plan.push_back(
+        {buffers[i].size, buffers[i].first, buffers[i].last, offsets[i]});
+  }
+
+  printf("Kernels: %s\n", KernelSetName(kernels));
+  printf("Buffers: %d, lower bound %d bytes (node %d)\n",
+         static_cast<int>(buffers.size()), lower_bound, bound_node);
+  printf("Layout: greedy %d bytes, searched %d bytes (%ld placements, "
+         "%.1f ms%s)\n",
+         greedy_size, plan_size, search.nodes(), search_us / 1000.0,
+         plan_size == lower_bound
+             ? ", optimal"
+             : (search.exhausted() ? ", stopped at -n" : ", best found"));
+
+  // Same model on the plan
+  tflite::PrecomputedMemoryPlanner precomputed(plan.data(),
+                                               static_cast<int>(plan.size()));
+  std::unique_ptr<tflite::MicroInterpreter> planned =
+      Allocate(model, resolver, plan_arena, kTensorArenaSize, error_reporter,
+               &precomputed, nullptr);
+  if (!planned) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed on the plan");
+    return 1;
+  }
+  printf("Arena used: greedy %d, plan %d bytes of %d\n",
+         static_cast<int>(greedy->arena_used_bytes()),
+         static_cast<int>(planned->arena_used_bytes()), kTensorArenaSize);
+
+  // Both layouts must give the same scores
+  TfLiteTensor* greedy_input = greedy->input(0);
+  TfLiteTensor* plan_input = planned->input(0);
+  TfLiteTensor* greedy_output = greedy->output(0);
+  TfLiteTensor* plan_output = planned->output(0);
+  srand(1);
+  int mismatches = 0;
+  for (int frame = 0; frame < kCheckFrames; frame++) {
+    for (size_t i = 0; i < greedy_input->bytes; i++) {
+      // A flat frame first, then noise
+      const uint8_t pixel = frame == 0 ? 128 : static_cast<uint8_t>(rand());
+      greedy_input->data.uint8[i] = pixel;
+      plan_input->data.uint8[i] = pixel;
+    }
+    if (greedy->Invoke() != kTfLiteOk || planned->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+      return 1;
+    }
+    if (memcmp(greedy_output->data.uint8, plan_output->data.uint8,
+               greedy_output->bytes) != 0) {
+      mismatches++;
+    }
+  }
+  printf("Outputs: %d of %d frames differ\n", mismatches, kCheckFrames);
+  greedy.reset();
+  planned.reset();
+
+  printf("Min arena: greedy %d, plan %d bytes\n",
+         MinArenaSize(model, resolver, nullptr),
+         MinArenaSize(model, resolver, &plan));
+  printf("AllocateTensors() us: greedy %u, plan %u (mean of %d)\n",
+         MeanAllocateUs(model, resolver, error_reporter, nullptr, runs),
+         MeanAllocateUs(model, resolver, error_reporter, &plan, runs), runs);
+
+  if (mismatches > 0) {
+    return 1;
+  }
+  if (out_dir != nullptr && !WritePlan(out_dir, kernels, plan, plan_size)) {
+    fprintf(stderr, "Can't write the plan in %s\n", out_dir);
+    return 1;
+  }
+  return 0;
+}
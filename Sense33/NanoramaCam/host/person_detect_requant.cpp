@@ -0,0 +1,283 @@
+/**
+ * @file person_detect_requant.cpp
+ * @brief Bakes the requantization tables into the person detection model.
+ *
+ * The CONV_2D and DEPTHWISE_CONV_2D kernels compute their output
+ * multipliers and shifts with the floating point QuantizeMultiplier() of
+ * every channel: the GEMM CONV_2D once at startup, keeping them with the
+ * accumulator offsets in the arena, the depthwise kernel at every Eval. This
+ * tool stores the values in the model metadata (requantization_tables.h),
+ * the kernels read them from the flash.
+ *
+ * Usage: person_detect_requant [-x] [-r runs] [-o dir]
+ *
+ * The size of the tables is printed. -x compares the model without and with
+ * the tables on the gemm kernels of NanoramaCam.ino: the outputs on random
+ * frames must be the same, the arena used, the AllocateTensors() time and
+ * the Invoke() time (mean of -r runs, default 100) are printed. -o writes
+ * person_detect_model_data.h and .cpp in dir, the sketch folder is "..";
+ * run person_detect_compress -o .. after it for the palettized model.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "person_detect_model_data.h"
+#include "requantization_tables.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+// Fits the gemm kernels on a model without the requantization tables
+constexpr int kTensorArenaSize = 89 * 1024;
+alignas(16) uint8_t plain_arena[kTensorArenaSize];
+alignas(16) uint8_t tables_arena[kTensorArenaSize];
+
+constexpr int kDefaultRuns = 100;
+// Random frames of the -x check
+constexpr int kCheckFrames = 8;
+
+std::vector<uint8_t> PackModel(const tflite::ModelT& model) {
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(builder, tflite::Model::Pack(builder, &model));
+  return std::vector<uint8_t>(builder.GetBufferPointer(),
+                              builder.GetBufferPointer() + builder.GetSize());
+}
+
+// Model without the tables, the kernels compute the values
+std::vector<uint8_t> StripTables(tflite::ModelT* model) {
+  std::vector<uint8_t> tables;
+  for (const std::unique_ptr<tflite::MetadataT>& metadata : model->metadata) {
+    if (metadata->name == tflite::kRequantizationMetadataName) {
+      tables.swap(model->buffers[metadata->buffer]->data);
+      std::vector<uint8_t> plain = PackModel(*model);
+      tables.swap(model->buffers[metadata->buffer]->data);
+      return plain;
+    }
+  }
+  return PackModel(*model);
+}
+
+struct Timing {
+  uint32_t allocate_us;
+  uint32_t invoke_us;
+};
+
+std::unique_ptr<tflite::MicroInterpreter> Allocate(
+    const uint8_t* model_data, const tflite::OpResolver& resolver,
+    uint8_t* arena, tflite::ErrorReporter* error_reporter, Timing* timing) {
+  std::unique_ptr<tflite::MicroInterpreter> interpreter(
+      new tflite::MicroInterpreter(tflite::GetModel(model_data), resolver,
+                                   arena, kTensorArenaSize, error_reporter));
+  const uint32_t start = tflite::GetCurrentTimeTicks();
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    interpreter.reset();
+  }
+  timing->allocate_us = tflite::GetCurrentTimeTicks() - start;
+  return interpreter;
+}
+
+uint32_t MeanInvokeUs(tflite::MicroInterpreter* interpreter, int runs) {
+  uint32_t total = 0;
+  for (int r = 0; r < runs; r++) {
+    const uint32_t start = tflite::GetCurrentTimeTicks();
+    interpreter->Invoke();
+    total += tflite::GetCurrentTimeTicks() - start;
+  }
+  return total / runs;
+}
+
+// Same outputs with and without the tables, false on errors or mismatches
+bool CheckTables(const std::vector<uint8_t>& plain_model,
+                 const std::vector<uint8_t>& tables_model, int runs,
+                 tflite::ErrorReporter* error_reporter) {
+  tflite::MicroOpResolver<3> resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                      tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                      tflite::ops::micro::Register_CONV_2D_GEMM());
+  resolver.AddBuiltin(tflite::BuiltinOperator_AVERAGE_POOL_2D,
+                      tflite::ops::micro::Register_AVERAGE_POOL_2D());
+  Timing plain_timing;
+  Timing tables_timing;
+  std::unique_ptr<tflite::MicroInterpreter> plain = Allocate(
+      plain_model.data(), resolver, plain_arena, error_reporter, &plain_timing);
+  std::unique_ptr<tflite::MicroInterpreter> tables =
+      Allocate(tables_model.data(), resolver, tables_arena, error_reporter,
+               &tables_timing);
+  if (!plain || !tables) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return false;
+  }
+  TfLiteTensor* plain_input = plain->input(0);
+  TfLiteTensor* tables_input = tables->input(0);
+  srand(1);
+  int mismatches = 0;
+  for (int frame = 0; frame < kCheckFrames; frame++) {
+    for (size_t i = 0; i < plain_input->bytes; i++) {
+      // A flat frame first, then noise
+      const uint8_t pixel = frame == 0 ? 128 : static_cast<uint8_t>(rand());
+      plain_input->data.uint8[i] = pixel;
+      tables_input->data.uint8[i] = pixel;
+    }
+    if (plain->Invoke() != kTfLiteOk || tables->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+      return false;
+    }
+    if (memcmp(plain->output(0)->data.uint8, tables->output(0)->data.uint8,
+               plain->output(0)->bytes) != 0) {
+      mismatches++;
+    }
+  }
+  printf("Tables attached: %d nodes\n", tables->requantization_tables());
+  printf("Outputs: %d of %d frames differ\n", mismatches, kCheckFrames);
+  printf("Arena used: computed %d, tables %d bytes of %d\n",
+         static_cast<int>(plain->arena_used_bytes()),
+         static_cast<int>(tables->arena_used_bytes()), kTensorArenaSize);
+  printf("AllocateTensors() us: computed %u, tables %u\n",
+         plain_timing.allocate_us, tables_timing.allocate_us);
+  printf("Invoke() us: computed %u, tables %u (mean of %d)\n",
+         MeanInvokeUs(plain.get(), runs), MeanInvokeUs(tables.get(), runs),
+         runs);
+  return mismatches == 0;
+}
+
+bool WriteModel(const std::string& dir, const std::vector<uint8_t>& model) {
+  const std::string header = dir + "/person_detect_model_data.h";
+  const std::string source = dir + "/person_detect_model_data.cpp";
+  const char* license =
+      "/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.\n\n"
+      "Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+      "you may not use this file except in compliance with the License.\n"
+      "You may obtain a copy of the License at\n\n"
+      "    http://www.apache.org/licenses/LICENSE-2.0\n\n"
+      "Unless required by applicable law or agreed to in writing, software\n"
+      "distributed under the License is distributed on an \"AS IS\" BASIS,\n"
+      "WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or "
+      "implied.\nSee the License for the specific language governing "
+      "permissions and\nlimitations under the License.\n"
+      "============================================================="
+      "=================*/\n\n";
+  FILE* f = fopen(header.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "%s// This is a standard TensorFlow Lite model file that has been "
+          "converted into a\n// C data array, so it can be easily compiled "
+          "into a binary for devices that\n// don't have a file system. The "
+          "metadata holds the requantization tables of\n// the convolutions "
+          "(micro_requantization.h). It was created using the commands:\n"
+          "// xxd -i person_detect.tflite > person_detect_model_data.cc\n"
+          "// host/person_detect_requant -o ..\n\n"
+          "#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PERSON_"
+          "DETECT_MODEL_DATA_H_\n"
+          "#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PERSON_"
+          "DETECT_MODEL_DATA_H_\n\n"
+          "extern const unsigned char g_person_detect_model_data[];\n"
+          "extern const int g_person_detect_model_data_len;\n\n"
+          "#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PERSON_"
+          "DETECT_MODEL_DATA_H_\n",
+          license);
+  fclose(f);
+
+  f = fopen(source.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f,
+          "%s// Generated by host/person_detect_requant, don't edit. E.M.\n\n"
+          "#include \"person_detect_model_data.h\"\n\n"
+          "// The flatbuffer and the tables are read in place, keep them "
+          "aligned\nalignas(16) const unsigned char "
+          "g_person_detect_model_data[] = {\n",
+          license);
+  for (size_t i = 0; i < model.size(); i++) {
+    fprintf(f, "%s0x%02x,%s", i % 12 == 0 ? "  " : " ", model[i],
+            i % 12 == 11 || i + 1 == model.size() ? "\n" : "");
+  }
+  fprintf(f, "};\nconst int g_person_detect_model_data_len = %d;\n",
+          static_cast<int>(model.size()));
+  fclose(f);
+  printf("Wrote %s and %s\n", header.c_str(), source.c_str());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool check = false;
+  int runs = kDefaultRuns;
+  const char* out_dir = nullptr;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "xr:o:")) != -1) {
+    switch (opt) {
+      case 'x':
+        check = true;
+        break;
+      case 'r':
+        runs = std::max(atoi(optarg), 1);
+        break;
+      case 'o':
+        out_dir = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: person_detect_requant [-x] [-r runs] "
+                        "[-o dir]\n");
+        return 1;
+    }
+  }
+
+  static tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  const tflite::Model* source = tflite::GetModel(g_person_detect_model_data);
+  if (source->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         source->version(), TFLITE_SCHEMA_VERSION);
+    return 1;
+  }
+  std::unique_ptr<tflite::ModelT> model(source->UnPack());
+  RequantizationTablesInfo info;
+  std::string error;
+  if (!BakeRequantizationTables(model.get(), &info, &error)) {
+    fprintf(stderr, "Can't compute the tables: %s\n", error.c_str());
+    return 1;
+  }
+  const std::vector<uint8_t> tables_model = PackModel(*model);
+  printf("Tables: %d operators, %d bytes of metadata\n", info.tables,
+         info.bytes);
+  printf("Model: %d -> %d bytes\n", g_person_detect_model_data_len,
+         static_cast<int>(tables_model.size()));
+
+  if (check &&
+      !CheckTables(StripTables(model.get()), tables_model, runs,
+                   error_reporter)) {
+    return 1;
+  }
+  if (out_dir != nullptr && !WriteModel(out_dir, tables_model)) {
+    fprintf(stderr, "Can't write the model in %s\n", out_dir);
+    return 1;
+  }
+  return 0;
+}
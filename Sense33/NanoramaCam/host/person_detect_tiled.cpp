@@ -0,0 +1,246 @@
+/**
+ * @file person_detect_tiled.cpp
+ * @brief Frame rate of the tiled pyramid person detector (tiled_detector.h)
+ * at several camera resolutions.
+ *
+ * Every frame is scaled to each of the resolutions and run through the
+ * detector; the frames/s, the windows of the pyramid, the share rejected by
+ * the contrast test and the detections after the suppression are reported
+ * per resolution.
+ *
+ * Usage: person_detect_tiled [-R WxH,...] [-s stride] [-c contrast]
+ *                            [-l layers] [-m max_width] [-n iou]
+ *                            [-r runs] [-x] [-v] <frame.pgm | dir> ...
+ *
+ * The frames are binary PGM (P5), 8 bit, of any size. The directories are
+ * scanned recursively. Without frames a flat grey frame is used.
+ * -R lists the resolutions (default 160x120,320x240,640x480,1280x960).
+ * -s is the step between the windows of a level (default 48). -c is the
+ * min standard deviation of a window (default 10, 0 runs every window).
+ * -l is the max number of layers shared by the windows (default 3, 0
+ * disables the sharing). -m halves the frames wider than max_width before
+ * the pyramid (default 640, 0 never). -n is the max overlap of two
+ * detections (default 0.3). -r repeats every frame (default 1). -x runs the
+ * full model on the shared windows too and fails on a score mismatch.
+ * -v prints the detections of every frame.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "pgm_corpus.h"
+#include "tiled_detector.h"
+
+namespace {
+
+constexpr char kDefaultResolutions[] = "160x120,320x240,640x480,1280x960";
+// Frame used when no frame is given
+constexpr int kGreyFrameWidth = 640;
+constexpr int kGreyFrameHeight = 480;
+
+struct Frame {
+  std::string path;
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;
+};
+
+struct Resolution {
+  int width;
+  int height;
+};
+
+bool ParseResolutions(const char* list, std::vector<Resolution>* out) {
+  out->clear();
+  const char* p = list;
+  while (*p != '\0') {
+    Resolution r;
+    int used = 0;
+    if (sscanf(p, "%dx%d%n", &r.width, &r.height, &used) != 2 ||
+        r.width <= 0 || r.height <= 0) {
+      return false;
+    }
+    out->push_back(r);
+    p += used;
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0') {
+      return false;
+    }
+  }
+  return !out->empty();
+}
+
+// Bilinear scaling of a frame to the camera resolution under test
+void ScaleFrame(const Frame& src, int width, int height,
+                std::vector<uint8_t>* dst) {
+  dst->resize(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; y++) {
+    const float fy =
+        std::max((y + 0.5f) * src.height / height - 0.5f, 0.0f);
+    const int y0 = std::min(static_cast<int>(fy), src.height - 1);
+    const int y1 = std::min(y0 + 1, src.height - 1);
+    const float wy = fy - y0;
+    for (int x = 0; x < width; x++) {
+      const float fx = std::max((x + 0.5f) * src.width / width - 0.5f, 0.0f);
+      const int x0 = std::min(static_cast<int>(fx), src.width - 1);
+      const int x1 = std::min(x0 + 1, src.width - 1);
+      const float wx = fx - x0;
+      const uint8_t* r0 = src.pixels.data() + y0 * src.width;
+      const uint8_t* r1 = src.pixels.data() + y1 * src.width;
+      const float v = (r0[x0] * (1 - wx) + r0[x1] * wx) * (1 - wy) +
+                      (r1[x0] * (1 - wx) + r1[x1] * wx) * wy;
+      (*dst)[y * width + x] = static_cast<uint8_t>(v + 0.5f);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  TiledDetectorConfig config;
+  std::vector<Resolution> resolutions;
+  ParseResolutions(kDefaultResolutions, &resolutions);
+  int runs = 1;
+  bool verbose = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "R:s:c:l:m:n:r:xv")) != -1) {
+    switch (opt) {
+      case 'R':
+        if (!ParseResolutions(optarg, &resolutions)) {
+          fprintf(stderr, "Bad resolution list %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 's':
+        config.window_stride = std::max(atoi(optarg), 1);
+        break;
+      case 'c':
+        config.min_contrast = std::max(atoi(optarg), 0);
+        break;
+      case 'l':
+        config.max_shared_layers = std::max(atoi(optarg), 0);
+        break;
+      case 'm':
+        config.max_width = std::max(atoi(optarg), 0);
+        break;
+      case 'n':
+        config.nms_iou = static_cast<float>(atof(optarg));
+        break;
+      case 'r':
+        runs = std::max(atoi(optarg), 1);
+        break;
+      case 'x':
+        config.verify_sharing = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: person_detect_tiled [-R WxH,...] [-s stride] "
+                "[-c contrast] [-l layers] [-m max_width] [-n iou] "
+                "[-r runs] [-x] [-v] <frame.pgm | dir> ...\n");
+        return 1;
+    }
+  }
+
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) {
+    CollectImages(argv[i], &files);
+  }
+  std::vector<Frame> frames;
+  for (const std::string& file : files) {
+    Frame f;
+    if (!ReadPgm(file, &f.width, &f.height, &f.pixels)) {
+      fprintf(stderr, "Skipped %s (not an 8 bit PGM)\n", file.c_str());
+      continue;
+    }
+    f.path = file;
+    frames.push_back(std::move(f));
+  }
+  if (frames.empty()) {
+    printf("No frames, using a flat grey %dx%d frame\n", kGreyFrameWidth,
+           kGreyFrameHeight);
+    Frame f;
+    f.path = "grey";
+    f.width = kGreyFrameWidth;
+    f.height = kGreyFrameHeight;
+    f.pixels.assign(kGreyFrameWidth * kGreyFrameHeight, 128);
+    frames.push_back(std::move(f));
+  }
+
+  TiledDetector detector(config);
+  if (!detector.Init()) {
+    return 1;
+  }
+  printf("Frames: %d, window stride %d, min contrast %d, max width %d\n",
+         static_cast<int>(frames.size()), config.window_stride,
+         config.min_contrast, config.max_width);
+  printf("Resolution  Levels  Windows  Rejected  Shared  Frames/s  "
+         "Detections\n");
+
+  int mismatches = 0;
+  std::vector<uint8_t> pixels;
+  std::vector<Detection> detections;
+  for (const Resolution& r : resolutions) {
+    if (r.width < 96 || r.height < 96) {
+      fprintf(stderr, "Skipped %dx%d (smaller than the window)\n", r.width,
+              r.height);
+      continue;
+    }
+    int64_t elapsed_us = 0;
+    int64_t windows = 0, rejected = 0, found = 0;
+    int levels = 0, shared = 0;
+    for (const Frame& f : frames) {
+      ScaleFrame(f, r.width, r.height, &pixels);
+      for (int run = 0; run < runs; run++) {
+        if (!detector.Detect(pixels.data(), r.width, r.height,
+                             &detections)) {
+          return 1;
+        }
+        const TiledDetectorStats& stats = detector.stats();
+        elapsed_us += stats.total_us;
+        windows += stats.windows;
+        rejected += stats.rejected;
+        mismatches += stats.mismatches;
+        levels = stats.levels;
+        shared = stats.shared_layers;
+      }
+      found += detections.size();
+      if (verbose) {
+        printf("%s %dx%d: %d windows, %d rejected, %.1f ms:",
+               f.path.c_str(), r.width, r.height, detector.stats().windows,
+               detector.stats().rejected, detector.stats().total_us / 1000.0);
+        for (const Detection& d : detections) {
+          printf(" [%d,%d %d score %d]", d.x, d.y, d.size, d.score);
+        }
+        printf("\n");
+      }
+    }
+    const int64_t count = static_cast<int64_t>(frames.size()) * runs;
+    printf("%4dx%-5d %7d %8.1f %8.1f%% %7d %9.2f %11.2f\n", r.width,
+           r.height, levels, static_cast<double>(windows) / count,
+           windows > 0 ? 100.0 * rejected / windows : 0.0, shared,
+           elapsed_us > 0 ? 1e6 * count / elapsed_us : 0.0,
+           static_cast<double>(found) / frames.size());
+  }
+  if (config.verify_sharing) {
+    printf("Shared layer mismatches: %d\n", mismatches);
+    if (mismatches > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
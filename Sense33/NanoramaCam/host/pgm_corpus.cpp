@@ -0,0 +1,155 @@
+/**
+ * @file pgm_corpus.cpp
+ * @brief Image corpus and sketch model setup shared by the host tools.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include "pgm_corpus.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#include "model_settings.h"
+#include "person_detect_model_data.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+alignas(16) uint8_t tensor_arena[kSketchArenaSize];
+
+// Skip the blanks and the comments of the PGM header
+void SkipPgmBlanks(FILE* f) {
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    if (c == '#') {
+      while ((c = fgetc(f)) != EOF && c != '\n') {
+      }
+    } else if (!isspace(c)) {
+      ungetc(c, f);
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+bool ReadPgm(const std::string& path, int* width, int* height,
+             std::vector<uint8_t>* pixels) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  int w = 0, h = 0, maxval = 0;
+  bool ok = fgetc(f) == 'P' && fgetc(f) == '5';
+  if (ok) {
+    SkipPgmBlanks(f);
+    ok = fscanf(f, "%d", &w) == 1;
+    SkipPgmBlanks(f);
+    ok = ok && fscanf(f, "%d", &h) == 1;
+    SkipPgmBlanks(f);
+    ok = ok && fscanf(f, "%d", &maxval) == 1;
+    // A single blank separates the header from the pixels
+    ok = ok && fgetc(f) != EOF;
+  }
+  ok = ok && w > 0 && h > 0 && maxval == 255;
+  if (ok) {
+    const size_t size = static_cast<size_t>(w) * h;
+    pixels->resize(size);
+    ok = fread(pixels->data(), 1, size, f) == size;
+    *width = w;
+    *height = h;
+  }
+  fclose(f);
+  return ok;
+}
+
+bool ReadModelPgm(const std::string& path, std::vector<uint8_t>* pixels) {
+  int width, height;
+  return ReadPgm(path, &width, &height, pixels) && width == kNumCols &&
+         height == kNumRows;
+}
+
+void CollectImages(const std::string& path, std::vector<std::string>* files) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    fprintf(stderr, "Can't read %s\n", path.c_str());
+    return;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    files->push_back(path);
+    return;
+  }
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  std::vector<std::string> entries;
+  while (struct dirent* e = readdir(dir)) {
+    std::string name = e->d_name;
+    if (name != "." && name != "..") {
+      entries.push_back(path + "/" + name);
+    }
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end());
+  for (const std::string& entry : entries) {
+    if (stat(entry.c_str(), &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode) ||
+        (entry.size() > 4 && entry.compare(entry.size() - 4, 4, ".pgm") == 0)) {
+      CollectImages(entry, files);
+    }
+  }
+}
+
+int LabelFromPath(const std::string& path) {
+  std::string p = path;
+  std::transform(p.begin(), p.end(), p.begin(), ::tolower);
+  if (p.find("no_person") != std::string::npos ||
+      p.find("noperson") != std::string::npos ||
+      p.find("notperson") != std::string::npos) {
+    return kNoPerson;
+  }
+  if (p.find("person") != std::string::npos) {
+    return kPerson;
+  }
+  return kUnlabeled;
+}
+
+tflite::MicroInterpreter* NewSketchInterpreter(
+    tflite::ErrorReporter* error_reporter) {
+  const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         model->version(), TFLITE_SCHEMA_VERSION);
+    return nullptr;
+  }
+  static tflite::MicroOpResolver<3> resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                      tflite::ops::micro::Register_DEPTHWISE_CONV_2D());
+  resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                      tflite::ops::micro::Register_CONV_2D_GEMM());
+  resolver.AddBuiltin(
+      tflite::BuiltinOperator_AVERAGE_POOL_2D,
+      tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL());
+  static tflite::MicroInterpreter interpreter(
+      model, resolver, tensor_arena, kSketchArenaSize, error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return nullptr;
+  }
+  return &interpreter;
+}
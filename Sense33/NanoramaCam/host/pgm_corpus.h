@@ -0,0 +1,64 @@
+/**
+ * @file pgm_corpus.h
+ * @brief Image corpus and sketch model setup shared by the host tools.
+ *
+ * The corpus is a list of 8 bit P5 PGM files and directories, scanned
+ * recursively in name order. The label of an image comes from its path:
+ * a component containing "no_person" (or "noperson", "notperson") labels
+ * it as no person, else a component containing "person" labels it as
+ * person.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#ifndef PGM_CORPUS_H
+#define PGM_CORPUS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+//! Labels of LabelFromPath()
+constexpr int kUnlabeled = -1;
+constexpr int kNoPerson = 0;
+constexpr int kPerson = 1;
+
+//! Arena of NanoramaCam.ino
+constexpr int kSketchArenaSize = 71 * 1024;
+
+/**
+ * Reads an 8 bit P5 PGM of any size.
+ * @return false if the file can't be read or is not one
+ */
+bool ReadPgm(const std::string& path, int* width, int* height,
+             std::vector<uint8_t>* pixels);
+
+/**
+ * Reads a kNumCols x kNumRows 8 bit P5 PGM, the model input.
+ * @return false if the file can't be read or is not one
+ */
+bool ReadModelPgm(const std::string& path, std::vector<uint8_t>* pixels);
+
+/**
+ * Appends the file, or the .pgm files of the directory and its
+ * subdirectories in name order, to files.
+ */
+void CollectImages(const std::string& path, std::vector<std::string>* files);
+
+//! kPerson, kNoPerson or kUnlabeled from the path of an image
+int LabelFromPath(const std::string& path);
+
+/**
+ * The person detection model on the op resolver and the arena size of
+ * NanoramaCam.ino, the greedy planner in place of the offline plan. The
+ * tensors are allocated. A single interpreter per process.
+ * @return nullptr on errors, reported on error_reporter
+ */
+tflite::MicroInterpreter* NewSketchInterpreter(
+    tflite::ErrorReporter* error_reporter);
+
+#endif  // PGM_CORPUS_H
@@ -0,0 +1,202 @@
+/**
+ * @file requantization_tables.cpp
+ * @brief Offline requantization tables of the model metadata.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include "requantization_tables.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/all_ops_resolver.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/conv_gemm.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
+
+namespace {
+
+// Any model of the sketch fits, nothing is invoked
+constexpr int kArenaSize = 256 * 1024;
+alignas(16) uint8_t arena[kArenaSize];
+
+// Persistent buffers of the kernel code, freed by the next bake
+std::vector<std::unique_ptr<uint8_t[]>> persistent_buffers;
+
+TfLiteStatus AllocatePersistentBuffer(TfLiteContext* context, size_t bytes,
+                                      void** ptr) {
+  persistent_buffers.emplace_back(new uint8_t[bytes]);
+  *ptr = persistent_buffers.back().get();
+  return kTfLiteOk;
+}
+
+void ReportError(TfLiteContext* context, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void AppendInt32(std::vector<uint8_t>* data, int32_t value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  data->insert(data->end(), bytes, bytes + sizeof(value));
+}
+
+void AppendTable(std::vector<uint8_t>* data,
+                 const tflite::TfLiteRequantizationTable& table,
+                 const int32_t* multipliers, const int32_t* shifts,
+                 const int32_t* acc_offsets) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&table);
+  data->insert(data->end(), bytes, bytes + sizeof(table));
+  for (int i = 0; i < table.output_depth; i++) {
+    AppendInt32(data, multipliers[i]);
+  }
+  for (int i = 0; i < table.output_depth; i++) {
+    AppendInt32(data, shifts[i]);
+  }
+  for (int i = 0; acc_offsets != nullptr && i < table.output_depth; i++) {
+    AppendInt32(data, acc_offsets[i]);
+  }
+}
+
+// Table of a CONV_2D or DEPTHWISE_CONV_2D node appended to data
+bool AddTable(TfLiteContext* context, tflite::MicroInterpreter* interpreter,
+              const TfLiteNode& node, bool is_conv,
+              std::vector<uint8_t>* data) {
+  const TfLiteTensor* input = interpreter->tensor(node.inputs->data[0]);
+  const TfLiteTensor* filter = interpreter->tensor(node.inputs->data[1]);
+  const TfLiteTensor* bias = node.inputs->size == 3 &&
+                                     node.inputs->data[2] >= 0
+                                 ? interpreter->tensor(node.inputs->data[2])
+                                 : nullptr;
+  TfLiteTensor* output = interpreter->tensor(node.outputs->data[0]);
+  const int output_depth = filter->dims->data[is_conv ? 0 : 3];
+  const TfLiteFusedActivation activation =
+      is_conv
+          ? static_cast<const TfLiteConvParams*>(node.builtin_data)->activation
+          : static_cast<const TfLiteDepthwiseConvParams*>(node.builtin_data)
+                ->activation;
+
+  tflite::TfLiteRequantizationTable table = {};
+  table.output_depth = output_depth;
+  std::vector<int32_t> multipliers(output_depth);
+  std::vector<int32_t> shifts(output_depth);
+  int output_shift;
+  if (tflite::PopulateConvolutionQuantizationParams(
+          context, input, filter, bias, output, activation,
+          &table.output_multiplier, &output_shift,
+          &table.output_activation_min, &table.output_activation_max,
+          multipliers.data(), reinterpret_cast<int*>(shifts.data()),
+          output_depth) != kTfLiteOk) {
+    return false;
+  }
+  table.output_shift = output_shift;
+  if (!is_conv) {
+    AppendTable(data, table, multipliers.data(), shifts.data(), nullptr);
+    return true;
+  }
+  // The arrays of the GEMM
+  tflite::ops::micro::conv_gemm::OpData conv = {};
+  if (tflite::ops::micro::conv_gemm::CalculateOpData(
+          context, static_cast<const TfLiteConvParams*>(node.builtin_data),
+          input, filter, bias, output, /*table=*/nullptr,
+          &conv) != kTfLiteOk) {
+    return false;
+  }
+  table.has_acc_offset = 1;
+  AppendTable(data, table, conv.output_multiplier, conv.output_shift,
+              conv.acc_offset);
+  return true;
+}
+
+}  // namespace
+
+bool BakeRequantizationTables(tflite::ModelT* model,
+                              RequantizationTablesInfo* info,
+                              std::string* error) {
+  if (model->subgraphs.size() != 1) {
+    *error = "only single subgraph models are supported";
+    return false;
+  }
+  // Metadata buffer of the tables, emptied while the interpreter reads
+  // the model
+  int buffer = -1;
+  for (const std::unique_ptr<tflite::MetadataT>& metadata : model->metadata) {
+    if (metadata->name == tflite::kRequantizationMetadataName) {
+      buffer = metadata->buffer;
+    }
+  }
+  if (buffer < 0) {
+    buffer = static_cast<int>(model->buffers.size());
+    model->buffers.emplace_back(new tflite::BufferT());
+    std::unique_ptr<tflite::MetadataT> metadata(new tflite::MetadataT());
+    metadata->name = tflite::kRequantizationMetadataName;
+    metadata->buffer = buffer;
+    model->metadata.push_back(std::move(metadata));
+  }
+  model->buffers[buffer]->data.clear();
+
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(builder, tflite::Model::Pack(builder, model));
+  const std::vector<uint8_t> packed(
+      builder.GetBufferPointer(),
+      builder.GetBufferPointer() + builder.GetSize());
+
+  static tflite::MicroErrorReporter error_reporter;
+  tflite::ops::micro::AllOpsResolver resolver;
+  tflite::MicroInterpreter interpreter(tflite::GetModel(packed.data()),
+                                       resolver, arena, kArenaSize,
+                                       &error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    *error = "AllocateTensors() failed";
+    return false;
+  }
+
+  TfLiteContext context = {};
+  context.AllocatePersistentBuffer = AllocatePersistentBuffer;
+  context.ReportError = ReportError;
+  persistent_buffers.clear();
+
+  const int node_count = static_cast<int>(interpreter.operators_size());
+  std::vector<uint8_t> data;
+  AppendInt32(&data, static_cast<int32_t>(tflite::kRequantizationMagic));
+  AppendInt32(&data, node_count);
+  for (int i = 0; i < node_count; i++) {
+    AppendInt32(&data, 0);
+  }
+  info->tables = 0;
+  for (int i = 0; i < node_count; i++) {
+    const tflite::NodeAndRegistration node =
+        interpreter.node_and_registration(i);
+    const int32_t code = node.registration->builtin_code;
+    if (code != tflite::BuiltinOperator_CONV_2D &&
+        code != tflite::BuiltinOperator_DEPTHWISE_CONV_2D) {
+      continue;
+    }
+    const TfLiteType type = interpreter.tensor(node.node.inputs->data[0])->type;
+    if (type != kTfLiteUInt8 && type != kTfLiteInt8) {
+      continue;
+    }
+    const int32_t offset = static_cast<int32_t>(data.size());
+    if (!AddTable(&context, &interpreter, node.node,
+                  code == tflite::BuiltinOperator_CONV_2D, &data)) {
+      *error = "can't compute the table of operator " + std::to_string(i);
+      return false;
+    }
+    memcpy(&data[(2 + i) * sizeof(int32_t)], &offset, sizeof(offset));
+    info->tables++;
+  }
+  persistent_buffers.clear();
+  model->buffers[buffer]->data = data;
+  info->bytes = static_cast<int>(data.size());
+  return true;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file requantization_tables.h
+ * @brief Offline requantization tables of the CONV_2D and DEPTHWISE_CONV_2D
+ * operators, stored in the model metadata (micro_requantization.h).
+ *
+ * The tables are computed by the kernel code on the tensors of a
+ * MicroInterpreter: PopulateConvolutionQuantizationParams() for the
+ * multipliers, shifts and activation ranges and conv_gemm::CalculateOpData()
+ * for the accumulator offsets of the GEMM, which fold the bias and the zero
+ * points. The values are the ones the kernels compute at startup, the
+ * palettized filters included.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#ifndef REQUANTIZATION_TABLES_H
+#define REQUANTIZATION_TABLES_H
+
+#include <string>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+struct RequantizationTablesInfo {
+  //! Operators with a table
+  int tables = 0;
+  //! Bytes of the metadata buffer
+  int bytes = 0;
+};
+
+/**
+ * Replaces the kRequantizationMetadataName metadata of the model (single
+ * subgraph) with the tables of its current filters. Run it again after
+ * changing the weights or the quantization of the model.
+ * @return false on errors, described in error
+ */
+bool BakeRequantizationTables(tflite::ModelT* model,
+                              RequantizationTablesInfo* info,
+                              std::string* error);
+
+#endif  // REQUANTIZATION_TABLES_H
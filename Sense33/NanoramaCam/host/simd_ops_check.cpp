@@ -0,0 +1,457 @@
+/**
+ * @file simd_ops_check.cpp
+ * @brief Bit-exactness check and timing of the SIMD kernels.
+ *
+ * Runs the kernels of optimized/simd_ops.h on random data and compares them
+ * with the reference ops: fully connected, depthwise conv, average pool and
+ * softmax, uint8 and int8. The person detection model has no fully connected
+ * or softmax layer, these are only covered here; the CONV_2D GEMM tile is
+ * covered by the fully connected checks. The time of the largest shapes is
+ * printed against the reference one.
+ *
+ * Usage: simd_ops_check [-s seed]
+ *
+ * The exit status is 1 if any output differs from the reference.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/optimized/simd_ops.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
+#include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/micro_time.h"
+
+namespace {
+
+namespace simd_ops = tflite::simd_ops;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int32_t Random(int32_t min, int32_t max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int32_t>((random_state >> 8) %
+                                    static_cast<uint32_t>(max - min + 1));
+}
+
+template <typename T>
+void FillRandom(std::vector<T>* values, size_t size) {
+  values->resize(size);
+  for (T& v : *values) {
+    v = static_cast<T>(Random(std::numeric_limits<T>::min(),
+                              std::numeric_limits<T>::max()));
+  }
+}
+
+void RandomMultiplier(int32_t* multiplier, int32_t* shift) {
+  int exponent;
+  tflite::QuantizeMultiplier(Random(100, 5000) * 1e-6, multiplier, &exponent);
+  *shift = exponent;
+}
+
+int checks = 0;
+int mismatches = 0;
+
+void Report(const char* kernel, const char* type, const char* shape,
+            bool exact) {
+  checks++;
+  mismatches += exact ? 0 : 1;
+  if (!exact) {
+    printf("%-16s %-12s %-26s differs\n", kernel, type, shape);
+  }
+}
+
+template <typename T>
+const char* TypeName() {
+  return std::numeric_limits<T>::is_signed ? "int8" : "uint8";
+}
+
+// Microseconds per call of the function, averaged on runs calls
+template <typename F>
+double TimeUs(int runs, F function) {
+  const int32_t start = tflite::GetCurrentTimeTicks();
+  for (int i = 0; i < runs; ++i) {
+    function();
+  }
+  const int32_t ticks = tflite::GetCurrentTimeTicks() - start;
+  return 1e6 * ticks / tflite::ticks_per_second() / runs;
+}
+
+void ReportTime(const char* kernel, const char* type, const char* shape,
+                double reference_us, double simd_us) {
+  printf("%-16s %-12s %-26s reference %8.1f us simd %8.1f us (%.2fx)\n",
+         kernel, type, shape, reference_us, simd_us, reference_us / simd_us);
+}
+
+template <typename T>
+void ReferenceFullyConnected(const tflite::FullyConnectedParams& params,
+                             const tflite::RuntimeShape& input_shape,
+                             const T* input,
+                             const tflite::RuntimeShape& filter_shape,
+                             const T* filter,
+                             const tflite::RuntimeShape& bias_shape,
+                             const int32_t* bias,
+                             const tflite::RuntimeShape& output_shape,
+                             T* output) {
+  if (std::numeric_limits<T>::is_signed) {
+    tflite::reference_integer_ops::FullyConnected(
+        params, input_shape, reinterpret_cast<const int8_t*>(input),
+        filter_shape, reinterpret_cast<const int8_t*>(filter), bias_shape,
+        bias, output_shape, reinterpret_cast<int8_t*>(output));
+  } else {
+    tflite::reference_ops::FullyConnected(
+        params, input_shape, reinterpret_cast<const uint8_t*>(input),
+        filter_shape, reinterpret_cast<const uint8_t*>(filter), bias_shape,
+        bias, output_shape, reinterpret_cast<uint8_t*>(output));
+  }
+}
+
+template <typename T>
+void CheckFullyConnected(int batches, int accum_depth, int output_depth,
+                         int timed_runs) {
+  const tflite::RuntimeShape input_shape({batches, accum_depth});
+  const tflite::RuntimeShape filter_shape({output_depth, accum_depth});
+  const tflite::RuntimeShape bias_shape({output_depth});
+  const tflite::RuntimeShape output_shape({batches, output_depth});
+  std::vector<T> input;
+  std::vector<T> filter;
+  std::vector<int32_t> bias(output_depth);
+  FillRandom(&input, input_shape.FlatSize());
+  FillRandom(&filter, filter_shape.FlatSize());
+  for (int32_t& v : bias) {
+    v = Random(-20000, 20000);
+  }
+
+  const bool is_int8 = std::numeric_limits<T>::is_signed;
+  tflite::FullyConnectedParams params;
+  params.input_offset = is_int8 ? Random(-127, 128) : -Random(0, 255);
+  params.weights_offset = is_int8 ? 0 : -Random(0, 255);
+  params.output_offset = is_int8 ? Random(-128, 127) : Random(0, 255);
+  RandomMultiplier(&params.output_multiplier, &params.output_shift);
+  params.quantized_activation_min = std::numeric_limits<T>::min();
+  params.quantized_activation_max = std::numeric_limits<T>::max();
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> simd(reference.size());
+  auto run_reference = [&]() {
+    ReferenceFullyConnected(params, input_shape, input.data(), filter_shape,
+                            filter.data(), bias_shape, bias.data(),
+                            output_shape, reference.data());
+  };
+  auto run_simd = [&]() {
+    simd_ops::FullyConnected<T>(params, input_shape, input.data(),
+                                filter_shape, filter.data(), bias.data(),
+                                output_shape, simd.data());
+  };
+  run_reference();
+  run_simd();
+
+  char shape[32];
+  snprintf(shape, sizeof(shape), "%dx%d -> %d", batches, accum_depth,
+           output_depth);
+  Report("fully connected", TypeName<T>(), shape, reference == simd);
+  if (timed_runs > 0) {
+    ReportTime("fully connected", TypeName<T>(), shape,
+               TimeUs(timed_runs, run_reference), TimeUs(timed_runs, run_simd));
+  }
+}
+
+struct WindowShape {
+  int height;
+  int width;
+  int depth;
+  int filter_size;
+  int stride;
+  int dilation;
+  TfLitePadding padding;
+};
+
+template <typename T>
+void CheckDepthwise(const WindowShape& s, int depth_multiplier,
+                    int timed_runs) {
+  int out_height, out_width;
+  const TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+      s.stride, s.stride, s.dilation, s.dilation, s.height, s.width,
+      s.filter_size, s.filter_size, s.padding, &out_height, &out_width);
+  const int output_depth = s.depth * depth_multiplier;
+  const tflite::RuntimeShape input_shape({1, s.height, s.width, s.depth});
+  const tflite::RuntimeShape filter_shape(
+      {1, s.filter_size, s.filter_size, output_depth});
+  const tflite::RuntimeShape bias_shape({output_depth});
+  const tflite::RuntimeShape output_shape(
+      {1, out_height, out_width, output_depth});
+  std::vector<T> input;
+  std::vector<T> filter;
+  std::vector<int32_t> bias(output_depth);
+  FillRandom(&input, input_shape.FlatSize());
+  FillRandom(&filter, filter_shape.FlatSize());
+  for (int32_t& v : bias) {
+    v = Random(-20000, 20000);
+  }
+
+  const bool is_int8 = std::numeric_limits<T>::is_signed;
+  tflite::DepthwiseParams params;
+  params.padding_type = tflite::PaddingType::kSame;
+  params.padding_values.width = pad.width;
+  params.padding_values.height = pad.height;
+  params.stride_width = s.stride;
+  params.stride_height = s.stride;
+  params.dilation_width_factor = s.dilation;
+  params.dilation_height_factor = s.dilation;
+  params.depth_multiplier = depth_multiplier;
+  params.input_offset = is_int8 ? Random(-127, 128) : -Random(0, 255);
+  params.weights_offset = is_int8 ? 0 : -Random(0, 255);
+  params.output_offset = is_int8 ? Random(-128, 127) : Random(0, 255);
+  RandomMultiplier(&params.output_multiplier, &params.output_shift);
+  params.quantized_activation_min = std::numeric_limits<T>::min();
+  params.quantized_activation_max = std::numeric_limits<T>::max();
+
+  // Per channel quantization of the int8 models, per tensor of the uint8 ones
+  std::vector<int32_t> multipliers(output_depth);
+  std::vector<int32_t> shifts(output_depth);
+  for (int c = 0; c < output_depth; ++c) {
+    RandomMultiplier(&multipliers[c], &shifts[c]);
+  }
+  const int32_t output_shift = params.output_shift;
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> simd(reference.size());
+  auto run_reference = [&]() {
+    if (is_int8) {
+      tflite::reference_integer_ops::DepthwiseConvPerChannel(
+          params, multipliers.data(), shifts.data(), input_shape,
+          reinterpret_cast<const int8_t*>(input.data()), filter_shape,
+          reinterpret_cast<const int8_t*>(filter.data()), bias_shape,
+          bias.data(), output_shape,
+          reinterpret_cast<int8_t*>(reference.data()));
+    } else {
+      tflite::reference_ops::DepthwiseConv(
+          params, input_shape, reinterpret_cast<const uint8_t*>(input.data()),
+          filter_shape, reinterpret_cast<const uint8_t*>(filter.data()),
+          bias_shape, bias.data(), output_shape,
+          reinterpret_cast<uint8_t*>(reference.data()));
+    }
+  };
+  auto run_simd = [&]() {
+    if (is_int8) {
+      simd_ops::DepthwiseConv<T>(params, multipliers.data(), shifts.data(),
+                                 /*quant_step=*/1, input_shape, input.data(),
+                                 filter_shape, filter.data(), bias.data(),
+                                 output_shape, simd.data());
+    } else {
+      simd_ops::DepthwiseConv<T>(params, &params.output_multiplier,
+                                 &output_shift, /*quant_step=*/0, input_shape,
+                                 input.data(), filter_shape, filter.data(),
+                                 bias.data(), output_shape, simd.data());
+    }
+  };
+  run_reference();
+  run_simd();
+
+  char shape[40];
+  snprintf(shape, sizeof(shape), "%dx%dx%d %dx%d m%d s%d d%d %s", s.height,
+           s.width, s.depth, s.filter_size, s.filter_size, depth_multiplier,
+           s.stride, s.dilation,
+           s.padding == kTfLitePaddingSame ? "same" : "valid");
+  Report("depthwise conv", TypeName<T>(), shape, reference == simd);
+  if (timed_runs > 0) {
+    ReportTime("depthwise conv", TypeName<T>(), shape,
+               TimeUs(timed_runs, run_reference), TimeUs(timed_runs, run_simd));
+  }
+}
+
+template <typename T>
+void CheckAveragePool(const WindowShape& s, int timed_runs) {
+  int out_height, out_width;
+  const TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+      s.stride, s.stride, 1, 1, s.height, s.width, s.filter_size,
+      s.filter_size, s.padding, &out_height, &out_width);
+  const tflite::RuntimeShape input_shape({1, s.height, s.width, s.depth});
+  const tflite::RuntimeShape output_shape({1, out_height, out_width, s.depth});
+  std::vector<T> input;
+  FillRandom(&input, input_shape.FlatSize());
+
+  tflite::PoolParams params;
+  params.stride_height = s.stride;
+  params.stride_width = s.stride;
+  params.filter_height = s.filter_size;
+  params.filter_width = s.filter_size;
+  params.padding_values.height = pad.height;
+  params.padding_values.width = pad.width;
+  params.quantized_activation_min = std::numeric_limits<T>::min() + 10;
+  params.quantized_activation_max = std::numeric_limits<T>::max() - 10;
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> simd(reference.size());
+  auto run_reference = [&]() {
+    if (std::numeric_limits<T>::is_signed) {
+      tflite::reference_integer_ops::AveragePool(
+          params, input_shape, reinterpret_cast<const int8_t*>(input.data()),
+          output_shape, reinterpret_cast<int8_t*>(reference.data()));
+    } else {
+      tflite::reference_ops::AveragePool(
+          params, input_shape, reinterpret_cast<const uint8_t*>(input.data()),
+          output_shape, reinterpret_cast<uint8_t*>(reference.data()));
+    }
+  };
+  auto run_simd = [&]() {
+    simd_ops::AveragePool<T>(params, input_shape, input.data(), output_shape,
+                             simd.data());
+  };
+  run_reference();
+  run_simd();
+
+  char shape[40];
+  snprintf(shape, sizeof(shape), "%dx%dx%d %dx%d s%d %s", s.height, s.width,
+           s.depth, s.filter_size, s.filter_size, s.stride,
+           s.padding == kTfLitePaddingSame ? "same" : "valid");
+  Report("average pool", TypeName<T>(), shape, reference == simd);
+  if (timed_runs > 0) {
+    ReportTime("average pool", TypeName<T>(), shape,
+               TimeUs(timed_runs, run_reference), TimeUs(timed_runs, run_simd));
+  }
+}
+
+template <typename InputT, typename OutputT>
+void CheckSoftmax(int outer_size, int depth, int timed_runs) {
+  const tflite::RuntimeShape shape({outer_size, depth});
+  std::vector<InputT> input;
+  FillRandom(&input, shape.FlatSize());
+
+  // Same scaling of CalculateSoftmaxParams() in softmax.cpp
+  static const int kScaledDiffIntegerBits = 5;
+  tflite::SoftmaxParams params;
+  int input_left_shift;
+  tflite::PreprocessSoftmaxScaling(1.0, Random(10, 2000) * 1e-4,
+                                   kScaledDiffIntegerBits,
+                                   &params.input_multiplier,
+                                   &input_left_shift);
+  params.input_left_shift = input_left_shift;
+  params.diff_min = -1.0 * tflite::CalculateInputRadius(kScaledDiffIntegerBits,
+                                                        input_left_shift);
+
+  std::vector<OutputT> reference(shape.FlatSize());
+  std::vector<OutputT> simd(reference.size());
+  auto run_reference = [&]() {
+    tflite::reference_ops::Softmax(params, shape, input.data(), shape,
+                                   reference.data());
+  };
+  auto run_simd = [&]() {
+    simd_ops::Softmax(params, shape, input.data(), shape, simd.data());
+  };
+  run_reference();
+  run_simd();
+
+  char type[16];
+  snprintf(type, sizeof(type), "%s->%s", TypeName<InputT>(),
+           sizeof(OutputT) == 2 ? "int16" : TypeName<OutputT>());
+  char name[32];
+  snprintf(name, sizeof(name), "%dx%d", outer_size, depth);
+  Report("softmax", type, name, reference == simd);
+  if (timed_runs > 0) {
+    ReportTime("softmax", type, name, TimeUs(timed_runs, run_reference),
+               TimeUs(timed_runs, run_simd));
+  }
+}
+
+template <typename T>
+void CheckAll(int timed_runs) {
+  const int fc_shapes[][3] = {{1, 1, 1},    {1, 4, 3},   {1, 7, 2},
+                              {2, 16, 5},   {3, 37, 10}, {1, 256, 2},
+                              {4, 250, 7},  {1, 1024, 3}, {2, 33, 9},
+                              {1, 1024, 256}};
+  const int fc_count = sizeof(fc_shapes) / sizeof(fc_shapes[0]);
+  for (int i = 0; i < fc_count; ++i) {
+    CheckFullyConnected<T>(fc_shapes[i][0], fc_shapes[i][1], fc_shapes[i][2],
+                           i == fc_count - 1 ? timed_runs : 0);
+  }
+
+  // The model layers, then the borders and the channel tails
+  const WindowShape dw_shapes[] = {
+      {48, 48, 8, 3, 2, 1, kTfLitePaddingSame},
+      {24, 24, 16, 3, 1, 1, kTfLitePaddingSame},
+      {24, 24, 16, 3, 2, 1, kTfLitePaddingSame},
+      {12, 12, 32, 3, 1, 1, kTfLitePaddingSame},
+      {6, 6, 64, 3, 2, 1, kTfLitePaddingSame},
+      {3, 3, 256, 3, 1, 1, kTfLitePaddingSame},
+      {5, 7, 4, 3, 1, 1, kTfLitePaddingSame},
+      {5, 7, 12, 3, 2, 1, kTfLitePaddingValid},
+      {1, 1, 8, 3, 2, 1, kTfLitePaddingSame},
+      {6, 6, 13, 5, 1, 1, kTfLitePaddingSame},
+      {7, 5, 8, 5, 2, 1, kTfLitePaddingValid},
+      {9, 9, 20, 3, 1, 2, kTfLitePaddingSame},
+      {4, 6, 8, 2, 1, 1, kTfLitePaddingValid},
+  };
+  for (const WindowShape& shape : dw_shapes) {
+    CheckDepthwise<T>(shape, 1, 0);
+    CheckDepthwise<T>(shape, 2, 0);
+    CheckDepthwise<T>(shape, 8, 0);
+  }
+  CheckDepthwise<T>(dw_shapes[1], 1, timed_runs);
+
+  const WindowShape pool_shapes[] = {
+      {3, 3, 256, 3, 1, 1, kTfLitePaddingValid},
+      {8, 8, 7, 2, 2, 1, kTfLitePaddingValid},
+      {7, 9, 20, 3, 2, 1, kTfLitePaddingSame},
+      {5, 5, 1, 3, 1, 1, kTfLitePaddingSame},
+      {12, 12, 32, 3, 1, 1, kTfLitePaddingSame},
+  };
+  for (const WindowShape& shape : pool_shapes) {
+    CheckAveragePool<T>(shape, 0);
+  }
+  CheckAveragePool<T>(pool_shapes[4], timed_runs);
+
+  const int softmax_shapes[][2] = {{1, 1},  {1, 2},   {3, 10},
+                                   {2, 17}, {1, 256}, {2, 300}};
+  for (const auto& shape : softmax_shapes) {
+    CheckSoftmax<T, T>(shape[0], shape[1], 0);
+  }
+  CheckSoftmax<T, T>(64, 256, timed_runs);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+      case 's':
+        random_state = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+        break;
+      default:
+        fprintf(stderr, "Usage: simd_ops_check [-s seed]\n");
+        return 1;
+    }
+  }
+
+  printf("SIMD backend: %s\n", simd_ops::BackendName());
+  const int kTimedRuns = 50;
+  CheckAll<uint8_t>(kTimedRuns);
+  CheckAll<int8_t>(kTimedRuns);
+  CheckSoftmax<int8_t, int16_t>(3, 10, 0);
+  CheckSoftmax<int8_t, int16_t>(2, 300, 0);
+
+  if (mismatches > 0) {
+    printf("%d of %d checks differ from the reference\n", mismatches, checks);
+    return 1;
+  }
+  printf("All the %d checks are bit-exact\n", checks);
+  return 0;
+}
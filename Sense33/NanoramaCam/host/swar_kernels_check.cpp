@@ -0,0 +1,320 @@
+/**
+ * @file swar_kernels_check.cpp
+ * @brief Bit-exactness check of the packed 8-bit (SWAR) kernels.
+ *
+ * Runs the kernels of portable_optimized/swar_kernels.h on random data and
+ * compares them with the reference ops: the GEMM tile of CONV_2D against the
+ * scalar products, the fully connected layer against
+ * reference_ops::FullyConnected and reference_integer_ops::FullyConnected,
+ * the depthwise layer against reference_ops::DepthwiseConv and
+ * reference_integer_ops::DepthwiseConvPerChannel. On the host the DSP
+ * instructions run the C emulation of swar.h, the same kernel source of the
+ * Cortex-M4 build.
+ *
+ * Usage: swar_kernels_check [-s seed]
+ *
+ * The exit status is 1 if any output differs from the reference.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
+#include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar_kernels.h"
+
+namespace {
+
+namespace swar = tflite::ops::micro::swar;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int32_t Random(int32_t min, int32_t max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int32_t>((random_state >> 8) %
+                                    static_cast<uint32_t>(max - min + 1));
+}
+
+template <typename T>
+void FillRandom(std::vector<T>* values, size_t size) {
+  values->resize(size);
+  for (T& v : *values) {
+    v = static_cast<T>(Random(std::numeric_limits<T>::min(),
+                              std::numeric_limits<T>::max()));
+  }
+}
+
+void RandomMultiplier(int32_t* multiplier, int32_t* shift) {
+  int exponent;
+  tflite::QuantizeMultiplier(Random(100, 5000) * 1e-6, multiplier, &exponent);
+  *shift = exponent;
+}
+
+int checks = 0;
+int mismatches = 0;
+
+void Report(const char* kernel, const char* type, const char* shape,
+            bool exact) {
+  checks++;
+  mismatches += exact ? 0 : 1;
+  if (!exact) {
+    printf("%-16s %-5s %-24s differs\n", kernel, type, shape);
+  }
+}
+
+template <typename T>
+const char* TypeName() {
+  return std::numeric_limits<T>::is_signed ? "int8" : "uint8";
+}
+
+// GEMM tile of conv_gemm.cpp against the scalar products
+template <typename T, int kRows, int kCols>
+void CheckMacTile(int depth) {
+  std::vector<T> rows;
+  std::vector<T> cols;
+  FillRandom(&rows, kRows * depth);
+  FillRandom(&cols, kCols * depth);
+  const T* a[kRows];
+  const T* b[kCols];
+  int32_t acc[kRows][kCols];
+  int32_t expected[kRows][kCols];
+  for (int r = 0; r < kRows; ++r) {
+    a[r] = rows.data() + r * depth;
+  }
+  for (int c = 0; c < kCols; ++c) {
+    b[c] = cols.data() + c * depth;
+  }
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      // Non-zero start, the tile adds to the accumulators
+      acc[r][c] = expected[r][c] = Random(-1000, 1000);
+      for (int k = 0; k < depth; ++k) {
+        expected[r][c] += static_cast<int32_t>(a[r][k]) * b[c][k];
+      }
+    }
+  }
+  swar::MacTile<T, kRows, kCols>(a, b, depth, acc);
+
+  bool exact = true;
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      exact = exact && acc[r][c] == expected[r][c];
+    }
+  }
+  char shape[32];
+  snprintf(shape, sizeof(shape), "%dx%d depth %d", kRows, kCols, depth);
+  Report("mac tile", TypeName<T>(), shape, exact);
+}
+
+template <typename T>
+void CheckFullyConnected(int batches, int accum_depth, int output_depth) {
+  const tflite::RuntimeShape input_shape({batches, accum_depth});
+  const tflite::RuntimeShape filter_shape({output_depth, accum_depth});
+  const tflite::RuntimeShape bias_shape({output_depth});
+  const tflite::RuntimeShape output_shape({batches, output_depth});
+  std::vector<T> input;
+  std::vector<T> filter;
+  std::vector<int32_t> bias(output_depth);
+  FillRandom(&input, input_shape.FlatSize());
+  FillRandom(&filter, filter_shape.FlatSize());
+  for (int32_t& v : bias) {
+    v = Random(-20000, 20000);
+  }
+
+  const bool is_int8 = std::numeric_limits<T>::is_signed;
+  tflite::FullyConnectedParams params;
+  params.input_offset = is_int8 ? Random(-127, 128) : -Random(0, 255);
+  params.weights_offset = is_int8 ? 0 : -Random(0, 255);
+  params.output_offset = is_int8 ? Random(-128, 127) : Random(0, 255);
+  RandomMultiplier(&params.output_multiplier, &params.output_shift);
+  params.quantized_activation_min = std::numeric_limits<T>::min();
+  params.quantized_activation_max = std::numeric_limits<T>::max();
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> packed(reference.size());
+  if (is_int8) {
+    tflite::reference_integer_ops::FullyConnected(
+        params, input_shape, reinterpret_cast<const int8_t*>(input.data()),
+        filter_shape, reinterpret_cast<const int8_t*>(filter.data()),
+        bias_shape, bias.data(), output_shape,
+        reinterpret_cast<int8_t*>(reference.data()));
+  } else {
+    tflite::reference_ops::FullyConnected(
+        params, input_shape, reinterpret_cast<const uint8_t*>(input.data()),
+        filter_shape, reinterpret_cast<const uint8_t*>(filter.data()),
+        bias_shape, bias.data(), output_shape,
+        reinterpret_cast<uint8_t*>(reference.data()));
+  }
+  swar::FullyConnected<T>(params, input_shape, input.data(), filter_shape,
+                          filter.data(), bias.data(), output_shape,
+                          packed.data());
+
+  char shape[32];
+  snprintf(shape, sizeof(shape), "%dx%d -> %d", batches, accum_depth,
+           output_depth);
+  Report("fully connected", TypeName<T>(), shape, reference == packed);
+}
+
+struct DepthwiseShape {
+  int height;
+  int width;
+  int depth;
+  int filter_size;
+  int stride;
+  int dilation;
+  TfLitePadding padding;
+};
+
+template <typename T>
+void CheckDepthwise(const DepthwiseShape& s) {
+  int out_height, out_width;
+  const TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+      s.stride, s.stride, s.dilation, s.dilation, s.height, s.width,
+      s.filter_size, s.filter_size, s.padding, &out_height, &out_width);
+  const tflite::RuntimeShape input_shape({1, s.height, s.width, s.depth});
+  const tflite::RuntimeShape filter_shape(
+      {1, s.filter_size, s.filter_size, s.depth});
+  const tflite::RuntimeShape bias_shape({s.depth});
+  const tflite::RuntimeShape output_shape({1, out_height, out_width, s.depth});
+  std::vector<T> input;
+  std::vector<T> filter;
+  std::vector<int32_t> bias(s.depth);
+  FillRandom(&input, input_shape.FlatSize());
+  FillRandom(&filter, filter_shape.FlatSize());
+  for (int32_t& v : bias) {
+    v = Random(-20000, 20000);
+  }
+
+  const bool is_int8 = std::numeric_limits<T>::is_signed;
+  tflite::DepthwiseParams params;
+  params.padding_type = tflite::PaddingType::kSame;
+  params.padding_values.width = pad.width;
+  params.padding_values.height = pad.height;
+  params.stride_width = s.stride;
+  params.stride_height = s.stride;
+  params.dilation_width_factor = s.dilation;
+  params.dilation_height_factor = s.dilation;
+  params.depth_multiplier = 1;
+  params.input_offset = is_int8 ? Random(-127, 128) : -Random(0, 255);
+  params.weights_offset = is_int8 ? 0 : -Random(0, 255);
+  params.output_offset = is_int8 ? Random(-128, 127) : Random(0, 255);
+  RandomMultiplier(&params.output_multiplier, &params.output_shift);
+  params.quantized_activation_min = std::numeric_limits<T>::min();
+  params.quantized_activation_max = std::numeric_limits<T>::max();
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> packed(reference.size());
+  if (is_int8) {
+    // Per channel quantization of EvalQuantizedPerChannel()
+    std::vector<int32_t> multipliers(s.depth);
+    std::vector<int32_t> shifts(s.depth);
+    for (int c = 0; c < s.depth; ++c) {
+      RandomMultiplier(&multipliers[c], &shifts[c]);
+    }
+    tflite::reference_integer_ops::DepthwiseConvPerChannel(
+        params, multipliers.data(), shifts.data(), input_shape,
+        reinterpret_cast<const int8_t*>(input.data()), filter_shape,
+        reinterpret_cast<const int8_t*>(filter.data()), bias_shape,
+        bias.data(), output_shape,
+        reinterpret_cast<int8_t*>(reference.data()));
+    swar::DepthwiseConv<T>(params, multipliers.data(), shifts.data(),
+                           /*quant_step=*/1, input_shape, input.data(),
+                           filter_shape, filter.data(), bias.data(),
+                           output_shape, packed.data());
+  } else {
+    tflite::reference_ops::DepthwiseConv(
+        params, input_shape, reinterpret_cast<const uint8_t*>(input.data()),
+        filter_shape, reinterpret_cast<const uint8_t*>(filter.data()),
+        bias_shape, bias.data(), output_shape,
+        reinterpret_cast<uint8_t*>(reference.data()));
+    const int32_t output_shift = params.output_shift;
+    swar::DepthwiseConv<T>(params, &params.output_multiplier, &output_shift,
+                           /*quant_step=*/0, input_shape, input.data(),
+                           filter_shape, filter.data(), bias.data(),
+                           output_shape, packed.data());
+  }
+
+  char shape[32];
+  snprintf(shape, sizeof(shape), "%dx%dx%d %dx%d s%d d%d %s", s.height,
+           s.width, s.depth, s.filter_size, s.filter_size, s.stride,
+           s.dilation, s.padding == kTfLitePaddingSame ? "same" : "valid");
+  Report("depthwise conv", TypeName<T>(), shape, reference == packed);
+}
+
+template <typename T>
+void CheckAll() {
+  for (int depth = 1; depth <= 67; ++depth) {
+    CheckMacTile<T, 2, 4>(depth);
+    CheckMacTile<T, 1, 1>(depth);
+  }
+
+  const int fc_shapes[][3] = {{1, 1, 1},   {1, 4, 3},   {1, 7, 2},
+                              {2, 16, 5},  {3, 37, 10}, {1, 256, 2},
+                              {4, 250, 7}, {1, 1024, 3}};
+  for (const auto& shape : fc_shapes) {
+    CheckFullyConnected<T>(shape[0], shape[1], shape[2]);
+  }
+
+  // The model layers with depth multiplier 1, then the borders
+  const DepthwiseShape dw_shapes[] = {
+      {48, 48, 8, 3, 2, 1, kTfLitePaddingSame},
+      {24, 24, 16, 3, 1, 1, kTfLitePaddingSame},
+      {24, 24, 16, 3, 2, 1, kTfLitePaddingSame},
+      {12, 12, 32, 3, 1, 1, kTfLitePaddingSame},
+      {6, 6, 64, 3, 2, 1, kTfLitePaddingSame},
+      {3, 3, 256, 3, 1, 1, kTfLitePaddingSame},
+      {5, 7, 4, 3, 1, 1, kTfLitePaddingSame},
+      {5, 7, 4, 3, 2, 1, kTfLitePaddingValid},
+      {1, 1, 8, 3, 2, 1, kTfLitePaddingSame},
+      {6, 6, 12, 5, 1, 1, kTfLitePaddingSame},
+      {7, 5, 8, 5, 2, 1, kTfLitePaddingValid},
+      {9, 9, 4, 3, 1, 2, kTfLitePaddingSame},
+      {4, 6, 8, 2, 1, 1, kTfLitePaddingValid},
+      {4, 4, 8, 1, 1, 1, kTfLitePaddingValid},
+  };
+  for (const DepthwiseShape& shape : dw_shapes) {
+    CheckDepthwise<T>(shape);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+      case 's':
+        random_state = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+        break;
+      default:
+        fprintf(stderr, "Usage: swar_kernels_check [-s seed]\n");
+        return 1;
+    }
+  }
+
+  printf("DSP instructions: %s\n",
+         TF_LITE_MICRO_SWAR_ASM ? "native" : "C emulation");
+  CheckAll<uint8_t>();
+  CheckAll<int8_t>();
+
+  if (mismatches > 0) {
+    printf("%d of %d checks differ from the reference\n", mismatches, checks);
+    return 1;
+  }
+  printf("All the %d checks are bit-exact\n", checks);
+  return 0;
+}
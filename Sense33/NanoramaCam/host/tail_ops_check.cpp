@@ -0,0 +1,456 @@
+/**
+ * @file tail_ops_check.cpp
+ * @brief Bit-exactness check and timing of the model tail kernels of
+ * portable_optimized/tail_ops.h.
+ *
+ * The table softmax is compared with reference_ops::Softmax on random rows,
+ * input scales and betas (uint8, int8 and int8 to int16), the reciprocal
+ * average pool with the reference ops on random windows up to the largest
+ * one of kMaxReciprocalWindow values (uint8 and int8). The person detection
+ * model has no softmax layer, it is only covered here. The registrations
+ * (Register_SOFTMAX_LUT(), Register_AVERAGE_POOL_2D_RECIPROCAL()) are also
+ * run through Init(), Prepare() and Eval() on single node contexts against
+ * the reference registrations. The time of the largest shapes is printed
+ * against the reference one.
+ *
+ * Usage: tail_ops_check [-s seed]
+ *
+ * The exit status is 1 if any output differs by more than one LSB from the
+ * reference, the differences of one LSB are counted.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include <unistd.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/tail_ops.h"
+#include "tensorflow/lite/micro/micro_time.h"
+
+namespace {
+
+namespace tail_ops = tflite::ops::micro::tail_ops;
+
+// Deterministic pseudo random numbers (LCG)
+uint32_t random_state = 1;
+
+int32_t Random(int32_t min, int32_t max) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return min + static_cast<int32_t>((random_state >> 8) %
+                                    static_cast<uint32_t>(max - min + 1));
+}
+
+template <typename T>
+void FillRandom(std::vector<T>* values, size_t size) {
+  values->resize(size);
+  for (T& v : *values) {
+    v = static_cast<T>(Random(std::numeric_limits<T>::min(),
+                              std::numeric_limits<T>::max()));
+  }
+}
+
+int checks = 0;
+int mismatches = 0;
+int one_lsb = 0;
+
+// Largest difference of two outputs
+template <typename T>
+int MaxDifference(const std::vector<T>& a, const std::vector<T>& b) {
+  int max = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    max = std::max(max, std::abs(static_cast<int>(a[i]) - b[i]));
+  }
+  return max;
+}
+
+void Report(const char* kernel, const char* type, const char* shape,
+            int difference) {
+  checks++;
+  mismatches += difference > 1 ? 1 : 0;
+  one_lsb += difference == 1 ? 1 : 0;
+  if (difference > 0) {
+    printf("%-16s %-12s %-26s differs by %d\n", kernel, type, shape,
+           difference);
+  }
+}
+
+template <typename T>
+const char* TypeName() {
+  return std::numeric_limits<T>::is_signed ? "int8" : "uint8";
+}
+
+// Microseconds per call of the function, averaged on runs calls
+template <typename F>
+double TimeUs(int runs, F function) {
+  const int32_t start = tflite::GetCurrentTimeTicks();
+  for (int i = 0; i < runs; ++i) {
+    function();
+  }
+  const int32_t ticks = tflite::GetCurrentTimeTicks() - start;
+  return 1e6 * ticks / tflite::ticks_per_second() / runs;
+}
+
+void ReportTime(const char* kernel, const char* type, const char* shape,
+                double reference_us, double tail_us) {
+  printf("%-16s %-12s %-26s reference %8.1f us tail %8.1f us (%.2fx)\n",
+         kernel, type, shape, reference_us, tail_us, reference_us / tail_us);
+}
+
+// Softmax params of CalculateSoftmaxParams() in softmax.cpp
+tflite::SoftmaxParams SoftmaxParams(double beta, double input_scale) {
+  tflite::SoftmaxParams params;
+  int input_left_shift;
+  tflite::PreprocessSoftmaxScaling(beta, input_scale,
+                                   tail_ops::kScaledDiffIntegerBits,
+                                   &params.input_multiplier,
+                                   &input_left_shift);
+  params.input_left_shift = input_left_shift;
+  params.diff_min = -1.0 * tflite::CalculateInputRadius(
+                               tail_ops::kScaledDiffIntegerBits,
+                               input_left_shift);
+  return params;
+}
+
+template <typename InputT, typename OutputT>
+void CheckSoftmax(int outer_size, int depth, int timed_runs) {
+  const tflite::RuntimeShape shape({outer_size, depth});
+  std::vector<InputT> input;
+  FillRandom(&input, shape.FlatSize());
+  const double beta = Random(1, 20) * 0.1;
+  const double input_scale = Random(10, 2000) * 1e-4;
+  const tflite::SoftmaxParams params = SoftmaxParams(beta, input_scale);
+  int32_t table[tail_ops::kSoftmaxTableSize];
+  tail_ops::BuildSoftmaxExpTable(params, table);
+
+  std::vector<OutputT> reference(shape.FlatSize());
+  std::vector<OutputT> tail(reference.size());
+  auto run_reference = [&]() {
+    tflite::reference_ops::Softmax(params, shape, input.data(), shape,
+                                   reference.data());
+  };
+  auto run_tail = [&]() {
+    tail_ops::Softmax(table, shape, input.data(), shape, tail.data());
+  };
+  run_reference();
+  run_tail();
+
+  char type[16];
+  snprintf(type, sizeof(type), "%s->%s", TypeName<InputT>(),
+           sizeof(OutputT) == 2 ? "int16" : TypeName<OutputT>());
+  char name[40];
+  snprintf(name, sizeof(name), "%dx%d b%.1f s%.4f", outer_size, depth, beta,
+           input_scale);
+  Report("softmax", type, name, MaxDifference(reference, tail));
+  if (timed_runs > 0) {
+    ReportTime("softmax", type, name, TimeUs(timed_runs, run_reference),
+               TimeUs(timed_runs, run_tail));
+  }
+}
+
+struct PoolShape {
+  int height;
+  int width;
+  int depth;
+  int filter_height;
+  int filter_width;
+  int stride;
+  TfLitePadding padding;
+};
+
+template <typename T>
+void CheckAveragePool(const PoolShape& s, int timed_runs) {
+  int out_height, out_width;
+  const TfLitePaddingValues pad = tflite::ComputePaddingHeightWidth(
+      s.stride, s.stride, 1, 1, s.height, s.width, s.filter_height,
+      s.filter_width, s.padding, &out_height, &out_width);
+  const tflite::RuntimeShape input_shape({1, s.height, s.width, s.depth});
+  const tflite::RuntimeShape output_shape({1, out_height, out_width, s.depth});
+  std::vector<T> input;
+  FillRandom(&input, input_shape.FlatSize());
+
+  tflite::PoolParams params;
+  params.stride_height = s.stride;
+  params.stride_width = s.stride;
+  params.filter_height = s.filter_height;
+  params.filter_width = s.filter_width;
+  params.padding_values.height = pad.height;
+  params.padding_values.width = pad.width;
+  params.quantized_activation_min = std::numeric_limits<T>::min() + 10;
+  params.quantized_activation_max = std::numeric_limits<T>::max() - 10;
+
+  std::vector<T> reference(output_shape.FlatSize());
+  std::vector<T> tail(reference.size());
+  auto run_reference = [&]() {
+    if (std::numeric_limits<T>::is_signed) {
+      tflite::reference_integer_ops::AveragePool(
+          params, input_shape, reinterpret_cast<const int8_t*>(input.data()),
+          output_shape, reinterpret_cast<int8_t*>(reference.data()));
+    } else {
+      tflite::reference_ops::AveragePool(
+          params, input_shape, reinterpret_cast<const uint8_t*>(input.data()),
+          output_shape, reinterpret_cast<uint8_t*>(reference.data()));
+    }
+  };
+  auto run_tail = [&]() {
+    tail_ops::AveragePool<T>(params, input_shape, input.data(), output_shape,
+                             tail.data());
+  };
+  run_reference();
+  run_tail();
+
+  char shape[40];
+  snprintf(shape, sizeof(shape), "%dx%dx%d %dx%d s%d %s", s.height, s.width,
+           s.depth, s.filter_height, s.filter_width, s.stride,
+           s.padding == kTfLitePaddingSame ? "same" : "valid");
+  Report("average pool", TypeName<T>(), shape, MaxDifference(reference, tail));
+  if (timed_runs > 0) {
+    ReportTime("average pool", TypeName<T>(), shape,
+               TimeUs(timed_runs, run_reference), TimeUs(timed_runs, run_tail));
+  }
+}
+
+// Every window size of the reciprocal division, with the largest rounded
+// sums of both signs
+void CheckWindowReciprocals() {
+  int differences = 0;
+  for (int d = 1; d <= tail_ops::kMaxReciprocalWindow; ++d) {
+    const uint32_t reciprocal = tail_ops::WindowReciprocal(d);
+    const uint32_t sums[] = {0u, 1u, static_cast<uint32_t>(d - 1),
+                             static_cast<uint32_t>(d),
+                             static_cast<uint32_t>(128 * d + d / 2),
+                             static_cast<uint32_t>(255 * d + d / 2)};
+    for (uint32_t n : sums) {
+      differences += tail_ops::DivideByWindow(n, reciprocal) !=
+                     static_cast<int32_t>(n / d);
+    }
+  }
+  char shape[40];
+  snprintf(shape, sizeof(shape), "1..%d", tail_ops::kMaxReciprocalWindow);
+  Report("reciprocal", "uint32", shape, differences > 0 ? 2 : 0);
+}
+
+// Single node context running a registration on its own tensors
+class NodeContext {
+ public:
+  NodeContext(TfLiteTensor* tensors, void* builtin_data) {
+    context_.tensors = tensors;
+    context_.tensors_size = 2;
+    context_.ReportError = ReportError;
+    context_.AllocatePersistentBuffer = AllocatePersistentBuffer;
+    node_.inputs = reinterpret_cast<TfLiteIntArray*>(inputs_);
+    node_.outputs = reinterpret_cast<TfLiteIntArray*>(outputs_);
+    node_.builtin_data = builtin_data;
+  }
+
+  // Init(), Prepare() and Eval() of the registration
+  TfLiteStatus Run(TfLiteRegistration* registration) {
+    node_.user_data = registration->init != nullptr
+                          ? registration->init(&context_, nullptr, 0)
+                          : nullptr;
+    if (registration->prepare != nullptr &&
+        registration->prepare(&context_, &node_) != kTfLiteOk) {
+      return kTfLiteError;
+    }
+    return registration->invoke(&context_, &node_);
+  }
+
+ private:
+  static void ReportError(TfLiteContext* context, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+  }
+
+  // Buffers of the persistent allocations, freed at exit
+  static TfLiteStatus AllocatePersistentBuffer(TfLiteContext* context,
+                                               size_t bytes, void** ptr) {
+    static std::vector<std::vector<uint8_t>> buffers;
+    buffers.emplace_back(bytes);
+    *ptr = buffers.back().data();
+    return kTfLiteOk;
+  }
+
+  TfLiteContext context_ = {};
+  TfLiteNode node_ = {};
+  // TfLiteIntArray layout: size, then the tensor indices
+  int inputs_[2] = {1, 0};
+  int outputs_[2] = {1, 1};
+};
+
+template <typename T>
+TfLiteType TensorType() {
+  return std::numeric_limits<T>::is_signed ? kTfLiteInt8 : kTfLiteUInt8;
+}
+
+// Quantized tensor over data with the dims of the int array (size first)
+template <typename T>
+TfLiteTensor MakeTensor(int* dims, std::vector<T>* data, float scale,
+                        int zero_point) {
+  TfLiteTensor tensor = {};
+  tensor.type = TensorType<T>();
+  tensor.data.raw = reinterpret_cast<char*>(data->data());
+  tensor.dims = reinterpret_cast<TfLiteIntArray*>(dims);
+  tensor.bytes = data->size() * sizeof(T);
+  tensor.params.scale = scale;
+  tensor.params.zero_point = zero_point;
+  tensor.allocation_type = kTfLiteArenaRw;
+  return tensor;
+}
+
+// The same node run by a reference and a tail registration
+template <typename T>
+void CheckRegistrations(const char* kernel, const char* shape,
+                        TfLiteRegistration* reference_registration,
+                        TfLiteRegistration* tail_registration, int* input_dims,
+                        int* output_dims, float input_scale,
+                        int input_zero_point, float output_scale,
+                        int output_zero_point, void* builtin_data) {
+  int input_size = 1;
+  for (int i = 1; i <= input_dims[0]; ++i) {
+    input_size *= input_dims[i];
+  }
+  int output_size = 1;
+  for (int i = 1; i <= output_dims[0]; ++i) {
+    output_size *= output_dims[i];
+  }
+  std::vector<T> input;
+  FillRandom(&input, input_size);
+  std::vector<T> reference(output_size);
+  std::vector<T> tail(output_size);
+
+  TfLiteTensor reference_tensors[] = {
+      MakeTensor(input_dims, &input, input_scale, input_zero_point),
+      MakeTensor(output_dims, &reference, output_scale, output_zero_point)};
+  TfLiteTensor tail_tensors[] = {
+      MakeTensor(input_dims, &input, input_scale, input_zero_point),
+      MakeTensor(output_dims, &tail, output_scale, output_zero_point)};
+  NodeContext reference_node(reference_tensors, builtin_data);
+  NodeContext tail_node(tail_tensors, builtin_data);
+  const bool ok = reference_node.Run(reference_registration) == kTfLiteOk &&
+                  tail_node.Run(tail_registration) == kTfLiteOk;
+  Report(kernel, TypeName<T>(), shape,
+         ok ? MaxDifference(reference, tail) : 256);
+}
+
+template <typename T>
+void CheckAllRegistrations() {
+  const int zero_point = std::numeric_limits<T>::is_signed ? -128 : 0;
+
+  TfLiteSoftmaxParams softmax_params = {1.0f};
+  int softmax_dims[] = {2, 4, 37};
+  CheckRegistrations<T>(
+      "SOFTMAX_LUT", "4x37", tflite::ops::micro::Register_SOFTMAX(),
+      tflite::ops::micro::Register_SOFTMAX_LUT(), softmax_dims, softmax_dims,
+      0.0625f, Random(-20, 20), 1.f / 256, zero_point, &softmax_params);
+
+  // The model tail and a padded window
+  TfLitePoolParams pool_params = {};
+  pool_params.padding = kTfLitePaddingValid;
+  pool_params.stride_width = 2;
+  pool_params.stride_height = 2;
+  pool_params.filter_width = 3;
+  pool_params.filter_height = 3;
+  pool_params.activation = kTfLiteActNone;
+  int pool_input_dims[] = {4, 1, 3, 3, 256};
+  int pool_output_dims[] = {4, 1, 1, 1, 256};
+  CheckRegistrations<T>(
+      "AVG_POOL_RECIP", "3x3x256 3x3 s2 valid",
+      tflite::ops::micro::Register_AVERAGE_POOL_2D(),
+      tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL(),
+      pool_input_dims, pool_output_dims, 0.02f, Random(-20, 20), 0.02f,
+      Random(-20, 20), &pool_params);
+  pool_params.padding = kTfLitePaddingSame;
+  pool_params.activation = kTfLiteActRelu6;
+  int padded_input_dims[] = {4, 1, 7, 9, 13};
+  int padded_output_dims[] = {4, 1, 4, 5, 13};
+  CheckRegistrations<T>(
+      "AVG_POOL_RECIP", "7x9x13 3x3 s2 same relu6",
+      tflite::ops::micro::Register_AVERAGE_POOL_2D(),
+      tflite::ops::micro::Register_AVERAGE_POOL_2D_RECIPROCAL(),
+      padded_input_dims, padded_output_dims, 0.05f, zero_point + 10, 0.05f,
+      zero_point + 10, &pool_params);
+}
+
+template <typename T>
+void CheckAll(int timed_runs) {
+  const PoolShape pool_shapes[] = {
+      {3, 3, 256, 3, 3, 2, kTfLitePaddingValid},
+      {8, 8, 7, 2, 2, 2, kTfLitePaddingValid},
+      {7, 9, 20, 3, 3, 2, kTfLitePaddingSame},
+      {5, 5, 1, 3, 3, 1, kTfLitePaddingSame},
+      {12, 12, 32, 3, 3, 1, kTfLitePaddingSame},
+      {6, 10, 3, 5, 7, 3, kTfLitePaddingSame},
+      {20, 20, 4, 20, 20, 1, kTfLitePaddingValid},
+      {53, 54, 2, 53, 54, 1, kTfLitePaddingValid},
+  };
+  for (const PoolShape& shape : pool_shapes) {
+    CheckAveragePool<T>(shape, 0);
+  }
+  CheckAveragePool<T>(pool_shapes[0], timed_runs);
+  CheckAveragePool<T>(pool_shapes[4], timed_runs);
+
+  const int softmax_shapes[][2] = {{1, 1},  {1, 2},   {3, 10},
+                                   {2, 17}, {1, 256}, {2, 300}};
+  for (const auto& shape : softmax_shapes) {
+    for (int i = 0; i < 8; ++i) {
+      CheckSoftmax<T, T>(shape[0], shape[1], 0);
+    }
+  }
+  CheckSoftmax<T, T>(1, 2, timed_runs);
+  CheckSoftmax<T, T>(64, 256, timed_runs);
+  CheckAllRegistrations<T>();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+      case 's':
+        random_state = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+        break;
+      default:
+        fprintf(stderr, "Usage: tail_ops_check [-s seed]\n");
+        return 1;
+    }
+  }
+
+  const int kTimedRuns = 200;
+  CheckWindowReciprocals();
+  CheckAll<uint8_t>(kTimedRuns);
+  CheckAll<int8_t>(kTimedRuns);
+  for (int i = 0; i < 8; ++i) {
+    CheckSoftmax<int8_t, int16_t>(3, 10, 0);
+    CheckSoftmax<int8_t, int16_t>(2, 300, 0);
+  }
+
+  if (mismatches > 0) {
+    printf("%d of %d checks differ by more than one LSB from the reference\n",
+           mismatches, checks);
+    return 1;
+  }
+  if (one_lsb > 0) {
+    printf("%d of %d checks differ by one LSB, the others are bit-exact\n",
+           one_lsb, checks);
+    return 0;
+  }
+  printf("All the %d checks are bit-exact\n", checks);
+  return 0;
+}
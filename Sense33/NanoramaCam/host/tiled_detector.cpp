@@ -0,0 +1,766 @@
+/**
+ * @file tiled_detector.cpp
+ * @brief Person detection over whole frames with an image pyramid of
+ * overlapping 96x96 windows, see tiled_detector.h.
+ *
+ * Sharing of the leading layers: with the window origins on multiples of
+ * the cumulative stride, an output pixel of a shared layer only depends on
+ * the window pixels under its receptive field. Where the field is inside
+ * the part of the previous layer that equals the level output (the
+ * interior), the pixel is copied from the level output; the outer rows and
+ * columns see the zero padding of the window and are recomputed on the
+ * window data with the same kernels of the interpreter (simd_ops.h). The
+ * last shared layer is assembled in its interpreter tensor and Invoke()
+ * resumes from the next operator.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#include "tiled_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <set>
+
+#include "model_settings.h"
+#include "person_detect_model_data.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/simd_ops.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace {
+
+// Fits every kernel set as person_detect_bench
+constexpr int kTensorArenaSize = 89 * 1024;
+
+int64_t ElapsedUs(uint32_t start) {
+  const uint32_t ticks = tflite::GetCurrentTimeTicks() - start;
+  return static_cast<int64_t>(ticks) * 1000000 / tflite::ticks_per_second();
+}
+
+// Error reporting of the context used to read the quantization parameters
+void ReportError(TfLiteContext* context, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  static_cast<tflite::ErrorReporter*>(context->impl_)->Report(format, args);
+  va_end(args);
+}
+
+// Pixels of an image or a feature map, HWC
+struct Plane {
+  int height;
+  int width;
+  int depth;
+  std::vector<uint8_t> pixels;
+
+  void Resize(int h, int w, int d) {
+    height = h;
+    width = w;
+    depth = d;
+    pixels.resize(static_cast<size_t>(h) * w * d);
+  }
+};
+
+// Rectangle of a plane, rows row_stride values apart
+struct View {
+  const uint8_t* data;
+  int height;
+  int width;
+  int depth;
+  int row_stride;
+};
+
+View WholeView(const Plane& plane) {
+  return {plane.pixels.data(), plane.height, plane.width, plane.depth,
+          plane.width * plane.depth};
+}
+
+// A leading DEPTHWISE_CONV_2D or 1x1 CONV_2D computed once per level
+struct SharedLayer {
+  bool depthwise;
+  int stride;
+  int pad_height;
+  int pad_width;
+  int filter_height;
+  int filter_width;
+  int out_depth;
+  // Output of a window and the part of it equal to the level output
+  int out_height;
+  int out_width;
+  int inner_top;
+  int inner_bottom;
+  int inner_left;
+  int inner_right;
+  // Level pixels per output pixel
+  int scale;
+  const uint8_t* filter;
+  const int32_t* bias;
+  tflite::DepthwiseParams dw_params;
+  tflite::FullyConnectedParams fc_params;
+  int32_t output_multiplier;
+  int32_t output_shift;
+  // Output of the whole level and of the current window. The window output
+  // of the last layer is its interpreter tensor.
+  Plane level;
+  std::vector<uint8_t> window;
+  uint8_t* window_data;
+};
+
+// Interior of a layer output: the pixels whose receptive field is in the
+// interior [begin, end) of the input
+void InnerRange(int begin, int end, int stride, int pad, int filter, int size,
+                int* inner_begin, int* inner_end) {
+  *inner_begin = std::min((begin + pad + stride - 1) / stride, size);
+  const int last = end - filter + pad;
+  *inner_end = last < 0 ? 0 : std::min(last / stride + 1, size);
+  *inner_end = std::max(*inner_end, *inner_begin);
+}
+
+// Box filter halving, the odd row and column are dropped
+void Halve(const Plane& src, Plane* dst) {
+  dst->Resize(src.height / 2, src.width / 2, 1);
+  for (int y = 0; y < dst->height; y++) {
+    const uint8_t* row0 = src.pixels.data() + 2 * y * src.width;
+    const uint8_t* row1 = row0 + src.width;
+    uint8_t* out = dst->pixels.data() + y * dst->width;
+    for (int x = 0; x < dst->width; x++) {
+      out[x] = static_cast<uint8_t>(
+          (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >>
+          2);
+    }
+  }
+}
+
+// Source index and 8 bit weight of the bilinear sampling of one axis
+void BilinearTaps(int src_size, int dst_size, std::vector<int>* index,
+                  std::vector<int>* weight) {
+  index->resize(dst_size);
+  weight->resize(dst_size);
+  for (int i = 0; i < dst_size; i++) {
+    // Pixel centers, 8 fractional bits
+    int pos = (2 * i + 1) * src_size * 128 / dst_size - 128;
+    pos = std::max(pos, 0);
+    (*index)[i] = std::min(pos >> 8, src_size - 1);
+    (*weight)[i] = (*index)[i] == src_size - 1 ? 0 : pos & 255;
+  }
+}
+
+void ScaleBilinear(const Plane& src, int width, int height, Plane* dst) {
+  std::vector<int> xs, wx, ys, wy;
+  BilinearTaps(src.width, width, &xs, &wx);
+  BilinearTaps(src.height, height, &ys, &wy);
+  dst->Resize(height, width, 1);
+  for (int y = 0; y < height; y++) {
+    const uint8_t* row0 = src.pixels.data() + ys[y] * src.width;
+    const uint8_t* row1 = wy[y] ? row0 + src.width : row0;
+    uint8_t* out = dst->pixels.data() + y * width;
+    for (int x = 0; x < width; x++) {
+      const int x0 = xs[x];
+      const int x1 = wx[x] ? x0 + 1 : x0;
+      const int top = row0[x0] * (256 - wx[x]) + row0[x1] * wx[x];
+      const int bottom = row1[x0] * (256 - wx[x]) + row1[x1] * wx[x];
+      out[x] = static_cast<uint8_t>(
+          (top * (256 - wy[y]) + bottom * wy[y] + 32768) >> 16);
+    }
+  }
+}
+
+// Window origins along one side of a level, on multiples of align. The last
+// window is moved to the last aligned origin before the border.
+std::vector<int> WindowOrigins(int size, int window, int stride, int align) {
+  std::vector<int> origins;
+  for (int p = 0; p + window <= size; p += stride) {
+    origins.push_back(p);
+  }
+  const int last = (size - window) / align * align;
+  if (origins.back() < last) {
+    origins.push_back(last);
+  }
+  return origins;
+}
+
+float Overlap(const Detection& a, const Detection& b) {
+  const int w = std::min(a.x + a.size, b.x + b.size) - std::max(a.x, b.x);
+  const int h = std::min(a.y + a.size, b.y + b.size) - std::max(a.y, b.y);
+  if (w <= 0 || h <= 0) {
+    return 0;
+  }
+  const float inter = static_cast<float>(w) * h;
+  return inter / (static_cast<float>(a.size) * a.size +
+                  static_cast<float>(b.size) * b.size - inter);
+}
+
+// Greedy non-maximum suppression, best score first
+void Suppress(float max_overlap, std::vector<Detection>* detections) {
+  std::stable_sort(
+      detections->begin(), detections->end(),
+      [](const Detection& a, const Detection& b) { return a.score > b.score; });
+  std::vector<Detection> kept;
+  for (const Detection& d : *detections) {
+    bool overlaps = false;
+    for (const Detection& k : kept) {
+      if (Overlap(d, k) > max_overlap) {
+        overlaps = true;
+        break;
+      }
+    }
+    if (!overlaps) {
+      kept.push_back(d);
+    }
+  }
+  detections->swap(kept);
+}
+
+}  // namespace
+
+struct TiledDetector::Impl {
+  uint8_t tensor_arena[kTensorArenaSize];
+  tflite::MicroErrorReporter error_reporter;
+  tflite::MicroOpResolver<3> resolver;
+  std::unique_ptr<tflite::MicroInterpreter> interpreter;
+  std::vector<SharedLayer> layers;
+  // Level pixels per output pixel of the last shared layer
+  int align = 1;
+
+  std::vector<Plane> pyramid;
+  // Integral images of the pixels and of their squares
+  std::vector<uint32_t> sums;
+  std::vector<uint64_t> squares;
+  std::vector<uint8_t> scratch_in;
+  std::vector<uint8_t> scratch_out;
+
+  bool SetUpSharedLayers(int window_stride, int max_layers);
+  void BuildPyramid(const uint8_t* grey, int width, int height, int max_width,
+                    float scale_step);
+  void Integrate(const Plane& level);
+  bool IsFlat(int width, int x, int y, int min_contrast) const;
+  void RunRegion(const SharedLayer& layer, const View& in, int r0, int r1,
+                 int c0, int c1, uint8_t* out, int out_row_stride);
+  void ComputeLevel(const Plane& level);
+  void AssembleWindow(const Plane& level, int x, int y);
+  bool Score(int first_node, int* score);
+  void FillInput(const Plane& level, int x, int y);
+};
+
+TiledDetector::TiledDetector(const TiledDetectorConfig& config)
+    : config_(config), stats_() {}
+
+TiledDetector::~TiledDetector() {}
+
+bool TiledDetector::Init() {
+  impl_.reset(new Impl);
+  tflite::ErrorReporter* error_reporter = &impl_->error_reporter;
+  const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         model->version(), TFLITE_SCHEMA_VERSION);
+    return false;
+  }
+  impl_->resolver.AddBuiltin(
+      tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+      tflite::ops::micro::Register_DEPTHWISE_CONV_2D_SIMD());
+  impl_->resolver.AddBuiltin(tflite::BuiltinOperator_CONV_2D,
+                             tflite::ops::micro::Register_CONV_2D_SIMD());
+  impl_->resolver.AddBuiltin(
+      tflite::BuiltinOperator_AVERAGE_POOL_2D,
+      tflite::ops::micro::Register_AVERAGE_POOL_2D_SIMD());
+  impl_->interpreter.reset(new tflite::MicroInterpreter(
+      model, impl_->resolver, impl_->tensor_arena, kTensorArenaSize,
+      error_reporter));
+  if (impl_->interpreter->AllocateTensors() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    return false;
+  }
+  const TfLiteTensor* input = impl_->interpreter->input(0);
+  if (input->type != kTfLiteUInt8 && input->type != kTfLiteInt8) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Unsupported input type %s",
+                         TfLiteTypeGetName(input->type));
+    return false;
+  }
+  return impl_->SetUpSharedLayers(config_.window_stride,
+                                  config_.max_shared_layers);
+}
+
+// Walks the leading operators of the graph while they are uint8 depthwise or
+// 1x1 convolutions chained on their first input, with strides dividing the
+// window stride and a non empty interior.
+bool TiledDetector::Impl::SetUpSharedLayers(int window_stride,
+                                            int max_layers) {
+  layers.clear();
+  align = 1;
+  tflite::MicroInterpreter* interp = interpreter.get();
+  if (interp->input(0)->type != kTfLiteUInt8) {
+    return true;
+  }
+  TfLiteContext context = {};
+  context.impl_ = &error_reporter;
+  context.ReportError = ReportError;
+
+  int previous = interp->inputs()[0];
+  int in_height = kNumRows;
+  int in_width = kNumCols;
+  int top = 0, bottom = kNumRows, left = 0, right = kNumCols;
+  int scale = 1;
+  for (size_t i = 0; i < interp->operators_size() &&
+                     static_cast<int>(layers.size()) < max_layers;
+       i++) {
+    const tflite::NodeAndRegistration nr = interp->node_and_registration(i);
+    const TfLiteNode& node = nr.node;
+    if (node.inputs->size < 2 || node.inputs->data[0] != previous) {
+      break;
+    }
+    TfLiteTensor* input = interp->tensor(node.inputs->data[0]);
+    TfLiteTensor* filter = interp->tensor(node.inputs->data[1]);
+    TfLiteTensor* bias =
+        node.inputs->size > 2 ? interp->tensor(node.inputs->data[2]) : nullptr;
+    TfLiteTensor* output = interp->tensor(node.outputs->data[0]);
+    if (input->type != kTfLiteUInt8 || filter->type != kTfLiteUInt8 ||
+        output->type != kTfLiteUInt8) {
+      break;
+    }
+
+    SharedLayer layer = SharedLayer();
+    TfLiteFusedActivation activation;
+    layer.filter_height = filter->dims->data[1];
+    layer.filter_width = filter->dims->data[2];
+    int out_height, out_width;
+    if (nr.registration->builtin_code ==
+        tflite::BuiltinOperator_DEPTHWISE_CONV_2D) {
+      const auto* params =
+          static_cast<const TfLiteDepthwiseConvParams*>(node.builtin_data);
+      if (params->stride_height != params->stride_width ||
+          params->dilation_height_factor != 1 ||
+          params->dilation_width_factor != 1) {
+        break;
+      }
+      const TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(
+          params->stride_height, params->stride_width, 1, 1, in_height,
+          in_width, layer.filter_height, layer.filter_width, params->padding,
+          &out_height, &out_width);
+      layer.depthwise = true;
+      layer.stride = params->stride_height;
+      layer.pad_height = padding.height;
+      layer.pad_width = padding.width;
+      layer.dw_params.padding_type = tflite::PaddingType::kSame;
+      layer.dw_params.stride_width = layer.stride;
+      layer.dw_params.stride_height = layer.stride;
+      layer.dw_params.dilation_width_factor = 1;
+      layer.dw_params.dilation_height_factor = 1;
+      layer.dw_params.depth_multiplier = params->depth_multiplier;
+      activation = params->activation;
+    } else if (nr.registration->builtin_code ==
+               tflite::BuiltinOperator_CONV_2D) {
+      const auto* params =
+          static_cast<const TfLiteConvParams*>(node.builtin_data);
+      if (layer.filter_height != 1 || layer.filter_width != 1 ||
+          params->stride_height != 1 || params->stride_width != 1) {
+        break;
+      }
+      layer.depthwise = false;
+      layer.stride = 1;
+      layer.pad_height = 0;
+      layer.pad_width = 0;
+      out_height = in_height;
+      out_width = in_width;
+      activation = params->activation;
+    } else {
+      break;
+    }
+    if (window_stride % (scale * layer.stride) != 0 ||
+        output->dims->data[1] != out_height ||
+        output->dims->data[2] != out_width) {
+      break;
+    }
+
+    int32_t multiplier, per_channel_multiplier;
+    int shift, per_channel_shift;
+    int32_t activation_min, activation_max;
+    if (tflite::PopulateConvolutionQuantizationParams(
+            &context, input, filter, bias, output, activation, &multiplier,
+            &shift, &activation_min, &activation_max, &per_channel_multiplier,
+            &per_channel_shift, 1) != kTfLiteOk) {
+      break;
+    }
+    layer.output_multiplier = multiplier;
+    // Legacy ops used mixed left and right shifts. Now all are
+    // +ve-means-left.
+    layer.output_shift = -shift;
+    layer.dw_params.input_offset = -input->params.zero_point;
+    layer.dw_params.weights_offset = -filter->params.zero_point;
+    layer.dw_params.output_offset = output->params.zero_point;
+    layer.dw_params.quantized_activation_min = activation_min;
+    layer.dw_params.quantized_activation_max = activation_max;
+    layer.fc_params.input_offset = -input->params.zero_point;
+    layer.fc_params.weights_offset = -filter->params.zero_point;
+    layer.fc_params.output_offset = output->params.zero_point;
+    layer.fc_params.output_multiplier = multiplier;
+    layer.fc_params.output_shift = -shift;
+    layer.fc_params.quantized_activation_min = activation_min;
+    layer.fc_params.quantized_activation_max = activation_max;
+    layer.filter = filter->data.uint8;
+    layer.bias = bias != nullptr ? bias->data.i32 : nullptr;
+    layer.out_depth = output->dims->data[3];
+    layer.out_height = out_height;
+    layer.out_width = out_width;
+    InnerRange(top, bottom, layer.stride, layer.pad_height,
+               layer.filter_height, out_height, &layer.inner_top,
+               &layer.inner_bottom);
+    InnerRange(left, right, layer.stride, layer.pad_width, layer.filter_width,
+               out_width, &layer.inner_left, &layer.inner_right);
+    if (layer.inner_top == layer.inner_bottom ||
+        layer.inner_left == layer.inner_right) {
+      break;
+    }
+    scale *= layer.stride;
+    layer.scale = scale;
+    layers.push_back(layer);
+
+    previous = node.outputs->data[0];
+    in_height = out_height;
+    in_width = out_width;
+    top = layer.inner_top;
+    bottom = layer.inner_bottom;
+    left = layer.inner_left;
+    right = layer.inner_right;
+  }
+
+  // The remaining operators may only read the output of the last shared
+  // layer among the tensors computed by the shared ones
+  while (!layers.empty()) {
+    const size_t count = layers.size();
+    std::set<int> skipped = {interp->inputs()[0]};
+    for (size_t i = 0; i + 1 < count; i++) {
+      skipped.insert(interp->node_and_registration(i).node.outputs->data[0]);
+    }
+    bool reads_skipped = false;
+    for (size_t i = count; i < interp->operators_size(); i++) {
+      const TfLiteIntArray* inputs =
+          interp->node_and_registration(i).node.inputs;
+      for (int j = 0; j < inputs->size; j++) {
+        reads_skipped = reads_skipped || skipped.count(inputs->data[j]) > 0;
+      }
+    }
+    if (!reads_skipped) {
+      break;
+    }
+    layers.pop_back();
+  }
+  if (layers.empty()) {
+    return true;
+  }
+  for (size_t i = 0; i + 1 < layers.size(); i++) {
+    SharedLayer& layer = layers[i];
+    layer.window.resize(layer.out_height * layer.out_width * layer.out_depth);
+    layer.window_data = layer.window.data();
+  }
+  const int last = layers.size() - 1;
+  layers[last].window_data =
+      interp->tensor(interp->node_and_registration(last).node.outputs->data[0])
+          ->data.uint8;
+  align = layers[last].scale;
+  return true;
+}
+
+void TiledDetector::Impl::BuildPyramid(const uint8_t* grey, int width,
+                                       int height, int max_width,
+                                       float scale_step) {
+  pyramid.resize(1);
+  Plane& frame = pyramid[0];
+  frame.Resize(height, width, 1);
+  memcpy(frame.pixels.data(), grey, frame.pixels.size());
+  while (max_width > 0 && frame.width > max_width &&
+         frame.width / 2 >= kNumCols && frame.height / 2 >= kNumRows) {
+    Plane half;
+    Halve(frame, &half);
+    frame.pixels.swap(half.pixels);
+    frame.height = half.height;
+    frame.width = half.width;
+  }
+  for (;;) {
+    const Plane& last = pyramid.back();
+    const int w = static_cast<int>(std::lround(last.width * scale_step));
+    const int h = static_cast<int>(std::lround(last.height * scale_step));
+    if (w < kNumCols || h < kNumRows || w >= last.width) {
+      break;
+    }
+    Plane next;
+    ScaleBilinear(last, w, h, &next);
+    pyramid.push_back(std::move(next));
+  }
+}
+
+void TiledDetector::Impl::Integrate(const Plane& level) {
+  const int stride = level.width + 1;
+  sums.assign(static_cast<size_t>(stride) * (level.height + 1), 0);
+  squares.assign(sums.size(), 0);
+  for (int y = 0; y < level.height; y++) {
+    const uint8_t* row = level.pixels.data() + y * level.width;
+    uint32_t sum = 0;
+    uint64_t square = 0;
+    for (int x = 0; x < level.width; x++) {
+      sum += row[x];
+      square += row[x] * row[x];
+      const size_t i = (y + 1) * stride + x + 1;
+      sums[i] = sums[i - stride] + sum;
+      squares[i] = squares[i - stride] + square;
+    }
+  }
+}
+
+// Standard deviation of the window under min_contrast
+bool TiledDetector::Impl::IsFlat(int width, int x, int y,
+                                 int min_contrast) const {
+  const int stride = width + 1;
+  const size_t a = y * stride + x;
+  const size_t b = a + kNumCols;
+  const size_t c = a + kNumRows * stride;
+  const size_t d = c + kNumCols;
+  const int64_t n = kNumCols * kNumRows;
+  const int64_t sum = static_cast<int64_t>(sums[d]) - sums[b] - sums[c] +
+                      sums[a];
+  const int64_t square = static_cast<int64_t>(squares[d] - squares[b] -
+                                              squares[c] + squares[a]);
+  // n^2 variance against n^2 min_contrast^2
+  const int64_t limit = n * min_contrast;
+  return n * square - sum * sum < limit * limit;
+}
+
+// Output pixels [r0, r1) x [c0, c1) of a shared layer computed on the input
+// view, the pixels outside of the view are padding
+void TiledDetector::Impl::RunRegion(const SharedLayer& layer, const View& in,
+                                    int r0, int r1, int c0, int c1,
+                                    uint8_t* out, int out_row_stride) {
+  if (r0 >= r1 || c0 >= c1) {
+    return;
+  }
+  const int row_origin = r0 * layer.stride - layer.pad_height;
+  const int col_origin = c0 * layer.stride - layer.pad_width;
+  const int i0 = std::max(row_origin, 0);
+  const int i1 = std::min((r1 - 1) * layer.stride - layer.pad_height +
+                              layer.filter_height,
+                          in.height);
+  const int j0 = std::max(col_origin, 0);
+  const int j1 = std::min(
+      (c1 - 1) * layer.stride - layer.pad_width + layer.filter_width,
+      in.width);
+  const int rows = i1 - i0;
+  const int cols = j1 - j0;
+  const uint8_t* input = in.data + i0 * in.row_stride + j0 * in.depth;
+  if (cols * in.depth != in.row_stride) {
+    scratch_in.resize(static_cast<size_t>(rows) * cols * in.depth);
+    for (int i = 0; i < rows; i++) {
+      memcpy(scratch_in.data() + i * cols * in.depth,
+             input + i * in.row_stride, cols * in.depth);
+    }
+    input = scratch_in.data();
+  }
+  const int out_rows = r1 - r0;
+  const int out_cols = c1 - c0;
+  const int out_size = out_cols * layer.out_depth;
+  uint8_t* output = out + r0 * out_row_stride + c0 * layer.out_depth;
+  if (out_size != out_row_stride) {
+    scratch_out.resize(static_cast<size_t>(out_rows) * out_size);
+    output = scratch_out.data();
+  }
+
+  if (layer.depthwise) {
+    tflite::DepthwiseParams params = layer.dw_params;
+    params.padding_values.height = i0 - row_origin;
+    params.padding_values.width = j0 - col_origin;
+    tflite::simd_ops::DepthwiseConv<uint8_t>(
+        params, &layer.output_multiplier, &layer.output_shift,
+        /*quant_step=*/0, tflite::RuntimeShape({1, rows, cols, in.depth}),
+        input,
+        tflite::RuntimeShape(
+            {1, layer.filter_height, layer.filter_width, layer.out_depth}),
+        layer.filter, layer.bias,
+        tflite::RuntimeShape({1, out_rows, out_cols, layer.out_depth}),
+        output);
+  } else {
+    // The 1x1 convolution is a fully connected layer over the pixels
+    tflite::simd_ops::FullyConnected<uint8_t>(
+        layer.fc_params, tflite::RuntimeShape({rows * cols, in.depth}), input,
+        tflite::RuntimeShape({layer.out_depth, in.depth}), layer.filter,
+        layer.bias,
+        tflite::RuntimeShape({out_rows * out_cols, layer.out_depth}), output);
+  }
+
+  if (output == scratch_out.data()) {
+    for (int i = 0; i < out_rows; i++) {
+      memcpy(out + (r0 + i) * out_row_stride + c0 * layer.out_depth,
+             output + i * out_size, out_size);
+    }
+  }
+}
+
+// Shared layers on the whole level. The SAME output size covers the whole
+// input, the level planes are used without copies.
+void TiledDetector::Impl::ComputeLevel(const Plane& level) {
+  View in = WholeView(level);
+  for (SharedLayer& layer : layers) {
+    const int height = (in.height + layer.stride - 1) / layer.stride;
+    const int width = (in.width + layer.stride - 1) / layer.stride;
+    layer.level.Resize(height, width, layer.out_depth);
+    RunRegion(layer, in, 0, height, 0, width, layer.level.pixels.data(),
+              width * layer.out_depth);
+    in = WholeView(layer.level);
+  }
+}
+
+// Shared layers of the window at (x, y): interior copied from the level
+// outputs, border recomputed on the window
+void TiledDetector::Impl::AssembleWindow(const Plane& level, int x, int y) {
+  View in = {level.pixels.data() + y * level.width + x, kNumRows, kNumCols, 1,
+             level.width};
+  for (SharedLayer& layer : layers) {
+    const int depth = layer.out_depth;
+    const int row_stride = layer.out_width * depth;
+    const int inner_size = (layer.inner_right - layer.inner_left) * depth;
+    const uint8_t* src =
+        layer.level.pixels.data() +
+        ((y / layer.scale + layer.inner_top) * layer.level.width +
+         x / layer.scale + layer.inner_left) *
+            depth;
+    uint8_t* dst = layer.window_data + layer.inner_top * row_stride +
+                   layer.inner_left * depth;
+    for (int r = layer.inner_top; r < layer.inner_bottom; r++) {
+      memcpy(dst, src, inner_size);
+      src += layer.level.width * depth;
+      dst += row_stride;
+    }
+    RunRegion(layer, in, 0, layer.inner_top, 0, layer.out_width,
+              layer.window_data, row_stride);
+    RunRegion(layer, in, layer.inner_bottom, layer.out_height, 0,
+              layer.out_width, layer.window_data, row_stride);
+    RunRegion(layer, in, layer.inner_top, layer.inner_bottom, 0,
+              layer.inner_left, layer.window_data, row_stride);
+    RunRegion(layer, in, layer.inner_top, layer.inner_bottom,
+              layer.inner_right, layer.out_width, layer.window_data,
+              row_stride);
+    in = {layer.window_data, layer.out_height, layer.out_width, depth,
+          row_stride};
+  }
+}
+
+void TiledDetector::Impl::FillInput(const Plane& level, int x, int y) {
+  TfLiteTensor* input = interpreter->input(0);
+  for (int r = 0; r < kNumRows; r++) {
+    const uint8_t* row = level.pixels.data() + (y + r) * level.width + x;
+    if (input->type == kTfLiteInt8) {
+      int8_t* dst = input->data.int8 + r * kNumCols;
+      for (int c = 0; c < kNumCols; c++) {
+        dst[c] = static_cast<int8_t>(row[c] - 128);
+      }
+    } else {
+      memcpy(input->data.uint8 + r * kNumCols, row, kNumCols);
+    }
+  }
+}
+
+// Person score in the 0-255 range of the uint8 model
+bool TiledDetector::Impl::Score(int first_node, int* score) {
+  if (interpreter->Invoke(first_node) != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(&error_reporter, "Invoke failed");
+    return false;
+  }
+  const TfLiteTensor* output = interpreter->output(0);
+  *score = output->type == kTfLiteInt8
+               ? output->data.int8[kPersonIndex] + 128
+               : output->data.uint8[kPersonIndex];
+  return true;
+}
+
+bool TiledDetector::Detect(const uint8_t* grey, int width, int height,
+                           std::vector<Detection>* detections) {
+  detections->clear();
+  stats_ = TiledDetectorStats();
+  if (!impl_ || width < kNumCols || height < kNumRows) {
+    return false;
+  }
+  Impl& impl = *impl_;
+  const uint32_t start = tflite::GetCurrentTimeTicks();
+  impl.BuildPyramid(grey, width, height, config_.max_width,
+                    config_.scale_step);
+  stats_.pyramid_us = ElapsedUs(start);
+  stats_.levels = impl.pyramid.size();
+  stats_.shared_layers = impl.layers.size();
+  const int shared = impl.layers.size();
+
+  for (int l = 0; l < stats_.levels; l++) {
+    const Plane& level = impl.pyramid[l];
+    const float scale_x = static_cast<float>(width) / level.width;
+    const float scale_y = static_cast<float>(height) / level.height;
+    uint32_t t = tflite::GetCurrentTimeTicks();
+    if (config_.min_contrast > 0) {
+      impl.Integrate(level);
+    }
+    stats_.pyramid_us += ElapsedUs(t);
+    bool level_computed = false;
+    for (int y : WindowOrigins(level.height, kNumRows, config_.window_stride,
+                               impl.align)) {
+      for (int x : WindowOrigins(level.width, kNumCols,
+                                 config_.window_stride, impl.align)) {
+        stats_.windows++;
+        if (config_.min_contrast > 0 &&
+            impl.IsFlat(level.width, x, y, config_.min_contrast)) {
+          stats_.rejected++;
+          continue;
+        }
+        int score;
+        if (shared > 0) {
+          t = tflite::GetCurrentTimeTicks();
+          if (!level_computed) {
+            impl.ComputeLevel(level);
+            level_computed = true;
+          }
+          impl.AssembleWindow(level, x, y);
+          stats_.shared_us += ElapsedUs(t);
+        } else {
+          impl.FillInput(level, x, y);
+        }
+        t = tflite::GetCurrentTimeTicks();
+        if (!impl.Score(shared, &score)) {
+          return false;
+        }
+        stats_.invoke_us += ElapsedUs(t);
+        stats_.invoked++;
+        if (config_.verify_sharing && shared > 0) {
+          int full_score;
+          impl.FillInput(level, x, y);
+          if (!impl.Score(0, &full_score)) {
+            return false;
+          }
+          stats_.mismatches += full_score != score ? 1 : 0;
+        }
+        if (score > config_.threshold) {
+          Detection d;
+          d.x = static_cast<int>(std::lround(x * scale_x));
+          d.y = static_cast<int>(std::lround(y * scale_y));
+          d.size = static_cast<int>(std::lround(kNumCols * scale_x));
+          d.score = score;
+          d.level = l;
+          detections->push_back(d);
+        }
+      }
+    }
+  }
+  Suppress(config_.nms_iou, detections);
+  stats_.total_us = ElapsedUs(start);
+  return true;
+}
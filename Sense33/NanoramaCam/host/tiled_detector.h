@@ -0,0 +1,116 @@
+/**
+ * @file tiled_detector.h
+ * @brief Person detection over whole frames with an image pyramid of
+ * overlapping 96x96 windows.
+ *
+ * The frame is halved down to max_width, then scaled by scale_step until
+ * the short side is under 96 pixels. Every level is scanned with windows
+ * window_stride pixels apart: the flat windows (standard deviation under
+ * min_contrast) are rejected without running the model, the others are
+ * run through the person detection model and the windows over threshold
+ * are merged across the levels by a greedy non-maximum suppression.
+ *
+ * The leading depthwise and 1x1 convolutions of the model are shared by
+ * the overlapping windows: they are computed once on the whole level, the
+ * window copies its part of the level outputs, recomputes only the border
+ * pixels where the zero padding of the window differs from the level, and
+ * the interpreter resumes the graph after the shared layers. The scores
+ * are the same of a full inference on every window.
+ *
+ * The header only needs the standard library, the NanoramaCam TFLM stack
+ * is linked from libpersondetect.a (host Makefile) by the Raspberry Pi
+ * application.
+ *
+ * @author Enrico Miglino <balearicdynamics@gmail.com>
+ * @version 1.0
+ * @date October 2026
+ */
+
+#ifndef TILED_DETECTOR_H
+#define TILED_DETECTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct TiledDetectorConfig {
+  //! Step between the windows of a level, in level pixels
+  int window_stride = 48;
+  //! Size ratio of two consecutive levels after the halvings
+  float scale_step = 0.75f;
+  //! Frames wider than this are halved first (0 keeps the full frame)
+  int max_width = 640;
+  //! Person score (0-255) of a detection, same of NanoramaCam.ino
+  int threshold = 150;
+  //! Max intersection over union of two kept detections
+  float nms_iou = 0.3f;
+  //! Min standard deviation of the window pixels (0 runs every window).
+  //! The person windows of the test corpus are all over 25.
+  int min_contrast = 10;
+  //! Max number of leading layers shared by the windows (0 disables)
+  int max_shared_layers = 3;
+  //! Runs the full model on the windows too and counts the mismatches
+  bool verify_sharing = false;
+};
+
+//! Square detection box in frame pixels
+struct Detection {
+  int x;
+  int y;
+  int size;
+  int score;
+  int level;
+};
+
+struct TiledDetectorStats {
+  int levels;
+  int windows;
+  //! Windows rejected by the contrast test
+  int rejected;
+  //! Windows run through the model
+  int invoked;
+  //! Layers shared by the windows of a level
+  int shared_layers;
+  //! Shared windows scoring differently from the full model (verify_sharing)
+  int mismatches;
+  int64_t pyramid_us;
+  int64_t shared_us;
+  int64_t invoke_us;
+  int64_t total_us;
+};
+
+class TiledDetector {
+ public:
+  explicit TiledDetector(const TiledDetectorConfig& config =
+                             TiledDetectorConfig());
+  ~TiledDetector();
+
+  //! Loads the model on the SIMD kernels, false on error
+  bool Init();
+
+  /**
+   * Detects the people of a greyscale frame, at least 96x96.
+   *
+   * @param grey Frame pixels, row major without padding
+   * @param width Frame width
+   * @param height Frame height
+   * @param detections Detections after the suppression, best first
+   * @return false on error
+   */
+  bool Detect(const uint8_t* grey, int width, int height,
+              std::vector<Detection>* detections);
+
+  //! Statistics of the last Detect()
+  const TiledDetectorStats& stats() const { return stats_; }
+
+  const TiledDetectorConfig& config() const { return config_; }
+
+ private:
+  struct Impl;
+
+  TiledDetectorConfig config_;
+  TiledDetectorStats stats_;
+  std::unique_ptr<Impl> impl_;
+};
+
+#endif  // TILED_DETECTOR_H
@@ -11,6 +11,10 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+Added the capture path selection of the Arducam providers and the split
+capture functions of capture_pipeline.h. E.M.
+
 ==============================================================================*/
 
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_PROVIDER_H_
@@ -19,6 +23,11 @@ limitations under the License.
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
+// The Arducam frames are captured as JPEG and decoded
+// (arduino_image_provider.cpp). Define to capture the raw sensor luminance
+// streamed into the image instead (arduino_raw_image_provider.cpp)
+#undef _RAW_CAPTURE
+
 // This is an abstraction around an image source like a camera, and is
 // expected to return 8-bit sample data.  The assumption is that this will be
 // called in a low duty-cycle fashion in a low-power application.  In these
@@ -36,4 +45,14 @@ limitations under the License.
 TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
                       int image_height, int channels, uint8_t* image_data);
 
+// GetImage() in two steps for the overlapped capture of capture_pipeline.h:
+// StartImageCapture() makes the camera capture a frame into its own FIFO and
+// returns, the frame is read into image_data by ReadCapturedImage(), which
+// waits for the end of the capture if needed. Only the Arducam providers
+// implement them.
+TfLiteStatus StartImageCapture(tflite::ErrorReporter* error_reporter);
+TfLiteStatus ReadCapturedImage(tflite::ErrorReporter* error_reporter,
+                               int image_width, int image_height,
+                               int channels, uint8_t* image_data);
+
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_PROVIDER_H_
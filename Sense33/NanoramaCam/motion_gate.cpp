@@ -0,0 +1,84 @@
+/* Motion gate of NanoramaCam.ino, see motion_gate.h. E.M.
+*/
+
+#include "motion_gate.h"
+
+namespace {
+
+constexpr int kBlockPixels = kMotionBlockSize * kMotionBlockSize;
+static_assert(kMotionBlockSize == 4, "BlockSums() adds 4 pixels per row");
+
+// Sums of the 4x4 blocks of the image
+void BlockSums(const uint8_t* image, uint16_t* sums) {
+  for (int by = 0; by < kMotionBlockRows; by++) {
+    uint16_t* row_sums = sums + by * kMotionBlockCols;
+    for (int bx = 0; bx < kMotionBlockCols; bx++) {
+      row_sums[bx] = 0;
+    }
+    for (int y = 0; y < kMotionBlockSize; y++) {
+      const uint8_t* pixels = image + (by * kMotionBlockSize + y) * kNumCols;
+      for (int bx = 0; bx < kMotionBlockCols; bx++) {
+        row_sums[bx] += pixels[0] + pixels[1] + pixels[2] + pixels[3];
+        pixels += kMotionBlockSize;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+MotionGate::MotionGate() {
+  for (int i = 0; i < kMotionBlocks; i++) {
+    reference_[i] = 0;
+  }
+}
+
+uint32_t MotionGate::BlockLimit() const {
+  const uint32_t noise = (noise_q4_ * kMotionNoiseGain) >> 4;
+  const uint32_t min = kMotionMinThreshold * kBlockPixels;
+  return noise > min ? noise : min;
+}
+
+int MotionGate::threshold() const {
+  return static_cast<int>(BlockLimit() / kBlockPixels);
+}
+
+uint8_t MotionGate::skipped_percent() const {
+  return frames_ == 0 ? 0 : static_cast<uint8_t>(skipped_ * 100 / frames_);
+}
+
+bool MotionGate::Check(const uint8_t* image) {
+  uint16_t sums[kMotionBlocks];
+  BlockSums(image, sums);
+  frames_++;
+
+  const uint32_t limit = BlockLimit();
+  int changed = 0;
+  uint32_t total = 0;
+  for (int i = 0; i < kMotionBlocks; i++) {
+    const uint32_t diff = sums[i] > reference_[i] ? sums[i] - reference_[i]
+                                                  : reference_[i] - sums[i];
+    total += diff;
+    changed += diff > limit;
+  }
+
+  if (has_reference_ && changed < kMotionSceneBlocks) {
+    // Same scene: the mean difference follows the noise of the sensor, a
+    // few moving blocks don't count. Measured on the inferred frames too,
+    // otherwise a noise over the smallest threshold would never be learned.
+    const uint32_t mean_q4 = (total << 4) / kMotionBlocks;
+    noise_q4_ = noise_q4_ + mean_q4 / 8 - noise_q4_ / 8;
+  }
+  if (has_reference_ && changed < kMotionMinBlocks &&
+      skips_in_row_ < kMotionMaxSkips) {
+    skips_in_row_++;
+    skipped_++;
+    return false;
+  }
+  for (int i = 0; i < kMotionBlocks; i++) {
+    reference_[i] = sums[i];
+  }
+  has_reference_ = true;
+  skips_in_row_ = 0;
+  return true;
+}
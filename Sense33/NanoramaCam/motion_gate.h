@@ -0,0 +1,71 @@
+/* Motion gate of NanoramaCam.ino: the inference is skipped, and the last
+scores are reused, when the image doesn't differ from the last one inferred.
+The image is reduced to the sums of its 4x4 blocks and compared block by
+block with the ones of the last inferred image, the reference. A block
+changed if its absolute difference is over a threshold following the
+sensor noise, measured on the frames without a change of scene. A pass
+over the 9216 pixels per frame against the second of the inference;
+host/motion_gate_sim measures the skips and the error of the reused scores.
+E.M.
+*/
+
+#ifndef NANORAMACAM_MOTION_GATE_H_
+#define NANORAMACAM_MOTION_GATE_H_
+
+#include <cstdint>
+
+#include "model_settings.h"
+
+// Side of the blocks summed
+constexpr int kMotionBlockSize = 4;
+constexpr int kMotionBlockCols = kNumCols / kMotionBlockSize;
+constexpr int kMotionBlockRows = kNumRows / kMotionBlockSize;
+constexpr int kMotionBlocks = kMotionBlockCols * kMotionBlockRows;
+static_assert(kNumCols % kMotionBlockSize == 0 &&
+                  kNumRows % kMotionBlockSize == 0,
+              "The image must be made of whole blocks");
+
+// Smallest block threshold, in grey levels of the block mean
+constexpr int kMotionMinThreshold = 4;
+// Threshold in multiples of the mean block difference of the static frames
+constexpr int kMotionNoiseGain = 5;
+// Changed blocks making a motion
+constexpr int kMotionMinBlocks = 3;
+// Changed blocks making a change of scene, not used for the noise
+constexpr int kMotionSceneBlocks = kMotionBlocks / 4;
+// An inference at least every kMotionMaxSkips frames
+constexpr int kMotionMaxSkips = 30;
+
+class MotionGate {
+ public:
+  MotionGate();
+
+  // Returns true if the kNumCols x kNumRows image must be inferred: it is
+  // the first, it moved since the reference or too many frames were
+  // skipped. The image becomes the reference, the caller runs the model.
+  // false means the last scores still hold.
+  bool Check(const uint8_t* image);
+
+  // Images checked and skipped since the start
+  uint32_t frames() const { return frames_; }
+  uint32_t skipped() const { return skipped_; }
+  // Skipped percentage, 0 to 100
+  uint8_t skipped_percent() const;
+  // Current block threshold, in grey levels of the block mean
+  int threshold() const;
+
+ private:
+  // Threshold of the block differences, in block sum units
+  uint32_t BlockLimit() const;
+
+  // Block sums of the reference image
+  uint16_t reference_[kMotionBlocks];
+  // Mean block difference of the frames, Q4 of the block sum
+  uint32_t noise_q4_ = 0;
+  bool has_reference_ = false;
+  int skips_in_row_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t skipped_ = 0;
+};
+
+#endif  // NANORAMACAM_MOTION_GATE_H_
@@ -0,0 +1,41 @@
+/* Generated by host/person_detect_plan -k gemm, don't edit. E.M. */
+
+#include "person_detect_memory_plan.h"
+
+// size, first node, last node, offset
+const tflite::PlannedBuffer g_person_detect_memory_plan[] = {
+    {18432, 0, 1, 0},
+    {4608, 19, 20, 0},
+    {4608, 20, 21, 4608},
+    {4608, 21, 22, 0},
+    {4608, 22, 23, 4608},
+    {1152, 23, 24, 2304},
+    {2304, 24, 25, 0},
+    {2304, 25, 26, 2304},
+    {2304, 26, 27, 0},
+    {18432, 1, 2, 36864},
+    {36864, 2, 3, 0},
+    {9216, 3, 4, 36864},
+    {18432, 4, 5, 0},
+    {18432, 5, 6, 18432},
+    {18432, 6, 7, 0},
+    {4608, 7, 8, 18432},
+    {9216, 8, 9, 0},
+    {9216, 9, 10, 9216},
+    {9216, 10, 11, 0},
+    {2304, 11, 12, 9216},
+    {4608, 12, 13, 0},
+    {4608, 13, 14, 4608},
+    {4608, 14, 15, 0},
+    {4608, 15, 16, 4608},
+    {4608, 16, 17, 0},
+    {4608, 17, 18, 4608},
+    {4608, 18, 19, 9216},
+    {256, 27, 28, 2304},
+    {16, 28, 28, 0},
+    {9216, 0, 0, 18432},
+};
+
+const int g_person_detect_memory_plan_len =
+    sizeof(g_person_detect_memory_plan) /
+    sizeof(g_person_detect_memory_plan[0]);
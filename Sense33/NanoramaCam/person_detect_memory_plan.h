@@ -0,0 +1,17 @@
+/* Arena layout of the person detection model, computed offline
+for the gemm kernels of the NanoramaCam.ino op resolver and replayed by the
+PrecomputedMemoryPlanner. It was created using the command:
+host/person_detect_plan -k gemm -o ..
+Run it again after changing the model or the kernels. E.M.
+*/
+
+#ifndef NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_
+#define NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_
+
+#include "tensorflow/lite/micro/memory_planner/precomputed_memory_planner.h"
+
+// Activation and scratch buffers in the AddBuffer() order, 55296 bytes of arena
+extern const tflite::PlannedBuffer g_person_detect_memory_plan[];
+extern const int g_person_detect_memory_plan_len;
+
+#endif  // NANORAMACAM_PERSON_DETECT_MEMORY_PLAN_H_
@@ -15,8 +15,10 @@ limitations under the License.
 
 // This is a standard TensorFlow Lite model file that has been converted into a
 // C data array, so it can be easily compiled into a binary for devices that
-// don't have a file system. It was created using the command:
+// don't have a file system. The metadata holds the requantization tables of
+// the convolutions (micro_requantization.h). It was created using the commands:
 // xxd -i person_detect.tflite > person_detect_model_data.cc
+// host/person_detect_requant -o ..
 
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PERSON_DETECT_MODEL_DATA_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PERSON_DETECT_MODEL_DATA_H_
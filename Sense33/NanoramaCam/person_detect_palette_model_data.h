@@ -0,0 +1,14 @@
+/* Person detection model with the CONV_2D filters palettized to 4 bits
+(palette_weights.h), only the gemm kernels of the NanoramaCam.ino op
+resolver can run it. It was created using the command:
+host/person_detect_compress -o ..
+Run it again after changing person_detect_model_data. E.M.
+*/
+
+#ifndef NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_
+#define NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_
+
+extern const unsigned char g_person_detect_palette_model_data[];
+extern const int g_person_detect_palette_model_data_len;
+
+#endif  // NANORAMACAM_PERSON_DETECT_PALETTE_MODEL_DATA_H_
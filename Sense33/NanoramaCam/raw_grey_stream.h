@@ -0,0 +1,91 @@
+/* Crop and downsample of the raw luminance frames of the Arducam FIFO,
+streamed into the input tensor as they are read (arduino_raw_image_provider
+.cpp) and checked on the host with a simulated FIFO
+(host/image_provider_bench). The centered square of 5/4 the image side is
+area averaged 5:4 in both directions: every output pixel is the weighted sum
+of at most 2x2 sensor pixels, weights in quarters of pixel. Only a row of
+horizontal sums and two row accumulators are kept, the rows below the crop
+are not read. E.M.
+*/
+
+#ifndef NANORAMACAM_RAW_GREY_STREAM_H_
+#define NANORAMACAM_RAW_GREY_STREAM_H_
+
+#include <cstdint>
+
+// Widest image of the row accumulators
+constexpr int kRawGreyStreamMaxWidth = 128;
+
+// Byte layout of the sensor frames
+enum class RawFormat {
+  // 8-bit luminance (OV2640 Y8)
+  kY8,
+  // YUV422, the luminance first: Y0 U Y1 V
+  kYuyv,
+};
+
+// Reads the image_width x image_height greyscale image from the frame of
+// source_width x source_height pixels at the head of fifo, which provides
+// uint8_t Read() and void Skip(int bytes). The image must be square, its
+// side a multiple of 4 and 5/4 of it must fit the frame. Returns false if
+// the sizes don't fit, nothing is read.
+template <typename Fifo>
+bool StreamRawToGrey(Fifo* fifo, int source_width, int source_height,
+                     RawFormat format, int image_width, int image_height,
+                     uint8_t* image_data) {
+  const int crop = image_height * 5 / 4;
+  if (image_width != image_height || image_height % 4 != 0 ||
+      image_width > kRawGreyStreamMaxWidth || crop > source_width ||
+      crop > source_height) {
+    return false;
+  }
+  const int bytes_per_pixel = format == RawFormat::kYuyv ? 2 : 1;
+  const int x0 = (source_width - crop) / 2;
+  const int y0 = (source_height - crop) / 2;
+  const int row_bytes = source_width * bytes_per_pixel;
+  // Horizontal sums of the current row (weights sum 5) and the two output
+  // rows in progress (weights sum 25)
+  uint16_t sums[kRawGreyStreamMaxWidth];
+  uint16_t acc[2][kRawGreyStreamMaxWidth];
+
+  fifo->Skip(y0 * row_bytes);
+  for (int y = 0; y < crop; y++) {
+    fifo->Skip(x0 * bytes_per_pixel);
+    for (int x = 0; x < image_width; x += 4) {
+      uint32_t s[5];
+      for (int i = 0; i < 5; i++) {
+        s[i] = fifo->Read();
+        if (format == RawFormat::kYuyv) {
+          fifo->Skip(1);
+        }
+      }
+      sums[x] = static_cast<uint16_t>(4 * s[0] + s[1]);
+      sums[x + 1] = static_cast<uint16_t>(3 * s[1] + 2 * s[2]);
+      sums[x + 2] = static_cast<uint16_t>(2 * s[2] + 3 * s[3]);
+      sums[x + 3] = static_cast<uint16_t>(s[3] + 4 * s[4]);
+    }
+    // The sensor rows of a group of 5 add to the 4 output rows with the
+    // weights 4, 1+3, 2+2, 3+1, 4: every sensor row but the first of the
+    // group completes an output row and starts the next one
+    const int phase = y % 5;
+    if (phase == 0) {
+      for (int x = 0; x < image_width; x++) {
+        acc[0][x] = 4 * sums[x];
+      }
+    } else {
+      const uint16_t* done = acc[(phase + 1) & 1];
+      uint16_t* next = acc[phase & 1];
+      uint8_t* out = image_data + (y / 5 * 4 + phase - 1) * image_width;
+      for (int x = 0; x < image_width; x++) {
+        out[x] = static_cast<uint8_t>((done[x] + phase * sums[x] + 12) / 25);
+        next[x] = (4 - phase) * sums[x];
+      }
+    }
+    if (y != crop - 1) {
+      fifo->Skip(row_bytes - (x0 + crop) * bytes_per_pixel);
+    }
+  }
+  return true;
+}
+
+#endif  // NANORAMACAM_RAW_GREY_STREAM_H_
@@ -0,0 +1,100 @@
+/* Fixed point RGB565 to greyscale conversion and cropping of the JPEG MCUs
+of the Arducam frames, shared by arduino_image_provider.cpp and the host
+harness (host/image_provider_bench). The luminance weights of the original
+double precision 0.2126 r + 0.7152 g + 0.0722 b are in Q16, scaled by the
+5 and 6 bits of the colors: the truncated result is the same for all the
+65536 RGB565 values, the Cortex-M4F has no double precision FPU. E.M.
+*/
+
+#ifndef NANORAMACAM_RGB565_GREY_H_
+#define NANORAMACAM_RGB565_GREY_H_
+
+#include <cstdint>
+#include <cstring>
+
+// Q16 weights of the 5 bits red (x 8), 6 bits green (x 4) and 5 bits blue
+// (x 8) values. The largest sum is below 2^24
+constexpr uint32_t kGreyWeightR = 111464;
+constexpr uint32_t kGreyWeightG = 187486;
+constexpr uint32_t kGreyWeightB = 37854;
+
+inline uint8_t Rgb565ToGrey(uint32_t color) {
+  return static_cast<uint8_t>(
+      ((color >> 11) * kGreyWeightR + ((color >> 5) & 0x3F) * kGreyWeightG +
+       (color & 0x1F) * kGreyWeightB) >>
+      16);
+}
+
+// Converts count pixels, two per 32-bit load: the color fields of both
+// pixels are extracted with one shift and mask
+inline void Rgb565RowToGrey(const uint16_t* src, int count, uint8_t* dst) {
+  int i = 0;
+  for (; i + 1 < count; i += 2) {
+    uint32_t pair;
+    memcpy(&pair, src + i, sizeof(pair));
+    const uint32_t r = (pair >> 11) & 0x001F001F;
+    const uint32_t g = (pair >> 5) & 0x003F003F;
+    const uint32_t b = pair & 0x001F001F;
+    // Little endian, the first pixel is in the low half
+    dst[i] = static_cast<uint8_t>(((r & 0xFFFF) * kGreyWeightR +
+                                   (g & 0xFFFF) * kGreyWeightG +
+                                   (b & 0xFFFF) * kGreyWeightB) >>
+                                  16);
+    dst[i + 1] = static_cast<uint8_t>(
+        ((r >> 16) * kGreyWeightR + (g >> 16) * kGreyWeightG +
+         (b >> 16) * kGreyWeightB) >>
+        16);
+  }
+  if (i < count) {
+    dst[i] = Rgb565ToGrey(src[i]);
+  }
+}
+
+// Crops the centered image_width x image_height greyscale image from the
+// MCUs of a JPEG parsed by decoder (JpegDec of the JPEGDecoder library or
+// the host stand-in). The entropy coded data can't be skipped, the MCUs
+// before the last kept one are decoded, but the decoder is stopped after
+// it: the MCU rows below the crop are never decoded. Returns the MCUs
+// decoded.
+template <typename Decoder>
+int DecodeMcusToGrey(Decoder* decoder, int image_width, int image_height,
+                     uint8_t* image_data) {
+  // Crop the image by keeping a certain number of MCUs in each dimension,
+  // roughly centered
+  const int keep_x_mcus = image_width / decoder->MCUWidth;
+  const int keep_y_mcus = image_height / decoder->MCUHeight;
+  const int skip_start_x_mcus = (decoder->MCUSPerRow - keep_x_mcus) / 2;
+  const int skip_start_y_mcus = (decoder->MCUSPerCol - keep_y_mcus) / 2;
+  const int skip_end_x_mcu_index = skip_start_x_mcus + keep_x_mcus;
+  const int skip_end_y_mcu_index = skip_start_y_mcus + keep_y_mcus;
+
+  int decoded = 0;
+  while (decoder->read()) {
+    decoded++;
+    const int mcu_x = decoder->MCUx;
+    const int mcu_y = decoder->MCUy;
+    if (mcu_y < skip_start_y_mcus || mcu_x < skip_start_x_mcus ||
+        mcu_x >= skip_end_x_mcu_index) {
+      continue;
+    }
+    // The top left of this MCU in the output image
+    const int x_origin = (mcu_x - skip_start_x_mcus) * decoder->MCUWidth;
+    const int y_origin = (mcu_y - skip_start_y_mcus) * decoder->MCUHeight;
+    const uint16_t* pixels = decoder->pImage;
+    for (int mcu_row = 0; mcu_row < decoder->MCUHeight; mcu_row++) {
+      Rgb565RowToGrey(pixels, decoder->MCUWidth,
+                      image_data + (y_origin + mcu_row) * image_width +
+                          x_origin);
+      pixels += decoder->MCUWidth;
+    }
+    // Last MCU of the crop
+    if (mcu_y == skip_end_y_mcu_index - 1 &&
+        mcu_x == skip_end_x_mcu_index - 1) {
+      decoder->abort();
+      break;
+    }
+  }
+  return decoded;
+}
+
+#endif  // NANORAMACAM_RGB565_GREY_H_
@@ -11,6 +11,9 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+The green and yellow LEDs follow the filtered detection,
+RespondToDetectionChange(). E.M.
 ==============================================================================*/
 
 #if defined(ARDUINO) && !defined(ARDUINO_SFE_EDGE)
@@ -40,18 +43,24 @@ void RespondToDetection(tflite::ErrorReporter* error_reporter,
   // Toggle the blue LED every time an inference is performed.
   am_devices_led_toggle(am_bsp_psLEDs, AM_BSP_LED_BLUE);
 
+  TF_LITE_REPORT_ERROR(error_reporter, "Person score: %d No person score: %d",
+                       person_score, no_person_score);
+}
+
+void RespondToDetectionChange(tflite::ErrorReporter* error_reporter,
+                              bool person, uint8_t confidence) {
   // Turn on the green LED if a person was detected.  Turn on the yellow LED
   // otherwise.
   am_devices_led_off(am_bsp_psLEDs, AM_BSP_LED_YELLOW);
   am_devices_led_off(am_bsp_psLEDs, AM_BSP_LED_GREEN);
-  if (person_score > no_person_score) {
+  if (person) {
     am_devices_led_on(am_bsp_psLEDs, AM_BSP_LED_GREEN);
   } else {
     am_devices_led_on(am_bsp_psLEDs, AM_BSP_LED_YELLOW);
   }
 
-  TF_LITE_REPORT_ERROR(error_reporter, "Person score: %d No person score: %d",
-                       person_score, no_person_score);
+  TF_LITE_REPORT_ERROR(error_reporter, "Person detected: %d Confidence: %d%%",
+                       person, confidence);
 }
 
 #endif  // ARDUINO_EXCLUDE_CODE
@@ -0,0 +1,700 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+SIMD kernels of the 8-bit CONV_2D, DEPTHWISE_CONV_2D, AVERAGE_POOL_2D,
+FULLY_CONNECTED and SOFTMAX ops for the host and companion computer builds:
+NEON on ARM (Raspberry Pi), SSE4.1 and AVX2 on x86, portable C elsewhere.
+Bit-exact with the reference kernels. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_SIMD_OPS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_SIMD_OPS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "third_party/gemmlowp/fixedpoint/fixedpoint.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define TFLITE_SIMD_NEON
+#include <arm_neon.h>
+#elif defined(__SSE4_1__)
+#define TFLITE_SIMD_SSE
+#include <smmintrin.h>
+#if defined(__AVX2__)
+#define TFLITE_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace tflite {
+namespace simd_ops {
+
+// Instruction set the kernels are compiled for.
+inline const char* BackendName() {
+#if defined(TFLITE_SIMD_NEON)
+  return "neon";
+#elif defined(TFLITE_SIMD_AVX2)
+  return "avx2";
+#elif defined(TFLITE_SIMD_SSE)
+  return "sse4.1";
+#else
+  return "portable";
+#endif
+}
+
+// Vector of 8 int16 values and vector of 4 int32 values. The 8-bit tensor
+// values are widened to 16 bits with their zero point offset, the products
+// are accumulated in 32 bits.
+#if defined(TFLITE_SIMD_NEON)
+
+typedef int16x8_t Int16x8;
+typedef int32x4_t Int32x4;
+
+inline Int16x8 Dup16(int32 value) {
+  return vdupq_n_s16(static_cast<int16>(value));
+}
+inline Int32x4 Dup32(int32 value) { return vdupq_n_s32(value); }
+inline Int16x8 Load8(const uint8* p) {
+  return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+}
+inline Int16x8 Load8(const int8* p) { return vmovl_s8(vld1_s8(p)); }
+inline Int16x8 Load16(const int16* p) { return vld1q_s16(p); }
+inline Int32x4 Load32(const int32* p) { return vld1q_s32(p); }
+inline void Store32(int32* p, Int32x4 v) { vst1q_s32(p, v); }
+inline Int16x8 Add16(Int16x8 a, Int16x8 b) { return vaddq_s16(a, b); }
+
+// acc plus the dot product of a and b, spread over the lanes.
+inline Int32x4 DotAccumulate(Int32x4 acc, Int16x8 a, Int16x8 b) {
+  acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+  return vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+}
+
+// Lane by lane products of a and b, the lanes 0-3 added to low, 4-7 to high.
+inline void MulAccumulate(Int16x8 a, Int16x8 b, Int32x4* low, Int32x4* high) {
+  *low = vmlal_s16(*low, vget_low_s16(a), vget_low_s16(b));
+  *high = vmlal_s16(*high, vget_high_s16(a), vget_high_s16(b));
+}
+
+// Lanes of a, 0-3 added to low, 4-7 to high.
+inline void Accumulate(Int16x8 a, Int32x4* low, Int32x4* high) {
+  *low = vaddw_s16(*low, vget_low_s16(a));
+  *high = vaddw_s16(*high, vget_high_s16(a));
+}
+
+inline int32 ReduceAdd(Int32x4 v) {
+#if defined(__aarch64__)
+  return vaddvq_s32(v);
+#else
+  const int32x2_t sum = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+  return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#endif
+}
+
+#elif defined(TFLITE_SIMD_SSE)
+
+typedef __m128i Int16x8;
+typedef __m128i Int32x4;
+
+inline Int16x8 Dup16(int32 value) {
+  return _mm_set1_epi16(static_cast<int16>(value));
+}
+inline Int32x4 Dup32(int32 value) { return _mm_set1_epi32(value); }
+inline Int16x8 Load8(const uint8* p) {
+  return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+inline Int16x8 Load8(const int8* p) {
+  return _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+inline Int16x8 Load16(const int16* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline Int32x4 Load32(const int32* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline void Store32(int32* p, Int32x4 v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+inline Int16x8 Add16(Int16x8 a, Int16x8 b) { return _mm_add_epi16(a, b); }
+
+inline Int32x4 DotAccumulate(Int32x4 acc, Int16x8 a, Int16x8 b) {
+  return _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+}
+
+inline void MulAccumulate(Int16x8 a, Int16x8 b, Int32x4* low, Int32x4* high) {
+  const __m128i product_low = _mm_mullo_epi16(a, b);
+  const __m128i product_high = _mm_mulhi_epi16(a, b);
+  *low = _mm_add_epi32(*low, _mm_unpacklo_epi16(product_low, product_high));
+  *high = _mm_add_epi32(*high, _mm_unpackhi_epi16(product_low, product_high));
+}
+
+inline void Accumulate(Int16x8 a, Int32x4* low, Int32x4* high) {
+  *low = _mm_add_epi32(*low, _mm_cvtepi16_epi32(a));
+  *high = _mm_add_epi32(*high, _mm_cvtepi16_epi32(_mm_unpackhi_epi64(a, a)));
+}
+
+inline int32 ReduceAdd(Int32x4 v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+#else
+
+struct Int16x8 {
+  int16 lane[8];
+};
+struct Int32x4 {
+  int32 lane[4];
+};
+
+inline Int16x8 Dup16(int32 value) {
+  Int16x8 v;
+  for (int i = 0; i < 8; ++i) {
+    v.lane[i] = static_cast<int16>(value);
+  }
+  return v;
+}
+inline Int32x4 Dup32(int32 value) {
+  Int32x4 v;
+  for (int i = 0; i < 4; ++i) {
+    v.lane[i] = value;
+  }
+  return v;
+}
+template <typename T>
+inline Int16x8 Load8(const T* p) {
+  Int16x8 v;
+  for (int i = 0; i < 8; ++i) {
+    v.lane[i] = p[i];
+  }
+  return v;
+}
+inline Int16x8 Load16(const int16* p) { return Load8(p); }
+inline Int32x4 Load32(const int32* p) {
+  Int32x4 v;
+  memcpy(v.lane, p, sizeof(v.lane));
+  return v;
+}
+inline void Store32(int32* p, Int32x4 v) { memcpy(p, v.lane, sizeof(v.lane)); }
+inline Int16x8 Add16(Int16x8 a, Int16x8 b) {
+  for (int i = 0; i < 8; ++i) {
+    a.lane[i] = static_cast<int16>(a.lane[i] + b.lane[i]);
+  }
+  return a;
+}
+
+inline Int32x4 DotAccumulate(Int32x4 acc, Int16x8 a, Int16x8 b) {
+  for (int i = 0; i < 8; ++i) {
+    acc.lane[i % 4] += a.lane[i] * b.lane[i];
+  }
+  return acc;
+}
+
+inline void MulAccumulate(Int16x8 a, Int16x8 b, Int32x4* low, Int32x4* high) {
+  for (int i = 0; i < 4; ++i) {
+    low->lane[i] += a.lane[i] * b.lane[i];
+    high->lane[i] += a.lane[i + 4] * b.lane[i + 4];
+  }
+}
+
+inline void Accumulate(Int16x8 a, Int32x4* low, Int32x4* high) {
+  for (int i = 0; i < 4; ++i) {
+    low->lane[i] += a.lane[i];
+    high->lane[i] += a.lane[i + 4];
+  }
+}
+
+inline int32 ReduceAdd(Int32x4 v) {
+  return v.lane[0] + v.lane[1] + v.lane[2] + v.lane[3];
+}
+
+#endif
+
+// Requantization of an accumulator, same as the reference kernels.
+inline int32 Requantize(int32 acc, int32 multiplier, int shift, int32 offset,
+                        int32 activation_min, int32 activation_max) {
+  acc = MultiplyByQuantizedMultiplier(acc, multiplier, shift);
+  acc += offset;
+  acc = std::max(acc, activation_min);
+  return std::min(acc, activation_max);
+}
+
+// acc[r][c] = sum((a[r][k] + a_offset) * (b[c][k] + b_offset)) over depth
+// values: the GEMM tile of CONV_2D and FULLY_CONNECTED. The rows of a are
+// widened once per block and used by the kCols rows of b.
+template <typename T, int kRows, int kCols>
+inline void DotTile(const T* const a[kRows], int32 a_offset,
+                    const T* const b[kCols], int32 b_offset, int depth,
+                    int32 acc[kRows][kCols]) {
+  Int32x4 sums[kRows][kCols];
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      sums[r][c] = Dup32(0);
+    }
+  }
+  int k = 0;
+#if defined(TFLITE_SIMD_AVX2)
+  if (depth >= 16) {
+    const __m256i a_offsets = _mm256_set1_epi16(static_cast<int16>(a_offset));
+    const __m256i b_offsets = _mm256_set1_epi16(static_cast<int16>(b_offset));
+    __m256i wide_sums[kRows][kCols];
+    for (int r = 0; r < kRows; ++r) {
+      for (int c = 0; c < kCols; ++c) {
+        wide_sums[r][c] = _mm256_setzero_si256();
+      }
+    }
+    for (; k <= depth - 16; k += 16) {
+      __m256i a_values[kRows];
+      for (int r = 0; r < kRows; ++r) {
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a[r] + k));
+        a_values[r] = _mm256_add_epi16(
+            std::numeric_limits<T>::is_signed ? _mm256_cvtepi8_epi16(bytes)
+                                              : _mm256_cvtepu8_epi16(bytes),
+            a_offsets);
+      }
+      for (int c = 0; c < kCols; ++c) {
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b[c] + k));
+        const __m256i b_values = _mm256_add_epi16(
+            std::numeric_limits<T>::is_signed ? _mm256_cvtepi8_epi16(bytes)
+                                              : _mm256_cvtepu8_epi16(bytes),
+            b_offsets);
+        for (int r = 0; r < kRows; ++r) {
+          wide_sums[r][c] = _mm256_add_epi32(
+              wide_sums[r][c], _mm256_madd_epi16(a_values[r], b_values));
+        }
+      }
+    }
+    for (int r = 0; r < kRows; ++r) {
+      for (int c = 0; c < kCols; ++c) {
+        sums[r][c] = _mm_add_epi32(_mm256_castsi256_si128(wide_sums[r][c]),
+                                   _mm256_extracti128_si256(wide_sums[r][c], 1));
+      }
+    }
+  }
+#endif
+  const Int16x8 a_offsets = Dup16(a_offset);
+  const Int16x8 b_offsets = Dup16(b_offset);
+  for (; k <= depth - 8; k += 8) {
+    Int16x8 a_values[kRows];
+    for (int r = 0; r < kRows; ++r) {
+      a_values[r] = Add16(Load8(a[r] + k), a_offsets);
+    }
+    for (int c = 0; c < kCols; ++c) {
+      const Int16x8 b_values = Add16(Load8(b[c] + k), b_offsets);
+      for (int r = 0; r < kRows; ++r) {
+        sums[r][c] = DotAccumulate(sums[r][c], a_values[r], b_values);
+      }
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      acc[r][c] = ReduceAdd(sums[r][c]);
+    }
+  }
+  for (; k < depth; ++k) {
+    for (int r = 0; r < kRows; ++r) {
+      for (int c = 0; c < kCols; ++c) {
+        acc[r][c] += (a[r][k] + a_offset) * (b[c][k] + b_offset);
+      }
+    }
+  }
+}
+
+// Fully connected layer, same results of reference_ops::FullyConnected
+// (uint8) and reference_integer_ops::FullyConnected (int8).
+template <typename T>
+inline void FullyConnected(const FullyConnectedParams& params,
+                           const RuntimeShape& input_shape,
+                           const T* input_data,
+                           const RuntimeShape& filter_shape,
+                           const T* filter_data, const int32* bias_data,
+                           const RuntimeShape& output_shape, T* output_data) {
+  constexpr int kCols = 4;
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+
+  auto output_value = [&](int32 acc, int out_c) {
+    if (bias_data) {
+      acc += bias_data[out_c];
+    }
+    return static_cast<T>(Requantize(
+        acc, params.output_multiplier, params.output_shift,
+        params.output_offset, params.quantized_activation_min,
+        params.quantized_activation_max));
+  };
+  for (int b = 0; b < batches; ++b) {
+    const T* const input[1] = {input_data + b * accum_depth};
+    T* output = output_data + b * output_depth;
+    int out_c = 0;
+    for (; out_c <= output_depth - kCols; out_c += kCols) {
+      const T* filters[kCols];
+      for (int c = 0; c < kCols; ++c) {
+        filters[c] = filter_data + (out_c + c) * accum_depth;
+      }
+      int32 acc[1][kCols];
+      DotTile<T, 1, kCols>(input, params.input_offset, filters,
+                           params.weights_offset, accum_depth, acc);
+      for (int c = 0; c < kCols; ++c) {
+        output[out_c + c] = output_value(acc[0][c], out_c + c);
+      }
+    }
+    for (; out_c < output_depth; ++out_c) {
+      const T* const filter[1] = {filter_data + out_c * accum_depth};
+      int32 acc[1][1];
+      DotTile<T, 1, 1>(input, params.input_offset, filter,
+                       params.weights_offset, accum_depth, acc);
+      output[out_c] = output_value(acc[0][0], out_c);
+    }
+  }
+}
+
+// Depthwise convolution, same results of reference_ops::DepthwiseConv (uint8)
+// and reference_integer_ops::DepthwiseConvPerChannel (int8). The lanes are 8
+// output channels of a pixel. output_multiplier and output_shift are per
+// channel when quant_step is 1, a single value when it is 0; a positive shift
+// means left.
+template <typename T>
+inline void DepthwiseConv(const DepthwiseParams& params,
+                          const int32* output_multiplier,
+                          const int32* output_shift, int quant_step,
+                          const RuntimeShape& input_shape, const T* input_data,
+                          const RuntimeShape& filter_shape,
+                          const T* filter_data, const int32* bias_data,
+                          const RuntimeShape& output_shape, T* output_data) {
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int output_depth = MatchingDim(filter_shape, 3, output_shape, 3);
+  const int depth_multiplier = params.depth_multiplier;
+  TFLITE_DCHECK_EQ(output_depth, input_depth * depth_multiplier);
+  const Int16x8 input_offsets = Dup16(params.input_offset);
+  const Int16x8 filter_offsets = Dup16(params.weights_offset);
+
+  auto output_value = [&](int32 acc, int oc) {
+    return static_cast<T>(Requantize(
+        acc, output_multiplier[oc * quant_step], output_shift[oc * quant_step],
+        params.output_offset, params.quantized_activation_min,
+        params.quantized_activation_max));
+  };
+
+  for (int b = 0; b < batches; ++b) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params.stride_height - params.padding_values.height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params.stride_width - params.padding_values.width;
+        T* out = output_data + Offset(output_shape, b, out_y, out_x, 0);
+        int oc = 0;
+        for (; oc <= output_depth - 8; oc += 8) {
+          Int32x4 low = bias_data ? Load32(bias_data + oc) : Dup32(0);
+          Int32x4 high = bias_data ? Load32(bias_data + oc + 4) : Dup32(0);
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y =
+                in_y_origin + params.dilation_height_factor * filter_y;
+            if (in_y < 0 || in_y >= input_height) {
+              continue;
+            }
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x =
+                  in_x_origin + params.dilation_width_factor * filter_x;
+              if (in_x < 0 || in_x >= input_width) {
+                continue;
+              }
+              const T* in = input_data + Offset(input_shape, b, in_y, in_x, 0);
+              Int16x8 input_values;
+              if (depth_multiplier == 1) {
+                input_values = Load8(in + oc);
+              } else if (depth_multiplier % 8 == 0) {
+                input_values = Dup16(in[oc / depth_multiplier]);
+              } else {
+                int16 gathered[8];
+                for (int j = 0; j < 8; ++j) {
+                  gathered[j] = in[(oc + j) / depth_multiplier];
+                }
+                input_values = Load16(gathered);
+              }
+              const Int16x8 filter_values = Add16(
+                  Load8(filter_data +
+                        Offset(filter_shape, 0, filter_y, filter_x, oc)),
+                  filter_offsets);
+              MulAccumulate(Add16(input_values, input_offsets), filter_values,
+                            &low, &high);
+            }
+          }
+          int32 acc[8];
+          Store32(acc, low);
+          Store32(acc + 4, high);
+          for (int j = 0; j < 8; ++j) {
+            out[oc + j] = output_value(acc[j], oc + j);
+          }
+        }
+        for (; oc < output_depth; ++oc) {
+          int32 acc = bias_data ? bias_data[oc] : 0;
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y =
+                in_y_origin + params.dilation_height_factor * filter_y;
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x =
+                  in_x_origin + params.dilation_width_factor * filter_x;
+              if (in_x < 0 || in_x >= input_width || in_y < 0 ||
+                  in_y >= input_height) {
+                continue;
+              }
+              const int32 input_value =
+                  input_data[Offset(input_shape, b, in_y, in_x,
+                                    oc / depth_multiplier)];
+              const int32 filter_value =
+                  filter_data[Offset(filter_shape, 0, filter_y, filter_x, oc)];
+              acc += (filter_value + params.weights_offset) *
+                     (input_value + params.input_offset);
+            }
+          }
+          out[oc] = output_value(acc, oc);
+        }
+      }
+    }
+  }
+}
+
+// Average pooling, same results of reference_ops::AveragePool (uint8) and
+// reference_integer_ops::AveragePool (int8). The lanes are 8 channels.
+template <typename T>
+inline void AveragePool(const PoolParams& params,
+                        const RuntimeShape& input_shape, const T* input_data,
+                        const RuntimeShape& output_shape, T* output_data) {
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+
+  // Rounded to nearest, half away from zero. The uint8 reference rounds half
+  // up, the same for the positive sums.
+  auto output_value = [&](int32 acc, int filter_count) {
+    acc = acc > 0 ? (acc + filter_count / 2) / filter_count
+                  : (acc - filter_count / 2) / filter_count;
+    acc = std::max(acc, params.quantized_activation_min);
+    acc = std::min(acc, params.quantized_activation_max);
+    return static_cast<T>(acc);
+  };
+
+  for (int b = 0; b < batches; ++b) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params.stride_height - params.padding_values.height;
+      const int filter_y_start = std::max(0, -in_y_origin);
+      const int filter_y_end =
+          std::min(params.filter_height, input_height - in_y_origin);
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params.stride_width - params.padding_values.width;
+        const int filter_x_start = std::max(0, -in_x_origin);
+        const int filter_x_end =
+            std::min(params.filter_width, input_width - in_x_origin);
+        const int filter_count = (filter_y_end - filter_y_start) *
+                                 (filter_x_end - filter_x_start);
+        T* out = output_data + Offset(output_shape, b, out_y, out_x, 0);
+        if (filter_count <= 0) {
+          // Same division by zero of the reference kernels
+          continue;
+        }
+        int channel = 0;
+        for (; channel <= depth - 8; channel += 8) {
+          Int32x4 low = Dup32(0);
+          Int32x4 high = Dup32(0);
+          for (int fy = filter_y_start; fy < filter_y_end; ++fy) {
+            for (int fx = filter_x_start; fx < filter_x_end; ++fx) {
+              Accumulate(Load8(input_data + Offset(input_shape, b,
+                                                   in_y_origin + fy,
+                                                   in_x_origin + fx, channel)),
+                         &low, &high);
+            }
+          }
+          int32 acc[8];
+          Store32(acc, low);
+          Store32(acc + 4, high);
+          for (int j = 0; j < 8; ++j) {
+            out[channel + j] = output_value(acc[j], filter_count);
+          }
+        }
+        for (; channel < depth; ++channel) {
+          int32 acc = 0;
+          for (int fy = filter_y_start; fy < filter_y_end; ++fy) {
+            for (int fx = filter_x_start; fx < filter_x_end; ++fx) {
+              acc += input_data[Offset(input_shape, b, in_y_origin + fy,
+                                       in_x_origin + fx, channel)];
+            }
+          }
+          out[channel] = output_value(acc, filter_count);
+        }
+      }
+    }
+  }
+}
+
+// Largest of n values.
+template <typename T>
+inline T MaxElement(const T* values, int n) {
+  T max = std::numeric_limits<T>::lowest();
+  int i = 0;
+#if defined(TFLITE_SIMD_NEON)
+  if (sizeof(T) == 1 && n >= 16) {
+    if (std::numeric_limits<T>::is_signed) {
+      const int8* p = reinterpret_cast<const int8*>(values);
+      int8x16_t v = vld1q_s8(p);
+      for (i = 16; i <= n - 16; i += 16) {
+        v = vmaxq_s8(v, vld1q_s8(p + i));
+      }
+      int8 lanes[16];
+      vst1q_s8(lanes, v);
+      max = static_cast<T>(*std::max_element(lanes, lanes + 16));
+    } else {
+      const uint8* p = reinterpret_cast<const uint8*>(values);
+      uint8x16_t v = vld1q_u8(p);
+      for (i = 16; i <= n - 16; i += 16) {
+        v = vmaxq_u8(v, vld1q_u8(p + i));
+      }
+      uint8 lanes[16];
+      vst1q_u8(lanes, v);
+      max = static_cast<T>(*std::max_element(lanes, lanes + 16));
+    }
+  }
+#elif defined(TFLITE_SIMD_SSE)
+  if (sizeof(T) == 1 && n >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+    for (i = 16; i <= n - 16; i += 16) {
+      const __m128i next =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+      v = std::numeric_limits<T>::is_signed ? _mm_max_epi8(v, next)
+                                            : _mm_max_epu8(v, next);
+    }
+    T lanes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+    max = *std::max_element(lanes, lanes + 16);
+  }
+#endif
+  for (; i < n; ++i) {
+    max = std::max(max, values[i]);
+  }
+  return max;
+}
+
+// Max depth of the softmax rows whose exponentials are kept between the sum
+// and the output pass.
+constexpr int kSoftmaxCachedDepth = 256;
+
+// Quantized softmax, same results of reference_ops::Softmax. The max of the
+// row is vectorized and the fixed-point exponential of every value is
+// computed once instead of twice (up to kSoftmaxCachedDepth values).
+template <typename InputT, typename OutputT>
+inline void Softmax(const SoftmaxParams& params,
+                    const RuntimeShape& input_shape, const InputT* input_data,
+                    const RuntimeShape& output_shape, OutputT* output_data) {
+  static const int kScaledDiffIntegerBits = 5;
+  static const int kAccumulationIntegerBits = 12;
+  using FixedPointScaledDiff =
+      gemmlowp::FixedPoint<int32, kScaledDiffIntegerBits>;
+  using FixedPointAccum = gemmlowp::FixedPoint<int32, kAccumulationIntegerBits>;
+  using FixedPoint0 = gemmlowp::FixedPoint<int32, 0>;
+
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+  const bool cached = depth <= kSoftmaxCachedDepth;
+  int32 exps[kSoftmaxCachedDepth];
+
+  for (int i = 0; i < outer_size; ++i) {
+    const InputT* input = input_data + i * depth;
+    OutputT* output = output_data + i * depth;
+    const InputT max_in_row = MaxElement(input, depth);
+
+    // exp() of the value, 0 raw value when the difference is below diff_min
+    auto exp_of = [&](int c, bool* valid) {
+      const int32 input_diff = static_cast<int32>(input[c]) - max_in_row;
+      *valid = input_diff >= params.diff_min;
+      if (!*valid) {
+        return FixedPoint0::Zero();
+      }
+      const int32 input_diff_rescaled =
+          MultiplyByQuantizedMultiplierGreaterThanOne(
+              input_diff, params.input_multiplier, params.input_left_shift);
+      return exp_on_negative_values(
+          FixedPointScaledDiff::FromRaw(input_diff_rescaled));
+    };
+
+    FixedPointAccum sum_of_exps = FixedPointAccum::Zero();
+    for (int c = 0; c < depth; ++c) {
+      bool valid;
+      const FixedPoint0 exp_in_0 = exp_of(c, &valid);
+      if (valid) {
+        sum_of_exps =
+            sum_of_exps + gemmlowp::Rescale<kAccumulationIntegerBits>(exp_in_0);
+      }
+      if (cached) {
+        exps[c] = valid ? exp_in_0.raw() : -1;
+      }
+    }
+
+    int num_bits_over_unit;
+    const FixedPoint0 shifted_scale = FixedPoint0::FromRaw(GetReciprocal(
+        sum_of_exps.raw(), kAccumulationIntegerBits, &num_bits_over_unit));
+
+    for (int c = 0; c < depth; ++c) {
+      bool valid;
+      FixedPoint0 exp_in_0;
+      if (cached) {
+        valid = exps[c] >= 0;
+        exp_in_0 = FixedPoint0::FromRaw(exps[c]);
+      } else {
+        exp_in_0 = exp_of(c, &valid);
+      }
+      if (!valid) {
+        output[c] = std::numeric_limits<OutputT>::min();
+        continue;
+      }
+      const int32 unsat_output = gemmlowp::RoundingDivideByPOT(
+          (shifted_scale * exp_in_0).raw(),
+          num_bits_over_unit + 31 - (sizeof(OutputT) * 8));
+      const int32 shifted_output =
+          unsat_output + static_cast<int32>(std::numeric_limits<OutputT>::min());
+      output[c] = static_cast<OutputT>(std::max(
+          std::min(shifted_output,
+                   static_cast<int32>(std::numeric_limits<OutputT>::max())),
+          static_cast<int32>(std::numeric_limits<OutputT>::min())));
+    }
+  }
+}
+
+}  // namespace simd_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_SIMD_OPS_H_
@@ -11,6 +11,10 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+The quantized layers run the packed kernel of
+portable_optimized/swar_kernels.h when TF_LITE_MICRO_SWAR is set. E.M.
+
 ==============================================================================*/
 
 #include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
@@ -22,6 +26,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar_kernels.h"
 
 namespace tflite {
 namespace ops {
@@ -115,11 +120,19 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = data.output_activation_min;
   op_params.quantized_activation_max = data.output_activation_max;
 
+#if TF_LITE_MICRO_SWAR
+  swar::FullyConnected<int8_t>(
+      op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
+      GetTensorShape(filter), GetTensorData<int8_t>(filter),
+      GetTensorData<int32_t>(bias), GetTensorShape(output),
+      GetTensorData<int8_t>(output));
+#else
   reference_integer_ops::FullyConnected(
       op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
       GetTensorShape(filter), GetTensorData<int8_t>(filter),
       GetTensorShape(bias), GetTensorData<int32_t>(bias),
       GetTensorShape(output), GetTensorData<int8_t>(output));
+#endif
   return kTfLiteOk;
 }
 
@@ -149,7 +162,15 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
       GetTensorShape(output), GetTensorData<output_data_type>(output))
   switch (output->type) {
     case kTfLiteUInt8:
+#if TF_LITE_MICRO_SWAR
+      swar::FullyConnected<uint8_t>(
+          op_params, GetTensorShape(input), GetTensorData<uint8_t>(input),
+          GetTensorShape(filter), GetTensorData<uint8_t>(filter),
+          GetTensorData<int32_t>(bias), GetTensorShape(output),
+          GetTensorData<uint8_t>(output));
+#else
       TF_LITE_FULLY_CONNECTED(uint8_t);
+#endif
       break;
     case kTfLiteInt16:
       TF_LITE_FULLY_CONNECTED(int16_t);
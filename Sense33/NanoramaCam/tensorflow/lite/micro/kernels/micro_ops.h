@@ -37,6 +37,30 @@ TfLiteRegistration* Register_AVERAGE_POOL_2D();
 TfLiteRegistration* Register_CEIL();
 TfLiteRegistration* Register_CIRCULAR_BUFFER();
 TfLiteRegistration* Register_CONV_2D();
+// Im2col + GEMM CONV_2D, bit-exact with Register_CONV_2D() on the quantized
+// models. The 1x1 convolutions need no scratch buffer.
+TfLiteRegistration* Register_CONV_2D_GEMM();
+// Fused DEPTHWISE_CONV_2D or AVERAGE_POOL_2D and 1x1 CONV_2D, registered as
+// the kFusedConv2dOpName custom operator to enable the fusion pass of
+// micro_fusion.h.
+TfLiteRegistration* Register_FUSED_CONV_2D();
+// First layers of the model run patch by patch, registered as the
+// kPatchedLayersOpName custom operator for
+// MicroInterpreter::SetPatchExecution().
+TfLiteRegistration* Register_PATCHED_LAYERS();
+// SIMD kernel set of kernels/internal/optimized/simd_ops.h (NEON, SSE4.1 or
+// AVX2, portable code otherwise), bit-exact with the reference kernels on
+// the quantized models.
+TfLiteRegistration* Register_CONV_2D_SIMD();
+TfLiteRegistration* Register_DEPTHWISE_CONV_2D_SIMD();
+TfLiteRegistration* Register_AVERAGE_POOL_2D_SIMD();
+TfLiteRegistration* Register_FULLY_CONNECTED_SIMD();
+TfLiteRegistration* Register_SOFTMAX_SIMD();
+// Model tail kernels of portable_optimized/tail_ops.h, bit-exact with the
+// reference kernels: SOFTMAX reading the exponentials from a table built at
+// Prepare(), AVERAGE_POOL_2D dividing by reciprocal multiplication.
+TfLiteRegistration* Register_SOFTMAX_LUT();
+TfLiteRegistration* Register_AVERAGE_POOL_2D_RECIPROCAL();
 TfLiteRegistration* Register_CONCATENATION();
 TfLiteRegistration* Register_COS();
 TfLiteRegistration* Register_DEPTHWISE_CONV_2D();
@@ -0,0 +1,407 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Im2col + GEMM implementation of CONV_2D for the uint8 and int8 models,
+bit-exact with the reference kernels of conv.cpp. The inner loop of the GEMM
+tile runs the packed kernel of swar_kernels.h when TF_LITE_MICRO_SWAR is set.
+The palettized filters of palette_weights.h are decoded by the GEMM. The
+requantization arrays are read from the offline tables of the model
+metadata if present. E.M.
+
+==============================================================================*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/conv.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/conv_gemm.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace conv_gemm {
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kFilterTensor = 1;
+constexpr int kBiasTensor = 2;
+constexpr int kOutputTensor = 0;
+
+// Conv is quantized along dimension 0:
+// https://www.tensorflow.org/lite/performance/quantization_spec
+constexpr int kConvQuantizedDimension = 0;
+
+// Target size of the im2col scratch buffer. The patches are packed a block of
+// output pixels at a time, the block holds at least kGemmRows pixels.
+constexpr int kIm2colBytes = 4 * 1024;
+
+// Pack the patch of the output pixel in im2col, in the HWC order of the
+// filter. The points outside the image take the input zero point, so they
+// don't contribute to the accumulator like in the reference kernel.
+template <typename T>
+inline void PackPatch(const TfLiteConvParams& conv_params, const OpData& data,
+                      const RuntimeShape& input_shape, const T* input_data,
+                      int filter_height, int filter_width, int batch,
+                      int out_y, int out_x, T* im2col) {
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const T zero_point = static_cast<T>(-data.input_offset);
+  const int in_x_origin = out_x * conv_params.stride_width - data.padding.width;
+  const int in_y_origin =
+      out_y * conv_params.stride_height - data.padding.height;
+  for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+    const int in_y = in_y_origin + conv_params.dilation_height_factor * filter_y;
+    for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+      const int in_x =
+          in_x_origin + conv_params.dilation_width_factor * filter_x;
+      if (in_x >= 0 && in_x < input_width && in_y >= 0 && in_y < input_height) {
+        memcpy(im2col,
+               input_data + Offset(input_shape, batch, in_y, in_x, 0),
+               input_depth * sizeof(T));
+      } else {
+        memset(im2col, zero_point, input_depth * sizeof(T));
+      }
+      im2col += input_depth;
+    }
+  }
+}
+
+template <typename T>
+void EvalGemm(TfLiteContext* context, const TfLiteConvParams& conv_params,
+              const OpData& data, const TfLiteTensor* input,
+              const TfLiteTensor* filter, TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const T* input_data = GetTensorData<T>(input);
+  const T* filter_data = GetTensorData<T>(filter);
+  T* output_data = GetTensorData<T>(output);
+
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+
+  GemmParams params;
+  params.data = &data;
+  params.depth = filter_height * filter_width * input_depth;
+  params.output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+
+  if (data.im2col_index < 0) {
+    // 1x1 fast path, the patches are the input pixels
+    for (int batch = 0; batch < batches; ++batch) {
+      for (int out_y = 0; out_y < output_height; ++out_y) {
+        const T* rows = input_data + Offset(input_shape, batch,
+                                            out_y * conv_params.stride_height,
+                                            0, 0);
+        T* out = output_data + Offset(output_shape, batch, out_y, 0, 0);
+        if (conv_params.stride_width == 1 && conv_params.stride_height == 1 &&
+            input_width == output_width) {
+          // Contiguous rows, the whole image is a single GEMM
+          Gemm<T>(params, rows, input_depth, output_height * output_width,
+                  filter_data, out);
+          break;
+        }
+        Gemm<T>(params, rows, input_depth * conv_params.stride_width,
+                output_width, filter_data, out);
+      }
+    }
+    return;
+  }
+
+  T* im2col = static_cast<T*>(context->GetScratchBuffer(context,
+                                                       data.im2col_index));
+  const int num_pixels = output_height * output_width;
+  for (int batch = 0; batch < batches; ++batch) {
+    T* out = output_data + Offset(output_shape, batch, 0, 0, 0);
+    for (int pixel = 0; pixel < num_pixels; pixel += data.im2col_rows) {
+      const int rows = std::min(data.im2col_rows, num_pixels - pixel);
+      for (int r = 0; r < rows; ++r) {
+        PackPatch<T>(conv_params, data, input_shape, input_data, filter_height,
+                     filter_width, batch, (pixel + r) / output_width,
+                     (pixel + r) % output_width, im2col + r * params.depth);
+      }
+      Gemm<T>(params, im2col, params.depth, rows, filter_data,
+              out + pixel * params.output_depth);
+    }
+  }
+}
+
+void EvalFloat(TfLiteContext* context, const TfLiteConvParams& conv_params,
+               const OpData& data, const TfLiteTensor* input,
+               const TfLiteTensor* filter, const TfLiteTensor* bias,
+               TfLiteTensor* output) {
+  float output_activation_min, output_activation_max;
+  CalculateActivationRange(conv_params.activation, &output_activation_min,
+                           &output_activation_max);
+  ConvParams op_params;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = data.padding.width;
+  op_params.padding_values.height = data.padding.height;
+  op_params.stride_width = conv_params.stride_width;
+  op_params.stride_height = conv_params.stride_height;
+  op_params.dilation_width_factor = conv_params.dilation_width_factor;
+  op_params.dilation_height_factor = conv_params.dilation_height_factor;
+  op_params.float_activation_min = output_activation_min;
+  op_params.float_activation_max = output_activation_max;
+
+  reference_ops::Conv(op_params, GetTensorShape(input),
+                      GetTensorData<float>(input), GetTensorShape(filter),
+                      GetTensorData<float>(filter), GetTensorShape(bias),
+                      GetTensorData<float>(bias), GetTensorShape(output),
+                      GetTensorData<float>(output), RuntimeShape(), nullptr);
+}
+
+// Sum of the filter values of every output channel, for the accumulator
+// offsets.
+template <typename T>
+void PrepareAccOffsets(const TfLiteTensor* filter, const TfLiteTensor* bias,
+                       int depth, int output_depth, const OpData& data,
+                       int32_t* acc_offset) {
+  const T* filter_data = GetTensorData<T>(filter);
+  const int32_t* bias_data = bias != nullptr ? GetTensorData<int32_t>(bias)
+                                             : nullptr;
+  T decoded[kPaletteMaxDepth];
+  for (int oc = 0; oc < output_depth; ++oc) {
+    const T* filter_row = filter_data + oc * depth;
+    if (data.palette != nullptr) {
+      palette_weights::DecodeRow<T>(data.palette, output_depth, depth, oc,
+                                    decoded);
+      filter_row = decoded;
+    }
+    int32_t filter_sum = 0;
+    for (int k = 0; k < depth; ++k) {
+      filter_sum += filter_row[k];
+    }
+    acc_offset[oc] = (bias_data != nullptr ? bias_data[oc] : 0) +
+                     data.input_offset * filter_sum +
+                     depth * data.input_offset * data.filter_offset;
+  }
+}
+
+}  // namespace
+
+TfLiteStatus CalculateOpData(TfLiteContext* context,
+                             const TfLiteConvParams* params,
+                             const TfLiteTensor* input,
+                             const TfLiteTensor* filter,
+                             const TfLiteTensor* bias, TfLiteTensor* output,
+                             const TfLiteRequantizationTable* table,
+                             OpData* data) {
+  // All per-channel quantized tensors need valid zero point and scale arrays.
+  if (input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
+                      kTfLiteAffineQuantization);
+
+    const auto* affine_quantization =
+        static_cast<TfLiteAffineQuantization*>(filter->quantization.params);
+    TF_LITE_ENSURE(context, affine_quantization);
+    TF_LITE_ENSURE(context, affine_quantization->scale);
+    TF_LITE_ENSURE(context, affine_quantization->zero_point);
+
+    TF_LITE_ENSURE(context,
+                   affine_quantization->scale->size == 1 ||
+                       affine_quantization->scale->size ==
+                           filter->dims->data[kConvQuantizedDimension]);
+    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
+                      affine_quantization->zero_point->size);
+  }
+
+  const int output_depth = filter->dims->data[kConvQuantizedDimension];
+  const int depth =
+      filter->dims->data[1] * filter->dims->data[2] * input->dims->data[3];
+  data->palette = palette_weights::Parse(GetTensorData<uint8_t>(filter),
+                                         output_depth, depth);
+  TF_LITE_ENSURE(context,
+                 data->palette == nullptr || depth <= kPaletteMaxDepth);
+  data->input_offset = -input->params.zero_point;
+  data->output_offset = output->params.zero_point;
+  // The int8 filters are symmetric
+  data->filter_offset =
+      input->type == kTfLiteUInt8 ? -filter->params.zero_point : 0;
+
+  if (table != nullptr) {
+    TF_LITE_ENSURE(context, table->has_acc_offset);
+    data->output_multiplier = RequantizationMultipliers(table);
+    data->output_shift = RequantizationShifts(table);
+    data->acc_offset = RequantizationAccOffsets(table);
+    data->output_activation_min = table->output_activation_min;
+    data->output_activation_max = table->output_activation_max;
+    return kTfLiteOk;
+  }
+
+  int32_t* output_multipliers;
+  int32_t* output_shifts;
+  int32_t* acc_offsets;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, output_depth * sizeof(int32_t),
+      reinterpret_cast<void**>(&output_multipliers)));
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, output_depth * sizeof(int32_t),
+      reinterpret_cast<void**>(&output_shifts)));
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, output_depth * sizeof(int32_t),
+      reinterpret_cast<void**>(&acc_offsets)));
+
+  int32_t output_multiplier;
+  int output_shift;
+  TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+      context, input, filter, bias, output, params->activation,
+      &output_multiplier, &output_shift, &data->output_activation_min,
+      &data->output_activation_max, output_multipliers,
+      reinterpret_cast<int*>(output_shifts), output_depth));
+
+  if (input->type == kTfLiteUInt8) {
+    // Per tensor quantization of the reference uint8 kernel
+    for (int oc = 0; oc < output_depth; ++oc) {
+      output_multipliers[oc] = output_multiplier;
+      output_shifts[oc] = -output_shift;
+    }
+    PrepareAccOffsets<uint8_t>(filter, bias, depth, output_depth, *data,
+                               acc_offsets);
+  } else {
+    PrepareAccOffsets<int8_t>(filter, bias, depth, output_depth, *data,
+                              acc_offsets);
+  }
+  data->output_multiplier = output_multipliers;
+  data->output_shift = output_shifts;
+  data->acc_offset = acc_offsets;
+
+  return kTfLiteOk;
+}
+
+void* Init(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  void* data = nullptr;
+  if (context->AllocatePersistentBuffer(context, sizeof(OpData), &data) ==
+      kTfLiteError) {
+    return nullptr;
+  }
+  return data;
+}
+
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+
+  OpData* data = static_cast<OpData*>(node->user_data);
+  const auto params = static_cast<const TfLiteConvParams*>(node->builtin_data);
+
+  bool has_bias = node->inputs->size == 3;
+  TF_LITE_ENSURE(context, has_bias || node->inputs->size == 2);
+  TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
+
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+
+  int input_width = input->dims->data[2];
+  int input_height = input->dims->data[1];
+  int filter_width = filter->dims->data[2];
+  int filter_height = filter->dims->data[1];
+  int output_width = output->dims->data[2];
+  int output_height = output->dims->data[1];
+
+  // Matching GetWindowedOutputSize in TensorFlow.
+  data->padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width,
+      params->dilation_height_factor, params->dilation_width_factor,
+      input_height, input_width, filter_height, filter_width, params->padding,
+      &output_height, &output_width);
+  data->im2col_index = -1;
+  data->im2col_rows = 0;
+
+  if (input->type == kTfLiteFloat32) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE(context,
+                 input->type == kTfLiteUInt8 || input->type == kTfLiteInt8);
+
+  // The persistent buffers are allocated before the scratch buffer request.
+  TF_LITE_ENSURE_STATUS(CalculateOpData(
+      context, params, input, filter, bias, output,
+      GetRequantizationTable(node, filter->dims->data[kConvQuantizedDimension]),
+      data));
+
+  // The 1x1 convolutions read the patches straight from the input
+  const bool is_pointwise = filter_width == 1 && filter_height == 1 &&
+                            data->padding.width == 0 &&
+                            data->padding.height == 0;
+  if (!is_pointwise) {
+    const int depth = filter_height * filter_width * input->dims->data[3];
+    const int num_pixels = output_width * output_height;
+    data->im2col_rows =
+        std::min(std::max(kIm2colBytes / depth, kGemmRows), num_pixels);
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, data->im2col_rows * depth, &data->im2col_index));
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const OpData& data = *(static_cast<const OpData*>(node->user_data));
+
+  switch (input->type) {  // Already know in/out types are same.
+    case kTfLiteFloat32:
+      EvalFloat(context, *params, data, input, filter, bias, output);
+      break;
+    case kTfLiteInt8:
+      EvalGemm<int8_t>(context, *params, data, input, filter, output);
+      break;
+    case kTfLiteUInt8:
+      EvalGemm<uint8_t>(context, *params, data, input, filter, output);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input->type), input->type);
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace conv_gemm
+
+TfLiteRegistration* Register_CONV_2D_GEMM() {
+  static TfLiteRegistration r = {/*init=*/conv_gemm::Init,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/conv_gemm::Prepare,
+                                 /*invoke=*/conv_gemm::Eval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
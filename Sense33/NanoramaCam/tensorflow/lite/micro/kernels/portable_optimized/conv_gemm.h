@@ -0,0 +1,253 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+GEMM of the quantized CONV_2D of conv_gemm.cpp, shared with the fused
+operators of fused_conv.cpp. It decodes the palettized filters of
+palette_weights.h. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_CONV_GEMM_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_CONV_GEMM_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/palette_weights.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar_kernels.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace conv_gemm {
+
+// Tile of the GEMM micro kernel: output pixels x output channels.
+constexpr int kGemmRows = 2;
+constexpr int kGemmCols = 4;
+
+// Rows multiplied by the decoded filter rows of kGemmCols palettized
+// channels, and the largest depth of a palettized filter (the decoded rows
+// are on the stack).
+constexpr int kPaletteRows = 32;
+constexpr int kPaletteMaxDepth = 512;
+
+struct OpData {
+  TfLitePaddingValues padding;
+
+  // Per channel output multiplier and shift, positive shift means left. The
+  // uint8 models broadcast the per tensor values of the reference kernel.
+  const int32_t* output_multiplier;
+  const int32_t* output_shift;
+
+  // Constant part of the accumulator of every output channel:
+  //   bias + input_offset * sum(filter) + depth * input_offset * filter_offset
+  // The GEMM only accumulates the raw products and filter_offset * sum(input).
+  const int32_t* acc_offset;
+
+  int32_t input_offset;
+  int32_t filter_offset;
+  int32_t output_offset;
+
+  // The range of the fused activation layer. For example for kNone and
+  // uint8_t these would be 0 and 255.
+  int32_t output_activation_min;
+  int32_t output_activation_max;
+
+  // Scratch buffer of the packed patches, -1 on the 1x1 fast path.
+  int im2col_index;
+  int im2col_rows;
+
+  // Codebooks of a palettized filter (palette_weights::Parse()), nullptr
+  // for a raw one. The filter data is not read by the GEMM.
+  const uint8_t* palette;
+};
+
+// Raw GEMM parameters shared by the fast path and the im2col path.
+struct GemmParams {
+  const OpData* data;
+  int depth;
+  int output_depth;
+};
+
+// Multiply kRows input rows (patches of depth values, row_stride apart) by
+// the kCols filter rows of the output channels from channel and requantize
+// the kRows x kCols outputs.
+template <typename T, int kRows, int kCols>
+inline void GemmTile(const GemmParams& params, const T* rows, int row_stride,
+                     const int32_t* row_sums, const T* filter_rows,
+                     int channel, T* output) {
+  const OpData& data = *params.data;
+  const int depth = params.depth;
+  int32_t acc[kRows][kCols] = {};
+  const T* a[kRows];
+  const T* b[kCols];
+  for (int r = 0; r < kRows; ++r) {
+    a[r] = rows + r * row_stride;
+  }
+  for (int c = 0; c < kCols; ++c) {
+    b[c] = filter_rows + c * depth;
+  }
+#if TF_LITE_MICRO_SWAR
+  swar::MacTile<T, kRows, kCols>(a, b, depth, acc);
+#else
+  for (int k = 0; k < depth; ++k) {
+    int32_t x[kRows];
+    for (int r = 0; r < kRows; ++r) {
+      x[r] = a[r][k];
+    }
+    for (int c = 0; c < kCols; ++c) {
+      const int32_t w = b[c][k];
+      for (int r = 0; r < kRows; ++r) {
+        acc[r][c] += x[r] * w;
+      }
+    }
+  }
+#endif
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      const int oc = channel + c;
+      int32_t value = acc[r][c] + data.filter_offset * row_sums[r] +
+                      data.acc_offset[oc];
+      value = MultiplyByQuantizedMultiplier(value, data.output_multiplier[oc],
+                                            data.output_shift[oc]);
+      value += data.output_offset;
+      value = std::max(value, data.output_activation_min);
+      value = std::min(value, data.output_activation_max);
+      output[r * params.output_depth + oc] = static_cast<T>(value);
+    }
+  }
+}
+
+// All the output channels of kRows rows.
+template <typename T, int kRows>
+inline void GemmRows(const GemmParams& params, const T* rows, int row_stride,
+                     const T* filter, T* output) {
+  int32_t row_sums[kRows] = {};
+  if (params.data->filter_offset != 0) {
+    for (int r = 0; r < kRows; ++r) {
+      const T* row = rows + r * row_stride;
+      for (int k = 0; k < params.depth; ++k) {
+        row_sums[r] += row[k];
+      }
+    }
+  }
+  int channel = 0;
+  for (; channel <= params.output_depth - kGemmCols; channel += kGemmCols) {
+    GemmTile<T, kRows, kGemmCols>(params, rows, row_stride, row_sums,
+                                  filter + channel * params.depth, channel,
+                                  output);
+  }
+  for (; channel < params.output_depth; ++channel) {
+    GemmTile<T, kRows, 1>(params, rows, row_stride, row_sums,
+                          filter + channel * params.depth, channel, output);
+  }
+}
+
+// kCols output channels of num_rows rows, with their filter rows.
+template <typename T, int kCols>
+inline void GemmCols(const GemmParams& params, const T* rows, int row_stride,
+                     int num_rows, const int32_t* row_sums,
+                     const T* filter_rows, int channel, T* output) {
+  int row = 0;
+  for (; row <= num_rows - kGemmRows; row += kGemmRows) {
+    GemmTile<T, kGemmRows, kCols>(params, rows + row * row_stride, row_stride,
+                                  row_sums + row, filter_rows, channel,
+                                  output + row * params.output_depth);
+  }
+  for (; row < num_rows; ++row) {
+    GemmTile<T, 1, kCols>(params, rows + row * row_stride, row_stride,
+                          row_sums + row, filter_rows, channel,
+                          output + row * params.output_depth);
+  }
+}
+
+// Gemm() of a palettized filter: the channels are decoded kGemmCols at a
+// time for a block of kPaletteRows rows, the whole filter is never
+// decoded.
+template <typename T>
+void PaletteGemm(const GemmParams& params, const T* rows, int row_stride,
+                 int num_rows, T* output) {
+  const uint8_t* palette = params.data->palette;
+  const int depth = params.depth;
+  alignas(4) T filter_rows[kGemmCols * kPaletteMaxDepth];
+  int32_t row_sums[kPaletteRows];
+  for (int block = 0; block < num_rows; block += kPaletteRows) {
+    const int block_rows = std::min(kPaletteRows, num_rows - block);
+    const T* block_data = rows + block * row_stride;
+    T* block_output = output + block * params.output_depth;
+    for (int r = 0; r < block_rows; ++r) {
+      row_sums[r] = 0;
+      if (params.data->filter_offset != 0) {
+        const T* row = block_data + r * row_stride;
+        for (int k = 0; k < depth; ++k) {
+          row_sums[r] += row[k];
+        }
+      }
+    }
+    int channel = 0;
+    for (; channel <= params.output_depth - kGemmCols; channel += kGemmCols) {
+      for (int c = 0; c < kGemmCols; ++c) {
+        palette_weights::DecodeRow<T>(palette, params.output_depth, depth,
+                                      channel + c, filter_rows + c * depth);
+      }
+      GemmCols<T, kGemmCols>(params, block_data, row_stride, block_rows,
+                             row_sums, filter_rows, channel, block_output);
+    }
+    for (; channel < params.output_depth; ++channel) {
+      palette_weights::DecodeRow<T>(palette, params.output_depth, depth,
+                                    channel, filter_rows);
+      GemmCols<T, 1>(params, block_data, row_stride, block_rows, row_sums,
+                     filter_rows, channel, block_output);
+    }
+  }
+}
+
+// Output pixels of num_rows input rows (or patches) row_stride apart, the
+// outputs are contiguous.
+template <typename T>
+void Gemm(const GemmParams& params, const T* rows, int row_stride,
+          int num_rows, const T* filter, T* output) {
+  if (params.data->palette != nullptr) {
+    PaletteGemm<T>(params, rows, row_stride, num_rows, output);
+    return;
+  }
+  int row = 0;
+  for (; row <= num_rows - kGemmRows; row += kGemmRows) {
+    GemmRows<T, kGemmRows>(params, rows + row * row_stride, row_stride, filter,
+                           output + row * params.output_depth);
+  }
+  for (; row < num_rows; ++row) {
+    GemmRows<T, 1>(params, rows + row * row_stride, row_stride, filter,
+                   output + row * params.output_depth);
+  }
+}
+
+// Quantization of a uint8 or int8 layer: fills everything but padding and
+// the im2col buffer. The per channel arrays point to the offline table if
+// not nullptr (micro_requantization.h), else they are computed in the
+// arena. The palettized filters are recognized by their header.
+TfLiteStatus CalculateOpData(TfLiteContext* context,
+                             const TfLiteConvParams* params,
+                             const TfLiteTensor* input,
+                             const TfLiteTensor* filter,
+                             const TfLiteTensor* bias, TfLiteTensor* output,
+                             const TfLiteRequantizationTable* table,
+                             OpData* data);
+
+}  // namespace conv_gemm
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_CONV_GEMM_H_
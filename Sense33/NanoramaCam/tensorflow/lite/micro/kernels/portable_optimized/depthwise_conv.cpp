@@ -11,6 +11,13 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+The 3x3 layers run the specialized kernels of depthwise_conv_3x3.h. With
+TF_LITE_MICRO_SWAR set, the other layers with depth multiplier 1 run the
+packed kernel of swar_kernels.h. The quantization parameters are read from the
+offline requantization tables of the model metadata if present, instead of
+computing them at every Eval. E.M.
+
 ==============================================================================*/
 
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
@@ -24,6 +31,9 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/depthwise_conv_3x3.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar_kernels.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
 
 namespace tflite {
 namespace ops {
@@ -51,7 +61,10 @@ struct OpData {
   int32_t output_multiplier;
   int output_shift;
 
-  // Per channel output multiplier and shift.
+  // Per channel output multiplier and shift, pointing to the arrays below or
+  // to the offline table.
+  const int32_t* per_channel_multiplier;
+  const int32_t* per_channel_shift;
   int32_t per_channel_output_multiplier[kMaxChannels];
   int32_t per_channel_output_shift[kMaxChannels];
 
@@ -88,6 +101,19 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
     TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
     int num_channels = filter->dims->data[kDepthwiseConvQuantizedDimension];
 
+    const TfLiteRequantizationTable* table =
+        GetRequantizationTable(node, num_channels);
+    if (table != nullptr) {
+      data->output_multiplier = table->output_multiplier;
+      data->output_shift = table->output_shift;
+      data->output_activation_min = table->output_activation_min;
+      data->output_activation_max = table->output_activation_max;
+      data->per_channel_multiplier = RequantizationMultipliers(table);
+      data->per_channel_shift = RequantizationShifts(table);
+      return kTfLiteOk;
+    }
+    data->per_channel_multiplier = data->per_channel_output_multiplier;
+    data->per_channel_shift = data->per_channel_output_shift;
     TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
         context, input, filter, bias, output, params->activation,
         &data->output_multiplier, &data->output_shift,
@@ -348,9 +374,31 @@ void EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
   op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
 
+  if (depthwise_conv_3x3::CanRun(op_params, GetTensorShape(filter))) {
+    depthwise_conv_3x3::DepthwiseConv3x3<int8_t>(
+        op_params, data->per_channel_multiplier, data->per_channel_shift,
+        /*quant_step=*/1, GetTensorShape(input), GetTensorData<int8_t>(input),
+        GetTensorShape(filter), GetTensorData<int8_t>(filter),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output));
+    return;
+  }
+#if TF_LITE_MICRO_SWAR
+  if (swar::CanRunDepthwise(op_params, GetTensorShape(input),
+                            GetTensorShape(filter))) {
+    swar::DepthwiseConv<int8_t>(
+        op_params, data->per_channel_multiplier, data->per_channel_shift,
+        /*quant_step=*/1, GetTensorShape(input), GetTensorData<int8_t>(input),
+        GetTensorShape(filter), GetTensorData<int8_t>(filter),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output));
+    return;
+  }
+#endif
+
   reference_integer_ops::DepthwiseConvPerChannel(
-      op_params, data->per_channel_output_multiplier,
-      data->per_channel_output_shift, GetTensorShape(input),
+      op_params, data->per_channel_multiplier, data->per_channel_shift,
+      GetTensorShape(input),
       GetTensorData<int8>(input), GetTensorShape(filter),
       GetTensorData<int8>(filter), GetTensorShape(bias),
       GetTensorData<int32>(bias), GetTensorShape(output),
@@ -415,6 +463,28 @@ void EvalQuantized(TfLiteContext* context, TfLiteNode* node,
       }
     }
   }
+  const int32_t output_shift = op_params.output_shift;
+  if (depthwise_conv_3x3::CanRun(op_params, GetTensorShape(filter))) {
+    depthwise_conv_3x3::DepthwiseConv3x3<uint8_t>(
+        op_params, &op_params.output_multiplier, &output_shift,
+        /*quant_step=*/0, GetTensorShape(input), GetTensorData<uint8_t>(input),
+        GetTensorShape(filter), GetTensorData<uint8_t>(filter),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<uint8_t>(output));
+    return;
+  }
+#if TF_LITE_MICRO_SWAR
+  if (swar::CanRunDepthwise(op_params, GetTensorShape(input),
+                            GetTensorShape(filter))) {
+    swar::DepthwiseConv<uint8_t>(
+        op_params, &op_params.output_multiplier, &output_shift,
+        /*quant_step=*/0, GetTensorShape(input), GetTensorData<uint8_t>(input),
+        GetTensorShape(filter), GetTensorData<uint8_t>(filter),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<uint8_t>(output));
+    return;
+  }
+#endif
   if (use_optimized_path) {
     DepthwiseConvOptimizedForFilterWidthEight(
         context, op_params, GetTensorShape(input),
@@ -0,0 +1,295 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Depthwise convolution kernels specialized on the filter size, the stride and
+the depth multiplier, bit-exact with the reference kernels. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_DEPTHWISE_CONV_3X3_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_DEPTHWISE_CONV_3X3_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace depthwise_conv_3x3 {
+
+// Every input channel slides a kFilterSize x kFilterSize window along the
+// output row, shared by its kDepthMultiplier output channels. The window
+// holds (input + input_offset), so the kFilterSize - kStride columns shared
+// by two outputs are kept in registers and only kStride new
+// columns are loaded per output. The points outside the image load 0, which
+// is the same as skipping them in the reference kernels. The checks are only
+// compiled in the border loops.
+template <typename T, int kFilterSize, int kStride, int kDepthMultiplier>
+class DepthwiseConvKernel {
+ public:
+  // output_multiplier and output_shift are per channel when quant_step is 1,
+  // a single value when it is 0. A positive shift means left.
+  static void Run(const DepthwiseParams& params,
+                  const int32* output_multiplier, const int32* output_shift,
+                  int quant_step, const RuntimeShape& input_shape,
+                  const T* input_data, const RuntimeShape& filter_shape,
+                  const T* filter_data, const int32* bias_data,
+                  const RuntimeShape& output_shape, T* output_data) {
+    TFLITE_DCHECK_EQ(params.stride_width, kStride);
+    TFLITE_DCHECK_EQ(params.stride_height, kStride);
+    TFLITE_DCHECK_EQ(params.depth_multiplier, kDepthMultiplier);
+    TFLITE_DCHECK_EQ(filter_shape.Dims(1), kFilterSize);
+    TFLITE_DCHECK_EQ(filter_shape.Dims(2), kFilterSize);
+
+    Row row;
+    row.params = &params;
+    row.input_width = input_shape.Dims(2);
+    row.input_depth = input_shape.Dims(3);
+    row.output_depth = MatchingDim(filter_shape, 3, output_shape, 3);
+    row.output_width = output_shape.Dims(2);
+    TFLITE_DCHECK_EQ(row.output_depth, row.input_depth * kDepthMultiplier);
+
+    const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+    const int input_height = input_shape.Dims(1);
+    const int output_height = output_shape.Dims(1);
+    const int pad_width = params.padding_values.width;
+    const int pad_height = params.padding_values.height;
+
+    // Outputs whose window is fully inside the input columns
+    row.x_begin = std::min((pad_width + kStride - 1) / kStride,
+                           row.output_width);
+    const int last_x = row.input_width + pad_width - kFilterSize;
+    row.x_end = last_x < 0 ? row.x_begin
+                           : std::max(std::min(last_x / kStride + 1,
+                                               row.output_width),
+                                      row.x_begin);
+    row.in_x_origin = -pad_width;
+
+    for (int b = 0; b < batches; ++b) {
+      for (int out_y = 0; out_y < output_height; ++out_y) {
+        const int in_y_origin = out_y * kStride - pad_height;
+        bool rows_inside = true;
+        for (int r = 0; r < kFilterSize; ++r) {
+          const int in_y = in_y_origin + r;
+          row.row_valid[r] = in_y >= 0 && in_y < input_height;
+          rows_inside = rows_inside && row.row_valid[r];
+          row.rows[r] = input_data + Offset(input_shape, b,
+                                            row.row_valid[r] ? in_y : 0, 0, 0);
+        }
+        T* out_row = output_data + Offset(output_shape, b, out_y, 0, 0);
+        for (int ic = 0; ic < row.input_depth; ++ic) {
+          if (rows_inside) {
+            RunChannel<false>(row, ic, filter_data, bias_data,
+                              output_multiplier, output_shift, quant_step,
+                              out_row);
+          } else {
+            RunChannel<true>(row, ic, filter_data, bias_data,
+                             output_multiplier, output_shift, quant_step,
+                             out_row);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  // Columns reused from the previous window
+  enum { kReused = kFilterSize > kStride ? kFilterSize - kStride : 0 };
+
+  // State of the output row being computed
+  struct Row {
+    const DepthwiseParams* params;
+    const T* rows[kFilterSize];
+    bool row_valid[kFilterSize];
+    int input_width;
+    int input_depth;
+    int output_depth;
+    int output_width;
+    int in_x_origin;
+    int x_begin;
+    int x_end;
+  };
+
+  template <bool kCheckY, bool kCheckX>
+  static inline int32 Load(const Row& row, int r, int in_x, int channel) {
+    if (kCheckY && !row.row_valid[r]) {
+      return 0;
+    }
+    if (kCheckX && (in_x < 0 || in_x >= row.input_width)) {
+      return 0;
+    }
+    return row.rows[r][in_x * row.input_depth + channel] +
+           row.params->input_offset;
+  }
+
+  // Load the columns from first of the window of the output out_x.
+  template <bool kCheckY, bool kCheckX>
+  static inline void LoadColumns(const Row& row, int out_x, int first,
+                                 int channel,
+                                 int32 window[kFilterSize][kFilterSize]) {
+    const int in_x = row.in_x_origin + out_x * kStride;
+    for (int c = first; c < kFilterSize; ++c) {
+      for (int r = 0; r < kFilterSize; ++r) {
+        window[r][c] = Load<kCheckY, kCheckX>(row, r, in_x + c, channel);
+      }
+    }
+  }
+
+  static inline void Slide(int32 window[kFilterSize][kFilterSize]) {
+    for (int c = 0; c < kReused; ++c) {
+      for (int r = 0; r < kFilterSize; ++r) {
+        window[r][c] = window[r][c + kStride];
+      }
+    }
+  }
+
+  // Filters and output stage of the kDepthMultiplier output channels of an
+  // input channel
+  struct Channel {
+    int32 filter[kDepthMultiplier][kFilterSize][kFilterSize];
+    int32 bias[kDepthMultiplier];
+    int32 output_multiplier[kDepthMultiplier];
+    int output_shift[kDepthMultiplier];
+  };
+
+  // All the outputs of the input channel ic in the current row. The window
+  // is shared by the kDepthMultiplier output channels.
+  template <bool kCheckY>
+  static inline void RunChannel(const Row& row, int ic, const T* filter_data,
+                                const int32* bias_data,
+                                const int32* output_multiplier,
+                                const int32* output_shift, int quant_step,
+                                T* out_row) {
+    const DepthwiseParams& params = *row.params;
+    Channel channel;
+    for (int m = 0; m < kDepthMultiplier; ++m) {
+      const int oc = ic * kDepthMultiplier + m;
+      for (int r = 0; r < kFilterSize; ++r) {
+        for (int c = 0; c < kFilterSize; ++c) {
+          channel.filter[m][r][c] =
+              filter_data[(r * kFilterSize + c) * row.output_depth + oc] +
+              params.weights_offset;
+        }
+      }
+      channel.bias[m] = bias_data != nullptr ? bias_data[oc] : 0;
+      channel.output_multiplier[m] = output_multiplier[oc * quant_step];
+      channel.output_shift[m] = output_shift[oc * quant_step];
+    }
+    int32 window[kFilterSize][kFilterSize];
+    T* out = out_row + ic * kDepthMultiplier;
+
+    // Left border, the first window is always loaded in full
+    int out_x = 0;
+    for (; out_x < row.x_begin; ++out_x) {
+      LoadColumns<kCheckY, true>(row, out_x, out_x == 0 ? 0 : kReused, ic,
+                                 window);
+      Output(params, window, channel, out + out_x * row.output_depth);
+      Slide(window);
+    }
+    if (out_x < row.x_end) {
+      if (out_x == 0) {
+        LoadColumns<kCheckY, false>(row, 0, 0, ic, window);
+        Output(params, window, channel, out);
+        Slide(window);
+        out_x = 1;
+      }
+      // Interior
+      for (; out_x < row.x_end; ++out_x) {
+        LoadColumns<kCheckY, false>(row, out_x, kReused, ic, window);
+        Output(params, window, channel, out + out_x * row.output_depth);
+        Slide(window);
+      }
+    }
+    // Right border
+    for (; out_x < row.output_width; ++out_x) {
+      LoadColumns<kCheckY, true>(row, out_x, out_x == 0 ? 0 : kReused, ic,
+                                 window);
+      Output(params, window, channel, out + out_x * row.output_depth);
+      Slide(window);
+    }
+  }
+
+  static inline void Output(const DepthwiseParams& params,
+                            const int32 window[kFilterSize][kFilterSize],
+                            const Channel& channel, T* out) {
+    for (int m = 0; m < kDepthMultiplier; ++m) {
+      int32 acc = 0;
+      for (int r = 0; r < kFilterSize; ++r) {
+        for (int c = 0; c < kFilterSize; ++c) {
+          acc += channel.filter[m][r][c] * window[r][c];
+        }
+      }
+      acc += channel.bias[m];
+      acc = MultiplyByQuantizedMultiplier(acc, channel.output_multiplier[m],
+                                          channel.output_shift[m]);
+      acc += params.output_offset;
+      acc = std::max(acc, params.quantized_activation_min);
+      acc = std::min(acc, params.quantized_activation_max);
+      out[m] = static_cast<T>(acc);
+    }
+  }
+};
+
+// True if the layer matches one of the specialized kernels.
+inline bool CanRun(const DepthwiseParams& params,
+                   const RuntimeShape& filter_shape) {
+  return filter_shape.Dims(1) == 3 && filter_shape.Dims(2) == 3 &&
+         params.dilation_width_factor == 1 &&
+         params.dilation_height_factor == 1 &&
+         params.stride_width == params.stride_height &&
+         (params.stride_width == 1 || params.stride_width == 2) &&
+         (params.depth_multiplier == 1 || params.depth_multiplier == 8);
+}
+
+// Run the specialized kernel of the layer, CanRun() must be true.
+template <typename T>
+inline void DepthwiseConv3x3(const DepthwiseParams& params,
+                             const int32* output_multiplier,
+                             const int32* output_shift, int quant_step,
+                             const RuntimeShape& input_shape,
+                             const T* input_data,
+                             const RuntimeShape& filter_shape,
+                             const T* filter_data, const int32* bias_data,
+                             const RuntimeShape& output_shape, T* output_data) {
+  // The person model starts with a 1 to 8 channels layer
+  if (params.depth_multiplier == 8) {
+    if (params.stride_width == 1) {
+      DepthwiseConvKernel<T, 3, 1, 8>::Run(
+          params, output_multiplier, output_shift, quant_step, input_shape,
+          input_data, filter_shape, filter_data, bias_data, output_shape,
+          output_data);
+    } else {
+      DepthwiseConvKernel<T, 3, 2, 8>::Run(
+          params, output_multiplier, output_shift, quant_step, input_shape,
+          input_data, filter_shape, filter_data, bias_data, output_shape,
+          output_data);
+    }
+  } else if (params.stride_width == 1) {
+    DepthwiseConvKernel<T, 3, 1, 1>::Run(
+        params, output_multiplier, output_shift, quant_step, input_shape,
+        input_data, filter_shape, filter_data, bias_data, output_shape,
+        output_data);
+  } else {
+    DepthwiseConvKernel<T, 3, 2, 1>::Run(
+        params, output_multiplier, output_shift, quant_step, input_shape,
+        input_data, filter_shape, filter_data, bias_data, output_shape,
+        output_data);
+  }
+}
+
+}  // namespace depthwise_conv_3x3
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_DEPTHWISE_CONV_3X3_H_
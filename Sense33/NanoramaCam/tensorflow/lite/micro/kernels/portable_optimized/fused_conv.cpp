@@ -0,0 +1,678 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Fused DEPTHWISE_CONV_2D or AVERAGE_POOL_2D and 1x1 CONV_2D, and patched
+layers of micro_fusion.h for the uint8 and int8 models, bit-exact with the
+operators they replace. E.M.
+
+==============================================================================*/
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/pooling.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/conv_gemm.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/depthwise_conv_3x3.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar_kernels.h"
+#include "tensorflow/lite/micro/micro_fusion.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace fused_conv {
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kFilterTensor = 1;
+constexpr int kBiasTensor = 2;
+constexpr int kOutputTensor = 0;
+
+// Depthwise conv is quantized along dimension 3:
+// https://www.tensorflow.org/lite/performance/quantization_spec
+constexpr int kDepthwiseConvQuantizedDimension = 3;
+
+// The depthwise convolutions and the average pools compute a band of output
+// rows with their usual kernel on a view of the input rows under the window
+// of the band: the padding above the view is the padding of the image or
+// the part of the window above the image, the rows past the view are past
+// the image, so the border handling of the kernels is unchanged.
+//
+// The fused operators compute one row of the intermediate tensor on the
+// stack, the 1x1 convolution turns it into a row of the output. The patched
+// layers compute the rows of a patch in the two buffers of the node.
+//
+// Parameters of a depthwise convolution or an average pool on a view.
+struct ViewOpData {
+  bool is_depthwise;
+  DepthwiseParams depthwise;
+  PoolParams pool;
+  // Per channel multiplier and shift of the int8 depthwise convolution, a
+  // single value for uint8, QuantizedChannels() entries. A positive shift
+  // means left. They point to the requantization table, to persistent
+  // arrays or to the per tensor values of uint8.
+  const int32_t* output_multiplier;
+  const int32_t* output_shift;
+  int32_t tensor_multiplier;
+  int32_t tensor_shift;
+  int quant_step;
+  // Input rows under the window of an intermediate row
+  int window_height;
+  int stride_height;
+  int pad_height;
+};
+
+static_assert(sizeof(ViewOpData) <= kFusedConvFirstOpBytes,
+              "kFusedConvFirstOpBytes of micro_fusion.h must hold ViewOpData");
+
+// Channels of the depthwise convolution multipliers, the uint8 filters have
+// a single scale.
+int QuantizedChannels(const TfLiteTensor* input, const TfLiteTensor* filter) {
+  return input->type == kTfLiteInt8
+             ? filter->dims->data[kDepthwiseConvQuantizedDimension]
+             : 1;
+}
+
+TfLiteStatus CalculateDepthwiseConvData(
+    TfLiteContext* context, const TfLiteDepthwiseConvParams* params,
+    const TfLiteTensor* input, const TfLiteTensor* filter,
+    const TfLiteTensor* bias, TfLiteTensor* output,
+    const TfLiteRequantizationTable* table, ViewOpData* data) {
+  const int filter_height = filter->dims->data[1];
+  const int filter_width = filter->dims->data[2];
+  int out_height, out_width;
+  const TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width,
+      params->dilation_height_factor, params->dilation_width_factor,
+      input->dims->data[1], input->dims->data[2], filter_height, filter_width,
+      params->padding, &out_height, &out_width);
+
+  const int num_channels = QuantizedChannels(input, filter);
+  int32_t output_multiplier;
+  int output_shift;
+  int32_t output_activation_min, output_activation_max;
+  if (table != nullptr) {
+    output_multiplier = table->output_multiplier;
+    output_shift = table->output_shift;
+    output_activation_min = table->output_activation_min;
+    output_activation_max = table->output_activation_max;
+    data->output_multiplier = RequantizationMultipliers(table);
+    data->output_shift = RequantizationShifts(table);
+  } else {
+    int32_t* multipliers = &data->tensor_multiplier;
+    int32_t* shifts = &data->tensor_shift;
+    if (input->type == kTfLiteInt8) {
+      TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+          context, num_channels * sizeof(int32_t),
+          reinterpret_cast<void**>(&multipliers)));
+      TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+          context, num_channels * sizeof(int32_t),
+          reinterpret_cast<void**>(&shifts)));
+    }
+    TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+        context, input, filter, bias, output, params->activation,
+        &output_multiplier, &output_shift, &output_activation_min,
+        &output_activation_max, multipliers, reinterpret_cast<int*>(shifts),
+        num_channels));
+    data->output_multiplier = multipliers;
+    data->output_shift = shifts;
+  }
+
+  DepthwiseParams& op_params = data->depthwise;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = padding.width;
+  op_params.padding_values.height = padding.height;
+  op_params.stride_width = params->stride_width;
+  op_params.stride_height = params->stride_height;
+  op_params.dilation_width_factor = params->dilation_width_factor;
+  op_params.dilation_height_factor = params->dilation_height_factor;
+  op_params.depth_multiplier = params->depth_multiplier;
+  op_params.input_offset = -input->params.zero_point;
+  op_params.output_offset = output->params.zero_point;
+  if (input->type == kTfLiteUInt8) {
+    // Same parameters of depthwise_conv.cpp
+    op_params.dilation_width_factor = 1;
+    op_params.dilation_height_factor = 1;
+    op_params.weights_offset = -filter->params.zero_point;
+    op_params.quantized_activation_min = output_activation_min;
+    op_params.quantized_activation_max = output_activation_max;
+    op_params.output_multiplier = output_multiplier;
+    op_params.output_shift = -output_shift;
+    data->tensor_multiplier = op_params.output_multiplier;
+    data->tensor_shift = op_params.output_shift;
+    data->output_multiplier = &data->tensor_multiplier;
+    data->output_shift = &data->tensor_shift;
+    data->quant_step = 0;
+  } else {
+    // The int8 kernel of depthwise_conv.cpp clamps to the type range
+    op_params.weights_offset = 0;
+    op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
+    op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+    data->quant_step = 1;
+  }
+  data->is_depthwise = true;
+  data->window_height =
+      (filter_height - 1) * op_params.dilation_height_factor + 1;
+  data->stride_height = params->stride_height;
+  data->pad_height = padding.height;
+  return kTfLiteOk;
+}
+
+TfLiteStatus CalculateAveragePoolData(TfLiteContext* context,
+                                      const TfLitePoolParams* params,
+                                      const TfLiteTensor* input,
+                                      TfLiteTensor* output,
+                                      ViewOpData* data) {
+  int out_height, out_width;
+  const TfLitePaddingValues padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width,
+      /*dilation_rate_height=*/1,
+      /*dilation_rate_width=*/1, input->dims->data[1], input->dims->data[2],
+      params->filter_height, params->filter_width, params->padding,
+      &out_height, &out_width);
+  int32_t activation_min, activation_max;
+  TF_LITE_ENSURE_STATUS(CalculateActivationRangeQuantized(
+      context, params->activation, output, &activation_min, &activation_max));
+
+  PoolParams& op_params = data->pool;
+  op_params.stride_height = params->stride_height;
+  op_params.stride_width = params->stride_width;
+  op_params.filter_height = params->filter_height;
+  op_params.filter_width = params->filter_width;
+  op_params.padding_values.height = padding.height;
+  op_params.padding_values.width = padding.width;
+  op_params.quantized_activation_min = activation_min;
+  op_params.quantized_activation_max = activation_max;
+  data->is_depthwise = false;
+  data->window_height = params->filter_height;
+  data->stride_height = params->stride_height;
+  data->pad_height = padding.height;
+  return kTfLiteOk;
+}
+
+// Depthwise convolution of a view of the input, with the kernel selection
+// of depthwise_conv.cpp.
+template <typename T>
+void DepthwiseConvView(const DepthwiseParams& params,
+                       const ViewOpData& data,
+                       const RuntimeShape& input_shape, const T* input_data,
+                       const TfLiteTensor* filter, const TfLiteTensor* bias,
+                       const RuntimeShape& output_shape, T* output_data);
+
+template <>
+void DepthwiseConvView<uint8_t>(const DepthwiseParams& params,
+                                const ViewOpData& data,
+                                const RuntimeShape& input_shape,
+                                const uint8_t* input_data,
+                                const TfLiteTensor* filter,
+                                const TfLiteTensor* bias,
+                                const RuntimeShape& output_shape,
+                                uint8_t* output_data) {
+  if (depthwise_conv_3x3::CanRun(params, GetTensorShape(filter))) {
+    depthwise_conv_3x3::DepthwiseConv3x3<uint8_t>(
+        params, data.output_multiplier, data.output_shift, data.quant_step,
+        input_shape, input_data, GetTensorShape(filter),
+        GetTensorData<uint8_t>(filter), GetTensorData<int32_t>(bias),
+        output_shape, output_data);
+    return;
+  }
+#if TF_LITE_MICRO_SWAR
+  if (swar::CanRunDepthwise(params, input_shape, GetTensorShape(filter))) {
+    swar::DepthwiseConv<uint8_t>(
+        params, data.output_multiplier, data.output_shift, data.quant_step,
+        input_shape, input_data, GetTensorShape(filter),
+        GetTensorData<uint8_t>(filter), GetTensorData<int32_t>(bias),
+        output_shape, output_data);
+    return;
+  }
+#endif
+  reference_ops::DepthwiseConv(
+      params, input_shape, input_data, GetTensorShape(filter),
+      GetTensorData<uint8_t>(filter), GetTensorShape(bias),
+      GetTensorData<int32_t>(bias), output_shape, output_data);
+}
+
+template <>
+void DepthwiseConvView<int8_t>(const DepthwiseParams& params,
+                               const ViewOpData& data,
+                               const RuntimeShape& input_shape,
+                               const int8_t* input_data,
+                               const TfLiteTensor* filter,
+                               const TfLiteTensor* bias,
+                               const RuntimeShape& output_shape,
+                               int8_t* output_data) {
+  if (depthwise_conv_3x3::CanRun(params, GetTensorShape(filter))) {
+    depthwise_conv_3x3::DepthwiseConv3x3<int8_t>(
+        params, data.output_multiplier, data.output_shift, data.quant_step,
+        input_shape, input_data, GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorData<int32_t>(bias),
+        output_shape, output_data);
+    return;
+  }
+#if TF_LITE_MICRO_SWAR
+  if (swar::CanRunDepthwise(params, input_shape, GetTensorShape(filter))) {
+    swar::DepthwiseConv<int8_t>(
+        params, data.output_multiplier, data.output_shift, data.quant_step,
+        input_shape, input_data, GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorData<int32_t>(bias),
+        output_shape, output_data);
+    return;
+  }
+#endif
+  reference_integer_ops::DepthwiseConvPerChannel(
+      params, data.output_multiplier, data.output_shift, input_shape,
+      input_data, GetTensorShape(filter), GetTensorData<int8_t>(filter),
+      GetTensorShape(bias), GetTensorData<int32_t>(bias), output_shape,
+      output_data);
+}
+
+inline void AveragePoolView(const PoolParams& params,
+                            const RuntimeShape& input_shape,
+                            const uint8_t* input_data,
+                            const RuntimeShape& output_shape,
+                            uint8_t* output_data) {
+  reference_ops::AveragePool(params, input_shape, input_data, output_shape,
+                             output_data);
+}
+
+inline void AveragePoolView(const PoolParams& params,
+                            const RuntimeShape& input_shape,
+                            const int8_t* input_data,
+                            const RuntimeShape& output_shape,
+                            int8_t* output_data) {
+  reference_integer_ops::AveragePool(params, input_shape, input_data,
+                                     output_shape, output_data);
+}
+
+// Parameters of the first operator, its output is the intermediate tensor.
+TfLiteStatus CalculateFirstOpData(TfLiteContext* context, TfLiteNode* node,
+                                  const TfLiteFusedConvParams& params,
+                                  ViewOpData* data) {
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* intermediate =
+      &context->tensors[params.conv_inputs->data[kInputTensor]];
+  if (params.first_op == BuiltinOperator_DEPTHWISE_CONV_2D) {
+    return CalculateDepthwiseConvData(
+        context,
+        static_cast<const TfLiteDepthwiseConvParams*>(params.first_params),
+        input, GetInput(context, node, kFilterTensor),
+        GetOptionalInputTensor(context, node, kBiasTensor), intermediate,
+        params.first_table, data);
+  }
+  TF_LITE_ENSURE_EQ(context, params.first_op,
+                    BuiltinOperator_AVERAGE_POOL_2D);
+  return CalculateAveragePoolData(
+      context, static_cast<const TfLitePoolParams*>(params.first_params),
+      input, intermediate, data);
+}
+
+// Output rows [out_begin, out_end) of a depthwise convolution or an average
+// pool, input_data holds the input rows from input_begin.
+template <typename T>
+void EvalViewRows(ViewOpData* data, const TfLiteTensor* input,
+                  const T* input_data, int input_begin,
+                  const TfLiteTensor* filter, const TfLiteTensor* bias,
+                  const TfLiteTensor* output, int out_begin, int out_end,
+                  T* output_data) {
+  const int input_height = input->dims->data[1];
+  const int input_width = input->dims->data[2];
+  const int input_depth = input->dims->data[3];
+  // Input rows under the window of the rows
+  const int in_y_origin = out_begin * data->stride_height - data->pad_height;
+  const int first_y = std::max(in_y_origin, 0);
+  const int end_y = std::max(
+      std::min((out_end - 1) * data->stride_height - data->pad_height +
+                   data->window_height,
+               input_height),
+      first_y);
+  const int32 view_dims[4] = {1, end_y - first_y, input_width, input_depth};
+  const RuntimeShape view_shape(4, view_dims);
+  const T* view =
+      input_data + (first_y - input_begin) * input_width * input_depth;
+  const int32 rows_dims[4] = {1, out_end - out_begin, output->dims->data[2],
+                              output->dims->data[3]};
+  const RuntimeShape rows_shape(4, rows_dims);
+  if (data->is_depthwise) {
+    data->depthwise.padding_values.height = first_y - in_y_origin;
+    DepthwiseConvView<T>(data->depthwise, *data, view_shape, view, filter,
+                         bias, rows_shape, output_data);
+  } else {
+    data->pool.padding_values.height = first_y - in_y_origin;
+    AveragePoolView(data->pool, view_shape, view, rows_shape, output_data);
+  }
+}
+
+// Data of a fused node, computed by Prepare.
+struct FusedOpData {
+  conv_gemm::OpData conv;
+  // First operator, its output is the intermediate tensor
+  ViewOpData first;
+};
+
+template <typename T>
+void EvalFused(TfLiteContext* context, TfLiteNode* node,
+               const TfLiteFusedConvParams& params, FusedOpData* data) {
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  const TfLiteTensor* intermediate =
+      &context->tensors[params.conv_inputs->data[kInputTensor]];
+  const TfLiteTensor* conv_filter =
+      &context->tensors[params.conv_inputs->data[kFilterTensor]];
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  const int row_height = intermediate->dims->data[1];
+  const int row_width = intermediate->dims->data[2];
+  const int row_depth = intermediate->dims->data[3];
+  const int output_depth = output->dims->data[3];
+  const T* input_data = GetTensorData<T>(input);
+  const T* conv_filter_data = GetTensorData<T>(conv_filter);
+  T* output_data = GetTensorData<T>(output);
+
+  alignas(4) T row[kFusedConvMaxRowBytes / sizeof(T)];
+  conv_gemm::GemmParams gemm;
+  gemm.data = &data->conv;
+  gemm.depth = row_depth;
+  gemm.output_depth = output_depth;
+
+  for (int out_y = 0; out_y < row_height; ++out_y) {
+    EvalViewRows<T>(&data->first, input, input_data, 0, filter, bias,
+                    intermediate, out_y, out_y + 1, row);
+    conv_gemm::Gemm<T>(gemm, row, row_depth, row_width, conv_filter_data,
+                       output_data + out_y * row_width * output_depth);
+  }
+}
+
+// Data of a layer of the patched node.
+union PatchedLayerData {
+  // DEPTHWISE_CONV_2D and AVERAGE_POOL_2D
+  ViewOpData view;
+  // 1x1 CONV_2D
+  conv_gemm::OpData conv;
+};
+
+struct PatchedOpData {
+  PatchedLayerData* layers;
+  // Scratch buffers of the patches of the inner layers, -1 if not used
+  int buffer_index[2];
+};
+
+const TfLiteTensor* LayerBias(const TfLiteContext* context,
+                              const TfLitePatchedLayer& layer) {
+  return layer.inputs->size > kBiasTensor
+             ? &context->tensors[layer.inputs->data[kBiasTensor]]
+             : nullptr;
+}
+
+TfLiteStatus PreparePatchedLayer(TfLiteContext* context,
+                                 const TfLitePatchedLayer& layer,
+                                 PatchedLayerData* data) {
+  TfLiteTensor* input = &context->tensors[layer.inputs->data[kInputTensor]];
+  TfLiteTensor* output = &context->tensors[layer.output];
+  if (layer.op == BuiltinOperator_AVERAGE_POOL_2D) {
+    return CalculateAveragePoolData(
+        context, static_cast<const TfLitePoolParams*>(layer.params), input,
+        output, &data->view);
+  }
+  const TfLiteTensor* filter =
+      &context->tensors[layer.inputs->data[kFilterTensor]];
+  const TfLiteTensor* bias = LayerBias(context, layer);
+  if (layer.op == BuiltinOperator_CONV_2D) {
+    TF_LITE_ENSURE_STATUS(conv_gemm::CalculateOpData(
+        context, static_cast<const TfLiteConvParams*>(layer.params), input,
+        filter, bias, output, layer.table, &data->conv));
+    data->conv.im2col_index = -1;
+    data->conv.im2col_rows = 0;
+    return kTfLiteOk;
+  }
+  return CalculateDepthwiseConvData(
+      context, static_cast<const TfLiteDepthwiseConvParams*>(layer.params),
+      input, filter, bias, output, layer.table, &data->view);
+}
+
+template <typename T>
+void EvalPatched(TfLiteContext* context, TfLiteNode* node,
+                 const TfLitePatchedLayersParams& params,
+                 const PatchedOpData& data) {
+  T* buffers[2] = {nullptr, nullptr};
+  for (int b = 0; b < 2; ++b) {
+    if (data.buffer_index[b] >= 0) {
+      buffers[b] = static_cast<T*>(
+          context->GetScratchBuffer(context, data.buffer_index[b]));
+    }
+  }
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const int height = output->dims->data[1];
+  const int last = params.num_layers - 1;
+  int begin[kMaxPatchedLayers];
+  int end[kMaxPatchedLayers];
+
+  for (int out_y = 0; out_y < height; out_y += params.patch_rows) {
+    PatchRows(context, params, out_y,
+              std::min(out_y + params.patch_rows, height), begin, end);
+    for (int l = 0; l <= last; ++l) {
+      const TfLitePatchedLayer& layer = params.layers[l];
+      PatchedLayerData* layer_data = &data.layers[l];
+      const TfLiteTensor* layer_input =
+          &context->tensors[layer.inputs->data[kInputTensor]];
+      const TfLiteTensor* layer_output = &context->tensors[layer.output];
+      // The first layer reads the input tensor, the last one writes the
+      // output tensor
+      const T* input_data =
+          l == 0 ? GetTensorData<T>(layer_input) : buffers[(l - 1) % 2];
+      const int input_begin = l == 0 ? 0 : begin[l - 1];
+      const int width = layer_output->dims->data[2];
+      const int depth = layer_output->dims->data[3];
+      T* output_data = l == last ? GetTensorData<T>(output) +
+                                       begin[l] * width * depth
+                                 : buffers[l % 2];
+      const TfLiteTensor* filter =
+          layer.inputs->size > kFilterTensor
+              ? &context->tensors[layer.inputs->data[kFilterTensor]]
+              : nullptr;
+
+      if (layer.op == BuiltinOperator_CONV_2D) {
+        const int input_depth = layer_input->dims->data[3];
+        conv_gemm::GemmParams gemm;
+        gemm.data = &layer_data->conv;
+        gemm.depth = input_depth;
+        gemm.output_depth = depth;
+        conv_gemm::Gemm<T>(gemm,
+                           input_data + (begin[l] - input_begin) *
+                                            layer_input->dims->data[2] *
+                                            input_depth,
+                           input_depth, (end[l] - begin[l]) * width,
+                           GetTensorData<T>(filter), output_data);
+      } else {
+        EvalViewRows<T>(&layer_data->view, layer_input, input_data,
+                        input_begin, filter, LayerBias(context, layer),
+                        layer_output, begin[l], end[l], output_data);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void* Init(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  void* data = nullptr;
+  if (context->AllocatePersistentBuffer(context, sizeof(FusedOpData),
+                                        &data) == kTfLiteError) {
+    return nullptr;
+  }
+  return data;
+}
+
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+
+  auto* data = static_cast<FusedOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteFusedConvParams*>(node->builtin_data);
+  TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
+  TF_LITE_ENSURE(context, params->conv_inputs->size == 2 ||
+                              params->conv_inputs->size == 3);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* intermediate =
+      &context->tensors[params->conv_inputs->data[kInputTensor]];
+  const TfLiteTensor* conv_filter =
+      &context->tensors[params->conv_inputs->data[kFilterTensor]];
+  const TfLiteTensor* conv_bias =
+      params->conv_inputs->size == 3
+          ? &context->tensors[params->conv_inputs->data[kBiasTensor]]
+          : nullptr;
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE(context,
+                 input->type == kTfLiteUInt8 || input->type == kTfLiteInt8);
+  TF_LITE_ENSURE_EQ(context, input->dims->data[0], 1);
+  TF_LITE_ENSURE(context, intermediate->dims->data[2] *
+                                  intermediate->dims->data[3] <=
+                              kFusedConvMaxRowBytes);
+
+  TF_LITE_ENSURE_STATUS(
+      CalculateFirstOpData(context, node, *params, &data->first));
+  TF_LITE_ENSURE_STATUS(
+      conv_gemm::CalculateOpData(context, params->conv_params, intermediate,
+                                 conv_filter, conv_bias, output,
+                                 params->conv_table, &data->conv));
+  data->conv.im2col_index = -1;
+  data->conv.im2col_rows = 0;
+  return kTfLiteOk;
+}
+
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  const auto* params =
+      static_cast<const TfLiteFusedConvParams*>(node->builtin_data);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+
+  TFLITE_DCHECK(node->user_data != nullptr);
+  auto* data = static_cast<FusedOpData*>(node->user_data);
+
+  switch (input->type) {  // Already know in/out types are same.
+    case kTfLiteInt8:
+      EvalFused<int8_t>(context, node, *params, data);
+      break;
+    case kTfLiteUInt8:
+      EvalFused<uint8_t>(context, node, *params, data);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input->type), input->type);
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+void* PatchedInit(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  void* data = nullptr;
+  if (context->AllocatePersistentBuffer(context, sizeof(PatchedOpData),
+                                        &data) == kTfLiteError) {
+    return nullptr;
+  }
+  return data;
+}
+
+TfLiteStatus PatchedPrepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+
+  auto* data = static_cast<PatchedOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLitePatchedLayersParams*>(node->builtin_data);
+  TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TF_LITE_ENSURE(context,
+                 input->type == kTfLiteUInt8 || input->type == kTfLiteInt8);
+
+  // The layer data is allocated here, the number of layers is in the params
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, params->num_layers * sizeof(PatchedLayerData),
+      reinterpret_cast<void**>(&data->layers)));
+  for (int l = 0; l < params->num_layers; ++l) {
+    TF_LITE_ENSURE_STATUS(
+        PreparePatchedLayer(context, params->layers[l], &data->layers[l]));
+  }
+  for (int b = 0; b < 2; ++b) {
+    data->buffer_index[b] = -1;
+    if (params->buffer_bytes[b] > 0) {
+      TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+          context, params->buffer_bytes[b], &data->buffer_index[b]));
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus PatchedEval(TfLiteContext* context, TfLiteNode* node) {
+  const auto* params =
+      static_cast<const TfLitePatchedLayersParams*>(node->builtin_data);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const auto& data = *(static_cast<const PatchedOpData*>(node->user_data));
+
+  switch (input->type) {  // Already know in/out types are same.
+    case kTfLiteInt8:
+      EvalPatched<int8_t>(context, node, *params, data);
+      break;
+    case kTfLiteUInt8:
+      EvalPatched<uint8_t>(context, node, *params, data);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input->type), input->type);
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace fused_conv
+
+TfLiteRegistration* Register_FUSED_CONV_2D() {
+  static TfLiteRegistration r = {/*init=*/fused_conv::Init,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/fused_conv::Prepare,
+                                 /*invoke=*/fused_conv::Eval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
+TfLiteRegistration* Register_PATCHED_LAYERS() {
+  static TfLiteRegistration r = {/*init=*/fused_conv::PatchedInit,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/fused_conv::PatchedPrepare,
+                                 /*invoke=*/fused_conv::PatchedEval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
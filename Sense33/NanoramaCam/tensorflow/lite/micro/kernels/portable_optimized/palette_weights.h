@@ -0,0 +1,93 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Palettized 4-bit CONV_2D filters: a codebook of 16 values per output channel
+and a 4-bit index per filter value. Written by host/person_detect_compress,
+decoded by the GEMM of conv_gemm.h a few channels at a time. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_PALETTE_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_PALETTE_WEIGHTS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace palette_weights {
+
+// Layout of a palettized filter in the buffer of the filter tensor, the
+// integers are little endian:
+//   "PAL4"
+//   uint16 output channels, uint16 depth (filter height x width x input
+//   channels)
+//   output channels x kCodebookSize bytes: the codebook of every output
+//   channel, filter values of the tensor type
+//   output channels x RowBytes(depth) bytes: the codebook index of every
+//   filter value, two per byte, low nibble first
+// The filters of less than kHeaderBytes values are never palettized, so the
+// header of a raw filter can be read.
+constexpr int kHeaderBytes = 8;
+constexpr int kCodebookSize = 16;
+constexpr uint8_t kMagic[4] = {'P', 'A', 'L', '4'};
+
+inline int RowBytes(int depth) { return (depth + 1) / 2; }
+
+inline size_t FilterBytes(int output_depth, int depth) {
+  return kHeaderBytes + output_depth * (kCodebookSize + RowBytes(depth));
+}
+
+// Codebooks of data if it is a palettized filter of the given shape, else
+// nullptr. The indices follow the codebooks, so the kernels only keep this
+// pointer.
+inline const uint8_t* Parse(const uint8_t* data, int output_depth,
+                            int depth) {
+  if (data == nullptr || output_depth * depth < kHeaderBytes) {
+    return nullptr;
+  }
+  for (int i = 0; i < 4; ++i) {
+    if (data[i] != kMagic[i]) {
+      return nullptr;
+    }
+  }
+  if ((data[4] | (data[5] << 8)) != output_depth ||
+      (data[6] | (data[7] << 8)) != depth) {
+    return nullptr;
+  }
+  return data + kHeaderBytes;
+}
+
+// Filter values of an output channel, codebooks as returned by Parse().
+template <typename T>
+inline void DecodeRow(const uint8_t* codebooks, int output_depth, int depth,
+                      int channel, T* row) {
+  const uint8_t* codebook = codebooks + channel * kCodebookSize;
+  const uint8_t* indices = codebooks + output_depth * kCodebookSize +
+                           channel * RowBytes(depth);
+  int k = 0;
+  for (; k <= depth - 2; k += 2) {
+    const uint8_t pair = indices[k / 2];
+    row[k] = static_cast<T>(codebook[pair & 0x0f]);
+    row[k + 1] = static_cast<T>(codebook[pair >> 4]);
+  }
+  if (k < depth) {
+    row[k] = static_cast<T>(codebook[indices[k / 2] & 0x0f]);
+  }
+}
+
+}  // namespace palette_weights
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_PALETTE_WEIGHTS_H_
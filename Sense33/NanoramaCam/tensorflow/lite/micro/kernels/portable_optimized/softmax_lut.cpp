@@ -0,0 +1,169 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+SOFTMAX reading the exponentials of the quantized input from a table of
+tail_ops.h, built at Prepare() in 1 KB of persistent arena, bit-exact with
+the reference kernel of softmax.cpp. E.M.
+
+==============================================================================*/
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/tail_ops.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace softmax_lut {
+namespace {
+
+struct OpData {
+  SoftmaxParams params;
+  // Exponentials of the quantized input, nullptr for the float one
+  int32_t* exp_table;
+};
+
+// Same parameters of CalculateSoftmaxParams() in softmax.cpp.
+TfLiteStatus CalculateSoftmaxParams(TfLiteContext* context,
+                                    const TfLiteTensor* input,
+                                    TfLiteTensor* output,
+                                    const TfLiteSoftmaxParams* params,
+                                    SoftmaxParams* op_data) {
+  if (input->type == kTfLiteUInt8 || input->type == kTfLiteInt8) {
+    if (input->type == kTfLiteUInt8) {
+      TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteUInt8);
+      TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+    } else {
+      TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+      if (output->type == kTfLiteInt16) {
+        TF_LITE_ENSURE_EQ(context, output->params.zero_point, -32768);
+      } else {
+        TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteInt8);
+        TF_LITE_ENSURE_EQ(context, output->params.zero_point, -128);
+        TF_LITE_ENSURE(context, output->params.scale == 1.f / 256);
+      }
+    }
+
+    int input_left_shift;
+    tflite::PreprocessSoftmaxScaling(
+        static_cast<double>(params->beta),
+        static_cast<double>(input->params.scale),
+        tail_ops::kScaledDiffIntegerBits, &op_data->input_multiplier,
+        &input_left_shift);
+    op_data->input_left_shift = input_left_shift;
+    op_data->diff_min = -1.0 * tflite::CalculateInputRadius(
+                                   tail_ops::kScaledDiffIntegerBits,
+                                   op_data->input_left_shift);
+  } else {
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteFloat32);
+    TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteFloat32);
+    op_data->beta = static_cast<double>(params->beta);
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace
+
+void* Init(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  void* data = nullptr;
+  if (context->AllocatePersistentBuffer(context, sizeof(OpData), &data) ==
+      kTfLiteError) {
+    return nullptr;
+  }
+  return data;
+}
+
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 1);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
+
+  OpData* data = static_cast<OpData*>(node->user_data);
+  const auto params =
+      static_cast<const TfLiteSoftmaxParams*>(node->builtin_data);
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+  TF_LITE_ENSURE(context, NumDimensions(input) >= 1);
+
+  TF_LITE_ENSURE_STATUS(
+      CalculateSoftmaxParams(context, input, output, params, &data->params));
+  data->exp_table = nullptr;
+  if (input->type == kTfLiteFloat32) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, tail_ops::kSoftmaxTableSize * sizeof(int32_t),
+      reinterpret_cast<void**>(&data->exp_table)));
+  tail_ops::BuildSoftmaxExpTable(data->params, data->exp_table);
+  return kTfLiteOk;
+}
+
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const OpData& data = *(static_cast<const OpData*>(node->user_data));
+
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+
+  switch (input->type) {
+    case kTfLiteFloat32:
+      tflite::reference_ops::Softmax(
+          data.params, GetTensorShape(input), GetTensorData<float>(input),
+          GetTensorShape(output), GetTensorData<float>(output));
+      return kTfLiteOk;
+    case kTfLiteUInt8:
+      tail_ops::Softmax(data.exp_table, GetTensorShape(input),
+                        GetTensorData<uint8_t>(input), GetTensorShape(output),
+                        GetTensorData<uint8_t>(output));
+      return kTfLiteOk;
+    case kTfLiteInt8:
+      if (output->type == kTfLiteInt16) {
+        tail_ops::Softmax(data.exp_table, GetTensorShape(input),
+                          GetTensorData<int8_t>(input), GetTensorShape(output),
+                          GetTensorData<int16_t>(output));
+      } else {
+        tail_ops::Softmax(data.exp_table, GetTensorShape(input),
+                          GetTensorData<int8_t>(input), GetTensorShape(output),
+                          GetTensorData<int8_t>(output));
+      }
+      return kTfLiteOk;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input->type), input->type);
+      return kTfLiteError;
+  }
+}
+
+}  // namespace softmax_lut
+
+TfLiteRegistration* Register_SOFTMAX_LUT() {
+  static TfLiteRegistration r = {/*init=*/softmax_lut::Init,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/softmax_lut::Prepare,
+                                 /*invoke=*/softmax_lut::Eval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
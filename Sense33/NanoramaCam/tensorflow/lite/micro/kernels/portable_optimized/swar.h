@@ -0,0 +1,179 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+SIMD within a register: the Cortex-M4 DSP instructions used by the packed
+8-bit kernels of swar_kernels.h, with a portable C emulation for the targets
+without them, so the same kernels build and run on the host. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_H_
+
+#include <cstdint>
+#include <cstring>
+
+// 1 to run the packed kernels of swar_kernels.h in the CONV_2D, the
+// DEPTHWISE_CONV_2D and the FULLY_CONNECTED ops. On by default on the cores
+// with the DSP extension (Cortex-M4/M7/M33), the host build can force it to
+// run the emulation.
+#ifndef TF_LITE_MICRO_SWAR
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define TF_LITE_MICRO_SWAR 1
+#else
+#define TF_LITE_MICRO_SWAR 0
+#endif
+#endif
+
+// The instructions are used through inline assembly: the SIMD32 intrinsics of
+// arm_acle.h are missing in the older toolchains of the Arduino cores.
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP && defined(__GNUC__)
+#define TF_LITE_MICRO_SWAR_ASM 1
+#else
+#define TF_LITE_MICRO_SWAR_ASM 0
+#endif
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace swar {
+
+// Four packed 8-bit values, byte 0 first (little-endian). The load can be
+// unaligned, the Cortex-M4 LDR supports it.
+inline uint32_t Load4(const void* p) {
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+// Pack the low halfwords of a and b: a.lo | b.lo << 16 (PKHBT).
+inline uint32_t PackLow(uint32_t a, uint32_t b) {
+  return (a & 0xFFFFu) | (b << 16);
+}
+
+// Pack the high halfwords of a and b: a.hi | b.hi << 16 (PKHTB).
+inline uint32_t PackHigh(uint32_t a, uint32_t b) {
+  return (a >> 16) | (b & 0xFFFF0000u);
+}
+
+// The same 16-bit value in both halfwords.
+inline uint32_t Broadcast16(int32_t value) {
+  return (static_cast<uint32_t>(value) & 0xFFFFu) * 0x10001u;
+}
+
+#if TF_LITE_MICRO_SWAR_ASM
+
+// Bytes 0 and 2 of b, zero extended and added to the halfwords of a.
+inline uint32_t Uxtab16(uint32_t a, uint32_t b) {
+  uint32_t result;
+  __asm__("uxtab16 %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+}
+
+// Bytes 1 and 3 of b, zero extended and added to the halfwords of a.
+inline uint32_t Uxtab16Ror8(uint32_t a, uint32_t b) {
+  uint32_t result;
+  __asm__("uxtab16 %0, %1, %2, ror #8" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+}
+
+// Bytes 0 and 2 of b, sign extended and added to the halfwords of a.
+inline uint32_t Sxtab16(uint32_t a, uint32_t b) {
+  uint32_t result;
+  __asm__("sxtab16 %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+}
+
+// Bytes 1 and 3 of b, sign extended and added to the halfwords of a.
+inline uint32_t Sxtab16Ror8(uint32_t a, uint32_t b) {
+  uint32_t result;
+  __asm__("sxtab16 %0, %1, %2, ror #8" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+}
+
+// Dual 16-bit signed multiply-accumulate: acc + a.lo * b.lo + a.hi * b.hi.
+inline int32_t Smlad(uint32_t a, uint32_t b, int32_t acc) {
+  int32_t result;
+  __asm__("smlad %0, %1, %2, %3" : "=r"(result) : "r"(a), "r"(b), "r"(acc));
+  return result;
+}
+
+#else
+
+inline uint32_t Uxtab16(uint32_t a, uint32_t b) {
+  const uint32_t low = (a + (b & 0xFFu)) & 0xFFFFu;
+  const uint32_t high = ((a >> 16) + ((b >> 16) & 0xFFu)) & 0xFFFFu;
+  return low | (high << 16);
+}
+
+inline uint32_t Uxtab16Ror8(uint32_t a, uint32_t b) {
+  return Uxtab16(a, (b >> 8) | (b << 24));
+}
+
+inline uint32_t Sxtab16(uint32_t a, uint32_t b) {
+  const uint32_t low =
+      (a + static_cast<uint32_t>(static_cast<int8_t>(b & 0xFFu))) & 0xFFFFu;
+  const uint32_t high =
+      ((a >> 16) +
+       static_cast<uint32_t>(static_cast<int8_t>((b >> 16) & 0xFFu))) &
+      0xFFFFu;
+  return low | (high << 16);
+}
+
+inline uint32_t Sxtab16Ror8(uint32_t a, uint32_t b) {
+  return Sxtab16(a, (b >> 8) | (b << 24));
+}
+
+inline int32_t Smlad(uint32_t a, uint32_t b, int32_t acc) {
+  const int32_t low = static_cast<int16_t>(a & 0xFFFFu) *
+                      static_cast<int16_t>(b & 0xFFFFu);
+  const int32_t high = static_cast<int16_t>(a >> 16) *
+                       static_cast<int16_t>(b >> 16);
+  // Wraps like the instruction
+  return static_cast<int32_t>(static_cast<uint32_t>(acc) +
+                              static_cast<uint32_t>(low) +
+                              static_cast<uint32_t>(high));
+}
+
+#endif  // TF_LITE_MICRO_SWAR_ASM
+
+// Extension of the packed bytes of a tensor type to two words of 16-bit
+// values, plus an offset (Broadcast16) added to every value. Even() holds the
+// bytes 0 and 2, Odd() the bytes 1 and 3.
+template <typename T>
+struct Extend;
+
+template <>
+struct Extend<uint8_t> {
+  static inline uint32_t Even(uint32_t offset, uint32_t word) {
+    return Uxtab16(offset, word);
+  }
+  static inline uint32_t Odd(uint32_t offset, uint32_t word) {
+    return Uxtab16Ror8(offset, word);
+  }
+};
+
+template <>
+struct Extend<int8_t> {
+  static inline uint32_t Even(uint32_t offset, uint32_t word) {
+    return Sxtab16(offset, word);
+  }
+  static inline uint32_t Odd(uint32_t offset, uint32_t word) {
+    return Sxtab16Ror8(offset, word);
+  }
+};
+
+}  // namespace swar
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_H_
@@ -0,0 +1,247 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Packed 8-bit kernels of the convolution, depthwise convolution and fully
+connected ops: four values per 32-bit load, extended to 16-bit pairs and
+accumulated with dual 16-bit multiply-accumulates (SMLAD). Bit-exact with the
+reference kernels. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_KERNELS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_KERNELS_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "tensorflow/lite/micro/kernels/portable_optimized/swar.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace swar {
+
+// Raw products of kRows rows by kCols rows of depth values, added to acc.
+// This is the inner loop of the GEMM tile of conv_gemm.cpp: the values of a
+// row are extended once per 4 depth values and used by the kCols columns.
+template <typename T, int kRows, int kCols>
+inline void MacTile(const T* const a[kRows], const T* const b[kCols],
+                    int depth, int32_t acc[kRows][kCols]) {
+  int k = 0;
+  for (; k <= depth - 4; k += 4) {
+    uint32_t a_even[kRows];
+    uint32_t a_odd[kRows];
+    for (int r = 0; r < kRows; ++r) {
+      const uint32_t word = Load4(a[r] + k);
+      a_even[r] = Extend<T>::Even(0, word);
+      a_odd[r] = Extend<T>::Odd(0, word);
+    }
+    for (int c = 0; c < kCols; ++c) {
+      const uint32_t word = Load4(b[c] + k);
+      const uint32_t b_even = Extend<T>::Even(0, word);
+      const uint32_t b_odd = Extend<T>::Odd(0, word);
+      for (int r = 0; r < kRows; ++r) {
+        acc[r][c] = Smlad(a_even[r], b_even, acc[r][c]);
+        acc[r][c] = Smlad(a_odd[r], b_odd, acc[r][c]);
+      }
+    }
+  }
+  for (; k < depth; ++k) {
+    for (int c = 0; c < kCols; ++c) {
+      for (int r = 0; r < kRows; ++r) {
+        acc[r][c] += static_cast<int32_t>(a[r][k]) * b[c][k];
+      }
+    }
+  }
+}
+
+// sum((a + a_offset) * (b + b_offset)) of n values. The offset values must
+// fit 16 bits, as they do for the zero points of the 8-bit tensors.
+template <typename T>
+inline int32_t DotProduct(const T* a, int32_t a_offset, const T* b,
+                          int32_t b_offset, int n) {
+  const uint32_t a_offsets = Broadcast16(a_offset);
+  const uint32_t b_offsets = Broadcast16(b_offset);
+  int32_t acc = 0;
+  int k = 0;
+  for (; k <= n - 4; k += 4) {
+    const uint32_t a_word = Load4(a + k);
+    const uint32_t b_word = Load4(b + k);
+    acc = Smlad(Extend<T>::Even(a_offsets, a_word),
+                Extend<T>::Even(b_offsets, b_word), acc);
+    acc = Smlad(Extend<T>::Odd(a_offsets, a_word),
+                Extend<T>::Odd(b_offsets, b_word), acc);
+  }
+  for (; k < n; ++k) {
+    acc += (a[k] + a_offset) * (b[k] + b_offset);
+  }
+  return acc;
+}
+
+// Fully connected layer, same results of reference_ops::FullyConnected
+// (uint8) and reference_integer_ops::FullyConnected (int8).
+template <typename T>
+inline void FullyConnected(const FullyConnectedParams& params,
+                           const RuntimeShape& input_shape,
+                           const T* input_data,
+                           const RuntimeShape& filter_shape,
+                           const T* filter_data, const int32* bias_data,
+                           const RuntimeShape& output_shape, T* output_data) {
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+  for (int b = 0; b < batches; ++b) {
+    const T* input = input_data + b * accum_depth;
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int32 acc = DotProduct<T>(input, params.input_offset,
+                                filter_data + out_c * accum_depth,
+                                params.weights_offset, accum_depth);
+      if (bias_data) {
+        acc += bias_data[out_c];
+      }
+      acc = MultiplyByQuantizedMultiplier(acc, params.output_multiplier,
+                                          params.output_shift);
+      acc += params.output_offset;
+      acc = std::max(acc, params.quantized_activation_min);
+      acc = std::min(acc, params.quantized_activation_max);
+      output_data[out_c + output_depth * b] = static_cast<T>(acc);
+    }
+  }
+}
+
+// Max filter taps of the packed depthwise kernel (5x5).
+constexpr int kMaxDepthwiseTaps = 25;
+
+// True if the depthwise layer can run the packed kernel: depth multiplier 1,
+// channels in groups of 4 and at most kMaxDepthwiseTaps filter taps.
+inline bool CanRunDepthwise(const DepthwiseParams& params,
+                            const RuntimeShape& input_shape,
+                            const RuntimeShape& filter_shape) {
+  return params.depth_multiplier == 1 && input_shape.Dims(3) % 4 == 0 &&
+         filter_shape.Dims(1) * filter_shape.Dims(2) <= kMaxDepthwiseTaps;
+}
+
+// Depthwise convolution of 4 channels at a time. The input pixel of a tap
+// is one word per 4 channels; the channels are paired with the next tap to
+// feed SMLAD, so a pair of taps costs 4 SMLAD for 8 MACs. The points outside
+// the image count as 0 like in the reference kernels. output_multiplier and
+// output_shift are per channel when quant_step is 1, a single value when it
+// is 0; a positive shift means left.
+template <typename T>
+inline void DepthwiseConv(const DepthwiseParams& params,
+                          const int32* output_multiplier,
+                          const int32* output_shift, int quant_step,
+                          const RuntimeShape& input_shape, const T* input_data,
+                          const RuntimeShape& filter_shape,
+                          const T* filter_data, const int32* bias_data,
+                          const RuntimeShape& output_shape, T* output_data) {
+  TFLITE_DCHECK(CanRunDepthwise(params, input_shape, filter_shape));
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int taps = filter_height * filter_width;
+  const uint32_t input_offsets = Broadcast16(params.input_offset);
+
+  // Offsets of the taps from the window origin
+  int tap_y[kMaxDepthwiseTaps];
+  int tap_x[kMaxDepthwiseTaps];
+  for (int t = 0; t < taps; ++t) {
+    tap_y[t] = (t / filter_width) * params.dilation_height_factor;
+    tap_x[t] = (t % filter_width) * params.dilation_width_factor;
+  }
+  const int pairs = (taps + 1) / 2;
+
+  for (int b = 0; b < batches; ++b) {
+    for (int c = 0; c < depth; c += 4) {
+      // Filter pairs of the 4 channels: tap 2p in the low halfword, tap
+      // 2p + 1 (0 past the last tap) in the high one
+      uint32_t filter[4][(kMaxDepthwiseTaps + 1) / 2];
+      int32_t bias[4];
+      int32_t multiplier[4];
+      int32_t shift[4];
+      for (int j = 0; j < 4; ++j) {
+        for (int p = 0; p < pairs; ++p) {
+          const int32_t low =
+              filter_data[2 * p * depth + c + j] + params.weights_offset;
+          const int32_t high =
+              2 * p + 1 < taps
+                  ? filter_data[(2 * p + 1) * depth + c + j] +
+                        params.weights_offset
+                  : 0;
+          filter[j][p] = PackLow(static_cast<uint32_t>(low),
+                                 static_cast<uint32_t>(high));
+        }
+        bias[j] = bias_data != nullptr ? bias_data[c + j] : 0;
+        multiplier[j] = output_multiplier[(c + j) * quant_step];
+        shift[j] = output_shift[(c + j) * quant_step];
+      }
+
+      for (int out_y = 0; out_y < output_height; ++out_y) {
+        const int in_y_origin =
+            out_y * params.stride_height - params.padding_values.height;
+        for (int out_x = 0; out_x < output_width; ++out_x) {
+          const int in_x_origin =
+              out_x * params.stride_width - params.padding_values.width;
+          int32_t acc[4] = {bias[0], bias[1], bias[2], bias[3]};
+          for (int p = 0; p < pairs; ++p) {
+            // Channels c, c + 2 in even and c + 1, c + 3 in odd
+            uint32_t even[2] = {0, 0};
+            uint32_t odd[2] = {0, 0};
+            for (int i = 0; i < 2; ++i) {
+              const int t = 2 * p + i;
+              if (t >= taps) {
+                break;
+              }
+              const int in_y = in_y_origin + tap_y[t];
+              const int in_x = in_x_origin + tap_x[t];
+              if (in_y >= 0 && in_y < input_height && in_x >= 0 &&
+                  in_x < input_width) {
+                const uint32_t word = Load4(
+                    input_data + Offset(input_shape, b, in_y, in_x, c));
+                even[i] = Extend<T>::Even(input_offsets, word);
+                odd[i] = Extend<T>::Odd(input_offsets, word);
+              }
+            }
+            acc[0] = Smlad(PackLow(even[0], even[1]), filter[0][p], acc[0]);
+            acc[1] = Smlad(PackLow(odd[0], odd[1]), filter[1][p], acc[1]);
+            acc[2] = Smlad(PackHigh(even[0], even[1]), filter[2][p], acc[2]);
+            acc[3] = Smlad(PackHigh(odd[0], odd[1]), filter[3][p], acc[3]);
+          }
+          T* out = output_data + Offset(output_shape, b, out_y, out_x, c);
+          for (int j = 0; j < 4; ++j) {
+            int32_t value =
+                MultiplyByQuantizedMultiplier(acc[j], multiplier[j], shift[j]);
+            value += params.output_offset;
+            value = std::max(value, params.quantized_activation_min);
+            value = std::min(value, params.quantized_activation_max);
+            out[j] = static_cast<T>(value);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace swar
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_SWAR_KERNELS_H_
@@ -0,0 +1,201 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Quantized SOFTMAX and AVERAGE_POOL_2D of the model tail without per element
+exponentials or divisions, bit-exact with the reference kernels. The
+softmax reads the fixed-point exponentials of the 256 differences from the
+row max in a table built at Prepare() from the input scale. The average
+pool multiplies the window sums by the reciprocal of the window size,
+computed once per output position. Checked by host/tail_ops_check. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_TAIL_OPS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_TAIL_OPS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace tail_ops {
+
+// Entries of the exponential table, one per difference of an 8-bit value
+// from the max of its row
+constexpr int kSoftmaxTableSize = 256;
+
+// Same fixed-point formats of reference_ops::Softmax
+constexpr int kScaledDiffIntegerBits = 5;
+constexpr int kAccumulationIntegerBits = 12;
+
+// Raw FixedPoint<int32, 0> exponential of the differences 0, -1 ... -255,
+// the values reference_ops::Softmax computes for the quantized input with
+// the same params. The differences under diff_min are 0, their outputs are
+// the type min both ways.
+inline void BuildSoftmaxExpTable(const SoftmaxParams& params, int32_t* table) {
+  using FixedPointScaledDiff =
+      gemmlowp::FixedPoint<int32, kScaledDiffIntegerBits>;
+  for (int i = 0; i < kSoftmaxTableSize; ++i) {
+    const int32 input_diff = -i;
+    if (input_diff < params.diff_min) {
+      table[i] = 0;
+      continue;
+    }
+    const int32 input_diff_rescaled =
+        MultiplyByQuantizedMultiplierGreaterThanOne(
+            input_diff, params.input_multiplier, params.input_left_shift);
+    table[i] = exp_on_negative_values(
+                   FixedPointScaledDiff::FromRaw(input_diff_rescaled))
+                   .raw();
+  }
+}
+
+// Quantized softmax on the table of BuildSoftmaxExpTable(), same results of
+// reference_ops::Softmax for uint8, int8 and int8 to int16.
+template <typename InputT, typename OutputT>
+inline void Softmax(const int32_t* exp_table, const RuntimeShape& input_shape,
+                    const InputT* input_data, const RuntimeShape& output_shape,
+                    OutputT* output_data) {
+  using FixedPointAccum = gemmlowp::FixedPoint<int32, kAccumulationIntegerBits>;
+  using FixedPoint0 = gemmlowp::FixedPoint<int32, 0>;
+
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+
+  for (int i = 0; i < outer_size; ++i) {
+    const InputT* input = input_data + i * depth;
+    OutputT* output = output_data + i * depth;
+    InputT max_in_row = std::numeric_limits<InputT>::min();
+    for (int c = 0; c < depth; ++c) {
+      max_in_row = std::max(max_in_row, input[c]);
+    }
+    const int32 max = max_in_row;
+
+    FixedPointAccum sum_of_exps = FixedPointAccum::Zero();
+    for (int c = 0; c < depth; ++c) {
+      sum_of_exps = sum_of_exps + gemmlowp::Rescale<kAccumulationIntegerBits>(
+                                      FixedPoint0::FromRaw(
+                                          exp_table[max - input[c]]));
+    }
+
+    int num_bits_over_unit;
+    const FixedPoint0 shifted_scale = FixedPoint0::FromRaw(GetReciprocal(
+        sum_of_exps.raw(), kAccumulationIntegerBits, &num_bits_over_unit));
+    const int exponent = num_bits_over_unit + 31 - (sizeof(OutputT) * 8);
+
+    for (int c = 0; c < depth; ++c) {
+      const FixedPoint0 exp_in_0 =
+          FixedPoint0::FromRaw(exp_table[max - input[c]]);
+      const int32 unsat_output = gemmlowp::RoundingDivideByPOT(
+          (shifted_scale * exp_in_0).raw(), exponent);
+      const int32 shifted_output =
+          unsat_output +
+          static_cast<int32>(std::numeric_limits<OutputT>::min());
+      output[c] = static_cast<OutputT>(std::max(
+          std::min(shifted_output,
+                   static_cast<int32>(std::numeric_limits<OutputT>::max())),
+          static_cast<int32>(std::numeric_limits<OutputT>::min())));
+    }
+  }
+}
+
+// Bits of the reciprocals of the window sizes
+constexpr int kReciprocalBits = 31;
+// Largest window of the reciprocal average pool: the quotient of n by the
+// window size d is exact for n * d < 2^kReciprocalBits, the rounded 8-bit
+// sums are under 256 * d.
+constexpr int kMaxReciprocalWindow = 2896;
+
+// ceil(2^kReciprocalBits / d)
+inline uint32_t WindowReciprocal(int d) {
+  return static_cast<uint32_t>(((1u << kReciprocalBits) + d - 1) / d);
+}
+
+// n / d truncated, n < 2^kReciprocalBits / d
+inline int32 DivideByWindow(uint32_t n, uint32_t reciprocal) {
+  return static_cast<int32>((static_cast<uint64_t>(n) * reciprocal) >>
+                            kReciprocalBits);
+}
+
+// Average pooling, same results of reference_ops::AveragePool (uint8) and
+// reference_integer_ops::AveragePool (int8) for windows up to
+// kMaxReciprocalWindow values.
+template <typename T>
+inline void AveragePool(const PoolParams& params,
+                        const RuntimeShape& input_shape, const T* input_data,
+                        const RuntimeShape& output_shape, T* output_data) {
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  for (int b = 0; b < batches; ++b) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params.stride_height - params.padding_values.height;
+      const int filter_y_start = std::max(0, -in_y_origin);
+      const int filter_y_end =
+          std::min(params.filter_height, input_height - in_y_origin);
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params.stride_width - params.padding_values.width;
+        const int filter_x_start = std::max(0, -in_x_origin);
+        const int filter_x_end =
+            std::min(params.filter_width, input_width - in_x_origin);
+        const int filter_count = (filter_y_end - filter_y_start) *
+                                 (filter_x_end - filter_x_start);
+        if (filter_count <= 0) {
+          // Same division by zero of the reference kernels
+          continue;
+        }
+        const uint32_t reciprocal = WindowReciprocal(filter_count);
+        const int32 half = filter_count / 2;
+        T* out = output_data + Offset(output_shape, b, out_y, out_x, 0);
+        for (int channel = 0; channel < depth; ++channel) {
+          int32 acc = 0;
+          for (int fy = filter_y_start; fy < filter_y_end; ++fy) {
+            const T* in = input_data + Offset(input_shape, b, in_y_origin + fy,
+                                              in_x_origin + filter_x_start,
+                                              channel);
+            for (int fx = filter_x_start; fx < filter_x_end; ++fx) {
+              acc += *in;
+              in += depth;
+            }
+          }
+          // Rounded to nearest, half away from zero as the int8 reference,
+          // half up for the uint8 positive sums
+          acc = acc > 0 ? DivideByWindow(acc + half, reciprocal)
+                        : -DivideByWindow(half - acc, reciprocal);
+          acc = std::max(acc, params.quantized_activation_min);
+          acc = std::min(acc, params.quantized_activation_max);
+          out[channel] = static_cast<T>(acc);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace tail_ops
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PORTABLE_OPTIMIZED_TAIL_OPS_H_
@@ -0,0 +1,422 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+CONV_2D of the SIMD kernel set (kernels/internal/optimized/simd_ops.h): the
+im2col + GEMM scheme of portable_optimized/conv_gemm.cpp with SIMD dot
+product tiles, bit-exact with the reference kernels. E.M.
+
+==============================================================================*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/simd_ops.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/conv.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace conv_simd {
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kFilterTensor = 1;
+constexpr int kBiasTensor = 2;
+constexpr int kOutputTensor = 0;
+
+// Conv is quantized along dimension 0:
+// https://www.tensorflow.org/lite/performance/quantization_spec
+constexpr int kConvQuantizedDimension = 0;
+
+// Target size of the im2col scratch buffer, a block of output pixels at a
+// time, at least kGemmRows pixels.
+constexpr int kIm2colBytes = 4 * 1024;
+
+// Tile of the GEMM: output pixels x output channels.
+constexpr int kGemmRows = 2;
+constexpr int kGemmCols = 4;
+
+struct OpData {
+  TfLitePaddingValues padding;
+
+  // Per channel output multiplier and shift, positive shift means left. The
+  // uint8 models broadcast the per tensor values of the reference kernel.
+  int32_t* output_multiplier;
+  int32_t* output_shift;
+
+  int32_t input_offset;
+  int32_t filter_offset;
+  int32_t output_offset;
+
+  // The range of the fused activation layer. For example for kNone and
+  // uint8_t these would be 0 and 255.
+  int32_t output_activation_min;
+  int32_t output_activation_max;
+
+  // Scratch buffer of the packed patches, -1 on the 1x1 fast path.
+  int im2col_index;
+  int im2col_rows;
+};
+
+struct GemmParams {
+  const OpData* data;
+  const int32_t* bias;
+  int depth;
+  int output_depth;
+};
+
+// kRows rows (patches of depth values, row_stride apart) by kCols filter
+// rows, requantized.
+template <typename T, int kRows, int kCols>
+inline void GemmTile(const GemmParams& params, const T* rows, int row_stride,
+                     const T* filter, int channel, T* output) {
+  const OpData& data = *params.data;
+  const T* a[kRows];
+  const T* b[kCols];
+  for (int r = 0; r < kRows; ++r) {
+    a[r] = rows + r * row_stride;
+  }
+  for (int c = 0; c < kCols; ++c) {
+    b[c] = filter + (channel + c) * params.depth;
+  }
+  int32_t acc[kRows][kCols];
+  simd_ops::DotTile<T, kRows, kCols>(a, data.input_offset, b,
+                                     data.filter_offset, params.depth, acc);
+  for (int r = 0; r < kRows; ++r) {
+    for (int c = 0; c < kCols; ++c) {
+      const int oc = channel + c;
+      const int32_t bias = params.bias != nullptr ? params.bias[oc] : 0;
+      output[r * params.output_depth + oc] =
+          static_cast<T>(simd_ops::Requantize(
+              acc[r][c] + bias, data.output_multiplier[oc],
+              data.output_shift[oc], data.output_offset,
+              data.output_activation_min, data.output_activation_max));
+    }
+  }
+}
+
+template <typename T, int kRows>
+inline void GemmRows(const GemmParams& params, const T* rows, int row_stride,
+                     const T* filter, T* output) {
+  int channel = 0;
+  for (; channel <= params.output_depth - kGemmCols; channel += kGemmCols) {
+    GemmTile<T, kRows, kGemmCols>(params, rows, row_stride, filter, channel,
+                                  output);
+  }
+  for (; channel < params.output_depth; ++channel) {
+    GemmTile<T, kRows, 1>(params, rows, row_stride, filter, channel, output);
+  }
+}
+
+template <typename T>
+void Gemm(const GemmParams& params, const T* rows, int row_stride,
+          int num_rows, const T* filter, T* output) {
+  int row = 0;
+  for (; row <= num_rows - kGemmRows; row += kGemmRows) {
+    GemmRows<T, kGemmRows>(params, rows + row * row_stride, row_stride, filter,
+                           output + row * params.output_depth);
+  }
+  for (; row < num_rows; ++row) {
+    GemmRows<T, 1>(params, rows + row * row_stride, row_stride, filter,
+                   output + row * params.output_depth);
+  }
+}
+
+// Patch of the output pixel in the HWC order of the filter. The points
+// outside the image take the input zero point, 0 once the offset is added.
+template <typename T>
+inline void PackPatch(const TfLiteConvParams& conv_params, const OpData& data,
+                      const RuntimeShape& input_shape, const T* input_data,
+                      int filter_height, int filter_width, int batch,
+                      int out_y, int out_x, T* im2col) {
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const T zero_point = static_cast<T>(-data.input_offset);
+  const int in_x_origin = out_x * conv_params.stride_width - data.padding.width;
+  const int in_y_origin =
+      out_y * conv_params.stride_height - data.padding.height;
+  for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+    const int in_y = in_y_origin + conv_params.dilation_height_factor * filter_y;
+    for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+      const int in_x =
+          in_x_origin + conv_params.dilation_width_factor * filter_x;
+      if (in_x >= 0 && in_x < input_width && in_y >= 0 && in_y < input_height) {
+        memcpy(im2col,
+               input_data + Offset(input_shape, batch, in_y, in_x, 0),
+               input_depth * sizeof(T));
+      } else {
+        memset(im2col, zero_point, input_depth * sizeof(T));
+      }
+      im2col += input_depth;
+    }
+  }
+}
+
+template <typename T>
+void EvalSimd(TfLiteContext* context, const TfLiteConvParams& conv_params,
+              const OpData& data, const TfLiteTensor* input,
+              const TfLiteTensor* filter, const TfLiteTensor* bias,
+              TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const T* input_data = GetTensorData<T>(input);
+  const T* filter_data = GetTensorData<T>(filter);
+  T* output_data = GetTensorData<T>(output);
+
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+
+  GemmParams params;
+  params.data = &data;
+  params.bias = bias != nullptr ? GetTensorData<int32_t>(bias) : nullptr;
+  params.depth = filter_height * filter_width * input_depth;
+  params.output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+
+  if (data.im2col_index < 0) {
+    // 1x1 fast path, the patches are the input pixels
+    for (int batch = 0; batch < batches; ++batch) {
+      for (int out_y = 0; out_y < output_height; ++out_y) {
+        const T* rows = input_data + Offset(input_shape, batch,
+                                            out_y * conv_params.stride_height,
+                                            0, 0);
+        T* out = output_data + Offset(output_shape, batch, out_y, 0, 0);
+        if (conv_params.stride_width == 1 && conv_params.stride_height == 1 &&
+            input_width == output_width) {
+          Gemm<T>(params, rows, input_depth, output_height * output_width,
+                  filter_data, out);
+          break;
+        }
+        Gemm<T>(params, rows, input_depth * conv_params.stride_width,
+                output_width, filter_data, out);
+      }
+    }
+    return;
+  }
+
+  T* im2col = static_cast<T*>(context->GetScratchBuffer(context,
+                                                       data.im2col_index));
+  const int num_pixels = output_height * output_width;
+  for (int batch = 0; batch < batches; ++batch) {
+    T* out = output_data + Offset(output_shape, batch, 0, 0, 0);
+    for (int pixel = 0; pixel < num_pixels; pixel += data.im2col_rows) {
+      const int rows = std::min(data.im2col_rows, num_pixels - pixel);
+      for (int r = 0; r < rows; ++r) {
+        PackPatch<T>(conv_params, data, input_shape, input_data, filter_height,
+                     filter_width, batch, (pixel + r) / output_width,
+                     (pixel + r) % output_width, im2col + r * params.depth);
+      }
+      Gemm<T>(params, im2col, params.depth, rows, filter_data,
+              out + pixel * params.output_depth);
+    }
+  }
+}
+
+void EvalFloat(TfLiteContext* context, const TfLiteConvParams& conv_params,
+               const OpData& data, const TfLiteTensor* input,
+               const TfLiteTensor* filter, const TfLiteTensor* bias,
+               TfLiteTensor* output) {
+  float output_activation_min, output_activation_max;
+  CalculateActivationRange(conv_params.activation, &output_activation_min,
+                           &output_activation_max);
+  ConvParams op_params;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = data.padding.width;
+  op_params.padding_values.height = data.padding.height;
+  op_params.stride_width = conv_params.stride_width;
+  op_params.stride_height = conv_params.stride_height;
+  op_params.dilation_width_factor = conv_params.dilation_width_factor;
+  op_params.dilation_height_factor = conv_params.dilation_height_factor;
+  op_params.float_activation_min = output_activation_min;
+  op_params.float_activation_max = output_activation_max;
+
+  reference_ops::Conv(op_params, GetTensorShape(input),
+                      GetTensorData<float>(input), GetTensorShape(filter),
+                      GetTensorData<float>(filter), GetTensorShape(bias),
+                      GetTensorData<float>(bias), GetTensorShape(output),
+                      GetTensorData<float>(output), RuntimeShape(), nullptr);
+}
+
+}  // namespace
+
+void* Init(TfLiteContext* context, const char* buffer, size_t length) {
+  TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
+  void* data = nullptr;
+  if (context->AllocatePersistentBuffer(context, sizeof(OpData), &data) ==
+      kTfLiteError) {
+    return nullptr;
+  }
+  return data;
+}
+
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TFLITE_DCHECK(node->user_data != nullptr);
+  TFLITE_DCHECK(node->builtin_data != nullptr);
+
+  OpData* data = static_cast<OpData*>(node->user_data);
+  const auto params = static_cast<const TfLiteConvParams*>(node->builtin_data);
+
+  bool has_bias = node->inputs->size == 3;
+  TF_LITE_ENSURE(context, has_bias || node->inputs->size == 2);
+  TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
+
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+
+  int input_width = input->dims->data[2];
+  int input_height = input->dims->data[1];
+  int filter_width = filter->dims->data[2];
+  int filter_height = filter->dims->data[1];
+  int output_width = output->dims->data[2];
+  int output_height = output->dims->data[1];
+
+  // Matching GetWindowedOutputSize in TensorFlow.
+  data->padding = ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width,
+      params->dilation_height_factor, params->dilation_width_factor,
+      input_height, input_width, filter_height, filter_width, params->padding,
+      &output_height, &output_width);
+  data->im2col_index = -1;
+  data->im2col_rows = 0;
+
+  if (input->type == kTfLiteFloat32) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE(context,
+                 input->type == kTfLiteUInt8 || input->type == kTfLiteInt8);
+
+  // All per-channel quantized tensors need valid zero point and scale arrays.
+  if (input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
+                      kTfLiteAffineQuantization);
+
+    const auto* affine_quantization =
+        static_cast<TfLiteAffineQuantization*>(filter->quantization.params);
+    TF_LITE_ENSURE(context, affine_quantization);
+    TF_LITE_ENSURE(context, affine_quantization->scale);
+    TF_LITE_ENSURE(context, affine_quantization->zero_point);
+
+    TF_LITE_ENSURE(context,
+                   affine_quantization->scale->size == 1 ||
+                       affine_quantization->scale->size ==
+                           filter->dims->data[kConvQuantizedDimension]);
+    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
+                      affine_quantization->zero_point->size);
+  }
+
+  // The persistent buffers are allocated before the scratch buffer request.
+  const int output_depth = filter->dims->data[kConvQuantizedDimension];
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, output_depth * sizeof(int32_t),
+      reinterpret_cast<void**>(&data->output_multiplier)));
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, output_depth * sizeof(int32_t),
+      reinterpret_cast<void**>(&data->output_shift)));
+
+  int32_t output_multiplier;
+  int output_shift;
+  TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+      context, input, filter, bias, output, params->activation,
+      &output_multiplier, &output_shift, &data->output_activation_min,
+      &data->output_activation_max, data->output_multiplier,
+      reinterpret_cast<int*>(data->output_shift), output_depth));
+
+  data->input_offset = -input->params.zero_point;
+  data->output_offset = output->params.zero_point;
+  if (input->type == kTfLiteUInt8) {
+    // Per tensor quantization of the reference uint8 kernel
+    data->filter_offset = -filter->params.zero_point;
+    for (int oc = 0; oc < output_depth; ++oc) {
+      data->output_multiplier[oc] = output_multiplier;
+      data->output_shift[oc] = -output_shift;
+    }
+  } else {
+    // The int8 filters are symmetric
+    data->filter_offset = 0;
+  }
+
+  // The 1x1 convolutions read the patches straight from the input
+  const bool is_pointwise = filter_width == 1 && filter_height == 1 &&
+                            data->padding.width == 0 &&
+                            data->padding.height == 0;
+  if (!is_pointwise) {
+    const int depth = filter_height * filter_width * input->dims->data[3];
+    const int num_pixels = output_width * output_height;
+    data->im2col_rows =
+        std::min(std::max(kIm2colBytes / depth, kGemmRows), num_pixels);
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, data->im2col_rows * depth, &data->im2col_index));
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+
+  TFLITE_DCHECK(node->user_data != nullptr);
+  const OpData& data = *(static_cast<const OpData*>(node->user_data));
+
+  switch (input->type) {  // Already know in/out types are same.
+    case kTfLiteFloat32:
+      EvalFloat(context, *params, data, input, filter, bias, output);
+      break;
+    case kTfLiteInt8:
+      EvalSimd<int8_t>(context, *params, data, input, filter, bias, output);
+      break;
+    case kTfLiteUInt8:
+      EvalSimd<uint8_t>(context, *params, data, input, filter, bias, output);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s (%d) not supported.",
+                         TfLiteTypeGetName(input->type), input->type);
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace conv_simd
+
+TfLiteRegistration* Register_CONV_2D_SIMD() {
+  static TfLiteRegistration r = {/*init=*/conv_simd::Init,
+                                 /*free=*/nullptr,
+                                 /*prepare=*/conv_simd::Prepare,
+                                 /*invoke=*/conv_simd::Eval,
+                                 /*profiling_string=*/nullptr,
+                                 /*builtin_code=*/0,
+                                 /*custom_name=*/nullptr,
+                                 /*version=*/0};
+  return &r;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
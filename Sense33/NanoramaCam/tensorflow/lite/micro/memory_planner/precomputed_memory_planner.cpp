@@ -0,0 +1,78 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Memory planner replaying an arena layout computed offline. E.M.
+
+==============================================================================*/
+
+#include "tensorflow/lite/micro/memory_planner/precomputed_memory_planner.h"
+
+namespace tflite {
+
+PrecomputedMemoryPlanner::PrecomputedMemoryPlanner(const PlannedBuffer* plan,
+                                                   int plan_size)
+    : plan_(plan),
+      plan_size_(plan_size),
+      buffer_count_(0),
+      max_memory_size_(0) {}
+
+PrecomputedMemoryPlanner::~PrecomputedMemoryPlanner() {
+  // We don't own the table, so nothing to free.
+}
+
+TfLiteStatus PrecomputedMemoryPlanner::AddBuffer(
+    tflite::ErrorReporter* error_reporter, int size, int first_time_used,
+    int last_time_used) {
+  if (buffer_count_ >= plan_size_) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Buffer %d is not in the memory plan (%d buffers)",
+                         buffer_count_, plan_size_);
+    return kTfLiteError;
+  }
+  const PlannedBuffer* planned = &plan_[buffer_count_];
+  if (planned->size != size || planned->first_time_used != first_time_used ||
+      planned->last_time_used != last_time_used) {
+    TF_LITE_REPORT_ERROR(
+        error_reporter,
+        "Buffer %d (%d bytes, %d-%d) doesn't match the memory plan "
+        "(%d bytes, %d-%d)",
+        buffer_count_, size, first_time_used, last_time_used, planned->size,
+        planned->first_time_used, planned->last_time_used);
+    return kTfLiteError;
+  }
+  const size_t end = static_cast<size_t>(planned->offset) + planned->size;
+  if (end > max_memory_size_) {
+    max_memory_size_ = end;
+  }
+  ++buffer_count_;
+  return kTfLiteOk;
+}
+
+size_t PrecomputedMemoryPlanner::GetMaximumMemorySize() {
+  return max_memory_size_;
+}
+
+int PrecomputedMemoryPlanner::GetBufferCount() { return buffer_count_; }
+
+TfLiteStatus PrecomputedMemoryPlanner::GetOffsetForBuffer(
+    tflite::ErrorReporter* error_reporter, int buffer_index, int* offset) {
+  if ((buffer_index < 0) || (buffer_index >= buffer_count_)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "buffer index %d is outside range 0 to %d",
+                         buffer_index, buffer_count_);
+    return kTfLiteError;
+  }
+  *offset = plan_[buffer_index].offset;
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
@@ -0,0 +1,73 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Memory planner replaying an arena layout computed offline. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_PRECOMPUTED_MEMORY_PLANNER_H_
+#define TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_PRECOMPUTED_MEMORY_PLANNER_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/memory_planner/memory_planner.h"
+
+namespace tflite {
+
+// A buffer of an offline plan, in the order of the AddBuffer() calls of the
+// MicroAllocator. The size and the lifetime identify the buffer: they depend
+// on the model and on the kernels (scratch buffers), a plan only fits the
+// interpreter it was computed for.
+struct PlannedBuffer {
+  int32_t size;
+  int32_t first_time_used;
+  int32_t last_time_used;
+  int32_t offset;
+};
+
+// A memory planner that doesn't plan: the offsets come from a table computed
+// on the host (see host/person_detect_plan.cpp), so the allocator skips the
+// greedy search and its scratch memory at startup.
+//
+// AddBuffer() fails when a buffer differs from the table; the MicroAllocator
+// then falls back to the GreedyMemoryPlanner. A prefix of the table is still a
+// valid layout, the table itself is trusted and not checked for overlaps.
+class PrecomputedMemoryPlanner : public MemoryPlanner {
+ public:
+  // The table must outlive the planner, usually it's a constant in flash.
+  PrecomputedMemoryPlanner(const PlannedBuffer* plan, int plan_size);
+  ~PrecomputedMemoryPlanner() override;
+
+  // Checks the buffer against the next entry of the table.
+  TfLiteStatus AddBuffer(ErrorReporter* error_reporter, int size,
+                         int first_time_used, int last_time_used) override;
+
+  // The arena needed by the buffers added so far.
+  size_t GetMaximumMemorySize() override;
+
+  int GetBufferCount() override;
+
+  TfLiteStatus GetOffsetForBuffer(ErrorReporter* error_reporter,
+                                  int buffer_index, int* offset) override;
+
+ private:
+  const PlannedBuffer* plan_;
+  int plan_size_;
+  int buffer_count_;
+  size_t max_memory_size_;
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MEMORY_PLANNER_PRECOMPUTED_MEMORY_PLANNER_H_
@@ -11,6 +11,12 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+The scratch buffer requests are kept at the head until the memory plan, so
+persistent buffers can be allocated between two requests. Added the optional
+external memory planner. The tensor lifetimes come from the node arrays, so the
+fused nodes of micro_fusion.h drop their intermediate tensors. E.M.
+
 ==============================================================================*/
 
 #include "tensorflow/lite/micro/micro_allocator.h"
@@ -101,6 +107,7 @@ class AllocationInfoBuilder {
 
   // Add allocaiton information for the tensors.
   TfLiteStatus AddTensors(const SubGraph* subgraph,
+                          const NodeAndRegistration* nodes,
                           TfLiteTensor* runtime_tensors);
   // Add allocation information for the scratch buffers.
   TfLiteStatus AddScratchBuffers(internal::ScratchBufferHandle* buffer_handles);
@@ -134,8 +141,9 @@ TfLiteStatus AllocationInfoBuilder::Allocate() {
   return kTfLiteOk;
 }
 
-TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
-                                               TfLiteTensor* runtime_tensors) {
+TfLiteStatus AllocationInfoBuilder::AddTensors(
+    const SubGraph* subgraph, const NodeAndRegistration* nodes,
+    TfLiteTensor* runtime_tensors) {
   // Set up allocation info for all tensors.
   for (size_t i = 0; i < tensor_count_; ++i) {
     AllocationInfo* current = &info_[i];
@@ -161,18 +169,23 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
     current->last_used = subgraph->operators()->size() - 1;
   }
 
-  // Figure out when the first and last use of each tensor is.
+  // Figure out when the first and last use of each tensor is. The node
+  // arrays are used instead of the operators of the model, the fused nodes
+  // (micro_fusion.h) drop their intermediate tensors and the optional ones.
   for (int i = (subgraph->operators()->size() - 1); i >= 0; --i) {
-    const auto* op = subgraph->operators()->Get(i);
-    for (size_t n = 0; n < op->inputs()->size(); ++n) {
-      const int tensor_index = op->inputs()->Get(n);
+    const TfLiteNode& node = nodes[i].node;
+    for (int n = 0; n < node.inputs->size; ++n) {
+      const int tensor_index = node.inputs->data[n];
+      if (tensor_index < 0) {
+        continue;
+      }
       AllocationInfo* current = &info_[tensor_index];
       if (((current->last_used == -1) || (current->last_used < i))) {
         current->last_used = i;
       }
     }
-    for (size_t n = 0; n < op->outputs()->size(); ++n) {
-      const int tensor_index = op->outputs()->Get(n);
+    for (int n = 0; n < node.outputs->size; ++n) {
+      const int tensor_index = node.outputs->data[n];
       AllocationInfo* current = &info_[tensor_index];
       if ((current->first_created == -1) || (current->first_created > i)) {
         current->first_created = i;
@@ -185,7 +198,9 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
     AllocationInfo* current = &info_[i];
     const bool is_read_only =
         (current->first_created == -1) && (current->last_used != -1);
-    if (is_read_only) {
+    const bool is_unused =
+        (current->first_created == -1) && (current->last_used == -1);
+    if (is_read_only || is_unused) {
       current->needs_allocating = false;
     }
     const bool has_partial_lifetime =
@@ -544,6 +559,7 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
     node->custom_initial_data = custom_data;
     node->custom_initial_data_size = custom_data_size;
   }
+  node_and_registrations_ = output;
   *node_and_registrations = output;
   return kTfLiteOk;
 }
@@ -553,6 +569,26 @@ TfLiteStatus MicroAllocator::FinishTensorAllocation() {
     return kTfLiteError;
   }
 
+  // Move the scratch buffer requests from the head to the tail, in reverse
+  // order, and give the head back to the memory plan.
+  if (scratch_buffer_count_ > 0) {
+    internal::ScratchBufferHandle* handles =
+        reinterpret_cast<internal::ScratchBufferHandle*>(
+            memory_allocator_->AllocateFromTail(
+                sizeof(internal::ScratchBufferHandle) * scratch_buffer_count_,
+                alignof(internal::ScratchBufferHandle)));
+    if (handles == nullptr) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Failed to allocate the scratch buffer handles");
+      return kTfLiteError;
+    }
+    for (size_t i = 0; i < scratch_buffer_count_; ++i) {
+      handles[scratch_buffer_count_ - i - 1] = scratch_buffer_handles_[i];
+    }
+    scratch_buffer_handles_ = handles;
+  }
+  memory_allocator_->ResetHead();
+
   // Create static memory plan
   // 1. Calculate AllocationInfo to know the lifetime of each tensor/buffer.
   // 2. Add them into the planner (such as the GreedyMemoryPlanner).
@@ -568,7 +604,8 @@ TfLiteStatus MicroAllocator::FinishTensorAllocation() {
     AllocationInfoBuilder builder(error_reporter_, &tmp_allocator);
     TF_LITE_ENSURE_STATUS(
         builder.Init(subgraph_->tensors()->size(), scratch_buffer_count_));
-    TF_LITE_ENSURE_STATUS(builder.AddTensors(subgraph_, context_->tensors));
+    TF_LITE_ENSURE_STATUS(builder.AddTensors(
+        subgraph_, node_and_registrations_, context_->tensors));
     TF_LITE_ENSURE_STATUS(builder.AddScratchBuffers(scratch_buffer_handles_));
     const AllocationInfo* allocation_info = builder.Finish();
 
@@ -577,29 +614,43 @@ TfLiteStatus MicroAllocator::FinishTensorAllocation() {
     uint8_t* planner_arena =
         tmp_allocator.AllocateFromHead(remaining_arena_size, /*alignment=*/1);
     TF_LITE_ENSURE(error_reporter_, planner_arena != nullptr);
-    GreedyMemoryPlanner planner(planner_arena, remaining_arena_size);
-    TF_LITE_ENSURE_STATUS(
-        CreatePlan(error_reporter_, &planner, allocation_info, builder.Size()));
+    GreedyMemoryPlanner greedy_planner(planner_arena, remaining_arena_size);
+    MemoryPlanner* planner = &greedy_planner;
+    if (memory_planner_ != nullptr) {
+      if (CreatePlan(error_reporter_, memory_planner_, allocation_info,
+                     builder.Size()) == kTfLiteOk) {
+        planner = memory_planner_;
+      } else {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Memory planner failed, using the greedy planner");
+      }
+    }
+    if (planner == &greedy_planner) {
+      TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter_, &greedy_planner,
+                                       allocation_info, builder.Size()));
+    }
 
     size_t actual_available_arena_size =
         memory_allocator_->GetAvailableMemory();
     // Make sure we have enough arena size.
-    if (planner.GetMaximumMemorySize() > actual_available_arena_size) {
+    if (planner->GetMaximumMemorySize() > actual_available_arena_size) {
       TF_LITE_REPORT_ERROR(
           error_reporter_,
           "Arena size is too small for activation buffers. Needed %d but only "
           "%d was available.",
-          planner.GetMaximumMemorySize(), actual_available_arena_size);
+          planner->GetMaximumMemorySize(), actual_available_arena_size);
       return kTfLiteError;
     }
 
+    planned_bytes_ = planner->GetMaximumMemorySize();
+
     // Commit the plan.
-    TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, &planner,
+    TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, planner,
                                      memory_allocator_->GetHead(),
                                      allocation_info, builder.Size()));
     // Allocate the planned area, so the allocator knows it's used.
     uint8_t* allocated_tensor_memory =
-        memory_allocator_->AllocateFromHead(planner.GetMaximumMemorySize(),
+        memory_allocator_->AllocateFromHead(planner->GetMaximumMemorySize(),
                                             /*alignment=*/1);
     TF_LITE_ENSURE(error_reporter_, allocated_tensor_memory != nullptr);
   }
@@ -634,21 +685,12 @@ TfLiteStatus MicroAllocator::AllocatePersistentBuffer(size_t bytes,
 TfLiteStatus MicroAllocator::RequestScratchBufferInArena(int node_id,
                                                          size_t bytes,
                                                          int* buffer_idx) {
-  // A sanity check to make sure scratch_buffer_handles_ is contiguous i.e.
-  // scratch_buffer_handles_ is pointing to the last allocation from memory
-  // allocator.
-  if (scratch_buffer_handles_ != nullptr &&
-      reinterpret_cast<uint8_t*>(scratch_buffer_handles_) !=
-          memory_allocator_->GetTail()) {
-    TF_LITE_REPORT_ERROR(error_reporter_,
-                         "Internal error: AllocateFromTail can not be called "
-                         "between two RequestScratchBufferInArena calls.");
-    return kTfLiteError;
-  }
-
+  // Until FinishTensorAllocation the requests are an array at the head, in
+  // request order. Nothing else is allocated from the head before the memory
+  // plan, so it grows in place while the persistent buffers take the tail.
   internal::ScratchBufferHandle* handle =
       reinterpret_cast<internal::ScratchBufferHandle*>(
-          memory_allocator_->AllocateFromTail(
+          memory_allocator_->AllocateFromHead(
               sizeof(internal::ScratchBufferHandle),
               alignof(internal::ScratchBufferHandle)));
   if (handle == nullptr) {
@@ -657,14 +699,20 @@ TfLiteStatus MicroAllocator::RequestScratchBufferInArena(int node_id,
                          node_id);
     return kTfLiteError;
   }
+  if (scratch_buffer_handles_ == nullptr) {
+    scratch_buffer_handles_ = handle;
+  }
+  if (handle != scratch_buffer_handles_ + scratch_buffer_count_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Internal error: AllocateFromHead can not be called "
+                         "between two RequestScratchBufferInArena calls.");
+    return kTfLiteError;
+  }
   *handle = {};
   handle->bytes = bytes;
   handle->node_idx = node_id;
   *buffer_idx = scratch_buffer_count_;
   scratch_buffer_count_ += 1;
-  // scratch_buffer_handles_ is in reverse order. The following code ensures
-  // that scratch_buffers[0] is pointing to the newly allocated handle.
-  scratch_buffer_handles_ = handle;
   return kTfLiteOk;
 }
 
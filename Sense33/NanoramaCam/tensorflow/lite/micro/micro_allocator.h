@@ -11,6 +11,9 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+Added the optional external memory planner and its planned size. E.M.
+
 ==============================================================================*/
 #ifndef TENSORFLOW_LITE_MICRO_MICRO_ALLOCATOR_H_
 #define TENSORFLOW_LITE_MICRO_MICRO_ALLOCATOR_H_
@@ -22,6 +25,7 @@ limitations under the License.
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
 #include "tensorflow/lite/core/api/op_resolver.h"
+#include "tensorflow/lite/micro/memory_planner/memory_planner.h"
 #include "tensorflow/lite/micro/simple_memory_allocator.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
@@ -86,6 +90,13 @@ class MicroAllocator {
                  uint8_t* tensor_arena, size_t arena_size,
                  ErrorReporter* error_reporter);
 
+  // Lays out the buffers with the given planner instead of a
+  // GreedyMemoryPlanner in FinishTensorAllocation, usually a
+  // PrecomputedMemoryPlanner with an offline plan. If the planner rejects a
+  // buffer the error is reported and the greedy planner is used. The planner
+  // must be empty and serves a single allocation.
+  void SetMemoryPlanner(MemoryPlanner* planner) { memory_planner_ = planner; }
+
   // Runs through the model and allocates all necessary input, output and
   // intermediate tensors.
   // WARNING: doing any allocation after calling this method has the risk of
@@ -97,6 +108,10 @@ class MicroAllocator {
   // `FinishTensorAllocation`. Otherwise, it will return 0.
   size_t used_bytes() const;
 
+  // Returns the GetMaximumMemorySize() of the memory planner, the size of the
+  // activation buffers, after `FinishTensorAllocation`.
+  size_t planned_bytes() const { return planned_bytes_; }
+
   // Run through the model to allocate nodes and registrations. We need to keep
   // them for the entire life time of the model to allow persistent tensors.
   // This method needs to be called before FinishTensorAllocation method.
@@ -113,8 +128,8 @@ class MicroAllocator {
   // This method only allocates a BufferHandle holding information for memory
   // planning. The buffer ptr is ready after `FinishTensorAllocation` and can
   // be retrieved by `GetScratchBuffer` method using the returned buffer_idx.
-  // Note that there should be no tail allocation between two consecutive
-  // `RequestScratchBufferInArena` calls.
+  // The requests are kept at the arena head until `FinishTensorAllocation`,
+  // persistent buffers can be allocated between two calls.
   TfLiteStatus RequestScratchBufferInArena(int node_id, size_t bytes,
                                            int* buffer_idx);
   // Returns the pointer to the planned scratch buffer.
@@ -131,13 +146,20 @@ class MicroAllocator {
   // Indicating if the allocator is ready for allocation.
   bool active_ = false;
 
-  // In reverse order for efficiency.
+  // In request order at the arena head until FinishTensorAllocation, then
+  // moved to the tail in reverse order for efficiency.
   // i.e. scratch_buffer_handles_[0] is the handle for the last buffer,
   // corresponding to the last RequestScratchBufferInArena call.
   internal::ScratchBufferHandle* scratch_buffer_handles_ = nullptr;
   // How many scratch buffers have been allocated.
   size_t scratch_buffer_count_ = 0;
 
+  // Planner of the activation buffers, the greedy one when null.
+  MemoryPlanner* memory_planner_ = nullptr;
+  size_t planned_bytes_ = 0;
+  // Nodes of AllocateNodeAndRegistrations, their arrays give the lifetimes
+  NodeAndRegistration* node_and_registrations_ = nullptr;
+
   const SubGraph* subgraph_;
 };
 
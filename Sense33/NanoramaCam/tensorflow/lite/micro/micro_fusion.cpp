@@ -0,0 +1,520 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Load time operator fusion and patch-based execution of the first layers of
+the MicroInterpreter. E.M.
+
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_fusion.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "tensorflow/lite/kernels/padding.h"
+
+namespace tflite {
+namespace {
+
+// Registration of the nodes merged into a previous one. The interpreter
+// skips the nodes without invoke.
+const TfLiteRegistration kFusedAwayRegistration = {
+    /*init=*/nullptr,
+    /*free=*/nullptr,
+    /*prepare=*/nullptr,
+    /*invoke=*/nullptr,
+    /*profiling_string=*/nullptr,
+    /*builtin_code=*/BuiltinOperator_CUSTOM,
+    /*custom_name=*/"FUSED",
+    /*version=*/0};
+
+// Alignment of the persistent buffers of the MicroAllocator
+constexpr size_t kPersistentAlignment = 16;
+
+// True for the tensors planned in the arena: the constant tensors already
+// point to the model data.
+bool IsActivation(const TfLiteContext* context, int tensor_index) {
+  return tensor_index >= 0 &&
+         context->tensors[tensor_index].data.data == nullptr;
+}
+
+// First node writing the tensor and last node reading it, with the same
+// rules of the MicroAllocator: the inputs of the subgraph are created by the
+// first node and its outputs live until the last one.
+void TensorLifetime(const SubGraph* subgraph,
+                    const NodeAndRegistration* nodes, int node_count,
+                    int tensor_index, int* first, int* last) {
+  *first = -1;
+  *last = -1;
+  for (size_t i = 0; i < subgraph->inputs()->size(); ++i) {
+    if (subgraph->inputs()->Get(i) == tensor_index) {
+      *first = 0;
+    }
+  }
+  for (size_t i = 0; i < subgraph->outputs()->size(); ++i) {
+    if (subgraph->outputs()->Get(i) == tensor_index) {
+      *last = node_count - 1;
+    }
+  }
+  for (int i = 0; i < node_count; ++i) {
+    const TfLiteNode& node = nodes[i].node;
+    for (int n = 0; n < node.inputs->size; ++n) {
+      if (node.inputs->data[n] == tensor_index && i > *last) {
+        *last = i;
+      }
+    }
+    for (int n = 0; n < node.outputs->size; ++n) {
+      if (node.outputs->data[n] == tensor_index &&
+          (*first == -1 || i < *first)) {
+        *first = i;
+      }
+    }
+  }
+}
+
+// Bytes of the activation tensors alive at any node from first_node to
+// last_node, the excluded tensor (if any) is not counted.
+size_t LiveBytes(const TfLiteContext* context, const SubGraph* subgraph,
+                 const NodeAndRegistration* nodes, int node_count,
+                 int first_node, int last_node, int excluded) {
+  size_t bytes = 0;
+  for (size_t t = 0; t < context->tensors_size; ++t) {
+    if (!IsActivation(context, t) || static_cast<int>(t) == excluded) {
+      continue;
+    }
+    int first, last;
+    TensorLifetime(subgraph, nodes, node_count, t, &first, &last);
+    if (first != -1 && last != -1 && first <= last_node &&
+        last >= first_node) {
+      bytes += context->tensors[t].bytes;
+    }
+  }
+  return bytes;
+}
+
+// Largest live set of the nodes, the first and last excluded ones (if any)
+// are skipped.
+size_t PeakBytes(const TfLiteContext* context, const SubGraph* subgraph,
+                 const NodeAndRegistration* nodes, int node_count,
+                 int excluded_first, int excluded_last) {
+  size_t peak_bytes = 0;
+  for (int i = 0; i < node_count; ++i) {
+    if (i >= excluded_first && i <= excluded_last) {
+      continue;
+    }
+    peak_bytes = std::max(
+        peak_bytes, LiveBytes(context, subgraph, nodes, node_count, i, i, -1));
+  }
+  return peak_bytes;
+}
+
+size_t PersistentBytes(size_t bytes) {
+  return (bytes + kPersistentAlignment - 1) / kPersistentAlignment *
+         kPersistentAlignment;
+}
+
+// Persistent bytes the fused node of the pair adds to the arena.
+size_t FusedPersistentBytes(const TfLiteContext* context,
+                            const NodeAndRegistration& first) {
+  size_t bytes =
+      PersistentBytes(sizeof(TfLiteFusedConvParams)) + kFusedConvFirstOpBytes;
+  const TfLiteNode& node = first.node;
+  if (first.registration->builtin_code == BuiltinOperator_DEPTHWISE_CONV_2D &&
+      context->tensors[node.inputs->data[0]].type == kTfLiteInt8) {
+    const int channels = context->tensors[node.inputs->data[1]].dims->data[3];
+    if (GetRequantizationTable(&node, channels) == nullptr) {
+      bytes += 2 * PersistentBytes(channels * sizeof(int32_t));
+    }
+  }
+  return bytes;
+}
+
+bool IsQuantized4D(const TfLiteTensor& tensor, TfLiteType type) {
+  return tensor.type == type &&
+         (type == kTfLiteUInt8 || type == kTfLiteInt8) &&
+         tensor.dims->size == 4 && tensor.dims->data[0] == 1;
+}
+
+// True if the tensor is read only by the reader node, not by the other nodes
+// or as an output of the subgraph.
+bool HasSingleReader(const SubGraph* subgraph,
+                     const NodeAndRegistration* nodes, int node_count,
+                     int tensor_index, int reader) {
+  for (size_t i = 0; i < subgraph->outputs()->size(); ++i) {
+    if (subgraph->outputs()->Get(i) == tensor_index) {
+      return false;
+    }
+  }
+  for (int i = 0; i < node_count; ++i) {
+    if (i == reader) {
+      continue;
+    }
+    const TfLiteNode& node = nodes[i].node;
+    for (int n = 0; n < node.inputs->size; ++n) {
+      if (node.inputs->data[n] == tensor_index) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the intermediate tensor if the node and the next one can be
+// fused, -1 otherwise.
+int FusableIntermediate(const TfLiteContext* context,
+                        const SubGraph* subgraph,
+                        const NodeAndRegistration* nodes, int node_count,
+                        int index) {
+  if (index + 1 >= node_count) {
+    return -1;
+  }
+  const NodeAndRegistration& first = nodes[index];
+  const NodeAndRegistration& conv = nodes[index + 1];
+  const int32_t first_op = first.registration->builtin_code;
+  if ((first_op != BuiltinOperator_DEPTHWISE_CONV_2D &&
+       first_op != BuiltinOperator_AVERAGE_POOL_2D) ||
+      conv.registration->builtin_code != BuiltinOperator_CONV_2D ||
+      first.node.builtin_data == nullptr ||
+      conv.node.builtin_data == nullptr) {
+    return -1;
+  }
+  // The depthwise convolution has a filter and an optional bias
+  const int first_inputs = first.node.inputs->size;
+  const bool has_first_inputs =
+      first_op == BuiltinOperator_DEPTHWISE_CONV_2D
+          ? (first_inputs == 2 || first_inputs == 3)
+          : first_inputs == 1;
+  if (!has_first_inputs || first.node.outputs->size != 1 ||
+      (conv.node.inputs->size != 2 && conv.node.inputs->size != 3) ||
+      conv.node.outputs->size != 1) {
+    return -1;
+  }
+  const int intermediate = first.node.outputs->data[0];
+  if (conv.node.inputs->data[0] != intermediate ||
+      !IsActivation(context, intermediate)) {
+    return -1;
+  }
+
+  if (!HasSingleReader(subgraph, nodes, node_count, intermediate, index + 1)) {
+    return -1;
+  }
+
+  const TfLiteTensor& input = context->tensors[first.node.inputs->data[0]];
+  const TfLiteTensor& output = context->tensors[conv.node.outputs->data[0]];
+  const TfLiteTensor& filter = context->tensors[conv.node.inputs->data[1]];
+  if (!IsQuantized4D(input, input.type) ||
+      !IsQuantized4D(context->tensors[intermediate], input.type) ||
+      !IsQuantized4D(output, input.type) || filter.dims->size != 4 ||
+      filter.dims->data[1] != 1 || filter.dims->data[2] != 1) {
+    return -1;
+  }
+  // The 1x1 convolution maps every pixel of the row to the same pixel
+  const auto* conv_params =
+      static_cast<const TfLiteConvParams*>(conv.node.builtin_data);
+  if (conv_params->stride_width != 1 || conv_params->stride_height != 1 ||
+      conv_params->dilation_width_factor != 1 ||
+      conv_params->dilation_height_factor != 1) {
+    return -1;
+  }
+  return intermediate;
+}
+
+// Fills the layer of the patched node with the node index, false if the
+// operator can't run on a band of rows.
+bool PatchedLayer(const TfLiteContext* context, const SubGraph* subgraph,
+                  const NodeAndRegistration* nodes, int node_count, int index,
+                  bool is_last, TfLitePatchedLayer* layer) {
+  const TfLiteNode& node = nodes[index].node;
+  const int32_t op = nodes[index].registration->builtin_code;
+  if (node.builtin_data == nullptr || node.inputs->size < 1 ||
+      node.outputs->size != 1) {
+    return false;
+  }
+  const TfLiteTensor& input = context->tensors[node.inputs->data[0]];
+  const TfLiteTensor& output = context->tensors[node.outputs->data[0]];
+  if (!IsQuantized4D(input, input.type) ||
+      !IsQuantized4D(output, input.type)) {
+    return false;
+  }
+  // A chain of layers, the inner outputs are only in the patch buffers
+  if (index > 0 &&
+      node.inputs->data[0] != nodes[index - 1].node.outputs->data[0]) {
+    return false;
+  }
+  if (!is_last && !HasSingleReader(subgraph, nodes, node_count,
+                                   node.outputs->data[0], index + 1)) {
+    return false;
+  }
+
+  int filter_height, filter_width, stride_height, stride_width;
+  TfLitePadding padding;
+  if (op == BuiltinOperator_DEPTHWISE_CONV_2D) {
+    const auto* params =
+        static_cast<const TfLiteDepthwiseConvParams*>(node.builtin_data);
+    if ((node.inputs->size != 2 && node.inputs->size != 3) ||
+        params->dilation_width_factor != 1 ||
+        params->dilation_height_factor != 1) {
+      return false;
+    }
+    const TfLiteTensor& filter = context->tensors[node.inputs->data[1]];
+    filter_height = filter.dims->data[1];
+    filter_width = filter.dims->data[2];
+    stride_height = params->stride_height;
+    stride_width = params->stride_width;
+    padding = params->padding;
+  } else if (op == BuiltinOperator_AVERAGE_POOL_2D) {
+    const auto* params =
+        static_cast<const TfLitePoolParams*>(node.builtin_data);
+    if (node.inputs->size != 1) {
+      return false;
+    }
+    filter_height = params->filter_height;
+    filter_width = params->filter_width;
+    stride_height = params->stride_height;
+    stride_width = params->stride_width;
+    padding = params->padding;
+  } else if (op == BuiltinOperator_CONV_2D) {
+    // The 1x1 convolution maps every row to the same row
+    const auto* params =
+        static_cast<const TfLiteConvParams*>(node.builtin_data);
+    if (node.inputs->size != 2 && node.inputs->size != 3) {
+      return false;
+    }
+    const TfLiteTensor& filter = context->tensors[node.inputs->data[1]];
+    if (filter.dims->size != 4 || filter.dims->data[1] != 1 ||
+        filter.dims->data[2] != 1 || params->stride_width != 1 ||
+        params->stride_height != 1) {
+      return false;
+    }
+    filter_height = 1;
+    filter_width = 1;
+    stride_height = 1;
+    stride_width = 1;
+    padding = params->padding;
+  } else {
+    return false;
+  }
+
+  int out_height, out_width;
+  const TfLitePaddingValues padding_values = ComputePaddingHeightWidth(
+      stride_height, stride_width, /*dilation_rate_height=*/1,
+      /*dilation_rate_width=*/1, input.dims->data[1], input.dims->data[2],
+      filter_height, filter_width, padding, &out_height, &out_width);
+  layer->op = op;
+  layer->params = node.builtin_data;
+  layer->inputs = node.inputs;
+  layer->output = node.outputs->data[0];
+  layer->table = GetRequantizationTable(&node, output.dims->data[3]);
+  layer->window_height = filter_height;
+  layer->stride_height = stride_height;
+  layer->pad_height = padding_values.height;
+  return true;
+}
+
+// Multiply-accumulates of an output row of the layer.
+size_t RowMacs(const TfLiteContext* context, const TfLitePatchedLayer& layer) {
+  const TfLiteTensor& input = context->tensors[layer.inputs->data[0]];
+  const TfLiteTensor& output = context->tensors[layer.output];
+  const size_t outputs = output.dims->data[2] * output.dims->data[3];
+  if (layer.op == BuiltinOperator_CONV_2D) {
+    return outputs * input.dims->data[3];
+  }
+  if (layer.op == BuiltinOperator_AVERAGE_POOL_2D) {
+    const auto* params = static_cast<const TfLitePoolParams*>(layer.params);
+    return outputs * params->filter_height * params->filter_width;
+  }
+  const TfLiteTensor& filter = context->tensors[layer.inputs->data[1]];
+  return outputs * filter.dims->data[1] * filter.dims->data[2];
+}
+
+}  // namespace
+
+TfLiteStatus PatchLayers(TfLiteContext* context, const SubGraph* subgraph,
+                         const OpResolver& op_resolver,
+                         NodeAndRegistration* node_and_registrations,
+                         int layers, int patch_rows,
+                         PatchExecutionInfo* info) {
+  *info = {};
+  if (layers == 0) {
+    return kTfLiteOk;
+  }
+  const TfLiteRegistration* patched_registration =
+      op_resolver.FindOp(kPatchedLayersOpName, 1);
+  if (patched_registration == nullptr) {
+    TF_LITE_KERNEL_LOG(context, "Patch execution needs the %s operator",
+                       kPatchedLayersOpName);
+    return kTfLiteError;
+  }
+  NodeAndRegistration* nodes = node_and_registrations;
+  const int node_count = subgraph->operators()->size();
+  if (layers < 1 || layers > kMaxPatchedLayers || layers > node_count ||
+      patch_rows < 1) {
+    TF_LITE_KERNEL_LOG(context, "Can't patch %d layers by %d rows", layers,
+                       patch_rows);
+    return kTfLiteError;
+  }
+
+  TfLitePatchedLayersParams* params = nullptr;
+  TfLitePatchedLayer* patched = nullptr;
+  TfLiteIntArray* no_tensors = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, sizeof(TfLitePatchedLayersParams),
+      reinterpret_cast<void**>(&params)));
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, layers * sizeof(TfLitePatchedLayer),
+      reinterpret_cast<void**>(&patched)));
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, TfLiteIntArrayGetSizeInBytes(0),
+      reinterpret_cast<void**>(&no_tensors)));
+  no_tensors->size = 0;
+  for (int i = 0; i < layers; ++i) {
+    if (!PatchedLayer(context, subgraph, nodes, node_count, i,
+                      i == layers - 1, &patched[i])) {
+      TF_LITE_KERNEL_LOG(context, "Operator %d can't run by patches", i);
+      return kTfLiteError;
+    }
+  }
+  params->num_layers = layers;
+  params->layers = patched;
+  params->patch_rows = patch_rows;
+  params->buffer_bytes[0] = 0;
+  params->buffer_bytes[1] = 0;
+
+  // Buffers of the largest patches and the recomputed rows
+  const int height =
+      context->tensors[patched[layers - 1].output].dims->data[1];
+  int begin[kMaxPatchedLayers];
+  int end[kMaxPatchedLayers];
+  for (int out_y = 0; out_y < height; out_y += patch_rows) {
+    PatchRows(context, *params, out_y, std::min(out_y + patch_rows, height),
+              begin, end);
+    for (int l = 0; l < layers; ++l) {
+      const TfLiteTensor& output = context->tensors[patched[l].output];
+      if (l < layers - 1) {
+        const int bytes =
+            (end[l] - begin[l]) * output.dims->data[2] * output.dims->data[3];
+        params->buffer_bytes[l % 2] =
+            std::max(params->buffer_bytes[l % 2], bytes);
+      }
+      info->patch_macs += (end[l] - begin[l]) * RowMacs(context, patched[l]);
+    }
+    ++info->patches;
+  }
+  for (int l = 0; l < layers; ++l) {
+    const TfLiteTensor& output = context->tensors[patched[l].output];
+    info->layer_macs += output.dims->data[1] * RowMacs(context, patched[l]);
+  }
+  info->layers = layers;
+  info->patch_rows = patch_rows;
+  info->buffer_bytes = params->buffer_bytes[0] + params->buffer_bytes[1];
+
+  // The first node runs the patches, the arrays of the model are read only.
+  // The tables are in the layers, not in the custom data of the nodes.
+  TfLiteNode* first = &nodes[0].node;
+  first->outputs = nodes[layers - 1].node.outputs;
+  first->builtin_data = params;
+  first->custom_initial_data = nullptr;
+  first->custom_initial_data_size = 0;
+  nodes[0].registration = patched_registration;
+  for (int i = 1; i < layers; ++i) {
+    nodes[i].node.inputs = no_tensors;
+    nodes[i].node.outputs = no_tensors;
+    nodes[i].node.custom_initial_data = nullptr;
+    nodes[i].node.custom_initial_data_size = 0;
+    nodes[i].registration = &kFusedAwayRegistration;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus FuseOperators(TfLiteContext* context, const SubGraph* subgraph,
+                           const OpResolver& op_resolver,
+                           NodeAndRegistration* node_and_registrations,
+                           bool arena_guard, int* fused_count) {
+  *fused_count = 0;
+  const TfLiteRegistration* fused_registration =
+      op_resolver.FindOp(kFusedConv2dOpName, 1);
+  if (fused_registration == nullptr) {
+    return kTfLiteOk;
+  }
+  NodeAndRegistration* nodes = node_and_registrations;
+  const int node_count = subgraph->operators()->size();
+
+  // Largest live set of the graph, updated with the fused pairs
+  size_t peak_bytes = PeakBytes(context, subgraph, nodes, node_count, -1, -1);
+
+  TfLiteIntArray* no_tensors = nullptr;
+  for (int i = 0; i + 1 < node_count; ++i) {
+    const int intermediate =
+        FusableIntermediate(context, subgraph, nodes, node_count, i);
+    if (intermediate < 0) {
+      continue;
+    }
+    // The row of the intermediate tensor is on the stack of the kernel
+    const TfLiteIntArray* dims = context->tensors[intermediate].dims;
+    if (dims->data[2] * dims->data[3] > kFusedConvMaxRowBytes) {
+      continue;
+    }
+    // The arena must not grow: the fused node drops the intermediate tensor
+    // from the live sets and adds its persistent data
+    const size_t fused_peak_bytes = std::max(
+        PeakBytes(context, subgraph, nodes, node_count, i, i + 1),
+        LiveBytes(context, subgraph, nodes, node_count, i, i + 1,
+                  intermediate));
+    size_t added_bytes = FusedPersistentBytes(context, nodes[i]);
+    if (no_tensors == nullptr) {
+      added_bytes += PersistentBytes(TfLiteIntArrayGetSizeInBytes(0));
+    }
+    if (arena_guard && fused_peak_bytes + added_bytes > peak_bytes) {
+      continue;
+    }
+
+    TfLiteNode* first = &nodes[i].node;
+    TfLiteNode* conv = &nodes[i + 1].node;
+    TfLiteFusedConvParams* params = nullptr;
+    TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+        context, sizeof(TfLiteFusedConvParams),
+        reinterpret_cast<void**>(&params)));
+    if (no_tensors == nullptr) {
+      TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+          context, TfLiteIntArrayGetSizeInBytes(0),
+          reinterpret_cast<void**>(&no_tensors)));
+      no_tensors->size = 0;
+    }
+    params->first_op = nodes[i].registration->builtin_code;
+    params->first_params = first->builtin_data;
+    params->conv_params =
+        static_cast<const TfLiteConvParams*>(conv->builtin_data);
+    params->conv_inputs = conv->inputs;
+    params->first_table = GetRequantizationTable(
+        first, context->tensors[intermediate].dims->data[3]);
+    params->conv_table = GetRequantizationTable(
+        conv, context->tensors[conv->outputs->data[0]].dims->data[3]);
+
+    // The arrays of the model are read only, the pointers are moved
+    first->outputs = conv->outputs;
+    first->builtin_data = params;
+    first->custom_initial_data = nullptr;
+    first->custom_initial_data_size = 0;
+    nodes[i].registration = fused_registration;
+    conv->inputs = no_tensors;
+    conv->outputs = no_tensors;
+    conv->custom_initial_data = nullptr;
+    conv->custom_initial_data_size = 0;
+    nodes[i + 1].registration = &kFusedAwayRegistration;
+    peak_bytes = fused_peak_bytes;
+    ++(*fused_count);
+    ++i;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
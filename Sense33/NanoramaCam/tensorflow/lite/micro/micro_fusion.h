@@ -0,0 +1,182 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Load time operator fusion and patch-based execution of the first layers of
+the MicroInterpreter. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_FUSION_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_FUSION_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/op_resolver.h"
+#include "tensorflow/lite/micro/micro_allocator.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+// Custom operator replacing a DEPTHWISE_CONV_2D or an AVERAGE_POOL_2D
+// followed by a 1x1 CONV_2D. The fusion is enabled by registering it:
+//
+//   resolver.AddCustom(kFusedConv2dOpName,
+//                      tflite::ops::micro::Register_FUSED_CONV_2D());
+constexpr char kFusedConv2dOpName[] = "FUSED_CONV_2D";
+
+// Max bytes of a row of the intermediate tensor, the fused kernel keeps it
+// on the stack.
+constexpr int kFusedConvMaxRowBytes = 1024;
+
+// Arena bytes of the op data the fused kernel keeps for the first operator,
+// on top of the one of the 1x1 convolution (checked by fused_conv.cpp).
+constexpr int kFusedConvFirstOpBytes = 176;
+
+// builtin_data of a fused node. The node has the inputs of the first
+// operator and the output of the convolution.
+struct TfLiteFusedConvParams {
+  // BuiltinOperator_DEPTHWISE_CONV_2D or BuiltinOperator_AVERAGE_POOL_2D
+  int32_t first_op;
+  // TfLiteDepthwiseConvParams or TfLitePoolParams of the first operator
+  const void* first_params;
+  const TfLiteConvParams* conv_params;
+  // Inputs of the convolution: the intermediate tensor, the filter and the
+  // optional bias. Only the shape and the quantization of the intermediate
+  // tensor are used, it is not allocated.
+  const TfLiteIntArray* conv_inputs;
+  // Requantization tables of the depthwise convolution and of the
+  // convolution (micro_requantization.h), nullptr if none
+  const TfLiteRequantizationTable* first_table;
+  const TfLiteRequantizationTable* conv_table;
+};
+
+// Custom operator running the first layers of the model patch by patch
+// (depth-first): a patch is a band of rows of the output of the last layer,
+// every layer computes the rows read by the next one (the receptive field
+// with its halo) in a small buffer, so the full size outputs of the inner
+// layers are never allocated. The rows in the halos of two patches are
+// computed twice. Enabled by MicroInterpreter::SetPatchExecution() with the
+// operator registered:
+//
+//   resolver.AddCustom(kPatchedLayersOpName,
+//                      tflite::ops::micro::Register_PATCHED_LAYERS());
+constexpr char kPatchedLayersOpName[] = "PATCHED_LAYERS";
+
+constexpr int kMaxPatchedLayers = 16;
+
+// A DEPTHWISE_CONV_2D, AVERAGE_POOL_2D or 1x1 CONV_2D of a patched node.
+struct TfLitePatchedLayer {
+  int32_t op;
+  // Builtin parameters of the operator
+  const void* params;
+  // Inputs of the operator in the model, the first one is the output of the
+  // previous layer
+  const TfLiteIntArray* inputs;
+  int output;
+  // Requantization table of the operator, nullptr if none
+  const TfLiteRequantizationTable* table;
+  // Input rows under the window of an output row
+  int window_height;
+  int stride_height;
+  int pad_height;
+};
+
+// builtin_data of a patched node. The node has the inputs of the first
+// layer and the output of the last one.
+struct TfLitePatchedLayersParams {
+  int num_layers;
+  const TfLitePatchedLayer* layers;
+  // Output rows of the last layer computed by a patch
+  int patch_rows;
+  // Bytes of the two buffers of the patches of the inner layers, the odd
+  // layers write the second one.
+  int buffer_bytes[2];
+};
+
+// Output rows [begin[l], end[l]) of every layer computed by the patch of
+// the output rows [out_begin, out_end) of the last layer.
+inline void PatchRows(const TfLiteContext* context,
+                      const TfLitePatchedLayersParams& params, int out_begin,
+                      int out_end, int* begin, int* end) {
+  begin[params.num_layers - 1] = out_begin;
+  end[params.num_layers - 1] = out_end;
+  for (int l = params.num_layers - 1; l > 0; --l) {
+    const TfLitePatchedLayer& layer = params.layers[l];
+    const int input_height =
+        context->tensors[layer.inputs->data[0]].dims->data[1];
+    begin[l - 1] =
+        std::max(begin[l] * layer.stride_height - layer.pad_height, 0);
+    end[l - 1] = std::max(
+        std::min((end[l] - 1) * layer.stride_height - layer.pad_height +
+                     layer.window_height,
+                 input_height),
+        begin[l - 1]);
+  }
+}
+
+// Patch execution set by PatchLayers(), all zero if disabled.
+struct PatchExecutionInfo {
+  int layers;
+  int patch_rows;
+  int patches;
+  // Bytes of the buffers of the patches
+  size_t buffer_bytes;
+  // Multiply-accumulates of the patched layers: all the patches and the
+  // layers run once, the difference is the recompute of the halos.
+  size_t patch_macs;
+  size_t layer_macs;
+};
+
+// Replaces the first layers operators of the subgraph with the patched
+// registration of the resolver, every patch computes patch_rows output rows
+// of the last one. The layers must be a chain of DEPTHWISE_CONV_2D,
+// AVERAGE_POOL_2D and 1x1 CONV_2D with stride 1, their outputs read only by
+// the next layer. Nothing is done if layers is 0.
+//
+// Call it after MicroAllocator::AllocateNodeAndRegistrations and
+// AttachRequantizationTables(), and before FuseOperators(),
+// context->AllocatePersistentBuffer must be set.
+TfLiteStatus PatchLayers(TfLiteContext* context, const SubGraph* subgraph,
+                         const OpResolver& op_resolver,
+                         NodeAndRegistration* node_and_registrations,
+                         int layers, int patch_rows, PatchExecutionInfo* info);
+
+// Replaces the operator pairs of the subgraph with the fused registration
+// of the resolver; nothing is done if kFusedConv2dOpName is not registered.
+// The first node of a pair takes the fused registration, the second one is
+// left without registration functions and tensors. A pair is fused when the
+// intermediate tensor has no other reader, the types are uint8 or int8, a
+// row of the intermediate tensor fits in kFusedConvMaxRowBytes and the
+// arena doesn't grow: the largest live set of the graph with the pair fused
+// plus the persistent data the fused node adds (its parameters, the op data
+// of the first operator and the per channel arrays of an int8 depthwise
+// convolution without requantization table) must fit in the largest live
+// set of the graph before. The unfused first operator is counted as keeping
+// no persistent data. Without arena_guard every supported pair is fused,
+// for the checks of the fused kernel.
+//
+// Call it after MicroAllocator::AllocateNodeAndRegistrations and
+// AttachRequantizationTables(), and before the init of the kernels,
+// context->AllocatePersistentBuffer must be set. fused_count receives the
+// number of fused pairs.
+TfLiteStatus FuseOperators(TfLiteContext* context, const SubGraph* subgraph,
+                           const OpResolver& op_resolver,
+                           NodeAndRegistration* node_and_registrations,
+                           bool arena_guard, int* fused_count);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_FUSION_H_
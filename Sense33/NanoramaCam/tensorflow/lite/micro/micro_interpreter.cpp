@@ -11,6 +11,11 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+Added the optional per-operator profiler, the Invoke() from a given
+operator, the operator fusion, the patch-based execution of the first
+layers and the offline requantization tables. E.M.
+
 ==============================================================================*/
 #include "tensorflow/lite/micro/micro_interpreter.h"
 
@@ -24,6 +29,8 @@ limitations under the License.
 #include "tensorflow/lite/core/api/op_resolver.h"
 #include "tensorflow/lite/core/api/tensor_utils.h"
 #include "tensorflow/lite/micro/micro_allocator.h"
+#include "tensorflow/lite/micro/micro_profiler.h"
+#include "tensorflow/lite/micro/micro_requantization.h"
 
 namespace tflite {
 namespace {
@@ -74,10 +81,12 @@ MicroInterpreter::MicroInterpreter(const Model* model,
                                    const OpResolver& op_resolver,
                                    uint8_t* tensor_arena,
                                    size_t tensor_arena_size,
-                                   ErrorReporter* error_reporter)
+                                   ErrorReporter* error_reporter,
+                                   MicroProfiler* profiler)
     : model_(model),
       op_resolver_(op_resolver),
       error_reporter_(error_reporter),
+      profiler_(profiler),
       allocator_(&context_, model_, tensor_arena, tensor_arena_size,
                  error_reporter_),
       tensors_allocated_(false),
@@ -96,6 +105,10 @@ MicroInterpreter::MicroInterpreter(const Model* model,
   context_.ReportError = context_helper_.ReportOpError;
   context_.recommended_num_threads = 1;
 
+  if (profiler_ != nullptr) {
+    profiler_->SetArena(tensor_arena, tensor_arena_size);
+  }
+
   // If the system is big endian then convert weights from the flatbuffer from
   // little to big endian on startup so that it does not need to be done during
   // inference.
@@ -173,6 +186,21 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   context_.RequestScratchBufferInArena = nullptr;
   context_.GetScratchBuffer = nullptr;
 
+  // The patched and the fused kernels replace their operators before the
+  // init, taking the requantization tables of the operators
+  TF_LITE_ENSURE_OK(&context_,
+                    AttachRequantizationTables(
+                        model_, subgraph_, node_and_registrations_,
+                        error_reporter_, &requantization_tables_));
+  TF_LITE_ENSURE_OK(&context_,
+                    PatchLayers(&context_, subgraph_, op_resolver_,
+                                node_and_registrations_, patch_layers_,
+                                patch_rows_, &patch_info_));
+  TF_LITE_ENSURE_OK(&context_,
+                    FuseOperators(&context_, subgraph_, op_resolver_,
+                                  node_and_registrations_, fusion_arena_guard_,
+                                  &fused_operators_));
+
   for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
     context_helper_.SetNodeIndex(i);
     auto* node = &(node_and_registrations_[i].node);
@@ -226,7 +254,7 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   return kTfLiteOk;
 }
 
-TfLiteStatus MicroInterpreter::Invoke() {
+TfLiteStatus MicroInterpreter::Invoke(size_t first_node) {
   if (initialization_status_ != kTfLiteOk) {
     TF_LITE_REPORT_ERROR(error_reporter_,
                          "Invoke() called after initialization failed\n");
@@ -239,12 +267,23 @@ TfLiteStatus MicroInterpreter::Invoke() {
     TF_LITE_ENSURE_OK(&context_, AllocateTensors());
   }
 
-  for (size_t i = 0; i < subgraph_->operators()->size(); ++i) {
+  if (profiler_ != nullptr) {
+    profiler_->BeginInvoke(first_node);
+  }
+  for (size_t i = first_node; i < subgraph_->operators()->size(); ++i) {
     auto* node = &(node_and_registrations_[i].node);
     auto* registration = node_and_registrations_[i].registration;
 
     if (registration->invoke) {
+      if (profiler_ != nullptr) {
+        profiler_->BeginOp(i);
+      }
       TfLiteStatus invoke_status = registration->invoke(&context_, node);
+      if (profiler_ != nullptr) {
+        profiler_->EndOp(i, registration->builtin_code,
+                         OpNameFromRegistration(registration), &context_,
+                         node);
+      }
       if (invoke_status == kTfLiteError) {
         TF_LITE_REPORT_ERROR(
             error_reporter_,
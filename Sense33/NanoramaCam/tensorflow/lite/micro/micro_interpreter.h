@@ -11,6 +11,12 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+Added the optional per-operator profiler, the Invoke() from a given
+operator, the optional external memory planner, the operator fusion, the
+patch-based execution of the first layers and the offline requantization
+tables. E.M.
+
 ==============================================================================*/
 #ifndef TENSORFLOW_LITE_MICRO_MICRO_INTERPRETER_H_
 #define TENSORFLOW_LITE_MICRO_MICRO_INTERPRETER_H_
@@ -24,6 +30,8 @@ limitations under the License.
 #include "tensorflow/lite/core/api/op_resolver.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/micro/micro_allocator.h"
+#include "tensorflow/lite/micro/micro_fusion.h"
+#include "tensorflow/lite/micro/micro_profiler.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 #include "tensorflow/lite/type_to_tflitetype.h"
 
@@ -72,20 +80,53 @@ class MicroInterpreter {
   // function.
   // The interpreter doesn't do any deallocation of any of the pointed-to
   // objects, ownership remains with the caller.
+  // The optional profiler is called around the invoke of every node and must
+  // live as long as the interpreter.
   MicroInterpreter(const Model* model, const OpResolver& op_resolver,
                    uint8_t* tensor_arena, size_t tensor_arena_size,
-                   ErrorReporter* error_reporter);
+                   ErrorReporter* error_reporter,
+                   MicroProfiler* profiler = nullptr);
 
   ~MicroInterpreter();
 
+  // Lays out the activation buffers with the given planner instead of the
+  // greedy one, e.g. a PrecomputedMemoryPlanner replaying an offline plan.
+  // Call it before AllocateTensors(); the planner must outlive the call.
+  void SetMemoryPlanner(MemoryPlanner* planner) {
+    allocator_.SetMemoryPlanner(planner);
+  }
+
+  // Runs the first layers operators patch by patch (depth-first), each patch
+  // computes patch_rows output rows of the last one: the outputs of the inner
+  // layers are not allocated, for a smaller arena and the recompute of the
+  // rows in the halos of the patches. The resolver must have the
+  // kPatchedLayersOpName kernel (micro_fusion.h). Call it before
+  // AllocateTensors(), 0 layers (the default) runs layer by layer.
+  void SetPatchExecution(int layers, int patch_rows) {
+    patch_layers_ = layers;
+    patch_rows_ = patch_rows;
+  }
+
+  // Fuses every operator pair the fused kernel supports, even the ones that
+  // grow the arena (FuseOperators()), for the checks of the fused kernel.
+  // Call it before AllocateTensors().
+  void SetFusionArenaGuard(bool enabled) { fusion_arena_guard_ = enabled; }
+
   // Runs through the model and allocates all necessary input, output and
-  // intermediate tensors.
+  // intermediate tensors. The requantization tables of the model metadata
+  // are attached to their nodes (micro_requantization.h), then the first
+  // layers are patched if set and if the resolver has the kFusedConv2dOpName
+  // kernel the operator pairs it supports are fused (micro_fusion.h), with
+  // the tables of the operators they replace.
   TfLiteStatus AllocateTensors();
 
   // In order to support partial graph runs for strided models, this can return
   // values other than kTfLiteOk and kTfLiteError.
   // TODO(b/149795762): Add this to the TfLiteStatus enum.
-  TfLiteStatus Invoke();
+  // first_node > 0 resumes the graph from that operator: the caller has
+  // filled the outputs of the skipped operators read by the others (the
+  // layers shared by overlapping windows of the tiled detector).
+  TfLiteStatus Invoke(size_t first_node = 0);
 
   size_t tensors_size() const { return context_.tensors_size; }
   TfLiteTensor* tensor(size_t tensor_index);
@@ -138,6 +179,15 @@ class MicroInterpreter {
 
   size_t operators_size() const { return subgraph_->operators()->size(); }
 
+  // Operator pairs fused by AllocateTensors(), their second node is skipped.
+  int fused_operators() const { return fused_operators_; }
+
+  // Patches and recompute of SetPatchExecution(), after AllocateTensors().
+  const PatchExecutionInfo& patch_execution() const { return patch_info_; }
+
+  // Nodes reading their requantization tables from the model metadata.
+  int requantization_tables() const { return requantization_tables_; }
+
   // For debugging only.
   const NodeAndRegistration node_and_registration(int node_index) const {
     return node_and_registrations_[node_index];
@@ -151,6 +201,10 @@ class MicroInterpreter {
   // arena_used_bytes() + 16.
   size_t arena_used_bytes() const { return allocator_.used_bytes(); }
 
+  // Size of the activation buffers laid out by the memory planner
+  // (GetMaximumMemorySize()), available after `AllocateTensors`.
+  size_t arena_planned_bytes() const { return allocator_.planned_bytes(); }
+
  private:
   void CorrectTensorEndianness(TfLiteTensor* tensorCorr);
 
@@ -162,9 +216,16 @@ class MicroInterpreter {
   const Model* model_;
   const OpResolver& op_resolver_;
   ErrorReporter* error_reporter_;
+  MicroProfiler* profiler_;
   TfLiteContext context_ = {};
   MicroAllocator allocator_;
   bool tensors_allocated_;
+  int fused_operators_ = 0;
+  bool fusion_arena_guard_ = true;
+  int patch_layers_ = 0;
+  int patch_rows_ = 0;
+  PatchExecutionInfo patch_info_ = {};
+  int requantization_tables_ = 0;
 
   TfLiteStatus initialization_status_;
 
@@ -0,0 +1,240 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Per-operator profiler of the MicroInterpreter. E.M.
+
+==============================================================================*/
+#include "tensorflow/lite/micro/micro_profiler.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/micro/micro_time.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+namespace {
+
+int64_t ElementCount(const TfLiteTensor* tensor) {
+  int64_t count = 1;
+  for (int i = 0; i < tensor->dims->size; ++i) {
+    count *= tensor->dims->data[i];
+  }
+  return count;
+}
+
+const TfLiteTensor* NodeTensor(const TfLiteContext* context,
+                               const TfLiteIntArray* indices, int i) {
+  if (indices == nullptr || i >= indices->size || indices->data[i] < 0) {
+    return nullptr;
+  }
+  return &context->tensors[indices->data[i]];
+}
+
+// Multiply-accumulates of the node, from the output and the filter shapes.
+// The element-wise ops count one operation per output element.
+int64_t NodeMacs(int32_t builtin_code, const TfLiteContext* context,
+                 const TfLiteNode* node) {
+  const TfLiteTensor* output = NodeTensor(context, node->outputs, 0);
+  const TfLiteTensor* filter = NodeTensor(context, node->inputs, 1);
+  if (output == nullptr) {
+    return 0;
+  }
+  const int64_t output_count = ElementCount(output);
+
+  switch (builtin_code) {
+    case BuiltinOperator_CONV_2D:
+      // Filter is OHWI
+      if (filter != nullptr && filter->dims->size == 4) {
+        return output_count * filter->dims->data[1] * filter->dims->data[2] *
+               filter->dims->data[3];
+      }
+      return 0;
+    case BuiltinOperator_DEPTHWISE_CONV_2D:
+      // Filter is 1HW(I*M), one filter tap per output element
+      if (filter != nullptr && filter->dims->size == 4) {
+        return output_count * filter->dims->data[1] * filter->dims->data[2];
+      }
+      return 0;
+    case BuiltinOperator_FULLY_CONNECTED:
+      if (filter != nullptr && filter->dims->size == 2) {
+        return output_count * filter->dims->data[1];
+      }
+      return 0;
+    case BuiltinOperator_AVERAGE_POOL_2D:
+    case BuiltinOperator_MAX_POOL_2D: {
+      const TfLitePoolParams* params =
+          reinterpret_cast<const TfLitePoolParams*>(node->builtin_data);
+      if (params != nullptr) {
+        return output_count * params->filter_width * params->filter_height;
+      }
+      return 0;
+    }
+    case BuiltinOperator_ADD:
+    case BuiltinOperator_SUB:
+    case BuiltinOperator_MUL:
+    case BuiltinOperator_SOFTMAX:
+    case BuiltinOperator_LOGISTIC:
+      return output_count;
+    default:
+      return 0;
+  }
+}
+
+int32_t Clamp32(int64_t value) {
+  return value > INT32_MAX ? INT32_MAX : static_cast<int32_t>(value);
+}
+
+int32_t TicksToMicros(int64_t ticks) {
+  const int32_t ticks_per_s = ticks_per_second();
+  if (ticks_per_s <= 0) {
+    return 0;
+  }
+  return Clamp32(ticks * 1000000 / ticks_per_s);
+}
+
+// Mean ticks of a node over the invokes running it
+int64_t MeanTicks(const MicroOpProfile& op) {
+  return op.invokes > 0 ? op.total_ticks / op.invokes : 0;
+}
+
+}  // namespace
+
+MicroOpProfiler::MicroOpProfiler()
+    : num_ops_(0),
+      invokes_(0),
+      start_ticks_(0),
+      arena_(nullptr),
+      arena_size_(0) {}
+
+void MicroOpProfiler::SetArena(const uint8_t* arena, size_t arena_size) {
+  arena_ = arena;
+  arena_size_ = arena_size;
+}
+
+void MicroOpProfiler::BeginInvoke(int first_node) { invokes_++; }
+
+void MicroOpProfiler::BeginOp(int node_index) {
+  start_ticks_ = GetCurrentTimeTicks();
+}
+
+void MicroOpProfiler::EndOp(int node_index, int32_t builtin_code,
+                            const char* tag, const TfLiteContext* context,
+                            const TfLiteNode* node) {
+  // Unsigned difference, safe across the tick counter wrap
+  const int32_t ticks = static_cast<int32_t>(
+      static_cast<uint32_t>(GetCurrentTimeTicks()) -
+      static_cast<uint32_t>(start_ticks_));
+  if (node_index < 0 || node_index >= TF_LITE_MICRO_PROFILER_MAX_OPS) {
+    return;
+  }
+  MicroOpProfile* op = &ops_[node_index];
+  if (node_index >= num_ops_) {
+    // First invoke of the node: the static costs are computed only once
+    for (int i = num_ops_; i < node_index; ++i) {
+      memset(&ops_[i], 0, sizeof(MicroOpProfile));
+      ops_[i].node_index = i;
+    }
+    num_ops_ = node_index + 1;
+    memset(op, 0, sizeof(MicroOpProfile));
+    op->node_index = node_index;
+    op->builtin_code = builtin_code;
+    op->tag = tag;
+    op->macs = Clamp32(NodeMacs(builtin_code, context, node));
+
+    const TfLiteIntArray* lists[] = {node->inputs, node->outputs,
+                                     node->temporaries};
+    for (const TfLiteIntArray* list : lists) {
+      for (int i = 0; list != nullptr && i < list->size; ++i) {
+        const TfLiteTensor* tensor = NodeTensor(context, list, i);
+        if (tensor == nullptr || arena_ == nullptr) {
+          continue;
+        }
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(tensor->data.raw);
+        if (data >= arena_ && data < arena_ + arena_size_) {
+          const int32_t end =
+              static_cast<int32_t>(data + tensor->bytes - arena_);
+          if (end > op->arena_high_water) {
+            op->arena_high_water = end;
+          }
+        }
+      }
+    }
+  }
+  op->last_ticks = ticks;
+  op->total_ticks += ticks;
+  op->invokes++;
+}
+
+void MicroOpProfiler::Reset() {
+  for (int i = 0; i < num_ops_; ++i) {
+    ops_[i].last_ticks = 0;
+    ops_[i].total_ticks = 0;
+    ops_[i].invokes = 0;
+  }
+  invokes_ = 0;
+}
+
+void MicroOpProfiler::Log(ErrorReporter* error_reporter) const {
+  const int invokes = invokes_ > 0 ? invokes_ : 1;
+  int64_t total_ticks = 0;
+  int64_t mean_ticks = 0;
+  int64_t total_macs = 0;
+  int32_t high_water = 0;
+  for (int i = 0; i < num_ops_; ++i) {
+    total_ticks += ops_[i].total_ticks;
+    mean_ticks += MeanTicks(ops_[i]);
+    total_macs += ops_[i].macs;
+    if (ops_[i].arena_high_water > high_water) {
+      high_water = ops_[i].arena_high_water;
+    }
+  }
+
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "profile,%d ops,%d invokes,%d us,%d kmacs,%d arena",
+                       num_ops_, invokes_, TicksToMicros(total_ticks / invokes),
+                       Clamp32(total_macs / 1000), high_water);
+  TF_LITE_REPORT_ERROR(error_reporter, "node,op,ticks,us,kmacs,arena");
+  for (int i = 0; i < num_ops_; ++i) {
+    const MicroOpProfile& op = ops_[i];
+    TF_LITE_REPORT_ERROR(error_reporter, "%d,%s,%d,%d,%d,%d", op.node_index,
+                         op.tag != nullptr ? op.tag : "-",
+                         Clamp32(MeanTicks(op)), TicksToMicros(MeanTicks(op)),
+                         op.macs / 1000, op.arena_high_water);
+  }
+
+  // Totals per operator type, in the order of the first node of the type
+  TF_LITE_REPORT_ERROR(error_reporter, "op,count,us,percent");
+  for (int i = 0; i < num_ops_; ++i) {
+    bool is_first = true;
+    for (int j = 0; j < i && is_first; ++j) {
+      is_first = ops_[j].builtin_code != ops_[i].builtin_code;
+    }
+    if (!is_first || ops_[i].tag == nullptr) {
+      continue;
+    }
+    int count = 0;
+    int64_t ticks = 0;
+    for (int j = i; j < num_ops_; ++j) {
+      if (ops_[j].builtin_code == ops_[i].builtin_code) {
+        count++;
+        ticks += MeanTicks(ops_[j]);
+      }
+    }
+    TF_LITE_REPORT_ERROR(
+        error_reporter, "%s,%d,%d,%d", ops_[i].tag, count,
+        TicksToMicros(ticks),
+        mean_ticks > 0 ? static_cast<int32_t>(ticks * 100 / mean_ticks) : 0);
+  }
+}
+
+}  // namespace tflite
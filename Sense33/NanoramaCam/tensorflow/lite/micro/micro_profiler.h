@@ -0,0 +1,112 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Per-operator profiler of the MicroInterpreter. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_PROFILER_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/micro/compatibility.h"
+
+// Max number of nodes recorded by MicroOpProfiler. The table is allocated with
+// the profiler, the nodes beyond the limit are not profiled.
+#ifndef TF_LITE_MICRO_PROFILER_MAX_OPS
+#define TF_LITE_MICRO_PROFILER_MAX_OPS 64
+#endif
+
+namespace tflite {
+
+// Hooks called by MicroInterpreter::Invoke() around the invoke of every node.
+// Pass an implementation to the MicroInterpreter constructor to enable them;
+// without a profiler Invoke() only pays a null pointer check per node.
+class MicroProfiler {
+ public:
+  virtual ~MicroProfiler() {}
+
+  // Called once by the interpreter constructor with the tensor arena bounds.
+  virtual void SetArena(const uint8_t* arena, size_t arena_size) {}
+  // Called at the start of every Invoke(), first_node is the first node run.
+  virtual void BeginInvoke(int first_node) {}
+
+  // Called before the invoke of the node.
+  virtual void BeginOp(int node_index) = 0;
+
+  // Called after the invoke of the node. builtin_code is a BuiltinOperator.
+  virtual void EndOp(int node_index, int32_t builtin_code, const char* tag,
+                     const TfLiteContext* context, const TfLiteNode* node) = 0;
+
+ private:
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+// Profile of one node.
+struct MicroOpProfile {
+  const char* tag;           // Operator name
+  int32_t node_index;
+  int32_t builtin_code;      // BuiltinOperator
+  int32_t last_ticks;        // Ticks of the last invoke
+  int64_t total_ticks;       // Ticks of all the invokes since the last Reset()
+  int32_t invokes;           // Invokes of the node since the last Reset()
+  int32_t macs;              // Multiply-accumulates from the tensor shapes
+  int32_t arena_high_water;  // Arena bytes up to the end of the node tensors
+};
+
+// Records the profile of every node in a fixed table. The time is measured
+// with GetCurrentTimeTicks(), the platform needs a real micro_time to get
+// non-zero values. The MACs and the arena high-water mark are derived from
+// the tensors the first time a node is seen.
+class MicroOpProfiler : public MicroProfiler {
+ public:
+  MicroOpProfiler();
+  ~MicroOpProfiler() override {}
+
+  void SetArena(const uint8_t* arena, size_t arena_size) override;
+  void BeginInvoke(int first_node) override;
+  void BeginOp(int node_index) override;
+  void EndOp(int node_index, int32_t builtin_code, const char* tag,
+             const TfLiteContext* context, const TfLiteNode* node) override;
+
+  // Clear the timings, keeps the nodes.
+  void Reset();
+
+  // Dump the table, one line per node and one per operator type:
+  //   node,op,ticks,us,kmacs,arena
+  //   op,count,us,percent
+  // The times are the average of the invokes since the last Reset(), the
+  // node times of the invokes running the node.
+  void Log(ErrorReporter* error_reporter) const;
+
+  int num_ops() const { return num_ops_; }
+  int invokes() const { return invokes_; }
+  const MicroOpProfile& op(int index) const { return ops_[index]; }
+
+ private:
+  MicroOpProfile ops_[TF_LITE_MICRO_PROFILER_MAX_OPS];
+  int num_ops_;
+  // Interpreter invokes, partial ones included
+  int invokes_;
+  int32_t start_ticks_;
+  const uint8_t* arena_;
+  size_t arena_size_;
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_PROFILER_H_
@@ -0,0 +1,105 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Load time lookup of the offline requantization tables of the model
+metadata. E.M.
+
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_requantization.h"
+
+#include <cstring>
+
+namespace tflite {
+namespace {
+
+// Buffer of the kRequantizationMetadataName metadata, nullptr if none
+const flatbuffers::Vector<uint8_t>* FindTables(const Model* model) {
+  if (model->metadata() == nullptr || model->buffers() == nullptr) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < model->metadata()->size(); ++i) {
+    const Metadata* metadata = model->metadata()->Get(i);
+    if (metadata->name() == nullptr ||
+        strcmp(metadata->name()->c_str(), kRequantizationMetadataName) != 0 ||
+        metadata->buffer() >= model->buffers()->size()) {
+      continue;
+    }
+    return model->buffers()->Get(metadata->buffer())->data();
+  }
+  return nullptr;
+}
+
+int32_t ReadInt32(const uint8_t* data) {
+  int32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+TfLiteStatus AttachRequantizationTables(
+    const Model* model, const SubGraph* subgraph,
+    NodeAndRegistration* node_and_registrations,
+    ErrorReporter* error_reporter, int* table_count) {
+  *table_count = 0;
+  const flatbuffers::Vector<uint8_t>* tables = FindTables(model);
+  if (tables == nullptr) {
+    return kTfLiteOk;
+  }
+  const uint8_t* data = tables->data();
+  const int size = static_cast<int>(tables->size());
+  const int node_count = static_cast<int>(subgraph->operators()->size());
+  const int header_bytes = (2 + node_count) * sizeof(int32_t);
+  // The tables are read in place as int32 arrays
+  if (size < header_bytes ||
+      reinterpret_cast<uintptr_t>(data) % sizeof(int32_t) != 0 ||
+      static_cast<uint32_t>(ReadInt32(data)) != kRequantizationMagic ||
+      ReadInt32(data + sizeof(int32_t)) != node_count) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "The requantization tables don't match the model");
+    return kTfLiteError;
+  }
+  for (int i = 0; i < node_count; ++i) {
+    const int offset = ReadInt32(data + (2 + i) * sizeof(int32_t));
+    if (offset == 0) {
+      continue;
+    }
+    TfLiteNode* node = &node_and_registrations[i].node;
+    const int32_t code = node_and_registrations[i].registration->builtin_code;
+    if (code != BuiltinOperator_CONV_2D &&
+        code != BuiltinOperator_DEPTHWISE_CONV_2D) {
+      continue;
+    }
+    if (offset < header_bytes || offset % sizeof(int32_t) != 0 ||
+        offset + static_cast<int>(sizeof(TfLiteRequantizationTable)) > size) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Bad requantization table of node %d", i);
+      return kTfLiteError;
+    }
+    const auto* table =
+        reinterpret_cast<const TfLiteRequantizationTable*>(data + offset);
+    const int table_bytes = RequantizationTableBytes(
+        table->output_depth, table->has_acc_offset != 0);
+    if (table->output_depth <= 0 || offset + table_bytes > size) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Bad requantization table of node %d", i);
+      return kTfLiteError;
+    }
+    node->custom_initial_data = table;
+    node->custom_initial_data_size = table_bytes;
+    ++*table_count;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
@@ -0,0 +1,108 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Requantization tables computed offline (host/person_detect_requant) and
+stored in the model metadata: the CONV_2D and DEPTHWISE_CONV_2D kernels read
+the output multipliers, shifts and accumulator offsets from the flash
+instead of computing them in floating point and keeping them in the
+arena. E.M.
+
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_REQUANTIZATION_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_REQUANTIZATION_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/micro/micro_allocator.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+// Name of the model metadata holding the tables.
+constexpr char kRequantizationMetadataName[] = "requantization_tables";
+
+// Layout of the metadata buffer, little endian int32 values:
+//   "RQT1"
+//   number of operators of the subgraph
+//   byte offset of the table of every operator in the buffer, 0 if none
+//   the tables, 4 bytes aligned
+constexpr uint32_t kRequantizationMagic = 0x31545152;  // "RQT1"
+
+// Table of an operator, followed by output_depth multipliers, output_depth
+// shifts (positive means left) and, if has_acc_offset, the output_depth
+// accumulator offsets of the GEMM CONV_2D (conv_gemm.h). The arrays are the
+// ones the kernels use: the CONV_2D tables of the uint8 models broadcast the
+// per tensor multiplier and shift, the DEPTHWISE_CONV_2D tables keep the
+// per channel arrays of PopulateConvolutionQuantizationParams().
+struct TfLiteRequantizationTable {
+  int32_t output_depth;
+  // Per tensor multiplier and shift (positive means right) of
+  // PopulateConvolutionQuantizationParams()
+  int32_t output_multiplier;
+  int32_t output_shift;
+  int32_t output_activation_min;
+  int32_t output_activation_max;
+  int32_t has_acc_offset;
+};
+
+inline const int32_t* RequantizationMultipliers(
+    const TfLiteRequantizationTable* table) {
+  return reinterpret_cast<const int32_t*>(table + 1);
+}
+
+inline const int32_t* RequantizationShifts(
+    const TfLiteRequantizationTable* table) {
+  return RequantizationMultipliers(table) + table->output_depth;
+}
+
+inline const int32_t* RequantizationAccOffsets(
+    const TfLiteRequantizationTable* table) {
+  return table->has_acc_offset
+             ? RequantizationShifts(table) + table->output_depth
+             : nullptr;
+}
+
+inline int RequantizationTableBytes(int output_depth, bool has_acc_offset) {
+  return sizeof(TfLiteRequantizationTable) +
+         (has_acc_offset ? 3 : 2) * output_depth * sizeof(int32_t);
+}
+
+// Table attached to a builtin node by AttachRequantizationTables(), nullptr
+// if the model has none or it doesn't match output_depth.
+inline const TfLiteRequantizationTable* GetRequantizationTable(
+    const TfLiteNode* node, int output_depth) {
+  if (node->custom_initial_data == nullptr ||
+      node->custom_initial_data_size <
+          static_cast<int>(sizeof(TfLiteRequantizationTable))) {
+    return nullptr;
+  }
+  const auto* table = static_cast<const TfLiteRequantizationTable*>(
+      node->custom_initial_data);
+  return table->output_depth == output_depth ? table : nullptr;
+}
+
+// Points the custom_initial_data of the CONV_2D and DEPTHWISE_CONV_2D nodes
+// at their table in the kRequantizationMetadataName metadata of the model,
+// the builtin kernels don't read it otherwise. Nothing is done if the model
+// has no tables. Call it before the operators are patched and fused, the
+// patched and fused nodes carry the tables of the operators they replace
+// (micro_fusion.h). table_count receives the tables attached.
+TfLiteStatus AttachRequantizationTables(
+    const Model* model, const SubGraph* subgraph,
+    NodeAndRegistration* node_and_registrations,
+    ErrorReporter* error_reporter, int* table_count);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_REQUANTIZATION_H_
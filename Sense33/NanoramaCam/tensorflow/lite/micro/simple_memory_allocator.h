@@ -11,6 +11,9 @@ distributed under the License is distributed on an "AS IS" BASIS,
 WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
+
+Added ResetHead() for the temporary data kept at the head. E.M.
+
 ==============================================================================*/
 
 #ifndef TENSORFLOW_LITE_MICRO_SIMPLE_MEMORY_ALLOCATOR_H_
@@ -46,6 +49,9 @@ class SimpleMemoryAllocator {
   // moving downwards).
   uint8_t* AllocateFromTail(size_t size, size_t alignment);
 
+  // Frees all the head allocations, for temporary data kept at the head.
+  void ResetHead() { head_ = buffer_head_; }
+
   uint8_t* GetHead() const { return head_; }
   uint8_t* GetTail() const { return tail_; }
   size_t GetAvailableMemory() const { return tail_ - head_; }